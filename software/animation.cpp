@@ -0,0 +1,203 @@
+#include "animation.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "raster.h"
+
+// ========== 动画基类 ==========
+Animation::Animation(uint32_t duration_us, Easing easing, bool loop)
+    : duration_us(duration_us ? duration_us : 1),
+      easing(easing),
+      loop(loop),
+      start_us(0) {}
+
+bool Animation::finished(uint64_t now_us) const {
+  return !loop && now_us - start_us >= duration_us;
+}
+
+float Animation::progress(uint64_t now_us) const {
+  uint64_t elapsed = now_us - start_us;
+  if (loop) elapsed %= duration_us;
+  float t = elapsed >= duration_us ? 1.0f : (float)elapsed / duration_us;
+
+  if (easing == EASE_IN_OUT) {
+    if (t < 0.5f) return 4 * t * t * t;
+    float f = -2 * t + 2;
+    return 1 - f * f * f / 2;
+  }
+  return t;
+}
+
+// ========== 具体动画 ==========
+TweenAnimation::TweenAnimation(int from, int to, uint32_t duration_us,
+                               std::function<void(OLED &, int)> draw,
+                               Easing easing)
+    : Animation(duration_us, easing), from(from), to(to), draw(draw) {}
+
+void TweenAnimation::render(OLED &oled, float t) {
+  draw(oled, from + (int)lroundf((to - from) * t));
+}
+
+SlideAnimation::SlideAnimation(int from_x, int from_y, int to_x, int to_y,
+                               uint32_t duration_us,
+                               std::function<void(OLED &, int, int)> draw,
+                               Easing easing)
+    : Animation(duration_us, easing),
+      from_x(from_x),
+      from_y(from_y),
+      to_x(to_x),
+      to_y(to_y),
+      draw(draw) {}
+
+void SlideAnimation::render(OLED &oled, float t) {
+  draw(oled, from_x + (int)lroundf((to_x - from_x) * t),
+       from_y + (int)lroundf((to_y - from_y) * t));
+}
+
+// 8x8 Bayer矩阵（0~63）
+static const uint8_t kBayer8[8][8] = {
+    {0, 32, 8, 40, 2, 34, 10, 42},  {48, 16, 56, 24, 50, 18, 58, 26},
+    {12, 44, 4, 36, 14, 46, 6, 38}, {60, 28, 52, 20, 62, 30, 54, 22},
+    {3, 35, 11, 43, 1, 33, 9, 41},  {51, 19, 59, 27, 49, 17, 57, 25},
+    {15, 47, 7, 39, 13, 45, 5, 37}, {63, 31, 55, 23, 61, 29, 53, 21},
+};
+
+FadeAnimation::FadeAnimation(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2,
+                             bool fade_in, uint32_t duration_us)
+    : Animation(duration_us),
+      x1(x1),
+      y1(y1),
+      x2(x2),
+      y2(y2),
+      fade_in(fade_in) {}
+
+void FadeAnimation::render(OLED &oled, float t) {
+  int level = (int)((fade_in ? t : 1 - t) * 64);
+  if (level >= 64) return;
+
+  // 每种列相位(x & 7)对应一个保留掩码：Bayer值小于level的行保留
+  uint8_t keep[8];
+  for (int c = 0; c < 8; c++) {
+    keep[c] = 0;
+    for (int r = 0; r < 8; r++) {
+      if (kBayer8[r][c] < level) keep[c] |= 1 << r;
+    }
+  }
+
+  int right = x2 < oled.getWidth() ? x2 : oled.getWidth() - 1;
+  int bottom = y2 < oled.getHeight() ? y2 : oled.getHeight() - 1;
+  for (int page = y1 / 8; page <= bottom / 8; page++) {
+    int top = page * 8;
+    int a = y1 > top ? y1 - top : 0;
+    int b = bottom < top + 7 ? bottom - top : 7;
+    uint8_t rows = (uint8_t)((0xFF << a) & (0xFF >> (7 - b)));
+    uint8_t *row = oled.getPage_GRAM(page);
+    for (int x = x1; x <= right; x++) row[x] &= keep[x & 7] | ~rows;
+  }
+}
+
+BlinkAnimation::BlinkAnimation(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2,
+                               uint32_t period_us, uint32_t count)
+    : Animation(count ? period_us * count : period_us, EASE_LINEAR,
+                count == 0),
+      x1(x1),
+      y1(y1),
+      x2(x2),
+      y2(y2),
+      count(count) {}
+
+void BlinkAnimation::render(OLED &oled, float t) {
+  float cycles = count ? (float)count : 1.0f;
+  float phase = t * cycles - floorf(t * cycles);
+  if (t < 1.0f && phase < 0.5f) {
+    rasterInvertRect(oled.getPage_GRAM(0), x1, y1, x2, y2, oled.getWidth(),
+                     oled.getHeight());
+  }
+}
+
+// ========== 调度器 ==========
+Animator::Animator(OLED &oled, uint32_t frame_budget_us)
+    : oled(oled), budget_us(frame_budget_us), next_deadline(0) {
+  stats = Stats();
+}
+
+Animator::~Animator() { clear(); }
+
+void Animator::add(Animation *anim) {
+  uint64_t now = monotonicUs();
+  if (anims.empty()) next_deadline = now;
+  anim->start(now);
+  anims.push_back(anim);
+}
+
+void Animator::clear(void) {
+  for (size_t i = 0; i < anims.size(); i++) delete anims[i];
+  anims.clear();
+}
+
+uint32_t Animator::frame(void) {
+  uint64_t now = monotonicUs();
+  if (now < next_deadline) return (uint32_t)(next_deadline - now);
+
+  // 绘制：背景 + 各动画在当前时刻的状态
+  oled.clear_GRAM();
+  if (background) background(oled);
+  for (size_t i = 0; i < anims.size(); i++) {
+    anims[i]->render(oled, anims[i]->progress(now));
+  }
+
+  // 只上传变化的区域
+  uint32_t bytes_before = oled.getTxBytes();
+  uint64_t upload_start = monotonicUs();
+  statsRecord(STAT_RASTER, upload_start - now);
+  oled.present();
+  uint64_t done = monotonicUs();
+
+  uint32_t frame_us = (uint32_t)(done - now);
+  stats.frames++;
+  stats.upload_bytes += oled.getTxBytes() - bytes_before;
+  stats.last_frame_us = frame_us;
+  if (frame_us > stats.max_frame_us) stats.max_frame_us = frame_us;
+  stats.total_frame_us += frame_us;
+  stats.total_upload_us += done - upload_start;
+
+  // 超出预算时跳过错过的帧时刻，下一帧直接追上当前时间
+  next_deadline += budget_us;
+  if (done > next_deadline) {
+    uint32_t missed = (uint32_t)((done - next_deadline) / budget_us) + 1;
+    stats.dropped += missed;
+    next_deadline += (uint64_t)missed * budget_us;
+  }
+
+  // 移除已结束的动画（最后一帧已按t=1绘制）
+  for (size_t i = 0; i < anims.size();) {
+    if (anims[i]->finished(now)) {
+      delete anims[i];
+      anims.erase(anims.begin() + i);
+    } else {
+      i++;
+    }
+  }
+
+  done = monotonicUs();
+  return done < next_deadline ? (uint32_t)(next_deadline - done) : 0;
+}
+
+void Animator::run(void) {
+  while (active()) {
+    uint32_t wait = frame();
+    if (wait) usleep(wait);
+  }
+}
+
+void Animator::printStats(void) const {
+  uint32_t frames = stats.frames ? stats.frames : 1;
+  printf("Animation: %u frames, %u dropped, %u bytes uploaded\n",
+         stats.frames, stats.dropped, stats.upload_bytes);
+  printf("  frame avg %llu us, max %u us, upload avg %llu us\n",
+         (unsigned long long)(stats.total_frame_us / frames),
+         stats.max_frame_us,
+         (unsigned long long)(stats.total_upload_us / frames));
+}
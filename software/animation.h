@@ -0,0 +1,129 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+#include "oled.h"
+#include "stats.h"
+
+// 基于单调时钟的动画调度：动画状态只由时间决定，
+// 上传超出帧预算时直接跳帧（合并到下一帧），不会拖慢动画本身。
+
+enum Easing {
+  EASE_LINEAR,
+  EASE_IN_OUT,  // 三次缓入缓出
+};
+
+class Animation {
+ public:
+  Animation(uint32_t duration_us, Easing easing = EASE_LINEAR,
+            bool loop = false);
+  virtual ~Animation() {}
+
+  void start(uint64_t now_us) { start_us = now_us; }
+  bool finished(uint64_t now_us) const;
+  float progress(uint64_t now_us) const;  // 0~1，已应用缓动
+
+  // 按进度t绘制到GRAM
+  virtual void render(OLED &oled, float t) = 0;
+
+ protected:
+  uint32_t duration_us;
+  Easing easing;
+  bool loop;
+  uint64_t start_us;
+};
+
+// 数值补间：from -> to，每帧用当前值调用draw（用于滚动等）
+class TweenAnimation : public Animation {
+ public:
+  TweenAnimation(int from, int to, uint32_t duration_us,
+                 std::function<void(OLED &, int)> draw,
+                 Easing easing = EASE_IN_OUT);
+  void render(OLED &oled, float t);
+
+ private:
+  int from, to;
+  std::function<void(OLED &, int)> draw;
+};
+
+// 滑动：内容从(from_x, from_y)偏移移动到(to_x, to_y)
+class SlideAnimation : public Animation {
+ public:
+  SlideAnimation(int from_x, int from_y, int to_x, int to_y,
+                 uint32_t duration_us,
+                 std::function<void(OLED &, int, int)> draw,
+                 Easing easing = EASE_IN_OUT);
+  void render(OLED &oled, float t);
+
+ private:
+  int from_x, from_y, to_x, to_y;
+  std::function<void(OLED &, int, int)> draw;
+};
+
+// 抖动淡入/淡出：按Bayer阈值逐步屏蔽区域内的像素
+class FadeAnimation : public Animation {
+ public:
+  FadeAnimation(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, bool fade_in,
+                uint32_t duration_us);
+  void render(OLED &oled, float t);
+
+ private:
+  uint8_t x1, y1, x2, y2;
+  bool fade_in;
+};
+
+// 闪烁：区域按周期反色，count为0时一直闪烁
+class BlinkAnimation : public Animation {
+ public:
+  BlinkAnimation(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2,
+                 uint32_t period_us, uint32_t count = 0);
+  void render(OLED &oled, float t);
+
+ private:
+  uint8_t x1, y1, x2, y2;
+  uint32_t count;
+};
+
+class Animator {
+ public:
+  struct Stats {
+    uint32_t frames;         // 已上传的帧数
+    uint32_t dropped;        // 因超出预算而跳过的帧数
+    uint32_t upload_bytes;   // 累计上传字节
+    uint32_t last_frame_us;  // 最近一帧耗时（绘制+上传）
+    uint32_t max_frame_us;
+    uint64_t total_frame_us;
+    uint64_t total_upload_us;
+  };
+
+  Animator(OLED &oled, uint32_t frame_budget_us = 33333);
+  ~Animator();
+
+  // 每帧先调用背景绘制，再按加入顺序绘制动画
+  void setBackground(std::function<void(OLED &)> draw) { background = draw; }
+  void add(Animation *anim);  // 接管所有权，动画结束后自动释放
+  void clear(void);
+  bool active(void) const { return !anims.empty(); }
+
+  // 到达帧时刻时绘制并上传一帧，返回距离下一帧的微秒数
+  uint32_t frame(void);
+  // 运行到所有动画结束
+  void run(void);
+
+  const Stats &getStats(void) const { return stats; }
+  void printStats(void) const;
+
+ private:
+  OLED &oled;
+  uint32_t budget_us;
+  uint64_t next_deadline;
+  std::function<void(OLED &)> background;
+  std::vector<Animation *> anims;
+  Stats stats;
+};
+
+#endif  // ANIMATION_H
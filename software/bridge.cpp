@@ -0,0 +1,852 @@
+#include "bridge.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "stats.h"
+
+// epoll事件的来源
+enum {
+  SOURCE_LISTEN,
+  SOURCE_CLIENT,
+  SOURCE_PROBE,
+};
+
+// 缓冲池：每个在途请求一个IN缓冲，每个连接一个接收缓冲，另有等待发送的应答
+#define BRIDGE_BUFFER_SIZE (sizeof(BridgeRequest) + BRIDGE_MAX_PAYLOAD)
+// 差额轮转每轮给一个连接的额度，不小于最大的单个请求
+#define BRIDGE_DRR_QUANTUM (BRIDGE_BUFFER_SIZE + BRIDGE_MAX_PAYLOAD)
+// 持锁连接没有新请求超过此时间且有别人在等时收回锁
+#define BRIDGE_LOCK_IDLE_US 2000000
+
+static inline int atLeastOne(int v) { return v > 0 ? v : 1; }
+
+// 调度时按请求在USB上占用的字节计费
+static inline uint32_t requestCost(uint32_t tx_len, uint32_t ref_len,
+                                   uint32_t rx_len) {
+  uint64_t cost = sizeof(BridgeRequest) + (uint64_t)tx_len + ref_len + rx_len;
+  return cost > BRIDGE_DRR_QUANTUM ? BRIDGE_DRR_QUANTUM : (uint32_t)cost;
+}
+
+JLinkBridge::JLinkBridge(Probe &probe, uint16_t port, int max_inflight,
+                         int max_clients)
+    : probe(probe),
+      listen_port(port),
+      max_inflight(atLeastOne(max_inflight)),
+      listen_fd(-1),
+      epoll_fd(-1),
+      session(0),
+      running(false),
+      pool(this->max_inflight * 2 + atLeastOne(max_clients) * 2 + 2,
+           BRIDGE_BUFFER_SIZE),
+      slots(this->max_inflight * 2 * atLeastOne(max_clients)),
+      free_slots(nullptr),
+      clients(atLeastOne(max_clients)),
+      connected(0),
+      orphans(nullptr),
+      inflight(0),
+      bulk_inflight(0),
+      pending(0),
+      priority(true),
+      bulk_limit(2),
+      rr_interactive(0),
+      rr_bulk(0),
+      lock_owner(nullptr),
+      lock_active_us(0),
+      upload_owner(nullptr),
+      cache(nullptr),
+      status_interval_us(0),
+      last_status_us(0),
+      status_dirty(false) {
+  memset(&stats, 0, sizeof(stats));
+  memset(&flash, 0, sizeof(flash));
+  for (size_t i = 0; i < slots.size(); i++) {
+    slots[i].next = free_slots;
+    free_slots = &slots[i];
+  }
+  for (size_t i = 0; i < clients.size(); i++) {
+    memset(&clients[i], 0, sizeof(Client));
+    clients[i].fd = -1;
+  }
+}
+
+JLinkBridge::~JLinkBridge() {
+  for (size_t i = 0; i < clients.size(); i++) dropClient(&clients[i]);
+  // 关闭探针会以错误完成在途传输，随后回收所有请求
+  probe.close();
+  reapOrphans();
+  if (listen_fd >= 0) close(listen_fd);
+  if (epoll_fd >= 0) close(epoll_fd);
+}
+
+bool JLinkBridge::start(void) {
+  if (!pool.ok() || !lz4.ok()) {
+    fprintf(stderr, "bridge: cannot allocate buffer pool\n");
+    return false;
+  }
+  listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0) {
+    perror("socket");
+    return false;
+  }
+  int one = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_ANY);
+  sa.sin_port = htons(listen_port);
+  socklen_t len = sizeof(sa);
+  if (bind(listen_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+      listen(listen_fd, (int)clients.size() + 1) < 0 ||
+      getsockname(listen_fd, (struct sockaddr *)&sa, &len) < 0) {
+    perror("bind");
+    return false;
+  }
+  listen_port = ntohs(sa.sin_port);
+
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    perror("epoll_create1");
+    return false;
+  }
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u64 = SOURCE_LISTEN;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+
+  // 探针的完成事件和套接字在同一个循环里处理，不需要额外线程
+  std::vector<struct pollfd> fds;
+  probe.pollFds(fds);
+  ev.data.u64 = SOURCE_PROBE;
+  for (size_t i = 0; i < fds.size(); i++) {
+    ev.events = 0;
+    if (fds[i].events & POLLIN) ev.events |= EPOLLIN;
+    if (fds[i].events & POLLOUT) ev.events |= EPOLLOUT;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fds[i].fd, &ev);
+  }
+  running = true;
+  return true;
+}
+
+void JLinkBridge::accept(void) {
+  struct sockaddr_in peer;
+  socklen_t len = sizeof(peer);
+  int fd = ::accept4(listen_fd, (struct sockaddr *)&peer, &len,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (fd < 0) return;
+  // 轮流复用空闲槽位，刚断开的连接的统计保留得久一些
+  Client *c = nullptr;
+  for (size_t k = 0; k < clients.size() && !c; k++) {
+    Client *slot = &clients[(session + k) % clients.size()];
+    if (slot->fd < 0) c = slot;
+  }
+  if (!c) {
+    printf("bridge busy, rejecting %s\n", inet_ntoa(peer.sin_addr));
+    close(fd);
+    return;
+  }
+
+  // 关闭Nagle：应答在每轮循环末尾合并成一次send，不需要内核再攒包
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  memset(c, 0, sizeof(*c));
+  c->fd = fd;
+  c->session = ++session;
+  c->events = EPOLLIN;
+  snprintf(c->stats.peer, sizeof(c->stats.peer), "%s:%u",
+           inet_ntoa(peer.sin_addr), ntohs(peer.sin_port));
+  c->stats.connected = true;
+  c->stats.connected_us = monotonicUs();
+  if (++connected > (int)stats.max_clients) stats.max_clients = connected;
+  status_dirty = true;
+
+  struct epoll_event ev;
+  ev.events = c->events;
+  ev.data.u64 = SOURCE_CLIENT | (uint64_t)(c - &clients[0]) << 8;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+  printf("bridge client %s connected\n", c->stats.peer);
+}
+
+void JLinkBridge::dropClient(Client *c) {
+  if (c->fd < 0) return;
+  close(c->fd);  // 关闭时自动移出epoll
+  c->fd = -1;
+  connected--;
+  if (c->recv_buf) pool.release(c->recv_buf);
+  c->recv_buf = nullptr;
+  c->recv_len = c->parse_off = 0;
+
+  // 未提交的请求直接回收；已在USB上的仍持有各自的缓冲，完成后在
+  // reapOrphans()中回收
+  while (c->head) {
+    Request *r = c->head;
+    c->head = r->next;
+    if (!r->submitted) {
+      pending--;
+      recycle(r);
+    } else if (r->waiting == 0) {
+      retire(r);
+    } else {
+      r->next = orphans;
+      orphans = r;
+    }
+  }
+  c->tail = c->next_submit = nullptr;
+  c->queued = 0;
+  c->deficit = 0;
+  if (lock_owner == c) lock_owner = nullptr;
+  if (upload_owner == c) {
+    cache->abortUpload();
+    upload_owner = nullptr;
+  }
+  c->stats.connected = false;
+  status_dirty = true;
+
+  const StatSnapshot &l = c->stats.latency;
+  printf("bridge client %s disconnected: %llu requests, latency avg %llu us, "
+         "p99 %llu us\n",
+         c->stats.peer, (unsigned long long)c->stats.requests,
+         (unsigned long long)(l.count ? l.sum / l.count : 0),
+         (unsigned long long)l.percentile(0.99));
+}
+
+// 直接读进接收缓冲，读到EAGAIN或缓冲满为止；对端关闭或出错时返回false
+bool JLinkBridge::readClient(Client *c) {
+  for (;;) {
+    if (!c->recv_buf) {
+      c->recv_buf = pool.acquire();
+      if (!c->recv_buf) {
+        stats.pool_stalls++;
+        return true;
+      }
+      c->recv_len = c->parse_off = 0;
+    }
+    size_t space = pool.bufferSize() - c->recv_len;
+    if (space == 0) return true;
+
+    ssize_t n = recv(c->fd, c->recv_buf->data + c->recv_len, space, 0);
+    stats.recvs++;
+    if (n > 0) {
+      c->recv_len += n;
+      stats.net_in += n;
+      if ((size_t)n < space) return true;  // 已读空，省掉一次EAGAIN
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+    if (n < 0 && errno == EINTR) continue;
+    return false;
+  }
+}
+
+// 把完整请求原地解析进连接自己的队列，由schedule()决定何时提交；
+// 协议错误时返回false
+bool JLinkBridge::parseRequests(Client *c) {
+  while (c->recv_buf && c->queued < max_inflight * 2 && free_slots) {
+    uint32_t rest = c->recv_len - c->parse_off;
+    BridgeRequest hdr;
+    if (rest < sizeof(hdr)) break;
+    memcpy(&hdr, c->recv_buf->data + c->parse_off, sizeof(hdr));
+    int op = hdr.tx_len >> BRIDGE_OP_SHIFT;
+    uint32_t len = hdr.tx_len & BRIDGE_LEN_MASK;
+    bool compressed = op & BRIDGE_OP_LZ4;
+    op &= ~BRIDGE_OP_LZ4;
+    bool usb = op == BRIDGE_OP_XFER || op == BRIDGE_OP_XFER_REF;
+    if (op >= BRIDGE_OP_COUNT || len > BRIDGE_MAX_PAYLOAD ||
+        hdr.rx_len > BRIDGE_MAX_PAYLOAD || (!usb && hdr.rx_len) ||
+        (compressed && (!(c->features & BRIDGE_FEATURE_LZ4) ||
+                        (op != BRIDGE_OP_XFER && op != BRIDGE_OP_IMAGE_DATA)))) {
+      fprintf(stderr, "bridge: bad request %08x/%u from %s\n", hdr.tx_len,
+              hdr.rx_len, c->stats.peer);
+      return false;
+    }
+    if (rest < sizeof(hdr) + len) break;
+
+    // 压缩的负载解到池里的缓冲，之后和未压缩的一样处理；
+    // 同样留一个缓冲给接收缓冲换页
+    const uint8_t *payload = c->recv_buf->data + c->parse_off + sizeof(hdr);
+    PoolBuffer *raw = nullptr;
+    if (compressed) {
+      if (pool.available() < 2) {
+        stats.pool_stalls++;
+        break;
+      }
+      raw = pool.acquire();
+      int n = inflate(payload, len, raw);
+      if (n < 0) {
+        pool.release(raw);
+        fprintf(stderr, "bridge: bad compressed payload from %s\n",
+                c->stats.peer);
+        return false;
+      }
+      payload = raw->data;
+      len = n;
+    }
+    c->parse_off += sizeof(hdr) + (hdr.tx_len & BRIDGE_LEN_MASK);
+    Request *r = free_slots;
+    free_slots = r->next;
+    r->next = nullptr;
+    r->client = c;
+    r->session = c->session;
+    r->op = op;
+    r->bulk = false;
+    r->submitted = false;
+    r->tx_buf = nullptr;
+    r->tx = payload;
+    r->tx_len = 0;
+    r->image = nullptr;
+    r->ref = nullptr;
+    r->ref_len = 0;
+    r->rx_buf = nullptr;
+    r->rx_len = hdr.rx_len;
+    r->z_buf = nullptr;
+    r->packed = false;
+    r->reply.status = PROBE_OK;
+    r->reply.len = 0;
+    r->waiting = 1;
+    r->sent = 0;
+    r->start_us = monotonicUs();
+    if (c->tail) {
+      c->tail->next = r;
+    } else {
+      c->head = r;
+    }
+    c->tail = r;
+    c->queued++;
+
+    bool scheduled = usb || op == BRIDGE_OP_LOCK || op == BRIDGE_OP_UNLOCK;
+    if (op == BRIDGE_OP_FEATURES) {
+      uint32_t want = 0;
+      if (len >= sizeof(want)) memcpy(&want, payload, sizeof(want));
+      c->features = want & BRIDGE_FEATURE_LZ4;
+      r->submitted = true;
+      complete(r, (int)c->features);
+      continue;
+    }
+    if (!scheduled) {
+      // 镜像操作不经过探针，在这里同步完成，应答仍按请求顺序返回
+      r->submitted = true;
+      complete(r, imageCommand(c, op, payload, len));
+      if (raw) pool.release(raw);
+      continue;
+    }
+    int status = PROBE_OK;
+    if (op == BRIDGE_OP_XFER_REF) status = resolveRef(r, payload, len);
+    if (status != PROBE_OK) {
+      r->submitted = true;
+      complete(r, status);
+      continue;
+    }
+    if (op == BRIDGE_OP_XFER) r->tx_len = len;
+    if (raw) {
+      r->tx_buf = raw;  // 接过acquire的引用
+    } else if (r->tx_len) {
+      r->tx_buf = c->recv_buf;
+      pool.ref(c->recv_buf);
+    }
+    r->bulk = usb && (uint64_t)r->tx_len + r->ref_len + r->rx_len >=
+                         BRIDGE_BULK_BYTES;
+    if (!c->next_submit) c->next_submit = r;
+    pending++;
+  }
+  return true;
+}
+
+// 上传状态只有一份：同一时间只有一个连接能上传镜像
+int JLinkBridge::imageCommand(Client *c, int op, const uint8_t *payload,
+                              uint32_t len) {
+  if (!cache) return BRIDGE_NOT_CACHED;
+  switch (op) {
+    case BRIDGE_OP_IMAGE_QUERY:
+      if (len != SHA256_LEN) return BRIDGE_BAD_IMAGE;
+      return cache->contains(payload) ? PROBE_OK : BRIDGE_NOT_CACHED;
+    case BRIDGE_OP_IMAGE_BEGIN: {
+      BridgeImageBegin begin;
+      if (len != sizeof(begin)) return BRIDGE_BAD_IMAGE;
+      memcpy(&begin, payload, sizeof(begin));
+      if (upload_owner && upload_owner != c) return BRIDGE_BUSY;
+      if (!cache->beginUpload(begin.hash, begin.size)) {
+        upload_owner = nullptr;
+        return BRIDGE_BAD_IMAGE;
+      }
+      upload_owner = c;
+      return PROBE_OK;
+    }
+    case BRIDGE_OP_IMAGE_DATA:
+      if (upload_owner != c) return BRIDGE_BAD_IMAGE;
+      // 直接从接收缓冲写到缓存文件
+      return cache->appendUpload(payload, len) ? PROBE_OK : BRIDGE_BAD_IMAGE;
+    case BRIDGE_OP_IMAGE_END:
+      if (upload_owner != c) return BRIDGE_BAD_IMAGE;
+      upload_owner = nullptr;
+      return cache->finishUpload() ? PROBE_OK : BRIDGE_BAD_IMAGE;
+  }
+  return BRIDGE_BAD_IMAGE;
+}
+
+// 解析XFER_REF：命令头留在接收缓冲里，镜像片段指向缓存的映射区
+int JLinkBridge::resolveRef(Request *r, const uint8_t *payload, uint32_t len) {
+  BridgeImageRef ref;
+  if (len < sizeof(ref)) return BRIDGE_BAD_IMAGE;
+  memcpy(&ref, payload, sizeof(ref));
+  CachedImage *img = cache ? cache->acquire(ref.hash) : nullptr;
+  if (!img) return BRIDGE_NOT_CACHED;
+  if ((uint64_t)ref.offset + ref.length > img->size) {
+    cache->release(img);
+    return BRIDGE_BAD_IMAGE;
+  }
+  r->image = img;
+  r->ref = img->data + ref.offset;
+  r->ref_len = ref.length;
+  r->tx = payload + sizeof(ref);
+  r->tx_len = len - sizeof(ref);
+  return PROBE_OK;
+}
+
+// 压缩负载：uint32原始长度 + LZ4块；返回原始长度，损坏时返回-1
+int JLinkBridge::inflate(const uint8_t *payload, uint32_t len,
+                         PoolBuffer *out) {
+  uint32_t raw;
+  if (len < sizeof(raw)) return -1;
+  memcpy(&raw, payload, sizeof(raw));
+  if (raw > BRIDGE_MAX_PAYLOAD) return -1;
+  uint64_t start = monotonicUs();
+  int n = Lz4Codec::decompress(payload + sizeof(raw), len - sizeof(raw),
+                               out->data, raw);
+  stats.lz4_us += monotonicUs() - start;
+  if (n != (int)raw) return -1;
+  stats.lz4_in_raw += raw;
+  stats.lz4_in_wire += len;
+  return n;
+}
+
+// 发送前决定应答是否压缩：协商过、数据够长、压缩后更小，且池里有富余
+void JLinkBridge::pack(Client *c, Request *r) {
+  r->packed = true;
+  uint32_t raw = r->reply.len;
+  if (!(c->features & BRIDGE_FEATURE_LZ4) || raw < BRIDGE_LZ4_MIN ||
+      pool.available() < 2) {
+    return;
+  }
+  PoolBuffer *z = pool.acquire();
+  uint64_t start = monotonicUs();
+  // 压缩后至少省下头部的长度才值得
+  size_t n = lz4.compress(r->rx_buf->data, raw, z->data + sizeof(raw),
+                          raw - sizeof(raw) - 1);
+  stats.lz4_us += monotonicUs() - start;
+  if (!n) {
+    pool.release(z);
+    return;
+  }
+  memcpy(z->data, &raw, sizeof(raw));
+  r->z_buf = z;
+  r->reply.len = BRIDGE_REPLY_LZ4 | (uint32_t)(sizeof(raw) + n);
+  stats.lz4_out_raw += raw;
+  stats.lz4_out_wire += sizeof(raw) + n;
+}
+
+// 接收缓冲写满时腾出空间：只有末尾的半截请求需要搬到新缓冲
+void JLinkBridge::compactReceive(Client *c) {
+  if (!c->recv_buf) return;
+  uint32_t rest = c->recv_len - c->parse_off;
+  if (rest == 0 && c->recv_buf->refs == 1) {
+    c->recv_len = c->parse_off = 0;  // 没有请求引用，原地复用
+    return;
+  }
+  if (c->recv_len < pool.bufferSize()) return;
+
+  if (rest == 0) {
+    pool.release(c->recv_buf);
+    c->recv_buf = nullptr;  // 下次读时再取新缓冲
+    return;
+  }
+  BridgeRequest hdr;
+  if (rest >= sizeof(hdr)) {
+    memcpy(&hdr, c->recv_buf->data + c->parse_off, sizeof(hdr));
+    // 完整请求，等队列名额
+    if (rest >= sizeof(hdr) + (hdr.tx_len & BRIDGE_LEN_MASK)) return;
+  }
+
+  if (c->recv_buf->refs == 1) {
+    memmove(c->recv_buf->data, c->recv_buf->data + c->parse_off, rest);
+  } else {
+    PoolBuffer *b = pool.acquire();
+    if (!b) {
+      stats.pool_stalls++;
+      return;
+    }
+    memcpy(b->data, c->recv_buf->data + c->parse_off, rest);
+    pool.release(c->recv_buf);
+    c->recv_buf = b;
+  }
+  stats.carried += rest;
+  c->recv_len = rest;
+  c->parse_off = 0;
+}
+
+// 从各连接的队列里挑请求提交，直到在途名额用完。
+// 探针按提交顺序执行，交错的粒度是整个请求（OUT+IN），不会拆开
+void JLinkBridge::schedule(void) {
+  uint64_t now = monotonicUs();
+  if (lock_owner && !lock_owner->next_submit && pending > 0 &&
+      now - lock_active_us >= BRIDGE_LOCK_IDLE_US) {
+    fprintf(stderr, "bridge: %s held the probe lock while idle, releasing\n",
+            lock_owner->stats.peer);
+    stats.lock_timeouts++;
+    lock_owner = nullptr;
+  }
+
+  while (pending > 0 && inflight < max_inflight) {
+    // 留一个缓冲给接收缓冲换页，避免应答占满池后无法再读
+    if (pool.available() < 2) {
+      stats.pool_stalls++;
+      break;
+    }
+    Client *c = pick();
+    if (!c) break;
+    Request *r = c->next_submit;
+    Request *next = r->next;
+    while (next && next->submitted) next = next->next;
+    c->next_submit = next;
+    pending--;
+    r->submitted = true;
+    if (c == lock_owner) lock_active_us = now;
+
+    if (r->op == BRIDGE_OP_LOCK) {
+      lock_owner = c;
+      lock_active_us = now;
+      complete(r, PROBE_OK);
+    } else if (r->op == BRIDGE_OP_UNLOCK) {
+      if (lock_owner == c) lock_owner = nullptr;
+      complete(r, PROBE_OK);
+    } else if (r->rx_len && !(r->rx_buf = pool.acquire())) {
+      complete(r, PROBE_ERROR);
+    } else {
+      submit(r);
+    }
+  }
+}
+
+// 选下一个提交的连接：持锁连接独占；否则交互请求轮转优先，
+// 大块传输之间按字节差额轮转，每个有积压的连接轮到时加一份额度
+JLinkBridge::Client *JLinkBridge::pick(void) {
+  if (lock_owner) return lock_owner->next_submit ? lock_owner : nullptr;
+  int n = (int)clients.size();
+  if (!priority) {
+    Client *best = nullptr;
+    for (int i = 0; i < n; i++) {
+      Client *c = &clients[i];
+      if (c->next_submit &&
+          (!best || c->next_submit->start_us < best->next_submit->start_us)) {
+        best = c;
+      }
+    }
+    return best;
+  }
+
+  for (int k = 0; k < n; k++) {
+    int i = (rr_interactive + k) % n;
+    if (clients[i].next_submit && !clients[i].next_submit->bulk) {
+      rr_interactive = (i + 1) % n;
+      return &clients[i];
+    }
+  }
+  // 探针按顺序执行，交互命令要排在已提交的大块传输之后，所以有别的连接时
+  // 只让少量大块传输在途
+  if (connected > 1 && bulk_inflight >= bulk_limit) {
+    stats.bulk_deferred++;
+    return nullptr;
+  }
+  for (int k = 0; k <= n; k++) {
+    Client *c = &clients[rr_bulk];
+    if (c->next_submit) {
+      Request *r = c->next_submit;
+      uint32_t cost = requestCost(r->tx_len, r->ref_len, r->rx_len);
+      if (c->deficit >= cost) {
+        c->deficit -= cost;
+        return c;
+      }
+    } else {
+      c->deficit = 0;  // 没有积压的连接不积累额度
+    }
+    rr_bulk = (rr_bulk + 1) % n;
+    if (clients[rr_bulk].next_submit) {
+      clients[rr_bulk].deficit += BRIDGE_DRR_QUANTUM;
+    }
+  }
+  return nullptr;
+}
+
+// OUT和IN同时排队：IN在OUT之后提交，探针一应答就能立即读回，不用等下一轮循环
+void JLinkBridge::submit(Request *r) {
+  if (++inflight > (int)stats.max_inflight) stats.max_inflight = inflight;
+  if (r->bulk) bulk_inflight++;
+  r->waiting = 1;  // 提交期间占位，同步失败的回调不会提前完成请求
+
+  if (r->tx_len) {
+    r->waiting++;
+    if (!probe.submitOut(r->tx, r->tx_len,
+                         [this, r](int status, const uint8_t *, size_t) {
+                           finished(r, status);
+                         })) {
+      finished(r, PROBE_ERROR);
+    }
+  }
+  if (r->ref_len) {
+    r->waiting++;
+    if (!probe.submitOut(r->ref, r->ref_len,
+                         [this, r](int status, const uint8_t *, size_t) {
+                           finished(r, status);
+                         })) {
+      finished(r, PROBE_ERROR);
+    }
+  }
+  if (r->rx_len) {
+    r->waiting++;
+    if (!probe.submitIn(r->rx_buf->data, r->rx_len,
+                        [this, r](int status, const uint8_t *, size_t len) {
+                          if (status == PROBE_OK) r->reply.len = len;
+                          finished(r, status);
+                        })) {
+      finished(r, PROBE_ERROR);
+    }
+  }
+  finished(r, PROBE_OK);
+}
+
+// 不经过USB的请求直接完成
+void JLinkBridge::complete(Request *r, int status) {
+  r->reply.status = status;
+  r->waiting = 0;
+  r->done_us = monotonicUs();
+}
+
+void JLinkBridge::finished(Request *r, int status) {
+  if (status != PROBE_OK && r->reply.status == PROBE_OK) {
+    r->reply.status = status;
+  }
+  if (--r->waiting == 0) {
+    inflight--;
+    if (r->bulk) bulk_inflight--;
+    r->done_us = monotonicUs();
+  }
+}
+
+// 应答已发出（或客户端已断开）：记录统计，归还缓冲和请求
+void JLinkBridge::retire(Request *r) {
+  // 查询未命中是正常结果，不计为错误；FEATURES的status为非负的特性位
+  bool error = r->reply.status < 0 &&
+               !(r->op == BRIDGE_OP_IMAGE_QUERY &&
+                 r->reply.status == BRIDGE_NOT_CACHED);
+  uint32_t got = r->reply.len;
+  if (r->z_buf) memcpy(&got, r->z_buf->data, sizeof(got));
+  statsRecord(STAT_BRIDGE, r->done_us - r->start_us, r->tx_len + got, error);
+  stats.requests++;
+  stats.tx_bytes += r->tx_len;
+  stats.rx_bytes += got;
+  if (error) stats.errors++;
+  status_dirty = true;
+  if (r->client->session == r->session) {
+    ClientStats &cs = r->client->stats;
+    uint32_t bytes = r->tx_len + r->ref_len + got;
+    cs.requests++;
+    if (r->bulk) cs.bulk++;
+    cs.bytes += bytes;
+    cs.latency.add(r->done_us - r->start_us, bytes, error);
+  }
+
+  if (r->image) {
+    // 换了镜像时重新开始计算进度
+    if (!flash.active || memcmp(flash.hash, r->image->hash, SHA256_LEN)) {
+      memcpy(flash.hash, r->image->hash, SHA256_LEN);
+      flash.size = r->image->size;
+      flash.streamed = 0;
+      flash.passes = 0;
+      flash.active = true;
+    }
+    // 引用镜像开头时认为开始新一次烧录
+    if (r->ref == r->image->data && r->ref_len) {
+      flash.streamed = 0;
+      flash.passes++;
+    }
+    if (!error) {
+      flash.streamed += r->ref_len;
+      stats.ref_bytes += r->ref_len;
+    }
+  }
+  recycle(r);
+}
+
+// 归还请求持有的镜像引用、缓冲和槽位
+void JLinkBridge::recycle(Request *r) {
+  if (r->image) cache->release(r->image);
+  if (r->tx_buf) pool.release(r->tx_buf);
+  if (r->rx_buf) pool.release(r->rx_buf);
+  if (r->z_buf) pool.release(r->z_buf);
+  r->next = free_slots;
+  free_slots = r;
+}
+
+// 把已按序完成的应答用一次sendmsg发出，写不完的部分等EPOLLOUT
+bool JLinkBridge::flush(Client *c) {
+  Request *head = c->head;
+  if (c->fd < 0 || !head || !head->submitted || head->waiting) return true;
+
+  int n_iov = 0;
+  for (Request *r = head; r && r->submitted && r->waiting == 0 &&
+                          n_iov + 2 <= BRIDGE_IOV_MAX;
+       r = r->next) {
+    if (!r->packed) pack(c, r);
+    uint32_t off = r->sent;
+    if (off < sizeof(BridgeReply)) {
+      iov[n_iov].iov_base = (uint8_t *)&r->reply + off;
+      iov[n_iov].iov_len = sizeof(BridgeReply) - off;
+      n_iov++;
+      off = 0;
+    } else {
+      off -= sizeof(BridgeReply);
+    }
+    uint32_t len = r->reply.len & ~BRIDGE_REPLY_LZ4;
+    if (len > off) {
+      iov[n_iov].iov_base = (r->z_buf ? r->z_buf : r->rx_buf)->data + off;
+      iov[n_iov].iov_len = len - off;
+      n_iov++;
+    }
+  }
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = n_iov;
+  ssize_t n = sendmsg(c->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+  stats.sends++;
+  stats.send_iovs += n_iov;
+  if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+  stats.net_out += n;
+
+  while (n > 0) {
+    Request *r = c->head;
+    size_t left =
+        sizeof(BridgeReply) + (r->reply.len & ~BRIDGE_REPLY_LZ4) - r->sent;
+    if ((size_t)n < left) {
+      r->sent += n;
+      break;
+    }
+    n -= left;
+    c->head = r->next;
+    c->queued--;
+    retire(r);
+  }
+  if (!c->head) c->tail = nullptr;
+  return true;
+}
+
+// 断开的连接留下的请求完成后回收
+void JLinkBridge::reapOrphans(void) {
+  Request **p = &orphans;
+  while (*p) {
+    Request *r = *p;
+    if (r->waiting) {
+      p = &r->next;
+      continue;
+    }
+    *p = r->next;
+    retire(r);
+  }
+}
+
+void JLinkBridge::updateInterest(Client *c) {
+  if (c->fd < 0) return;
+  uint32_t want = 0;
+  if (c->recv_buf ? c->recv_len < pool.bufferSize() : pool.available() > 0) {
+    want |= EPOLLIN;
+  }
+  if (c->head && c->head->submitted && c->head->waiting == 0) want |= EPOLLOUT;
+  if (want == c->events) return;
+  c->events = want;
+  struct epoll_event ev;
+  ev.events = want;
+  ev.data.u64 = SOURCE_CLIENT | (uint64_t)(c - &clients[0]) << 8;
+  epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+void JLinkBridge::run(void) {
+  struct epoll_event events[16];
+  while (running) {
+    // 有在途传输时定期处理探针事件，兜底没有timerfd的libusb超时；
+    // 状态有变化时等到下一次状态刷新，有人等锁时等到锁可以收回
+    int timeout = inflight ? 100 : -1;
+    uint64_t now = monotonicUs();
+    if (status_hook && status_dirty) {
+      uint64_t due = last_status_us + status_interval_us;
+      int wait = now >= due ? 0 : (int)((due - now + 999) / 1000);
+      if (timeout < 0 || wait < timeout) timeout = wait;
+    }
+    if (lock_owner && pending > 0) {
+      uint64_t due = lock_active_us + BRIDGE_LOCK_IDLE_US;
+      int wait = now >= due ? 0 : (int)((due - now + 999) / 1000);
+      if (timeout < 0 || wait < timeout) timeout = wait;
+    }
+    int n = epoll_wait(epoll_fd, events, 16, timeout);
+    if (n < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      break;
+    }
+
+    bool probe_ready = n == 0;
+    for (int i = 0; i < n; i++) {
+      uint64_t tag = events[i].data.u64;
+      switch (tag & 0xff) {
+        case SOURCE_LISTEN:
+          accept();
+          break;
+        case SOURCE_CLIENT: {
+          Client *c = &clients[tag >> 8];
+          if (c->fd < 0) break;
+          if ((events[i].events & EPOLLIN) && !readClient(c)) {
+            dropClient(c);
+          } else if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+            dropClient(c);
+          }
+          break;
+        }
+        case SOURCE_PROBE:
+          probe_ready = true;
+          break;
+      }
+    }
+
+    // 先收完成再解析和调度新请求，空出的在途名额在同一轮就能用上
+    if (probe_ready) probe.handleEvents();
+    for (size_t i = 0; i < clients.size(); i++) {
+      if (clients[i].fd >= 0 && !parseRequests(&clients[i])) {
+        dropClient(&clients[i]);
+      }
+    }
+    schedule();
+    reapOrphans();
+    for (size_t i = 0; i < clients.size(); i++) {
+      Client *c = &clients[i];
+      compactReceive(c);
+      if (!flush(c)) dropClient(c);
+      updateInterest(c);
+    }
+
+    if (status_hook && status_dirty &&
+        monotonicUs() >= last_status_us + status_interval_us) {
+      status_dirty = false;
+      last_status_us = monotonicUs();
+      status_hook();
+    }
+  }
+}
@@ -0,0 +1,284 @@
+#ifndef BRIDGE_H
+#define BRIDGE_H
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "buffer_pool.h"
+#include "image_cache.h"
+#include "lz4_codec.h"
+#include "probe.h"
+#include "stats.h"
+
+// J-Link USB转TCP桥。
+// 桥转发J-Link USB批量端点上的原始命令，线上是下面的私有分帧协议，
+// 不是SEGGER J-Link Remote Server协议，J-Link软件包里的工具不能直接连接。
+// 主机端用BridgeClient（bridge_client.h）或jlink_remote工具访问。
+// 协议（小端）：请求为BridgeRequest + tx_len字节，桥把数据写到探针OUT端点，
+// 再从IN端点读rx_len字节，应答为BridgeReply + len字节。
+// 客户端可以连续发送多个请求，最多max_inflight个同时排队在USB上，应答按序返回。
+//
+// 数据路径不复制：请求数据直接从接收缓冲提交给OUT传输，IN传输读进池里的缓冲，
+// 应答头和数据用iovec一次sendmsg发出。只有跨越接收缓冲末尾的半截请求需要搬移。
+//
+// tx_len的高8位为操作码（0为普通传输）。固件镜像上传一次后存在本地缓存里，
+// 之后的烧录用BRIDGE_OP_XFER_REF引用镜像片段，数据从mmap直接交给USB，
+// 无线上只传命令头。
+//
+// 多个客户端（GDB、RTT查看器、烧录脚本……）可以共用一个探针：每个连接的请求
+// 先进自己的队列，由调度器按请求粒度交错提交到USB，各连接的应答仍按各自顺序。
+// 小请求（交互调试命令）优先于大块传输（烧录）；有其他连接时大块传输的在途数
+// 受限，交互命令最多排在几个大块传输之后；大块传输之间按字节做差额轮转。
+// 需要连续执行、不能被别人插入的一组命令用LOCK/UNLOCK括起来。
+//
+// 压缩（可选）：客户端先用FEATURES协商BRIDGE_FEATURE_LZ4。之后XFER和
+// IMAGE_DATA的操作码可以带BRIDGE_OP_LZ4，负载为uint32原始长度 + LZ4块；
+// 应答数据不小于BRIDGE_LZ4_MIN且压缩后更小时，len带BRIDGE_REPLY_LZ4，数据为
+// 同样格式。小命令不压缩，不增加交互延迟。
+
+#define JLINK_BRIDGE_PORT 19020
+#define BRIDGE_MAX_PAYLOAD 65536
+#define BRIDGE_IOV_MAX 64  // 每次sendmsg最多合并的iovec数
+#define BRIDGE_BULK_BYTES 4096  // 负载（含引用的镜像片段）达到此值算大块传输
+#define BRIDGE_LZ4_MIN 1024     // 应答数据短于此值时不压缩
+
+#define BRIDGE_OP_SHIFT 24
+#define BRIDGE_LEN_MASK 0x00FFFFFF
+
+enum BridgeOp {
+  BRIDGE_OP_XFER,         // 负载写到OUT，再读rx_len字节
+  BRIDGE_OP_IMAGE_QUERY,  // 负载为哈希，已缓存时status为0
+  BRIDGE_OP_IMAGE_BEGIN,  // 负载为BridgeImageBegin，开始上传
+  BRIDGE_OP_IMAGE_DATA,   // 负载为镜像数据，按顺序追加
+  BRIDGE_OP_IMAGE_END,    // 校验哈希并存入缓存
+  BRIDGE_OP_XFER_REF,     // 负载为BridgeImageRef + 命令头，OUT写命令头和镜像片段
+  BRIDGE_OP_LOCK,         // 独占探针，直到UNLOCK或断开（空闲过久会被收回）
+  BRIDGE_OP_UNLOCK,
+  BRIDGE_OP_FEATURES,     // 负载为uint32请求的特性，status为接受的特性
+  BRIDGE_OP_COUNT,
+};
+
+#define BRIDGE_OP_LZ4 0x80  // 操作码标志：负载经过压缩
+#define BRIDGE_REPLY_LZ4 0x80000000u  // BridgeReply.len标志：数据经过压缩
+
+#define BRIDGE_FEATURE_LZ4 0x1
+
+// 除PROBE_*以外的应答状态
+#define BRIDGE_NOT_CACHED -10
+#define BRIDGE_BAD_IMAGE -11
+#define BRIDGE_BUSY -12  // 另一个连接正在上传镜像
+
+struct BridgeRequest {
+  uint32_t tx_len;  // 操作码 << BRIDGE_OP_SHIFT | 负载长度
+  uint32_t rx_len;  // 0表示只写不读
+};
+
+struct BridgeReply {
+  int32_t status;  // PROBE_* / BRIDGE_*
+  // 实际读到的字节数，可能小于rx_len（短包）；带BRIDGE_REPLY_LZ4时为线上长度
+  uint32_t len;
+};
+
+struct BridgeImageBegin {
+  uint8_t hash[SHA256_LEN];
+  uint64_t size;
+};
+
+struct BridgeImageRef {
+  uint8_t hash[SHA256_LEN];
+  uint32_t offset;
+  uint32_t length;
+};
+
+class JLinkBridge {
+ public:
+  struct Counters {
+    uint64_t requests;
+    uint64_t tx_bytes;   // 从网络写到探针
+    uint64_t ref_bytes;  // 从镜像缓存写到探针
+    uint64_t rx_bytes;   // 从探针读到
+    uint64_t net_in;     // 套接字收到的总字节（含协议头和镜像上传）
+    uint64_t net_out;
+    uint64_t errors;
+    uint64_t recvs;       // 读套接字的系统调用次数
+    uint64_t sends;       // 写套接字的系统调用次数
+    uint64_t send_iovs;   // 合并进sendmsg的iovec总数
+    uint64_t carried;     // 跨接收缓冲搬移的字节
+    uint64_t pool_stalls;  // 缓冲池耗尽、暂停解析的次数
+    uint64_t bulk_deferred;  // 为交互请求让路、暂缓提交大块传输的次数
+    uint64_t lock_timeouts;  // 持锁连接空闲过久被收回锁的次数
+    uint64_t lz4_in_raw;     // 解压出的请求数据
+    uint64_t lz4_in_wire;    // 对应的压缩数据
+    uint64_t lz4_out_raw;    // 压缩过的应答数据
+    uint64_t lz4_out_wire;
+    uint64_t lz4_us;         // 压缩和解压耗时
+    uint32_t max_inflight;  // 实际达到的最大在途请求数
+    uint32_t max_clients;   // 同时连接数的峰值
+  };
+
+  // 每个连接的统计，断开后保留到槽位被复用
+  struct ClientStats {
+    char peer[24];  // 地址:端口
+    bool connected;
+    uint64_t requests;
+    uint64_t bulk;  // 其中的大块传输
+    uint64_t bytes;  // 写到和读自探针的字节
+    uint64_t connected_us;
+    StatSnapshot latency;  // 请求收到到探针应答（含排队），微秒
+  };
+
+  // 当前（最近）烧录的镜像
+  struct FlashProgress {
+    uint8_t hash[SHA256_LEN];
+    uint64_t size;
+    uint64_t streamed;  // 本次烧录已从缓存写到探针的字节
+    uint32_t passes;    // 从偏移0开始的烧录次数
+    bool active;
+  };
+
+  // port为0时由内核分配，start()后用port()查询；max_clients为1时拒绝第二个连接
+  JLinkBridge(Probe &probe, uint16_t port = JLINK_BRIDGE_PORT,
+              int max_inflight = 8, int max_clients = 1);
+  ~JLinkBridge();
+
+  bool start(void);
+  void run(void);
+  // 可在信号处理函数或其他线程中调用（无锁原子量）
+  void stop(void) { running.store(false); }
+
+  // 镜像缓存由调用者持有；为nullptr时镜像操作都返回BRIDGE_NOT_CACHED
+  void setImageCache(ImageCache *c) { cache = c; }
+  // 有请求完成时最多每interval_ms调用一次，用于刷新状态显示
+  void setStatusHook(std::function<void(void)> hook,
+                     uint32_t interval_ms = 200) {
+    status_hook = hook;
+    status_interval_us = interval_ms * 1000;
+  }
+
+  // priority为false时按到达顺序提交（对照用）；bulk_inflight为有多个连接时
+  // 大块传输的在途上限
+  void setScheduling(bool priority, int bulk_inflight = 2) {
+    this->priority = priority;
+    bulk_limit = bulk_inflight > 0 ? bulk_inflight : 1;
+  }
+
+  uint16_t port(void) const { return listen_port; }
+  bool clientConnected(void) const { return connected > 0; }
+  int clientCount(void) const { return connected; }
+  int clientSlots(void) const { return (int)clients.size(); }
+  const ClientStats &clientStats(int i) const { return clients[i].stats; }
+  const FlashProgress &progress(void) const { return flash; }
+  const Counters &counters(void) const { return stats; }
+  const BufferPool::Counters &poolCounters(void) const {
+    return pool.counters();
+  }
+
+ private:
+  struct Client;
+
+  struct Request {
+    Request *next;     // 所属连接的请求链表 / 空闲链表
+    Client *client;
+    uint32_t session;  // 所属连接，客户端断开后在途请求的应答被丢弃
+    int op;
+    bool bulk;
+    bool submitted;  // 已交给探针（或已同步完成）
+    PoolBuffer *tx_buf;  // tx指向的接收缓冲（持有一个引用）
+    const uint8_t *tx;
+    uint32_t tx_len;
+    CachedImage *image;  // XFER_REF引用的镜像（持有一个引用）
+    const uint8_t *ref;
+    uint32_t ref_len;
+    PoolBuffer *rx_buf;  // 提交时才从池里取
+    uint32_t rx_len;
+    PoolBuffer *z_buf;  // 压缩后的应答：uint32原始长度 + LZ4块
+    bool packed;        // 已决定是否压缩应答
+    BridgeReply reply;
+    int waiting;    // 尚未完成的传输数
+    uint32_t sent;  // 已发出的应答字节（头+数据）
+    uint64_t start_us;
+    uint64_t done_us;
+  };
+
+  struct Client {
+    int fd;  // -1为空闲槽位
+    uint32_t session;
+    uint32_t events;  // 当前注册的epoll事件
+    PoolBuffer *recv_buf;  // 当前接收缓冲，请求原地解析
+    uint32_t recv_len;
+    uint32_t parse_off;
+    Request *head, *tail;  // 应答尚未发完的请求，按到达顺序
+    Request *next_submit;  // 第一个尚未提交的请求
+    int queued;            // 链表中的请求数
+    uint32_t deficit;      // 差额轮转的剩余额度（字节）
+    uint32_t features;     // 协商的BRIDGE_FEATURE_*
+    ClientStats stats;
+  };
+
+  Probe &probe;
+  uint16_t listen_port;
+  int max_inflight;
+  int listen_fd;
+  int epoll_fd;
+  uint32_t session;
+  std::atomic<bool> running;  // 基准/驱动线程调用stop()，事件循环线程读取
+
+  BufferPool pool;
+  std::vector<Request> slots;  // 预分配的请求，数据路径上不分配内存
+  Request *free_slots;
+  std::vector<Client> clients;
+  int connected;
+  Request *orphans;  // 客户端断开时仍在USB上的请求，完成后回收
+  int inflight;      // 传输尚未完成的请求数
+  int bulk_inflight;
+  int pending;       // 已解析、尚未提交的请求数
+
+  bool priority;
+  int bulk_limit;
+  int rr_interactive;  // 轮转位置
+  int rr_bulk;
+  Client *lock_owner;
+  uint64_t lock_active_us;  // 持锁连接最近一次提交的时间
+  Client *upload_owner;     // 正在上传镜像的连接
+
+  struct iovec iov[BRIDGE_IOV_MAX];
+  Lz4Codec lz4;  // 事件循环单线程，所有连接共用
+
+  ImageCache *cache;
+  FlashProgress flash;
+  std::function<void(void)> status_hook;
+  uint32_t status_interval_us;
+  uint64_t last_status_us;
+  bool status_dirty;
+
+  Counters stats;
+
+  void accept(void);
+  void dropClient(Client *c);
+  bool readClient(Client *c);
+  bool parseRequests(Client *c);
+  void compactReceive(Client *c);
+  int imageCommand(Client *c, int op, const uint8_t *payload, uint32_t len);
+  int resolveRef(Request *r, const uint8_t *payload, uint32_t len);
+  int inflate(const uint8_t *payload, uint32_t len, PoolBuffer *out);
+  void pack(Client *c, Request *r);
+  void schedule(void);
+  Client *pick(void);
+  void submit(Request *r);
+  void complete(Request *r, int status);
+  void finished(Request *r, int status);
+  void retire(Request *r);
+  void recycle(Request *r);
+  bool flush(Client *c);
+  void reapOrphans(void);
+  void updateInterest(Client *c);
+
+  JLinkBridge(const JLinkBridge &);
+  JLinkBridge &operator=(const JLinkBridge &);
+};
+
+#endif  // BRIDGE_H
@@ -0,0 +1,216 @@
+#include "bridge_client.h"
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "probe.h"
+#include "sha256.h"
+
+#define UPLOAD_CHUNK 60000  // 镜像上传每个IMAGE_DATA的负载
+
+bool bridgeSendAll(int fd, const void *buf, size_t len) {
+  const uint8_t *p = (const uint8_t *)buf;
+  while (len) {
+    ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+    if (n <= 0) return false;
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool bridgeRecvAll(int fd, void *buf, size_t len) {
+  uint8_t *p = (uint8_t *)buf;
+  while (len) {
+    ssize_t n = recv(fd, p, len, 0);
+    if (n <= 0) return false;
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+BridgeClient::BridgeClient()
+    : fd(-1),
+      features(0),
+      buf(sizeof(BridgeRequest) + 4 + LZ4_BLOCK_BOUND(BRIDGE_MAX_PAYLOAD)) {}
+
+BridgeClient::~BridgeClient() { disconnect(); }
+
+bool BridgeClient::connect(const char *host, uint16_t port) {
+  disconnect();
+  struct addrinfo hints, *res;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  char service[8];
+  snprintf(service, sizeof(service), "%u", port);
+  int err = getaddrinfo(host, service, &hints, &res);
+  if (err) {
+    fprintf(stderr, "%s: %s\n", host, gai_strerror(err));
+    return false;
+  }
+  for (struct addrinfo *ai = res; ai && fd < 0; ai = ai->ai_next) {
+    fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                ai->ai_protocol);
+    if (fd < 0) continue;
+    if (::connect(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(res);
+  if (fd < 0) {
+    perror("connect");
+    return false;
+  }
+  // 命令短小且一问一答，不能等Nagle合并
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return true;
+}
+
+void BridgeClient::disconnect(void) {
+  if (fd >= 0) close(fd);
+  fd = -1;
+  features = 0;
+}
+
+int BridgeClient::negotiate(uint32_t want) {
+  int got = request(BRIDGE_OP_FEATURES, &want, sizeof(want), nullptr, 0);
+  if (got < 0) return -1;
+  features = (uint32_t)got;
+  return got;
+}
+
+bool BridgeClient::send(int op, const void *payload, uint32_t len,
+                        uint32_t rx_len) {
+  if (fd < 0 || len > BRIDGE_MAX_PAYLOAD || rx_len > BRIDGE_MAX_PAYLOAD) {
+    return false;
+  }
+  BridgeRequest hdr;
+  uint8_t *p = &buf[sizeof(hdr)];
+  size_t n = 0;
+  if ((features & BRIDGE_FEATURE_LZ4) && len >= BRIDGE_LZ4_MIN &&
+      (op == BRIDGE_OP_XFER || op == BRIDGE_OP_IMAGE_DATA)) {
+    // 压缩后不比原样小（加上4字节长度）时原样发送
+    n = lz4.compress((const uint8_t *)payload, len, p + 4, len - 5);
+  }
+  if (n) {
+    memcpy(p, &len, 4);
+    n += 4;
+    op |= BRIDGE_OP_LZ4;
+  } else {
+    if (len) memcpy(p, payload, len);
+    n = len;
+  }
+  hdr.tx_len = (uint32_t)op << BRIDGE_OP_SHIFT | (uint32_t)n;
+  hdr.rx_len = rx_len;
+  memcpy(&buf[0], &hdr, sizeof(hdr));
+  if (!bridgeSendAll(fd, buf.data(), sizeof(hdr) + n)) {
+    disconnect();
+    return false;
+  }
+  return true;
+}
+
+int BridgeClient::receive(void *rx, uint32_t rx_len, uint32_t *got) {
+  BridgeReply reply;
+  if (got) *got = 0;
+  if (!bridgeRecvAll(fd, &reply, sizeof(reply))) {
+    disconnect();
+    return PROBE_ERROR;
+  }
+  // 应答数据总要读完，否则后面的应答会错位
+  uint32_t len = reply.len & ~BRIDGE_REPLY_LZ4;
+  if (len > buf.size() || !bridgeRecvAll(fd, buf.data(), len)) {
+    disconnect();
+    return PROBE_ERROR;
+  }
+  int n;
+  if (reply.len & BRIDGE_REPLY_LZ4) {
+    uint32_t raw = 0;
+    if (len >= sizeof(raw)) memcpy(&raw, buf.data(), sizeof(raw));
+    n = len < sizeof(raw) ? -1
+                          : Lz4Codec::decompress(buf.data() + 4, len - 4,
+                                                 (uint8_t *)rx, rx_len);
+    if (n != (int)raw) n = -1;
+  } else {
+    n = len <= rx_len ? (int)len : -1;
+    if (n > 0) memcpy(rx, buf.data(), n);
+  }
+  if (n < 0) return PROBE_ERROR;
+  if (got) *got = n;
+  return reply.status;
+}
+
+int BridgeClient::request(int op, const void *payload, uint32_t len, void *rx,
+                          uint32_t rx_len, uint32_t *got) {
+  // 非XFER操作的rx_len必须为0，应答数据（如有）由桥决定
+  uint32_t want = op == BRIDGE_OP_XFER ? rx_len : 0;
+  if (!send(op, payload, len, want)) return PROBE_ERROR;
+  return receive(rx, rx_len, got);
+}
+
+int BridgeClient::transfer(const void *tx, uint32_t tx_len, void *rx,
+                           uint32_t rx_len, uint32_t *got) {
+  return request(BRIDGE_OP_XFER, tx, tx_len, rx, rx_len, got);
+}
+
+int BridgeClient::uploadImage(const uint8_t *data, size_t size,
+                              uint8_t hash[SHA256_LEN], bool *cached) {
+  Sha256::hash(data, size, hash);
+  if (cached) *cached = false;
+  int status = request(BRIDGE_OP_IMAGE_QUERY, hash, SHA256_LEN, nullptr, 0);
+  if (status == PROBE_OK) {
+    if (cached) *cached = true;
+    return PROBE_OK;
+  }
+  if (status != BRIDGE_NOT_CACHED) return status;
+
+  // BEGIN、DATA…、END连续发出，再按序收应答，上传不必每块等一次往返
+  BridgeImageBegin begin;
+  memcpy(begin.hash, hash, SHA256_LEN);
+  begin.size = size;
+  bool ok = send(BRIDGE_OP_IMAGE_BEGIN, &begin, sizeof(begin), 0);
+  int ops = 1;
+  for (size_t off = 0; ok && off < size; off += UPLOAD_CHUNK) {
+    uint32_t n = std::min<size_t>(UPLOAD_CHUNK, size - off);
+    ok = send(BRIDGE_OP_IMAGE_DATA, data + off, n, 0);
+    ops++;
+  }
+  ok = ok && send(BRIDGE_OP_IMAGE_END, nullptr, 0, 0);
+  if (!ok) return PROBE_ERROR;
+  ops++;
+  status = PROBE_OK;
+  for (int i = 0; i < ops; i++) {
+    int s = receive(nullptr, 0);
+    if (s == PROBE_ERROR && fd < 0) return PROBE_ERROR;
+    if (status == PROBE_OK) status = s;
+  }
+  return status;
+}
+
+int BridgeClient::transferRef(const uint8_t hash[SHA256_LEN], uint32_t offset,
+                              uint32_t length, const void *cmd,
+                              uint32_t cmd_len, void *rx, uint32_t rx_len,
+                              uint32_t *got) {
+  BridgeImageRef ref;
+  memcpy(ref.hash, hash, SHA256_LEN);
+  ref.offset = offset;
+  ref.length = length;
+  std::vector<uint8_t> payload(sizeof(ref) + cmd_len);
+  memcpy(payload.data(), &ref, sizeof(ref));
+  if (cmd_len) memcpy(&payload[sizeof(ref)], cmd, cmd_len);
+  if (!send(BRIDGE_OP_XFER_REF, payload.data(), payload.size(), rx_len)) {
+    return PROBE_ERROR;
+  }
+  return receive(rx, rx_len, got);
+}
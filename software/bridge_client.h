@@ -0,0 +1,71 @@
+#ifndef BRIDGE_CLIENT_H
+#define BRIDGE_CLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "bridge.h"
+#include "lz4_codec.h"
+
+// jlink_bridge的主机端客户端。桥在TCP上转发的是J-Link USB批量端点上的
+// 原始命令字节（EMU_CMD_*），协议见bridge.h，不是SEGGER J-Link Remote
+// Server的协议，J-Link软件包里的工具不能直接连接。主机上的烧录脚本或
+// 调试前端的适配层通过这个类把原本写给USB端点的命令发给桥：每次
+// transfer()相当于一次OUT写入加一次IN读取。
+// 同步调用，一次一个请求；需要流水线的场合直接按bridge.h的格式发请求。
+
+class BridgeClient {
+ public:
+  BridgeClient();
+  ~BridgeClient();
+
+  bool connect(const char *host, uint16_t port = JLINK_BRIDGE_PORT);
+  void disconnect(void);
+  bool connected(void) const { return fd >= 0; }
+
+  // 协商BRIDGE_FEATURE_*，返回桥接受的特性，出错时返回-1。
+  // 接受LZ4后，不小于BRIDGE_LZ4_MIN的负载压缩后发送
+  int negotiate(uint32_t want);
+
+  // 把tx写到探针OUT端点，再从IN端点读最多rx_len字节到rx；
+  // 返回PROBE_*/BRIDGE_*，got为实际读到的字节数
+  int transfer(const void *tx, uint32_t tx_len, void *rx, uint32_t rx_len,
+               uint32_t *got = nullptr);
+
+  // 在LOCK/UNLOCK之间的命令不会被其他连接的请求插入
+  int lock(void) { return request(BRIDGE_OP_LOCK, nullptr, 0, nullptr, 0); }
+  int unlock(void) {
+    return request(BRIDGE_OP_UNLOCK, nullptr, 0, nullptr, 0);
+  }
+
+  // 镜像不在桥的缓存里时上传；hash返回镜像的SHA-256，之后用transferRef引用
+  int uploadImage(const uint8_t *data, size_t size, uint8_t hash[SHA256_LEN],
+                  bool *cached = nullptr);
+  // 写命令头cmd，再由桥从缓存写镜像[offset, offset+length)，然后读应答
+  int transferRef(const uint8_t hash[SHA256_LEN], uint32_t offset,
+                  uint32_t length, const void *cmd, uint32_t cmd_len,
+                  void *rx, uint32_t rx_len, uint32_t *got = nullptr);
+
+ private:
+  int fd;
+  uint32_t features;
+  Lz4Codec lz4;
+  std::vector<uint8_t> buf;  // 请求头 + 负载，或压缩的应答数据
+
+  // 只发请求 / 只收一个应答，供上传时连续发送
+  bool send(int op, const void *payload, uint32_t len, uint32_t rx_len);
+  int receive(void *rx, uint32_t rx_len, uint32_t *got = nullptr);
+  int request(int op, const void *payload, uint32_t len, void *rx,
+              uint32_t rx_len, uint32_t *got = nullptr);
+
+  BridgeClient(const BridgeClient &);
+  BridgeClient &operator=(const BridgeClient &);
+};
+
+// 阻塞地发送/接收len字节，连接断开或出错时返回false
+bool bridgeSendAll(int fd, const void *buf, size_t len);
+bool bridgeRecvAll(int fd, void *buf, size_t len);
+
+#endif  // BRIDGE_CLIENT_H
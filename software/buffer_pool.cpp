@@ -0,0 +1,53 @@
+#include "buffer_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+BufferPool::BufferPool(size_t count, size_t size)
+    : count(count),
+      size((size + POOL_ALIGN - 1) & ~(size_t)(POOL_ALIGN - 1)),
+      arena(nullptr),
+      slots(nullptr),
+      free_list(nullptr) {
+  memset(&stats, 0, sizeof(stats));
+  // 所有缓冲来自一次分配，之后数据路径上不再有malloc
+  void *p;
+  if (count == 0 || posix_memalign(&p, POOL_ALIGN, this->count * this->size)) {
+    this->count = 0;
+    return;
+  }
+  arena = (uint8_t *)p;
+  slots = new PoolBuffer[count];
+  for (size_t i = count; i-- > 0;) {
+    slots[i].data = arena + i * this->size;
+    slots[i].refs = 0;
+    slots[i].next = free_list;
+    free_list = &slots[i];
+  }
+}
+
+BufferPool::~BufferPool() {
+  delete[] slots;
+  free(arena);
+}
+
+PoolBuffer *BufferPool::acquire(void) {
+  PoolBuffer *b = free_list;
+  if (!b) {
+    stats.misses++;
+    return nullptr;
+  }
+  free_list = b->next;
+  b->refs = 1;
+  b->next = nullptr;
+  stats.acquires++;
+  if (++stats.in_use > stats.peak) stats.peak = stats.in_use;
+  return b;
+}
+
+void BufferPool::release(PoolBuffer *b) {
+  if (--b->refs) return;
+  b->next = free_list;
+  free_list = b;
+  stats.in_use--;
+}
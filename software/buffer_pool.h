@@ -0,0 +1,53 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 固定数量、固定大小的预分配缓冲池，缓冲按缓存行对齐。
+// 缓冲带引用计数：多个请求可以引用同一个接收缓冲里的不同片段，
+// 全部释放后才回到空闲链表。只在单个事件循环线程中使用，不加锁。
+
+#define POOL_ALIGN 64
+
+struct PoolBuffer {
+  uint8_t *data;  // POOL_ALIGN对齐，长度为BufferPool::bufferSize()
+  uint32_t refs;
+  PoolBuffer *next;  // 空闲链表
+};
+
+class BufferPool {
+ public:
+  struct Counters {
+    uint64_t acquires;
+    uint64_t misses;  // 池已空导致的获取失败
+    uint32_t in_use;
+    uint32_t peak;  // 同时使用的最大缓冲数
+  };
+
+  BufferPool(size_t count, size_t size);
+  ~BufferPool();
+
+  bool ok(void) const { return arena != nullptr; }
+  size_t bufferSize(void) const { return size; }
+  size_t available(void) const { return count - stats.in_use; }
+
+  PoolBuffer *acquire(void);  // 引用计数为1；池空时返回nullptr
+  void ref(PoolBuffer *b) { b->refs++; }
+  void release(PoolBuffer *b);
+
+  const Counters &counters(void) const { return stats; }
+
+ private:
+  size_t count;
+  size_t size;
+  uint8_t *arena;
+  PoolBuffer *slots;
+  PoolBuffer *free_list;
+  Counters stats;
+
+  BufferPool(const BufferPool &);
+  BufferPool &operator=(const BufferPool &);
+};
+
+#endif  // BUFFER_POOL_H
@@ -0,0 +1,117 @@
+#include "display_client.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+DisplayClient::DisplayClient()
+    : oled(&null_bus), sock(-1), event_fd(-1), shared(nullptr), back(1) {}
+
+DisplayClient::~DisplayClient() { disconnect(); }
+
+bool DisplayClient::connect(uint8_t x, uint8_t y, uint8_t w, uint8_t h,
+                            const char *name, const char *path) {
+  disconnect();
+
+  struct sockaddr_un sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sun_family = AF_UNIX;
+  strncpy(sa.sun_path, path, sizeof(sa.sun_path) - 1);
+
+  sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (sock < 0 || ::connect(sock, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+    perror("display server");
+    disconnect();
+    return false;
+  }
+
+  DisplayRequest req;
+  memset(&req, 0, sizeof(req));
+  req.magic = DISPLAY_MAGIC;
+  req.x = x;
+  req.y = y;
+  req.w = w;
+  req.h = h;
+  strncpy(req.name, name, DISPLAY_NAME_LEN - 1);
+  if (send(sock, &req, sizeof(req), MSG_NOSIGNAL) != (ssize_t)sizeof(req)) {
+    disconnect();
+    return false;
+  }
+
+  // 应答附带memfd和eventfd
+  DisplayReply reply;
+  struct iovec iov = {&reply, sizeof(reply)};
+  char ctrl[CMSG_SPACE(2 * sizeof(int))];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctrl;
+  msg.msg_controllen = sizeof(ctrl);
+  if (recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) != (ssize_t)sizeof(reply) ||
+      reply.status != 0) {
+    fprintf(stderr, "display server refused region: %d\n", reply.status);
+    disconnect();
+    return false;
+  }
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(2 * sizeof(int))) {
+    disconnect();
+    return false;
+  }
+  int fds[2];
+  memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+  event_fd = fds[1];
+
+  void *p = mmap(nullptr, sizeof(DisplayShared), PROT_READ | PROT_WRITE,
+                 MAP_SHARED, fds[0], 0);
+  close(fds[0]);  // 映射建立后不再需要memfd
+  if (p == MAP_FAILED || ((DisplayShared *)p)->magic != DISPLAY_MAGIC) {
+    if (p != MAP_FAILED) munmap(p, sizeof(DisplayShared));
+    disconnect();
+    return false;
+  }
+  shared = (DisplayShared *)p;
+
+  // 在后台缓冲上绘制，canvas的每次刷新都提交一帧
+  back = 1;
+  oled.setTarget_GRAM(shared->buf[back]);
+  oled.setScanout_GRAM(shared->buf[back]);
+  oled.setPresentHook([this]() { present(); });
+  return true;
+}
+
+void DisplayClient::disconnect(void) {
+  oled.setPresentHook(nullptr);
+  oled.setTarget_GRAM(nullptr);
+  oled.setScanout_GRAM(nullptr);
+  if (shared) munmap(shared, sizeof(DisplayShared));
+  if (event_fd >= 0) close(event_fd);
+  if (sock >= 0) close(sock);
+  shared = nullptr;
+  event_fd = -1;
+  sock = -1;
+}
+
+void DisplayClient::present(void) {
+  if (!shared) return;
+
+  uint32_t done = back;
+  shared->front.store(done, std::memory_order_release);
+  shared->seq.fetch_add(1, std::memory_order_release);
+  // release只约束之前的写；之后写后台缓冲不能早于新的seq可见（ARM会重排）
+  std::atomic_thread_fence(std::memory_order_release);
+
+  // 翻转后把刚提交的内容复制到新的后台缓冲，保持GRAM的增量绘制语义
+  back ^= 1;
+  memcpy(shared->buf[back], shared->buf[done], sizeof(shared->buf[0]));
+  oled.setTarget_GRAM(shared->buf[back]);
+  oled.setScanout_GRAM(shared->buf[back]);
+
+  uint64_t one = 1;
+  if (write(event_fd, &one, sizeof(one)) < 0) perror("display present");
+}
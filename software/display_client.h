@@ -0,0 +1,35 @@
+#ifndef DISPLAY_CLIENT_H
+#define DISPLAY_CLIENT_H
+
+#include <stdint.h>
+
+#include "display_server.h"
+#include "i2c_transport.h"
+#include "oled.h"
+
+// 显示服务客户端：画布是一个不占用总线的OLED，绘图目标指向共享内存的
+// 后台缓冲。canvas()的refresh()/present()会自动提交到服务端。
+class DisplayClient {
+ public:
+  DisplayClient();
+  ~DisplayClient();
+
+  // 申请屏幕区域（像素坐标，y/h会向外按页对齐）
+  bool connect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, const char *name,
+               const char *path = DISPLAY_SERVER_SOCKET);
+  void disconnect(void);
+  bool connected(void) const { return shared != nullptr; }
+
+  OLED &canvas(void) { return oled; }
+  void present(void);  // 翻转前后台缓冲并通知服务端
+
+ private:
+  NullTransport null_bus;
+  OLED oled;
+  int sock;
+  int event_fd;
+  DisplayShared *shared;
+  uint32_t back;
+};
+
+#endif  // DISPLAY_CLIENT_H
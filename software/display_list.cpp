@@ -0,0 +1,292 @@
+#include "display_list.h"
+
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// 将颜色操作应用到一页中 [xa, xb] 列的掩码位上
+static inline void applyMask(uint8_t *row, int xa, int xb, uint8_t mask,
+                             uint8_t color) {
+  if (!mask) return;
+  switch (color) {
+    case WHITE:
+      for (int x = xa; x <= xb; x++) row[x] |= mask;
+      break;
+    case BLACK:
+      for (int x = xa; x <= xb; x++) row[x] &= ~mask;
+      break;
+    case INVERSE:
+      for (int x = xa; x <= xb; x++) row[x] ^= mask;
+      break;
+  }
+}
+
+// [ya, yb] 行在第page页内对应的位掩码
+static inline uint8_t pageMask(int ya, int yb, int page) {
+  int top = page * 8;
+  if (yb < top || ya > top + 7) return 0;
+  int a = ya < top ? 0 : ya - top;
+  int b = yb > top + 7 ? 7 : yb - top;
+  return (uint8_t)((0xFF << a) & (0xFF >> (7 - b)));
+}
+
+// 将以第y行为起点的列数据移位到第page页
+static inline uint8_t shiftToPage(uint32_t bits, int y, int page) {
+  int s = y - page * 8;
+  return (uint8_t)(s >= 0 ? bits << s : bits >> -s);
+}
+
+// 在一页内按Bresenham画线，只写落在该页的像素
+static void linePage(uint8_t *row, int page, int width, int x1, int y1,
+                     int x2, int y2, uint8_t color) {
+  int top = page * 8;
+  int dx = abs(x2 - x1);
+  int dy = abs(y2 - y1);
+  int sx = (x1 < x2) ? 1 : -1;
+  int sy = (y1 < y2) ? 1 : -1;
+  int err = dx - dy;
+
+  while (1) {
+    if (y1 >= top && y1 < top + 8 && x1 >= 0 && x1 < width) {
+      applyMask(row, x1, x1, 1 << (y1 - top), color);
+    }
+    if (x1 == x2 && y1 == y2) break;
+    // y单调变化，越过本页后即可提前结束
+    if ((sy > 0 && y1 > top + 7) || (sy < 0 && y1 < top)) break;
+    int e2 = 2 * err;
+    if (e2 > -dy) {
+      err -= dy;
+      x1 += sx;
+    }
+    if (e2 < dx) {
+      err += dx;
+      y1 += sy;
+    }
+  }
+}
+
+DisplayList::DisplayList()
+    : target(nullptr), ready(0), uploaded(0), quit(false) {}
+
+DisplayList::~DisplayList() {
+  if (!uploader.joinable()) return;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    quit = true;
+  }
+  ready_cv.notify_one();
+  uploader.join();
+}
+
+void DisplayList::clear(void) {
+  cmds.clear();
+  text_pool.clear();
+  sprites.clear();
+  for (int p = 0; p < DISPLAY_LIST_MAX_PAGES; p++) bins[p].clear();
+}
+
+void DisplayList::record(Command &cmd) {
+  // 按最大逻辑画布裁剪包围盒，完全在画布外的命令直接丢弃；
+  // 执行时再按实际宽度裁剪列范围
+  int limit = DISPLAY_LIST_MAX_PAGES * 8 - 1;
+  if (cmd.bx1 < 0) cmd.bx1 = 0;
+  if (cmd.by1 < 0) cmd.by1 = 0;
+  if (cmd.bx2 > limit) cmd.bx2 = limit;
+  if (cmd.by2 > limit) cmd.by2 = limit;
+  if (cmd.bx1 > cmd.bx2 || cmd.by1 > cmd.by2) return;
+
+  uint16_t index = (uint16_t)cmds.size();
+  cmds.push_back(cmd);
+  for (int p = cmd.by1 / 8; p <= cmd.by2 / 8; p++) bins[p].push_back(index);
+}
+
+void DisplayList::drawPixel(int16_t x, int16_t y, uint8_t color) {
+  Command cmd = {OP_PIXEL, color, 0, x, y, x, y, x, y, x, y, 0, 0};
+  record(cmd);
+}
+
+void DisplayList::drawLine(int16_t x1, int16_t y1, int16_t x2, int16_t y2,
+                           uint8_t color) {
+  Command cmd = {OP_LINE, color, 0, x1, y1, x2, y2,
+                 (int16_t)(x1 < x2 ? x1 : x2), (int16_t)(y1 < y2 ? y1 : y2),
+                 (int16_t)(x1 > x2 ? x1 : x2), (int16_t)(y1 > y2 ? y1 : y2),
+                 0, 0};
+  record(cmd);
+}
+
+void DisplayList::drawRect(int16_t x1, int16_t y1, int16_t x2, int16_t y2,
+                           uint8_t color) {
+  Command cmd = {OP_RECT, color, 0, x1, y1, x2, y2,
+                 (int16_t)(x1 < x2 ? x1 : x2), (int16_t)(y1 < y2 ? y1 : y2),
+                 (int16_t)(x1 > x2 ? x1 : x2), (int16_t)(y1 > y2 ? y1 : y2),
+                 0, 0};
+  record(cmd);
+}
+
+void DisplayList::fillRect(int16_t x1, int16_t y1, int16_t x2, int16_t y2,
+                           uint8_t color) {
+  // 与fillRect_GRAM一致：x1>x2或y1>y2时不绘制
+  Command cmd = {OP_FILL_RECT, color, 0, x1, y1, x2, y2, x1, y1, x2, y2, 0, 0};
+  record(cmd);
+}
+
+void DisplayList::showString(int16_t x, int16_t y, const char *str,
+                             uint8_t fontSize) {
+  uint16_t len = (uint16_t)strlen(str);
+  if (len == 0) return;
+  int cw = (fontSize == 16) ? 8 : 6;
+  int ch = (fontSize == 16) ? 16 : 8;
+
+  Command cmd = {OP_TEXT, WHITE, fontSize, x, y, 0, 0, x, y,
+                 (int16_t)(x + cw * len - 1), (int16_t)(y + ch - 1),
+                 (uint32_t)text_pool.size(), len};
+  text_pool.insert(text_pool.end(), str, str + len);
+  record(cmd);
+}
+
+void DisplayList::drawSprite(int16_t x, int16_t y, uint8_t w, uint8_t h,
+                             const uint8_t *sprite, uint8_t color) {
+  if (w == 0 || h == 0) return;
+  // x2/y2 保存精灵宽高
+  Command cmd = {OP_SPRITE, color, 0, x, y, w, h, x, y,
+                 (int16_t)(x + w - 1), (int16_t)(y + h - 1),
+                 (uint32_t)sprites.size(), 0};
+  sprites.push_back(sprite);
+  record(cmd);
+}
+
+void DisplayList::rasterPage(uint8_t *row, int page, int width,
+                             const Command &cmd) const {
+  int xa = cmd.bx1;
+  int xb = cmd.bx2 < width ? cmd.bx2 : width - 1;
+  if (xa > xb) return;
+
+  switch (cmd.op) {
+    case OP_PIXEL:
+      applyMask(row, xa, xa, pageMask(cmd.y1, cmd.y1, page), cmd.color);
+      break;
+
+    case OP_LINE:
+      if (cmd.y1 == cmd.y2) {
+        applyMask(row, xa, xb, pageMask(cmd.y1, cmd.y1, page), cmd.color);
+      } else if (cmd.x1 == cmd.x2) {
+        applyMask(row, xa, xa, pageMask(cmd.by1, cmd.by2, page), cmd.color);
+      } else {
+        linePage(row, page, width, cmd.x1, cmd.y1, cmd.x2, cmd.y2,
+                 cmd.color);
+      }
+      break;
+
+    case OP_RECT:
+      // 与drawRect_GRAM一致：四条边依次绘制（INVERSE时角点翻转两次）
+      linePage(row, page, width, cmd.x1, cmd.y1, cmd.x2, cmd.y1, cmd.color);
+      linePage(row, page, width, cmd.x2, cmd.y1, cmd.x2, cmd.y2, cmd.color);
+      linePage(row, page, width, cmd.x2, cmd.y2, cmd.x1, cmd.y2, cmd.color);
+      linePage(row, page, width, cmd.x1, cmd.y2, cmd.x1, cmd.y1, cmd.color);
+      break;
+
+    case OP_FILL_RECT:
+      applyMask(row, xa, xb, pageMask(cmd.by1, cmd.by2, page), cmd.color);
+      break;
+
+    case OP_TEXT: {
+      // 文本为不透明绘制，与showChar_GRAM一致
+      bool big = (cmd.size == 16);
+      int cw = big ? 8 : 6;
+      uint32_t cell = big ? 0xFFFF : 0xFF;
+      uint8_t mask = shiftToPage(cell, cmd.y1, page);
+      const char *str = &text_pool[cmd.data];
+      for (uint16_t n = 0; n < cmd.len; n++) {
+        unsigned char c = str[n] - ' ';
+        int cx = cmd.x1 + n * cw;
+        for (int i = 0; i < cw; i++) {
+          int x = cx + i;
+          if (x < xa || x > xb) continue;
+          uint32_t bits = big ? (F8X16[c * 16 + i] |
+                                 (F8X16[c * 16 + i + 8] << 8))
+                              : F6x8[c][i];
+          row[x] = (row[x] & ~mask) | shiftToPage(bits, cmd.y1, page);
+        }
+      }
+      break;
+    }
+
+    case OP_SPRITE: {
+      const uint8_t *src = sprites[cmd.data];
+      int w = cmd.x2;
+      int h = cmd.y2;
+      int src_pages = (h + 7) / 8;
+      int offset = page * 8 - cmd.y1;  // 本页首行在精灵中的行号
+      uint8_t valid = pageMask(cmd.y1, cmd.y1 + h - 1, page);
+      for (int x = xa; x <= xb; x++) {
+        int i = x - cmd.x1;
+        uint8_t bits;
+        if (offset < 0) {
+          bits = src[i] << -offset;
+        } else {
+          int q = offset >> 3;
+          int r = offset & 7;
+          bits = src[q * w + i] >> r;
+          if (r && q + 1 < src_pages) bits |= src[(q + 1) * w + i] << (8 - r);
+        }
+        applyMask(row, x, x, bits & valid, cmd.color);
+      }
+      break;
+    }
+  }
+}
+
+void DisplayList::uploadLoop(void) {
+  std::unique_lock<std::mutex> guard(lock);
+  for (;;) {
+    ready_cv.wait(guard, [this]() { return quit || uploaded < ready; });
+    if (quit) return;
+    int page = uploaded;
+    guard.unlock();
+    target->refreshPage(page);
+    guard.lock();
+    uploaded = page + 1;
+    if (uploaded == OLED_PAGES) done_cv.notify_one();
+  }
+}
+
+void DisplayList::execute(OLED &oled, bool clear, bool upload) {
+  int pages = oled.getHeight() / 8;
+  int width = oled.getWidth();
+  bool transposed = (pages != OLED_PAGES);
+  bool stream = upload && !transposed;
+
+  // 上一次执行已等到全部上传完成，上传线程空闲
+  if (stream) {
+    std::lock_guard<std::mutex> guard(lock);
+    target = &oled;
+    ready = uploaded = 0;
+    if (!uploader.joinable()) {
+      uploader = std::thread(&DisplayList::uploadLoop, this);
+    }
+  }
+
+  uint64_t raster_us = 0;
+  for (int page = 0; page < pages; page++) {
+    uint64_t start = monotonicUs();
+    uint8_t *row = oled.getPage_GRAM(page);
+    if (clear) memset(row, 0, width);
+    for (size_t n = 0; n < bins[page].size(); n++) {
+      rasterPage(row, page, width, cmds[bins[page][n]]);
+    }
+    raster_us += monotonicUs() - start;
+    if (stream) {
+      std::lock_guard<std::mutex> guard(lock);
+      ready = page + 1;
+      ready_cv.notify_one();
+    }
+  }
+
+  statsRecord(STAT_RASTER, raster_us);
+  if (stream) {
+    std::unique_lock<std::mutex> guard(lock);
+    done_cv.wait(guard, [this]() { return uploaded == OLED_PAGES; });
+  }
+  if (upload && transposed) oled.refresh();
+}
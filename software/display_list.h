@@ -0,0 +1,90 @@
+#ifndef DISPLAY_LIST_H
+#define DISPLAY_LIST_H
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "oled.h"
+
+// 逻辑画布最大为128x128（90°/270°旋转时高128）
+#define DISPLAY_LIST_MAX_PAGES (OLED_MAX_COLUMN / 8)
+
+// 显示列表：先记录绘图命令，执行时按页分箱、逐页光栅化。
+// 记录时只做一次裁剪和分箱，列表可重复执行；每页光栅化完成后
+// 立即交给上传线程，光栅化与I2C上传重叠进行。上传线程在第一次逐页上传时
+// 启动，之后常驻，由析构函数停止。
+class DisplayList {
+ public:
+  enum Op : uint8_t {
+    OP_PIXEL,
+    OP_LINE,
+    OP_RECT,
+    OP_FILL_RECT,
+    OP_TEXT,
+    OP_SPRITE,
+  };
+
+  struct Command {
+    uint8_t op;
+    uint8_t color;
+    uint8_t size;       // 字体大小（文本）
+    int16_t x1, y1;     // 原始参数
+    int16_t x2, y2;
+    int16_t bx1, by1;   // 裁剪后的包围盒
+    int16_t bx2, by2;
+    uint32_t data;      // 文本池偏移 / 精灵索引
+    uint16_t len;       // 文本长度
+  };
+
+  DisplayList();
+  ~DisplayList();
+
+  void clear(void);  // 清空已记录的命令
+  size_t size(void) const { return cmds.size(); }
+
+  // 记录命令（参数与对应的 *_GRAM 函数一致）
+  void drawPixel(int16_t x, int16_t y, uint8_t color);
+  void drawLine(int16_t x1, int16_t y1, int16_t x2, int16_t y2,
+                uint8_t color);
+  void drawRect(int16_t x1, int16_t y1, int16_t x2, int16_t y2,
+                uint8_t color);
+  void fillRect(int16_t x1, int16_t y1, int16_t x2, int16_t y2,
+                uint8_t color);
+  void showString(int16_t x, int16_t y, const char *str, uint8_t fontSize);
+  // 精灵为页打包格式（与GRAM相同）：ceil(h/8)页，每页w字节
+  void drawSprite(int16_t x, int16_t y, uint8_t w, uint8_t h,
+                  const uint8_t *sprite, uint8_t color = WHITE);
+
+  // 执行显示列表：clear为真时先清空GRAM，upload为真时逐页上传。
+  // 90°/270°旋转时物理页依赖所有逻辑页，改为全部光栅化后统一上传
+  void execute(OLED &oled, bool clear = true, bool upload = true);
+
+ private:
+  std::vector<Command> cmds;
+  std::vector<char> text_pool;
+  std::vector<const uint8_t *> sprites;
+  std::vector<uint16_t> bins[DISPLAY_LIST_MAX_PAGES];  // 每页涉及的命令索引
+
+  // 上传线程：按页顺序上传[uploaded, ready)，ready为已光栅化的页数
+  std::thread uploader;
+  std::mutex lock;
+  std::condition_variable ready_cv, done_cv;
+  OLED *target;
+  int ready, uploaded;
+  bool quit;
+
+  void record(Command &cmd);
+  void rasterPage(uint8_t *row, int page, int width,
+                  const Command &cmd) const;
+  void uploadLoop(void);
+
+  DisplayList(const DisplayList &);
+  DisplayList &operator=(const DisplayList &);
+};
+
+#endif  // DISPLAY_LIST_H
@@ -0,0 +1,350 @@
+#include "display_server.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "raster.h"
+#include "stats.h"
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001U
+#endif
+#ifndef MFD_ALLOW_SEALING
+#define MFD_ALLOW_SEALING 0x0002U
+#endif
+#ifndef F_ADD_SEALS
+#define F_ADD_SEALS 1033
+#define F_SEAL_SEAL 0x0001
+#define F_SEAL_SHRINK 0x0002
+#define F_SEAL_GROW 0x0004
+#endif
+
+// 允许封印：设定大小后封住，客户端拿到fd也不能截断（否则合成时SIGBUS）
+static int createSharedMemory(const char *name) {
+#ifdef SYS_memfd_create
+  return (int)syscall(SYS_memfd_create, name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+#else
+  (void)name;
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+// 发送应答，附带两个文件描述符
+static bool sendReply(int sock, const DisplayReply &reply, int fd0, int fd1) {
+  struct iovec iov = {(void *)&reply, sizeof(reply)};
+  char ctrl[CMSG_SPACE(2 * sizeof(int))];
+  memset(ctrl, 0, sizeof(ctrl));
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  if (fd0 >= 0) {
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(2 * sizeof(int));
+    int fds[2] = {fd0, fd1};
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+  }
+  return sendmsg(sock, &msg, MSG_NOSIGNAL) == (ssize_t)sizeof(reply);
+}
+
+DisplayServer::DisplayServer(OLED &oled, const char *path,
+                             uint32_t min_interval_us)
+    : oled(oled),
+      path(path),
+      min_interval_us(min_interval_us),
+      listen_fd(-1),
+      epoll_fd(-1),
+      bound(false),
+      running(false),
+      dirty(false),
+      last_upload_us(0) {}
+
+DisplayServer::~DisplayServer() {
+  while (!pending.empty()) drop(pending.back());
+  while (!clients.empty()) drop(clients.back());
+  if (listen_fd >= 0) close(listen_fd);
+  if (bound) unlink(path.c_str());  // 只删除自己绑定的套接字文件
+  if (epoll_fd >= 0) close(epoll_fd);
+}
+
+bool DisplayServer::start(void) {
+  struct sockaddr_un sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(sa.sun_path)) return false;
+  strcpy(sa.sun_path, path.c_str());
+
+  listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0) {
+    perror("socket");
+    return false;
+  }
+  // 清理上次异常退出留下的套接字文件；有服务端应答时不能抢占，
+  // 否则两个进程会同时驱动同一条I2C总线
+  int probe = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (probe < 0) {
+    perror("socket");
+    return false;
+  }
+  int err =
+      ::connect(probe, (struct sockaddr *)&sa, sizeof(sa)) < 0 ? errno : 0;
+  close(probe);
+  if (err == 0) {
+    fprintf(stderr, "%s: another display server is running\n", path.c_str());
+    return false;
+  }
+  if (err != ECONNREFUSED && err != ENOENT) {
+    fprintf(stderr, "%s: %s\n", path.c_str(), strerror(err));
+    return false;
+  }
+  if (err == ECONNREFUSED) unlink(path.c_str());
+  if (bind(listen_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+    perror("bind");
+    return false;
+  }
+  bound = true;
+  if (listen(listen_fd, 8) < 0) {
+    perror("listen");
+    return false;
+  }
+
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    perror("epoll_create1");
+    return false;
+  }
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.ptr = nullptr;  // nullptr表示监听套接字
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+
+  oled.clear_GRAM();
+  oled.present();  // 快速启动后屏幕已是空白，此时不会产生传输
+  last_upload_us = monotonicUs();
+  running = true;
+  return true;
+}
+
+void DisplayServer::accept(void) {
+  int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (fd < 0) return;
+
+  Client *c = new Client();
+  c->sock = fd;
+  c->accepted_us = monotonicUs();
+  c->event_fd = -1;
+  c->mem_fd = -1;
+  c->shared = nullptr;
+
+  // 请求到达后在onRequest里握手
+  struct epoll_event ev;
+  ev.data.ptr = c;
+  ev.events = EPOLLIN | EPOLLRDHUP | EPOLLHUP;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->sock, &ev);
+  pending.push_back(c);
+}
+
+void DisplayServer::onRequest(Client *c) {
+  for (size_t i = 0; i < pending.size(); i++) {
+    if (pending[i] == c) {
+      pending.erase(pending.begin() + i);
+      break;
+    }
+  }
+  if (!handshake(c)) {
+    drop(c);
+    return;
+  }
+
+  // 套接字只用于检测客户端退出，eventfd用于提交通知
+  struct epoll_event ev;
+  ev.data.ptr = c;
+  ev.events = EPOLLRDHUP | EPOLLHUP;
+  epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->sock, &ev);
+  ev.events = EPOLLIN;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->event_fd, &ev);
+  clients.push_back(c);
+  printf("display client '%s' connected: %dx%d at (%d,%d)\n",
+         c->name.c_str(), c->w, c->h, c->x, c->y);
+}
+
+// 丢弃超过期限仍没发请求的连接，返回到下一个期限的毫秒数（没有时为-1）
+int DisplayServer::expirePending(uint64_t now) {
+  int timeout = -1;
+  for (size_t i = pending.size(); i-- > 0;) {
+    uint64_t due = pending[i]->accepted_us + DISPLAY_HANDSHAKE_US;
+    if (now >= due) {
+      drop(pending[i]);
+      continue;
+    }
+    int ms = (int)((due - now + 999) / 1000);
+    if (timeout < 0 || ms < timeout) timeout = ms;
+  }
+  return timeout;
+}
+
+bool DisplayServer::handshake(Client *c) {
+  DisplayRequest req;
+  DisplayReply reply;
+  memset(&reply, 0, sizeof(reply));
+
+  // SOCK_SEQPACKET：请求是一整条消息，长度不对即为无效请求
+  if (recv(c->sock, &req, sizeof(req), MSG_DONTWAIT) != (ssize_t)sizeof(req) ||
+      req.magic != DISPLAY_MAGIC) {
+    return false;
+  }
+  req.name[DISPLAY_NAME_LEN - 1] = '\0';
+  c->name = req.name;
+
+  // 区域裁剪到屏幕内，纵向按页对齐
+  int x1 = req.x, y1 = req.y & ~7;
+  int x2 = req.x + req.w, y2 = (req.y + req.h + 7) & ~7;
+  if (x2 > OLED_MAX_COLUMN) x2 = OLED_MAX_COLUMN;
+  if (y2 > OLED_MAX_ROW) y2 = OLED_MAX_ROW;
+  if (x1 >= x2 || y1 >= y2) {
+    reply.status = -EINVAL;
+    sendReply(c->sock, reply, -1, -1);
+    return false;
+  }
+
+  c->mem_fd = createSharedMemory("oled-region");
+  c->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (c->mem_fd < 0 || c->event_fd < 0 ||
+      ftruncate(c->mem_fd, sizeof(DisplayShared)) < 0 ||
+      fcntl(c->mem_fd, F_ADD_SEALS,
+            F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+    reply.status = -errno;
+    sendReply(c->sock, reply, -1, -1);
+    return false;
+  }
+  void *p = mmap(nullptr, sizeof(DisplayShared), PROT_READ | PROT_WRITE,
+                 MAP_SHARED, c->mem_fd, 0);
+  if (p == MAP_FAILED) {
+    reply.status = -errno;
+    sendReply(c->sock, reply, -1, -1);
+    return false;
+  }
+
+  // 新建的memfd内容为0，只需填写头部
+  c->shared = (DisplayShared *)p;
+  c->shared->magic = DISPLAY_MAGIC;
+  c->shared->x = c->x = reply.x = x1;
+  c->shared->y = c->y = reply.y = y1;
+  c->shared->w = c->w = reply.w = x2 - x1;
+  c->shared->h = c->h = reply.h = y2 - y1;
+  c->shared->seq.store(0);
+  c->shared->front.store(0);
+  return sendReply(c->sock, reply, c->mem_fd, c->event_fd);
+}
+
+void DisplayServer::drop(Client *c) {
+  for (size_t i = 0; i < pending.size(); i++) {
+    if (pending[i] == c) {
+      pending.erase(pending.begin() + i);
+      break;
+    }
+  }
+  for (size_t i = 0; i < clients.size(); i++) {
+    if (clients[i] == c) {
+      clients.erase(clients.begin() + i);
+      printf("display client '%s' disconnected\n", c->name.c_str());
+      dirty = true;  // 重新合成以清除它的区域
+      break;
+    }
+  }
+  if (c->shared) munmap(c->shared, sizeof(DisplayShared));
+  if (c->mem_fd >= 0) close(c->mem_fd);
+  if (c->event_fd >= 0) close(c->event_fd);  // 关闭时自动移出epoll
+  if (c->sock >= 0) close(c->sock);
+  delete c;
+}
+
+// 按连接顺序合成所有区域，后连接的客户端在上层
+void DisplayServer::composite(void) {
+  uint64_t start = monotonicUs();
+  uint8_t *frame = oled.getFrame_GRAM();
+  memset(frame, 0, OLED_PAGES * OLED_MAX_COLUMN);
+
+  for (size_t i = 0; i < clients.size(); i++) {
+    Client *c = clients[i];
+    DisplayShared *sh = c->shared;
+    // 读取期间客户端又提交了两次时，缓冲可能已被重新绘制，重读一次
+    for (int tries = 0; tries < 3; tries++) {
+      uint32_t seq = sh->seq.load(std::memory_order_acquire);
+      uint32_t front = sh->front.load(std::memory_order_acquire) & 1;
+      const uint8_t *src = sh->buf[front];
+      rasterBlitRect(frame, src, c->x, c->y, c->x + c->w - 1, c->y + c->h - 1,
+                     ROP_COPY);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (sh->seq.load(std::memory_order_relaxed) == seq) break;
+    }
+  }
+  statsRecord(STAT_RASTER, monotonicUs() - start);
+  oled.present();
+}
+
+void DisplayServer::run(void) {
+  struct epoll_event events[16];
+  while (running) {
+    // 有待上传的提交时，等到最小间隔到期再合成
+    int timeout = -1;
+    if (dirty) {
+      uint64_t due = last_upload_us + min_interval_us;
+      uint64_t now = monotonicUs();
+      timeout = now >= due ? 0 : (int)((due - now + 999) / 1000);
+    }
+    int handshake_ms = expirePending(monotonicUs());
+    if (handshake_ms >= 0 && (timeout < 0 || handshake_ms < timeout)) {
+      timeout = handshake_ms;
+    }
+
+    int n = epoll_wait(epoll_fd, events, 16, timeout);
+    if (n < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      break;
+    }
+    for (int i = 0; i < n; i++) {
+      Client *c = (Client *)events[i].data.ptr;
+      if (!c) {
+        accept();
+        continue;
+      }
+      if (!c->shared) {
+        // 还在等请求：有数据就握手，断开或出错时handshake读不到请求
+        onRequest(c);
+        // 失败时c已释放，同一批事件里不会再有它的其他事件（只登记了套接字）
+        continue;
+      }
+      if (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        drop(c);
+        // 同一批事件里可能还有它的eventfd，重新等待即可
+        break;
+      }
+      uint64_t count;
+      if (read(c->event_fd, &count, sizeof(count)) == sizeof(count)) {
+        dirty = true;
+      }
+    }
+
+    if (dirty && monotonicUs() >= last_upload_us + min_interval_us) {
+      composite();
+      dirty = false;
+      last_upload_us = monotonicUs();
+    }
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef DISPLAY_SERVER_H
+#define DISPLAY_SERVER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "oled.h"
+
+// 显示服务：由一个进程独占I2C总线，其他进程通过UNIX套接字申请屏幕区域。
+// 每个客户端得到一块memfd共享帧缓冲区（双缓冲）和一个eventfd，
+// 绘制直接写共享内存，提交时只写eventfd，像素数据不经过套接字。
+// 服务端把各区域合成到自己的帧缓冲区，再只上传变化的块。
+
+#define DISPLAY_SERVER_SOCKET "/tmp/oled_server.sock"
+#define DISPLAY_MAGIC 0x4F4C4544  // "OLED"
+#define DISPLAY_NAME_LEN 16
+#define DISPLAY_HANDSHAKE_US 1000000  // 连接后发送请求的期限
+
+// 共享帧缓冲区：两个缓冲都按全屏页布局（8页 x 128列）存放，
+// 客户端可直接用绝对坐标绘制，服务端只取分配区域内的像素。
+struct DisplayShared {
+  uint32_t magic;
+  uint8_t x, y, w, h;             // 分配到的区域（y/h按页对齐）
+  std::atomic<uint32_t> seq;      // 每次提交递增，服务端据此检测读取期间的翻转
+  std::atomic<uint32_t> front;    // 已提交、供服务端读取的缓冲
+  uint8_t buf[2][OLED_PAGES * OLED_MAX_COLUMN];
+};
+
+// 连接请求/应答（应答随SCM_RIGHTS带上memfd和eventfd）
+struct DisplayRequest {
+  uint32_t magic;
+  uint8_t x, y, w, h;
+  char name[DISPLAY_NAME_LEN];
+};
+
+struct DisplayReply {
+  int32_t status;  // 0成功，否则为负的errno
+  uint8_t x, y, w, h;
+};
+
+class DisplayServer {
+ public:
+  // min_interval_us：两次上传的最小间隔，期间的提交合并为一次
+  DisplayServer(OLED &oled, const char *path = DISPLAY_SERVER_SOCKET,
+                uint32_t min_interval_us = 20000);
+  ~DisplayServer();
+
+  bool start(void);
+  void run(void);  // 事件循环，直到stop()
+  void stop(void) { running = false; }  // 可在信号处理函数中调用
+
+  size_t clientCount(void) const { return clients.size(); }
+
+ private:
+  // 连接后先放在pending里，由事件循环读到请求后再握手，
+  // 不发请求的客户端不会卡住其他客户端的上传
+  struct Client {
+    int sock;
+    uint64_t accepted_us;
+    int event_fd;
+    int mem_fd;
+    DisplayShared *shared;
+    uint8_t x, y, w, h;  // 以服务端保存的为准，不信任共享内存中的头部
+    std::string name;
+  };
+
+  OLED &oled;
+  std::string path;
+  uint32_t min_interval_us;
+  int listen_fd;
+  int epoll_fd;
+  bool bound;  // 套接字文件由本实例创建，析构时才删除
+  volatile bool running;
+  bool dirty;
+  uint64_t last_upload_us;
+  std::vector<Client *> clients;
+  std::vector<Client *> pending;  // 已连接、还没收到请求
+
+  void accept(void);
+  void onRequest(Client *c);
+  bool handshake(Client *c);
+  int expirePending(uint64_t now);
+  void drop(Client *c);
+  void composite(void);
+};
+
+#endif  // DISPLAY_SERVER_H
@@ -0,0 +1,81 @@
+#include "frame_codec.h"
+
+#include <string.h>
+
+size_t frameRleEncode(const uint8_t *src, size_t len, uint8_t *out) {
+  size_t o = 0;
+  size_t i = 0;
+  while (i < len) {
+    // 重复段；两字节的重复不划算（x,y,y会变成4字节），留在原样段里
+    size_t run = 1;
+    while (i + run < len && run < 129 && src[i + run] == src[i]) run++;
+    if (run >= 3) {
+      out[o++] = (uint8_t)(0x7E + run);
+      out[o++] = src[i];
+      i += run;
+      continue;
+    }
+    // 原样段，直到出现长度>=3的重复
+    size_t start = i;
+    while (i < len && i - start < 128) {
+      if (i + 2 < len && src[i + 1] == src[i] && src[i + 2] == src[i]) break;
+      i++;
+    }
+    out[o++] = (uint8_t)(i - start - 1);
+    memcpy(out + o, src + start, i - start);
+    o += i - start;
+  }
+  return o;
+}
+
+size_t frameRleDecode(const uint8_t *in, size_t in_len, uint8_t *out,
+                      size_t out_len) {
+  size_t o = 0;
+  size_t i = 0;
+  while (i < in_len) {
+    uint8_t c = in[i++];
+    if (c < 0x80) {
+      size_t n = c + 1;
+      if (i + n > in_len || o + n > out_len) return 0;
+      memcpy(out + o, in + i, n);
+      i += n;
+      o += n;
+    } else {
+      size_t n = c - 0x7E;
+      if (i >= in_len || o + n > out_len) return 0;
+      memset(out + o, in[i++], n);
+      o += n;
+    }
+  }
+  return o;
+}
+
+size_t frameDeltaEncode(const uint8_t *cur, const uint8_t *prev,
+                        uint8_t *out) {
+  if (!prev) return frameRleEncode(cur, FRAME_BYTES, out);
+
+  // 调用者的缓冲区不保证对齐，按字用memcpy读写
+  uint64_t diff[FRAME_BYTES / 8];
+  for (int i = 0; i < FRAME_BYTES / 8; i++) {
+    uint64_t a, b;
+    memcpy(&a, cur + i * 8, 8);
+    memcpy(&b, prev + i * 8, 8);
+    diff[i] = a ^ b;
+  }
+  return frameRleEncode((const uint8_t *)diff, FRAME_BYTES, out);
+}
+
+bool frameDeltaApply(uint8_t *frame, const uint8_t *in, size_t in_len) {
+  uint64_t diff[FRAME_BYTES / 8];
+  if (frameRleDecode(in, in_len, (uint8_t *)diff, FRAME_BYTES) !=
+      FRAME_BYTES) {
+    return false;
+  }
+  for (int i = 0; i < FRAME_BYTES / 8; i++) {
+    uint64_t f;
+    memcpy(&f, frame + i * 8, 8);
+    f ^= diff[i];
+    memcpy(frame + i * 8, &f, 8);
+  }
+  return true;
+}
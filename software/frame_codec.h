@@ -0,0 +1,30 @@
+#ifndef FRAME_CODEC_H
+#define FRAME_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "oled.h"
+
+// 帧编码：当前帧与上一帧异或后做游程编码。
+// 控制字节c < 0x80：后跟c+1个原样字节；c >= 0x80：下一字节重复c-0x7E次（2~129）。
+// 大部分区域不变时异或结果几乎全为0，一帧通常只有几十字节。
+// 编码器只把3字节以上的重复编成重复段，每个原样段（最长128字节）只多
+// 一个控制字节，不是满段的原样段之后必有至少省1字节的重复段，所以
+// n字节最多编码为n + n/128 + 1字节。
+
+#define FRAME_BYTES (OLED_PAGES * OLED_MAX_COLUMN)
+#define FRAME_RLE_BOUND(n) ((n) + (n) / 128 + 1)  // 最坏情况
+#define FRAME_RLE_MAX FRAME_RLE_BOUND(FRAME_BYTES)
+
+size_t frameRleEncode(const uint8_t *src, size_t len, uint8_t *out);
+// 解码到out，返回写出的字节数；输入损坏或超出out_len时返回0
+size_t frameRleDecode(const uint8_t *in, size_t in_len, uint8_t *out,
+                      size_t out_len);
+
+// out = RLE(cur ^ prev)，prev为nullptr时编码关键帧
+size_t frameDeltaEncode(const uint8_t *cur, const uint8_t *prev, uint8_t *out);
+// frame ^= RLE解码(in)
+bool frameDeltaApply(uint8_t *frame, const uint8_t *in, size_t in_len);
+
+#endif  // FRAME_CODEC_H
@@ -0,0 +1,158 @@
+#include "frame_recorder.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "stats.h"
+
+FrameRecorder::FrameRecorder()
+    : fd(-1),
+      nblocks(0),
+      seq(0),
+      block_used(0),
+      base_us(0),
+      last_rotation(0),
+      frames(0) {}
+
+FrameRecorder::~FrameRecorder() { close(); }
+
+bool FrameRecorder::open(const char *path, uint32_t max_bytes) {
+  close();
+  nblocks = (max_bytes - sizeof(RecordFileHeader)) / RECORD_BLOCK_SIZE;
+  if (max_bytes < sizeof(RecordFileHeader) || nblocks < 2) return false;
+
+  fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    perror("frame recorder");
+    return false;
+  }
+  RecordFileHeader hdr = {RECORD_FILE_MAGIC, 1, RECORD_BLOCK_SIZE, nblocks};
+  if (pwrite(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr)) {
+    close();
+    return false;
+  }
+  seq = 0;
+  block_used = 0;
+  frames = 0;
+  return true;
+}
+
+void FrameRecorder::close(void) {
+  if (fd < 0) return;
+  fdatasync(fd);
+  ::close(fd);
+  fd = -1;
+}
+
+void FrameRecorder::record(const uint8_t *frame, uint8_t rotation) {
+  if (fd < 0) return;
+  StatsTimer timer(STAT_RECORD);
+  uint64_t now = monotonicUs();
+
+  size_t hdr_len = 0;
+  bool key = block_used == 0 || rotation != last_rotation;
+  uint8_t *payload = buf + sizeof(RecordBlockHeader) + sizeof(RecordHeader);
+  size_t len = frameDeltaEncode(frame, key ? nullptr : prev, payload);
+
+  // 当前块放不下（或时间差溢出）时开新块，新块以关键帧开始
+  if (block_used == 0 ||
+      block_used + sizeof(RecordHeader) + len + sizeof(RecordHeader) >
+          RECORD_BLOCK_SIZE ||
+      now - base_us > 0xFFFFFFFFULL) {
+    if (block_used) seq++;
+    if (!key) len = frameDeltaEncode(frame, nullptr, payload);
+    key = true;
+    base_us = now;
+    block_used = sizeof(RecordBlockHeader);
+    RecordBlockHeader bh = {RECORD_BLOCK_MAGIC, seq, base_us};
+    memcpy(buf, &bh, sizeof(bh));
+    hdr_len = sizeof(bh);
+  }
+
+  RecordHeader rh = {(uint8_t)(key ? RECORD_KEY : RECORD_DELTA), rotation,
+                     (uint16_t)len, (uint32_t)(now - base_us)};
+  RecordHeader end = {RECORD_END, 0, 0, 0};
+  uint8_t *p = payload - sizeof(RecordHeader) - hdr_len;  // 块头已在buf开头
+  memcpy(p + hdr_len, &rh, sizeof(rh));
+  memcpy(payload + len, &end, sizeof(end));
+
+  // 记录连同结束标记一次写出，下一条记录覆盖结束标记
+  size_t total = hdr_len + sizeof(rh) + len + sizeof(end);
+  off_t off = sizeof(RecordFileHeader) +
+              (off_t)(seq % nblocks) * RECORD_BLOCK_SIZE + block_used -
+              hdr_len;
+  if (pwrite(fd, p, total, off) != (ssize_t)total) {
+    timer.fail();
+    return;
+  }
+  timer.addBytes(total);
+
+  block_used += sizeof(rh) + len;
+  memcpy(prev, frame, FRAME_BYTES);
+  last_rotation = rotation;
+  frames++;
+}
+
+// ========== 读取 ==========
+struct LoadedBlock {
+  uint32_t seq;
+  std::vector<uint8_t> data;
+};
+
+bool loadRecording(const char *path, std::vector<RecordedFrame> &frames) {
+  frames.clear();
+  FILE *fp = fopen(path, "rb");
+  if (!fp) return false;
+
+  RecordFileHeader hdr;
+  if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != RECORD_FILE_MAGIC ||
+      hdr.version != 1 || hdr.block_size < sizeof(RecordBlockHeader)) {
+    fclose(fp);
+    return false;
+  }
+
+  std::vector<LoadedBlock> blocks;
+  for (uint32_t i = 0; i < hdr.nblocks; i++) {
+    LoadedBlock b;
+    b.data.resize(hdr.block_size);
+    if (fread(&b.data[0], 1, hdr.block_size, fp) == 0) break;  // 尚未写到
+    RecordBlockHeader bh;
+    memcpy(&bh, &b.data[0], sizeof(bh));
+    if (bh.magic != RECORD_BLOCK_MAGIC) continue;
+    b.seq = bh.seq;
+    blocks.push_back(b);
+  }
+  fclose(fp);
+
+  std::sort(blocks.begin(), blocks.end(),
+            [](const LoadedBlock &a, const LoadedBlock &b) {
+              return a.seq < b.seq;
+            });
+
+  RecordedFrame f;
+  for (size_t i = 0; i < blocks.size(); i++) {
+    const uint8_t *d = &blocks[i].data[0];
+    size_t size = blocks[i].data.size();
+    RecordBlockHeader bh;
+    memcpy(&bh, d, sizeof(bh));
+
+    size_t pos = sizeof(bh);
+    while (pos + sizeof(RecordHeader) <= size) {
+      RecordHeader rh;
+      memcpy(&rh, d + pos, sizeof(rh));
+      pos += sizeof(rh);
+      if (rh.type == RECORD_END || pos + rh.len > size) break;
+      if (rh.type == RECORD_KEY) memset(f.frame, 0, FRAME_BYTES);
+      if (!frameDeltaApply(f.frame, d + pos, rh.len)) break;
+      pos += rh.len;
+      f.ts_us = bh.base_us + rh.dt_us;
+      f.rotation = rh.rotation;
+      frames.push_back(f);
+    }
+  }
+  return true;
+}
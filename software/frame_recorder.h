@@ -0,0 +1,83 @@
+#ifndef FRAME_RECORDER_H
+#define FRAME_RECORDER_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "frame_codec.h"
+
+// 帧录制：每次上传的帧以异或增量+RLE写入固定大小的环形文件。
+// 文件由若干块组成，每块以关键帧开始、可独立解码；写满后覆盖最旧的块。
+// 每帧只有一次pwrite（记录本身+结束标记），不做fsync。
+//
+// 文件布局：RecordFileHeader，随后nblocks个block_size字节的块；
+// 块 = RecordBlockHeader + 若干(RecordHeader + 数据)，以type为0的记录结束。
+
+#define RECORD_FILE_MAGIC 0x43524C4F   // "OLRC"
+#define RECORD_BLOCK_MAGIC 0x4B4C4252  // "RBLK"
+#define RECORD_BLOCK_SIZE 4096
+
+enum RecordType : uint8_t {
+  RECORD_END = 0,
+  RECORD_KEY = 1,    // 与全0帧的差（块内第一帧或旋转变化后）
+  RECORD_DELTA = 2,  // 与上一帧的差
+};
+
+struct RecordFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t block_size;
+  uint32_t nblocks;
+};
+
+struct RecordBlockHeader {
+  uint32_t magic;
+  uint32_t seq;      // 块序号，单调递增
+  uint64_t base_us;  // 块内时间戳基准（CLOCK_MONOTONIC）
+};
+
+struct RecordHeader {
+  uint8_t type;
+  uint8_t rotation;
+  uint16_t len;    // 数据长度
+  uint32_t dt_us;  // 相对base_us的时间
+};
+
+class FrameRecorder {
+ public:
+  FrameRecorder();
+  ~FrameRecorder();
+
+  // max_bytes为文件大小上限，至少两块
+  bool open(const char *path, uint32_t max_bytes = 256 * 1024);
+  void close(void);
+  bool isOpen(void) const { return fd >= 0; }
+
+  void record(const uint8_t *frame, uint8_t rotation);
+
+  uint32_t framesRecorded(void) const { return frames; }
+
+ private:
+  int fd;
+  uint32_t nblocks;
+  uint32_t seq;         // 当前块序号
+  uint32_t block_used;  // 当前块已用字节，0表示需要开新块
+  uint64_t base_us;
+  uint8_t last_rotation;
+  uint32_t frames;
+  alignas(8) uint8_t prev[FRAME_BYTES];
+  uint8_t buf[sizeof(RecordBlockHeader) + sizeof(RecordHeader) +
+              FRAME_RLE_MAX + sizeof(RecordHeader)];
+};
+
+struct RecordedFrame {
+  uint64_t ts_us;
+  uint8_t rotation;
+  alignas(8) uint8_t frame[FRAME_BYTES];
+};
+
+// 读取录制文件，按时间顺序返回所有可解码的帧
+bool loadRecording(const char *path, std::vector<RecordedFrame> &frames);
+
+#endif  // FRAME_RECORDER_H
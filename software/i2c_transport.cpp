@@ -0,0 +1,150 @@
+#include "i2c_transport.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#if HAVE_WIRINGPI
+#include <wiringPiI2C.h>
+#endif
+
+LinuxI2CTransport::LinuxI2CTransport(uint8_t i2c_bus, uint8_t addr) {
+#if HAVE_WIRINGPI
+  char device[20];
+  snprintf(device, sizeof(device), "/dev/i2c-%d", i2c_bus);
+  fd = wiringPiI2CSetupInterface(device, addr);
+#else
+  (void)i2c_bus;
+  (void)addr;
+  fd = -1;  // 主机工具构建：没有wiringPi
+#endif
+}
+
+LinuxI2CTransport::~LinuxI2CTransport() {
+  if (fd >= 0) close(fd);
+}
+
+bool LinuxI2CTransport::write(const uint8_t *buf, size_t len) {
+  if (fd < 0) return false;
+#if HAVE_WIRINGPI
+  // 单字节命令/数据沿用SMBus写寄存器，突发数据直接write
+  if (len == 2) return wiringPiI2CWriteReg8(fd, buf[0], buf[1]) >= 0;
+#endif
+  return ::write(fd, buf, len) == (ssize_t)len;
+}
+
+// ========== 模拟控制器 ==========
+MockTransport::MockTransport()
+    : mode(2),
+      page(0),
+      col(0),
+      col_start(0),
+      col_end(127),
+      page_start(0),
+      page_end(7),
+      pending_cmd(0),
+      pending_args(0),
+      pace_khz(0) {
+  memset(gram, 0, sizeof(gram));
+  resetCounters();
+}
+
+void MockTransport::resetCounters(void) {
+  n_transactions = 0;
+  n_short = 0;
+  n_bytes = 0;
+  n_bits = 0;
+}
+
+uint64_t MockTransport::estimateUs(uint32_t bus_khz, uint32_t settle_us) const {
+  return n_bits * 1000 / bus_khz + (uint64_t)n_short * settle_us;
+}
+
+bool MockTransport::write(const uint8_t *buf, size_t len) {
+  if (len == 0) return false;
+  n_transactions++;
+  n_bytes += len;
+  uint32_t bits = 9 * (len + 1) + 2;  // 地址字节 + 数据字节（含ACK），起止位
+  n_bits += bits;
+  if (len == 2) n_short++;
+  if (pace_khz) usleep(bits * 1000 / pace_khz);
+
+  bool is_data = buf[0] & 0x40;
+  for (size_t i = 1; i < len; i++) {
+    if (is_data) {
+      data(buf[i]);
+    } else {
+      command(buf[i]);
+    }
+  }
+  return true;
+}
+
+void MockTransport::command(uint8_t c) {
+  // 多字节命令的参数
+  if (pending_args) {
+    switch (pending_cmd) {
+      case 0x20:
+        mode = c & 3;
+        break;
+      case 0x21:
+        if (pending_args == 2) {
+          col_start = c & 127;
+        } else {
+          col_end = c & 127;
+          col = col_start;
+        }
+        break;
+      case 0x22:
+        if (pending_args == 2) {
+          page_start = c & 7;
+        } else {
+          page_end = c & 7;
+          page = page_start;
+        }
+        break;
+    }
+    pending_args--;
+    return;
+  }
+
+  if (mode == 2 && c <= 0x0F) {
+    col = (col & 0xF0) | c;
+  } else if (mode == 2 && c >= 0x10 && c <= 0x1F) {
+    col = ((c & 0x0F) << 4) | (col & 0x0F);
+  } else if (c >= 0xB0 && c <= 0xB7) {
+    page = c & 7;
+  } else if (c == 0x21 || c == 0x22) {
+    pending_cmd = c;
+    pending_args = 2;
+  } else if (c == 0x20 || c == 0x81 || c == 0x8D || c == 0xA8 || c == 0xD3 ||
+             c == 0xD5 || c == 0xD8 || c == 0xD9 || c == 0xDA || c == 0xDB) {
+    pending_cmd = c;
+    pending_args = 1;
+  }
+}
+
+void MockTransport::data(uint8_t d) {
+  gram[page][col & 127] = d;
+  if (mode == 2) {
+    col = (col + 1) & 127;
+    return;
+  }
+  if (mode == 1) {
+    // 垂直寻址：先换页再换列
+    if (page >= page_end) {
+      page = page_start;
+      col = col >= col_end ? col_start : col + 1;
+    } else {
+      page++;
+    }
+    return;
+  }
+  // 水平寻址：在列/页窗口内自动换行
+  if (col >= col_end) {
+    col = col_start;
+    page = page >= page_end ? page_start : page + 1;
+  } else {
+    col++;
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef I2C_TRANSPORT_H
+#define I2C_TRANSPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// OLED的总线抽象：每次write对应一次I2C写传输，首字节为控制字节
+// （0x00命令 / 0x40数据）。
+class I2CTransport {
+ public:
+  virtual ~I2CTransport() {}
+  virtual bool isOpen(void) const = 0;
+  virtual bool write(const uint8_t *buf, size_t len) = 0;
+  // 单字节命令/数据之后需要的等待时间（微秒）
+  virtual uint32_t settleUs(void) const { return 0; }
+};
+
+// /dev/i2c-N，经由wiringPi打开
+class LinuxI2CTransport : public I2CTransport {
+ public:
+  LinuxI2CTransport(uint8_t i2c_bus, uint8_t addr);
+  ~LinuxI2CTransport();
+
+  bool isOpen(void) const { return fd >= 0; }
+  bool write(const uint8_t *buf, size_t len);
+  uint32_t settleUs(void) const { return 100; }
+  int getFd(void) const { return fd; }
+
+ private:
+  int fd;
+};
+
+// 丢弃所有数据：用于不占用总线的离屏画布（如显示服务客户端）
+class NullTransport : public I2CTransport {
+ public:
+  bool isOpen(void) const { return true; }
+  bool write(const uint8_t *, size_t) { return true; }
+};
+
+// 模拟控制器：统计传输量，并按页/水平寻址模式解析命令，
+// 在内存中还原显存内容，用于回放和离线验证。
+class MockTransport : public I2CTransport {
+ public:
+  MockTransport();
+
+  bool isOpen(void) const { return true; }
+  bool write(const uint8_t *buf, size_t len);
+
+  void resetCounters(void);
+  uint32_t transactions(void) const { return n_transactions; }
+  uint32_t shortWrites(void) const { return n_short; }  // 单字节命令/数据
+  uint32_t bytes(void) const { return n_bytes; }
+  // 估算总线耗时：每次传输含起止位和地址字节，每字节9位；
+  // 单字节写另加settle_us（与真实驱动的等待一致）
+  uint64_t estimateUs(uint32_t bus_khz = 400, uint32_t settle_us = 100) const;
+  // 按总线速率实际等待每次传输的时长（0为不等待），用于多总线并行的测试
+  void setPacing(uint32_t bus_khz) { pace_khz = bus_khz; }
+
+  const uint8_t *panel(void) const { return gram[0]; }  // 8页 x 128列
+
+ private:
+  uint8_t gram[8][128];
+  uint8_t mode;  // 0水平，1垂直，2页寻址
+  uint8_t page, col;
+  uint8_t col_start, col_end, page_start, page_end;
+  uint8_t pending_cmd, pending_args;
+  uint32_t n_transactions, n_short, n_bytes;
+  uint64_t n_bits;
+  uint32_t pace_khz;
+
+  void command(uint8_t c);
+  void data(uint8_t d);
+};
+
+#endif  // I2C_TRANSPORT_H
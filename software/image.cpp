@@ -0,0 +1,176 @@
+#include "image.h"
+
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 8x8 Bayer矩阵（0~63）
+static const uint8_t kBayer8[8][8] = {
+    {0, 32, 8, 40, 2, 34, 10, 42},  {48, 16, 56, 24, 50, 18, 58, 26},
+    {12, 44, 4, 36, 14, 46, 6, 38}, {60, 28, 52, 20, 62, 30, 54, 22},
+    {3, 35, 11, 43, 1, 33, 9, 41},  {51, 19, 59, 27, 49, 17, 57, 25},
+    {15, 47, 7, 39, 13, 45, 5, 37}, {63, 31, 55, 23, 61, 29, 53, 21},
+};
+
+ImagePipeline::ImagePipeline(OLED &oled, int src_w, int src_h, int dst_x,
+                             int dst_y, int dst_w, int dst_h, DitherMode mode)
+    : oled(oled),
+      src_w(src_w),
+      src_h(src_h),
+      dst_x(dst_x),
+      dst_y(dst_y),
+      dst_w(dst_w),
+      dst_h(dst_h),
+      mode(mode),
+      src_row(0),
+      dst_row(0),
+      acc_rows(0) {
+  col_start.resize(dst_w);
+  col_count.resize(dst_w);
+  for (int j = 0; j < dst_w; j++) {
+    int start = (int)((int64_t)j * src_w / dst_w);
+    int end = (int)((int64_t)(j + 1) * src_w / dst_w);
+    if (end <= start) end = start + 1;
+    col_start[j] = start;
+    col_count[j] = end - start;
+  }
+  acc.assign(dst_w, 0);
+  line.resize(dst_w);
+  if (mode == DITHER_FLOYD) {
+    err_cur.assign(dst_w + 2, 0);
+    err_next.assign(dst_w + 2, 0);
+  }
+}
+
+int ImagePipeline::rowEnd(int y) const {
+  int start = rowStart(y);
+  int end = rowStart(y + 1);
+  return end <= start ? start + 1 : end;
+}
+
+void ImagePipeline::pushRow(const uint8_t *row) {
+  if (done()) return;
+
+  // 水平方向按区域平均缩放，累加到垂直累加器
+  for (int j = 0; j < dst_w; j++) {
+    const uint8_t *p = row + col_start[j];
+    uint32_t sum = 0;
+    for (int k = 0; k < col_count[j]; k++) sum += p[k];
+    acc[j] += sum;
+  }
+  acc_rows++;
+
+  // 当前源行是若干输出行的最后一行时输出它们（放大时一行源对应多行输出）
+  int sy = src_row++;
+  while (dst_row < dst_h && rowEnd(dst_row) - 1 == sy) {
+    emitRow(dst_row++);
+    if (dst_row < dst_h && rowStart(dst_row) > sy) {
+      memset(&acc[0], 0, dst_w * sizeof(uint32_t));
+      acc_rows = 0;
+    }
+  }
+}
+
+void ImagePipeline::pushFrame(const uint8_t *pixels, int stride) {
+  for (int y = src_row; y < src_h; y++) pushRow(pixels + y * stride);
+}
+
+void ImagePipeline::emitRow(int y) {
+  int cy = dst_y + y;
+  if (cy < 0 || cy >= oled.getHeight()) return;
+
+  for (int j = 0; j < dst_w; j++) {
+    line[j] = (uint8_t)(acc[j] / (col_count[j] * acc_rows));
+  }
+
+  if (mode == DITHER_FLOYD) {
+    ditherFloyd(cy);
+  } else {
+    ditherOrdered(cy, mode == DITHER_THRESHOLD);
+  }
+}
+
+// 有序抖动：一行灰度与阈值行比较，结果直接合并进所在页的对应位。
+// 页打包布局下同一行的像素在内存中按列连续，可以16列一组处理。
+void ImagePipeline::ditherOrdered(int cy, uint8_t threshold_only) {
+  int c0 = dst_x < 0 ? -dst_x : 0;
+  int c1 = dst_x + dst_w > oled.getWidth() ? oled.getWidth() - dst_x : dst_w;
+  if (c0 >= c1) return;
+
+  uint8_t thr[OLED_MAX_COLUMN];
+  const uint8_t *bayer = kBayer8[cy & 7];
+  for (int j = c0; j < c1; j++) {
+    thr[j - c0] = threshold_only ? 127 : bayer[(dst_x + j) & 7] * 4 + 2;
+  }
+
+  uint8_t bit = 1 << (cy & 7);
+  uint8_t *dst = oled.getPage_GRAM(cy >> 3) + dst_x + c0;
+  const uint8_t *src = &line[c0];
+  int n = c1 - c0;
+  int i = 0;
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+  uint8x16_t vbit = vdupq_n_u8(bit);
+  for (; i + 16 <= n; i += 16) {
+    uint8x16_t on = vcgtq_u8(vld1q_u8(src + i), vld1q_u8(thr + i));
+    vst1q_u8(dst + i, vbslq_u8(vbit, on, vld1q_u8(dst + i)));
+  }
+#elif defined(__SSE2__)
+  __m128i vbit = _mm_set1_epi8((char)bit);
+  __m128i sign = _mm_set1_epi8((char)0x80);
+  for (; i + 16 <= n; i += 16) {
+    // 无符号比较：两边同时异或0x80后做有符号比较
+    __m128i g = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(src + i)),
+                              sign);
+    __m128i t = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(thr + i)),
+                              sign);
+    __m128i on = _mm_and_si128(_mm_cmpgt_epi8(g, t), vbit);
+    __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+    _mm_storeu_si128((__m128i *)(dst + i),
+                     _mm_or_si128(_mm_andnot_si128(vbit, d), on));
+  }
+#endif
+
+  for (; i < n; i++) {
+    dst[i] = src[i] > thr[i] ? (dst[i] | bit) : (dst[i] & ~bit);
+  }
+}
+
+// Floyd-Steinberg误差扩散，蛇形扫描；误差以1/16为单位保存
+void ImagePipeline::ditherFloyd(int cy) {
+  int width = oled.getWidth();
+  uint8_t bit = 1 << (cy & 7);
+  uint8_t *page = oled.getPage_GRAM(cy >> 3);
+  bool reverse = (cy & 1);
+  int dir = reverse ? -1 : 1;
+
+  for (int k = 0; k < dst_w; k++) {
+    int j = reverse ? dst_w - 1 - k : k;
+    int v = line[j] + (err_cur[j + 1] >> 4);
+    bool on = v >= 128;
+    int e = v - (on ? 255 : 0);
+
+    err_cur[j + 1 + dir] += e * 7;
+    err_next[j + 1 - dir] += e * 3;
+    err_next[j + 1] += e * 5;
+    err_next[j + 1 + dir] += e;
+
+    int x = dst_x + j;
+    if (x < 0 || x >= width) continue;
+    page[x] = on ? (page[x] | bit) : (page[x] & ~bit);
+  }
+
+  err_cur.swap(err_next);
+  memset(&err_next[0], 0, err_next.size() * sizeof(int16_t));
+}
+
+void drawGrayImage(OLED &oled, int x, int y, int w, int h,
+                   const uint8_t *pixels, int src_w, int src_h,
+                   DitherMode mode) {
+  ImagePipeline pipeline(oled, src_w, src_h, x, y, w, h, mode);
+  pipeline.pushFrame(pixels, src_w);
+}
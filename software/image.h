@@ -0,0 +1,60 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "oled.h"
+
+// 灰度图像导入：缩放到面板尺寸、抖动后直接写入页打包的GRAM。
+// 按行流式处理，640x480的帧也只需要一行累加缓冲区。
+
+enum DitherMode {
+  DITHER_THRESHOLD,  // 固定阈值128
+  DITHER_BAYER,      // 8x8有序抖动（向量化）
+  DITHER_FLOYD,      // Floyd-Steinberg误差扩散
+};
+
+class ImagePipeline {
+ public:
+  // 源图像src_w x src_h，输出到逻辑画布的(dst_x, dst_y, dst_w, dst_h)区域
+  ImagePipeline(OLED &oled, int src_w, int src_h, int dst_x, int dst_y,
+                int dst_w, int dst_h, DitherMode mode = DITHER_BAYER);
+
+  // 按从上到下的顺序推入一行8位灰度源像素
+  void pushRow(const uint8_t *row);
+  // 推入整帧（stride为行字节数）
+  void pushFrame(const uint8_t *pixels, int stride);
+  bool done(void) const { return src_row >= src_h; }
+
+ private:
+  OLED &oled;
+  int src_w, src_h;
+  int dst_x, dst_y, dst_w, dst_h;
+  DitherMode mode;
+
+  int src_row;   // 下一个源行
+  int dst_row;   // 下一个输出行
+  int acc_rows;  // 累加器中的源行数
+
+  std::vector<uint16_t> col_start;  // 每个输出列对应的源列范围
+  std::vector<uint16_t> col_count;
+  std::vector<uint32_t> acc;        // 垂直累加器（已做水平缩放）
+  std::vector<uint8_t> line;        // 缩放后的一行灰度
+  std::vector<int16_t> err_cur;     // 误差扩散：当前行/下一行误差
+  std::vector<int16_t> err_next;
+
+  int rowStart(int y) const { return (int)((int64_t)y * src_h / dst_h); }
+  int rowEnd(int y) const;
+  void emitRow(int y);
+  void ditherOrdered(int y, uint8_t threshold_only);
+  void ditherFloyd(int y);
+};
+
+// 便捷函数：将整幅灰度图缩放抖动到指定区域
+void drawGrayImage(OLED &oled, int x, int y, int w, int h,
+                   const uint8_t *pixels, int src_w, int src_h,
+                   DitherMode mode = DITHER_BAYER);
+
+#endif  // IMAGE_H
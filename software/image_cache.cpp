@@ -0,0 +1,292 @@
+#include "image_cache.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define UPLOAD_TMP ".upload.tmp"
+
+static uint64_t mtimeUs(const struct stat &st) {
+  return (uint64_t)st.st_mtim.tv_sec * 1000000ULL + st.st_mtim.tv_nsec / 1000;
+}
+
+static bool parseHex(const char *s, uint8_t out[SHA256_LEN]) {
+  for (int i = 0; i < 2 * SHA256_LEN; i++) {
+    char c = s[i];
+    int v = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                                                                   : -1;
+    if (v < 0) return false;
+    if (i & 1) {
+      out[i / 2] |= v;
+    } else {
+      out[i / 2] = v << 4;
+    }
+  }
+  return true;
+}
+
+ImageCache::ImageCache(const char *dir, uint64_t max_bytes)
+    : dir(dir),
+      max_bytes(max_bytes),
+      used(0),
+      upload_fd(-1),
+      upload_size(0),
+      upload_done(0) {
+  memset(&stats, 0, sizeof(stats));
+}
+
+ImageCache::~ImageCache() {
+  abortUpload();
+  for (size_t i = 0; i < images.size(); i++) {
+    if (images[i]->data) munmap((void *)images[i]->data, images[i]->size);
+    delete images[i];
+  }
+}
+
+std::string ImageCache::pathOf(const uint8_t hash[SHA256_LEN]) const {
+  char hex[2 * SHA256_LEN + 1];
+  sha256Hex(hash, hex);
+  return dir + "/" + hex + ".img";
+}
+
+bool ImageCache::open(void) {
+  if (mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST) {
+    perror(dir.c_str());
+    return false;
+  }
+  DIR *d = opendir(dir.c_str());
+  if (!d) {
+    perror(dir.c_str());
+    return false;
+  }
+  struct dirent *de;
+  while ((de = readdir(d)) != nullptr) {
+    const char *name = de->d_name;
+    uint8_t hash[SHA256_LEN];
+    if (strlen(name) != 2 * SHA256_LEN + 4 ||
+        strcmp(name + 2 * SHA256_LEN, ".img") != 0 || !parseHex(name, hash)) {
+      continue;
+    }
+    struct stat st;
+    if (stat((dir + "/" + name).c_str(), &st) < 0) continue;
+    CachedImage *img = new CachedImage();
+    memcpy(img->hash, hash, SHA256_LEN);
+    img->size = st.st_size;
+    img->last_use = mtimeUs(st);
+    img->data = nullptr;
+    img->refs = 0;
+    img->verified = false;  // 只凭文件名和大小，第一次命中时再校验
+    images.push_back(img);
+    used += img->size;
+  }
+  closedir(d);
+  unlink((dir + "/" UPLOAD_TMP).c_str());  // 上次中断的上传
+  makeRoom(0);  // 上限可能比上次运行时小
+  return true;
+}
+
+CachedImage *ImageCache::find(const uint8_t hash[SHA256_LEN]) {
+  for (size_t i = 0; i < images.size(); i++) {
+    if (memcmp(images[i]->hash, hash, SHA256_LEN) == 0) return images[i];
+  }
+  return nullptr;
+}
+
+// 映射镜像，未校验过的先核对哈希；不符时删除镜像并返回false
+bool ImageCache::map(CachedImage *img) {
+  if (!img->data && img->size) {
+    int fd = ::open(pathOf(img->hash).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    void *p = mmap(nullptr, img->size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) return false;
+    madvise(p, img->size, MADV_SEQUENTIAL);
+    img->data = (const uint8_t *)p;
+  }
+  if (!img->verified) {
+    uint8_t hash[SHA256_LEN];
+    Sha256::hash(img->data, img->size, hash);
+    if (memcmp(hash, img->hash, SHA256_LEN) != 0) {
+      char hex[2 * SHA256_LEN + 1];
+      sha256Hex(img->hash, hex);
+      fprintf(stderr, "image cache: %s is corrupt, dropped\n", hex);
+      stats.corrupt++;
+      remove(img);
+      return false;
+    }
+    img->verified = true;
+  }
+  return true;
+}
+
+bool ImageCache::contains(const uint8_t hash[SHA256_LEN]) {
+  CachedImage *img = find(hash);
+  // 损坏的镜像按未命中处理，主机会重新上传
+  bool hit = img && (img->verified || map(img));
+  if (hit) {
+    stats.hits++;
+  } else {
+    stats.misses++;
+  }
+  return hit;
+}
+
+void ImageCache::remove(CachedImage *img) {
+  for (size_t i = 0; i < images.size(); i++) {
+    if (images[i] == img) {
+      images.erase(images.begin() + i);
+      break;
+    }
+  }
+  if (img->data) munmap((void *)img->data, img->size);
+  unlink(pathOf(img->hash).c_str());
+  used -= img->size;
+  delete img;
+}
+
+// 淘汰所有没有在途引用的镜像后能否放下size字节
+bool ImageCache::canFit(uint64_t size) const {
+  uint64_t pinned = 0;
+  for (size_t i = 0; i < images.size(); i++) {
+    if (images[i]->refs) pinned += images[i]->size;
+  }
+  return pinned + size <= max_bytes;
+}
+
+// 淘汰最久未用且没有在途引用的镜像，直到能再放下size字节
+bool ImageCache::makeRoom(uint64_t size) {
+  while (used + size > max_bytes) {
+    CachedImage *oldest = nullptr;
+    for (size_t i = 0; i < images.size(); i++) {
+      CachedImage *img = images[i];
+      if (img->refs == 0 && (!oldest || img->last_use < oldest->last_use)) {
+        oldest = img;
+      }
+    }
+    if (!oldest) return false;
+    remove(oldest);
+    stats.evictions++;
+  }
+  return true;
+}
+
+bool ImageCache::beginUpload(const uint8_t hash[SHA256_LEN], uint64_t size) {
+  abortUpload();
+  // 这里只检查放得下，不淘汰：中断或损坏的上传不能清空缓存
+  if (!canFit(size)) return false;
+  upload_fd = ::open((dir + "/" UPLOAD_TMP).c_str(),
+                     O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (upload_fd < 0) {
+    perror("image upload");
+    return false;
+  }
+  memcpy(upload_hash, hash, SHA256_LEN);
+  upload_size = size;
+  upload_done = 0;
+  upload_sha.reset();
+  return true;
+}
+
+bool ImageCache::appendUpload(const uint8_t *data, size_t len) {
+  if (upload_fd < 0 || upload_done + len > upload_size) return false;
+  upload_sha.update(data, len);
+  while (len) {
+    ssize_t n = write(upload_fd, data, len);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) {
+      perror("image upload");
+      abortUpload();
+      return false;
+    }
+    data += n;
+    len -= n;
+    upload_done += n;
+  }
+  return true;
+}
+
+bool ImageCache::finishUpload(void) {
+  if (upload_fd < 0) return false;
+  uint8_t hash[SHA256_LEN];
+  upload_sha.finish(hash);
+  if (upload_done != upload_size || memcmp(hash, upload_hash, SHA256_LEN)) {
+    fprintf(stderr, "image upload: hash or size mismatch\n");
+    abortUpload();
+    return false;
+  }
+  // 先落盘再改名：否则断电后可能留下内容还没写入的<hash>.img
+  if (fsync(upload_fd) < 0) {
+    perror("image upload");
+    abortUpload();
+    return false;
+  }
+  ::close(upload_fd);
+  upload_fd = -1;
+
+  // 已有同一镜像时只需丢弃临时文件
+  std::string tmp = dir + "/" UPLOAD_TMP;
+  if (find(hash)) {
+    unlink(tmp.c_str());
+    return true;
+  }
+  // 校验通过后才淘汰旧镜像；上传期间在途引用可能变了，仍放不下时丢弃
+  if (!makeRoom(upload_size)) {
+    fprintf(stderr, "image upload: cache full of in-use images\n");
+    unlink(tmp.c_str());
+    return false;
+  }
+  std::string path = pathOf(hash);
+  if (rename(tmp.c_str(), path.c_str()) < 0) {
+    perror("image upload");
+    unlink(tmp.c_str());
+    return false;
+  }
+  // 改名本身也要落盘
+  int dfd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dfd < 0 || fsync(dfd) < 0) perror(dir.c_str());
+  if (dfd >= 0) ::close(dfd);
+  struct stat st;
+  CachedImage *img = new CachedImage();
+  memcpy(img->hash, hash, SHA256_LEN);
+  img->size = upload_size;
+  img->last_use = stat(path.c_str(), &st) == 0 ? mtimeUs(st) : 0;
+  img->data = nullptr;
+  img->refs = 0;
+  img->verified = true;
+  images.push_back(img);
+  used += img->size;
+  stats.uploads++;
+  stats.upload_bytes += upload_size;
+  return true;
+}
+
+void ImageCache::abortUpload(void) {
+  if (upload_fd < 0) return;
+  ::close(upload_fd);
+  upload_fd = -1;
+  unlink((dir + "/" UPLOAD_TMP).c_str());
+}
+
+CachedImage *ImageCache::acquire(const uint8_t hash[SHA256_LEN]) {
+  CachedImage *img = find(hash);
+  if (!img || !map(img)) return nullptr;
+
+  // 更新mtime作为LRU时间；烧录时每块都会引用，最多每秒写一次
+  img->refs++;
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  uint64_t now = (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+  if (now - img->last_use > 1000000) {
+    utimensat(AT_FDCWD, pathOf(hash).c_str(), nullptr, 0);
+    img->last_use = now;
+  }
+  return img;
+}
+
+void ImageCache::release(CachedImage *img) { img->refs--; }
@@ -0,0 +1,86 @@
+#ifndef IMAGE_CACHE_H
+#define IMAGE_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "sha256.h"
+
+// 固件镜像缓存：按SHA-256内容寻址，每个镜像一个文件（<hex>.img），
+// 总大小超过上限时淘汰最久未用的镜像。镜像用mmap只读映射，
+// 烧录时直接把映射区交给USB传输。只在桥的事件循环线程中使用。
+// 上传完成时先fsync文件再改名、再fsync目录；重启后载入的镜像在第一次
+// 命中时重新校验哈希，断电留下的全0或不完整文件会被删除。
+
+struct CachedImage {
+  uint8_t hash[SHA256_LEN];
+  uint64_t size;
+  uint64_t last_use;  // 文件mtime（微秒），重启后仍保持LRU顺序
+  const uint8_t *data;  // 首次使用时映射
+  uint32_t refs;        // 在途传输的引用，非0时不会被淘汰
+  bool verified;        // 内容已与哈希核对
+};
+
+class ImageCache {
+ public:
+  struct Counters {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t uploads;
+    uint64_t upload_bytes;
+    uint64_t evictions;
+    uint64_t corrupt;  // 重新校验时哈希不符而删除的镜像
+  };
+
+  ImageCache(const char *dir, uint64_t max_bytes);
+  ~ImageCache();
+
+  bool open(void);  // 创建目录并载入已有镜像
+
+  bool contains(const uint8_t hash[SHA256_LEN]);  // 计入命中/未命中
+
+  // 上传：同一时刻只有一个；完成时校验哈希，不符则丢弃。
+  // 开始时只确认淘汰后放得下，校验通过后才真正淘汰旧镜像
+  bool beginUpload(const uint8_t hash[SHA256_LEN], uint64_t size);
+  bool appendUpload(const uint8_t *data, size_t len);
+  bool finishUpload(void);
+  void abortUpload(void);
+
+  // 取得映射后的镜像并增加引用，找不到或映射失败时返回nullptr
+  CachedImage *acquire(const uint8_t hash[SHA256_LEN]);
+  void release(CachedImage *img);
+
+  size_t entries(void) const { return images.size(); }
+  uint64_t usedBytes(void) const { return used; }
+  uint64_t maxBytes(void) const { return max_bytes; }
+  const Counters &counters(void) const { return stats; }
+
+ private:
+  std::string dir;
+  uint64_t max_bytes;
+  uint64_t used;
+  std::vector<CachedImage *> images;
+  Counters stats;
+
+  // 进行中的上传
+  int upload_fd;
+  uint8_t upload_hash[SHA256_LEN];
+  uint64_t upload_size;
+  uint64_t upload_done;
+  Sha256 upload_sha;
+
+  std::string pathOf(const uint8_t hash[SHA256_LEN]) const;
+  CachedImage *find(const uint8_t hash[SHA256_LEN]);
+  bool map(CachedImage *img);
+  bool canFit(uint64_t size) const;
+  bool makeRoom(uint64_t size);
+  void remove(CachedImage *img);
+
+  ImageCache(const ImageCache &);
+  ImageCache &operator=(const ImageCache &);
+};
+
+#endif  // IMAGE_CACHE_H
@@ -0,0 +1,242 @@
+#include "input.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/gpio.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "stats.h"
+
+// ========== gpio字符设备 ==========
+GpioChipSource::GpioChipSource() : epoll_fd(-1) {}
+
+GpioChipSource::~GpioChipSource() { close(); }
+
+bool GpioChipSource::open(const char *chip,
+                          const std::vector<uint32_t> &offsets,
+                          bool active_low) {
+  close();
+  int chip_fd = ::open(chip, O_RDONLY | O_CLOEXEC);
+  if (chip_fd < 0) {
+    perror(chip);
+    return false;
+  }
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    perror("epoll_create1");
+    ::close(chip_fd);
+    return false;
+  }
+
+  for (size_t i = 0; i < offsets.size(); i++) {
+    struct gpioevent_request req;
+    memset(&req, 0, sizeof(req));
+    req.lineoffset = offsets[i];
+    req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    if (active_low) req.handleflags |= GPIOHANDLE_REQUEST_ACTIVE_LOW;
+    req.eventflags = GPIOEVENT_REQUEST_BOTH_EDGES;
+    strncpy(req.consumer_label, "oled-input", sizeof(req.consumer_label) - 1);
+    if (ioctl(chip_fd, GPIO_GET_LINEEVENT_IOCTL, &req) < 0) {
+      fprintf(stderr, "gpio line %u: %s\n", offsets[i], strerror(errno));
+      ::close(chip_fd);
+      close();
+      return false;
+    }
+    fcntl(req.fd, F_SETFL, O_NONBLOCK);
+    line_fds.push_back(req.fd);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = i;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, req.fd, &ev);
+  }
+  ::close(chip_fd);  // 事件fd独立于芯片fd
+  return true;
+}
+
+void GpioChipSource::close(void) {
+  for (size_t i = 0; i < line_fds.size(); i++) ::close(line_fds[i]);
+  line_fds.clear();
+  if (epoll_fd >= 0) ::close(epoll_fd);
+  epoll_fd = -1;
+}
+
+bool GpioChipSource::read(GpioEdge &edge) {
+  struct epoll_event ev;
+  if (epoll_fd < 0 || epoll_wait(epoll_fd, &ev, 1, 0) != 1) return false;
+
+  struct gpioevent_data data;
+  if (::read(line_fds[ev.data.u32], &data, sizeof(data)) != sizeof(data)) {
+    return false;
+  }
+  // 设置了ACTIVE_LOW时内核按逻辑电平报告上升/下降沿
+  edge.line = ev.data.u32;
+  edge.level = data.id == GPIOEVENT_EVENT_RISING_EDGE;
+  edge.timestamp_ns = data.timestamp;
+  return true;
+}
+
+uint8_t GpioChipSource::level(uint8_t line) {
+  if (line >= line_fds.size()) return 0;
+  struct gpiohandle_data data;
+  memset(&data, 0, sizeof(data));
+  ioctl(line_fds[line], GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data);
+  return data.values[0];
+}
+
+// ========== 测试用事件源 ==========
+FakeEdgeSource::FakeEdgeSource(uint8_t lines) : levels(lines, 0) {
+  if (pipe2(pipe_fd, O_NONBLOCK | O_CLOEXEC) < 0) {
+    pipe_fd[0] = pipe_fd[1] = -1;
+  }
+}
+
+FakeEdgeSource::~FakeEdgeSource() {
+  if (pipe_fd[0] >= 0) ::close(pipe_fd[0]);
+  if (pipe_fd[1] >= 0) ::close(pipe_fd[1]);
+}
+
+void FakeEdgeSource::inject(uint8_t line, uint8_t level,
+                            uint64_t timestamp_ns) {
+  if (line < levels.size()) levels[line] = level;
+  GpioEdge edge = {line, level, timestamp_ns};
+  if (write(pipe_fd[1], &edge, sizeof(edge)) != sizeof(edge)) {
+    perror("fake edge");
+  }
+}
+
+bool FakeEdgeSource::read(GpioEdge &edge) {
+  return ::read(pipe_fd[0], &edge, sizeof(edge)) == sizeof(edge);
+}
+
+// ========== 消抖与解码 ==========
+// 编码器状态转移表：下标为(旧AB << 2) | 新AB，顺时针+1，逆时针-1，
+// 两线同时变化（丢边沿）为0
+static const int8_t kQuadrature[16] = {0, 1,  -1, 0,  -1, 0, 0,  1,
+                                       1, 0,  0,  -1, 0,  -1, 1, 0};
+
+InputManager::InputManager(EdgeSource *source, uint32_t debounce_us)
+    : source(source),
+      debounce_us(debounce_us),
+      enc_a(0xFF),
+      enc_b(0xFF),
+      enc_steps(4),
+      enc_state(0),
+      enc_acc(0) {}
+
+InputManager::Line &InputManager::line(uint8_t n) {
+  if (n >= lines.size()) {
+    Line blank = {ROLE_NONE, INPUT_KEY_NONE, 0, 0, 0, 0, 0};
+    lines.resize(n + 1, blank);
+  }
+  return lines[n];
+}
+
+void InputManager::bindButton(uint8_t n, InputKey key) {
+  Line &l = line(n);
+  l.role = ROLE_BUTTON;
+  l.key = key;
+  l.stable = l.raw = source->level(n);
+}
+
+void InputManager::bindEncoder(uint8_t line_a, uint8_t line_b,
+                               uint8_t steps_per_detent) {
+  line(line_a).role = ROLE_ENCODER;
+  line(line_b).role = ROLE_ENCODER;
+  enc_a = line_a;
+  enc_b = line_b;
+  enc_steps = steps_per_detent ? steps_per_detent : 1;
+  line(line_a).raw = source->level(line_a);
+  line(line_b).raw = source->level(line_b);
+  enc_state = (line(line_a).raw << 1) | line(line_b).raw;
+  enc_acc = 0;
+}
+
+void InputManager::emit(InputEventType type, InputKey key, int8_t delta,
+                        uint64_t ts_ns, uint64_t now_us) {
+  InputEvent ev = {type, key, delta, ts_ns, now_us};
+  pending.push_back(ev);
+}
+
+void InputManager::edge(const GpioEdge &e, uint64_t now_us) {
+  if (e.line >= lines.size()) return;
+  Line &l = lines[e.line];
+  l.raw = e.level;
+  l.raw_us = now_us;
+  l.raw_ns = e.timestamp_ns;
+
+  if (l.role == ROLE_BUTTON) {
+    // 锁定时间外的第一个边沿立即生效（不增加按键延迟），
+    // 锁定时间内的边沿先记下，静止满debounce后由settle()确认
+    if (l.raw != l.stable &&
+        e.timestamp_ns - l.changed_ns >= (uint64_t)debounce_us * 1000) {
+      l.stable = l.raw;
+      l.changed_ns = e.timestamp_ns;
+      emit(l.stable ? INPUT_PRESS : INPUT_RELEASE, l.key, 0, e.timestamp_ns,
+           now_us);
+    }
+  } else if (l.role == ROLE_ENCODER) {
+    uint8_t state = (lines[enc_a].raw << 1) | lines[enc_b].raw;
+    enc_acc += kQuadrature[(enc_state << 2) | state];
+    enc_state = state;
+    if (enc_acc >= enc_steps || enc_acc <= -enc_steps) {
+      int8_t dir = enc_acc > 0 ? 1 : -1;
+      enc_acc -= dir * enc_steps;
+      emit(INPUT_ROTATE, INPUT_KEY_NONE, dir, e.timestamp_ns, now_us);
+    }
+  }
+}
+
+// 锁定时间内变化、之后一直保持的按键状态在此确认
+void InputManager::settle(uint64_t now_us) {
+  for (size_t i = 0; i < lines.size(); i++) {
+    Line &l = lines[i];
+    if (l.role != ROLE_BUTTON || l.raw == l.stable) continue;
+    if (now_us - l.raw_us < debounce_us) continue;
+    l.stable = l.raw;
+    l.changed_ns = l.raw_ns;
+    emit(l.stable ? INPUT_PRESS : INPUT_RELEASE, l.key, 0, l.raw_ns, now_us);
+  }
+}
+
+void InputManager::drain(void) {
+  GpioEdge e;
+  while (source->read(e)) edge(e, monotonicUs());
+  settle(monotonicUs());
+}
+
+bool InputManager::poll(InputEvent &ev) {
+  drain();
+  if (pending.empty()) return false;
+  ev = pending.front();
+  pending.pop_front();
+  return true;
+}
+
+bool InputManager::wait(InputEvent &ev, int timeout_ms) {
+  uint64_t deadline = timeout_ms < 0 ? 0 : monotonicUs() + timeout_ms * 1000ULL;
+  while (true) {
+    if (poll(ev)) return true;
+
+    uint64_t now = monotonicUs();
+    if (timeout_ms >= 0 && now >= deadline) return false;
+    int wait_ms = timeout_ms < 0 ? -1 : (int)((deadline - now + 999) / 1000);
+
+    // 有等待确认的按键时，最多等到它的静止时间满
+    for (size_t i = 0; i < lines.size(); i++) {
+      const Line &l = lines[i];
+      if (l.role != ROLE_BUTTON || l.raw == l.stable) continue;
+      uint64_t due = l.raw_us + debounce_us;
+      int ms = due > now ? (int)((due - now + 999) / 1000) : 0;
+      if (wait_ms < 0 || ms < wait_ms) wait_ms = ms;
+    }
+
+    struct pollfd p = {fd(), POLLIN, 0};
+    ::poll(&p, 1, wait_ms);
+  }
+}
@@ -0,0 +1,130 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+
+#include <deque>
+#include <vector>
+
+// 按键/旋转编码器输入：从gpio字符设备（/dev/gpiochipN）读取带内核时间戳的
+// 边沿事件，用时间戳做软件消抖，不轮询引脚。事件源可替换为FakeEdgeSource，
+// 在没有硬件（或用gpio-sim）时驱动同一套消抖和解码逻辑。
+
+struct GpioEdge {
+  uint8_t line;           // 事件源内的线序号（不是芯片上的偏移）
+  uint8_t level;          // 边沿之后的逻辑电平，1为有效（按下）
+  uint64_t timestamp_ns;  // 内核时间戳
+};
+
+class EdgeSource {
+ public:
+  virtual ~EdgeSource() {}
+  virtual int fd(void) const = 0;           // 有边沿时可读，用于poll
+  virtual bool read(GpioEdge &edge) = 0;    // 非阻塞，没有事件时返回false
+  virtual uint8_t level(uint8_t line) = 0;  // 当前逻辑电平
+};
+
+// gpio字符设备v1接口（GPIO_GET_LINEEVENT_IOCTL），每条线一个事件fd，
+// 汇总到一个epoll fd上
+class GpioChipSource : public EdgeSource {
+ public:
+  GpioChipSource();
+  ~GpioChipSource();
+
+  // offsets为芯片上的线偏移，active_low时低电平为按下（上拉按键）
+  bool open(const char *chip, const std::vector<uint32_t> &offsets,
+            bool active_low = true);
+  void close(void);
+
+  int fd(void) const { return epoll_fd; }
+  bool read(GpioEdge &edge);
+  uint8_t level(uint8_t line);
+
+ private:
+  int epoll_fd;
+  std::vector<int> line_fds;
+};
+
+// 测试用事件源：inject写入管道，fd与真实设备一样可poll
+class FakeEdgeSource : public EdgeSource {
+ public:
+  explicit FakeEdgeSource(uint8_t lines);
+  ~FakeEdgeSource();
+
+  void inject(uint8_t line, uint8_t level, uint64_t timestamp_ns);
+
+  int fd(void) const { return pipe_fd[0]; }
+  bool read(GpioEdge &edge);
+  uint8_t level(uint8_t line) { return line < levels.size() ? levels[line] : 0; }
+
+ private:
+  int pipe_fd[2];
+  std::vector<uint8_t> levels;
+};
+
+enum InputKey : uint8_t {
+  INPUT_KEY_NONE,
+  INPUT_KEY_UP,
+  INPUT_KEY_DOWN,
+  INPUT_KEY_SELECT,
+  INPUT_KEY_BACK,
+};
+
+enum InputEventType : uint8_t {
+  INPUT_PRESS,
+  INPUT_RELEASE,
+  INPUT_ROTATE,  // delta为正表示顺时针
+};
+
+struct InputEvent {
+  InputEventType type;
+  InputKey key;
+  int8_t delta;
+  uint64_t timestamp_ns;  // 边沿的内核时间戳
+  uint64_t received_us;   // 读到边沿时的monotonicUs()，用于统计按键到上屏的延迟
+};
+
+class InputManager {
+ public:
+  // debounce_us：按键状态改变后的锁定时间，期间的抖动边沿被忽略
+  explicit InputManager(EdgeSource *source, uint32_t debounce_us = 5000);
+
+  void bindButton(uint8_t line, InputKey key);
+  // 编码器按格雷码状态表解码，抖动产生的来回跳变相互抵消，不需要锁定时间
+  void bindEncoder(uint8_t line_a, uint8_t line_b,
+                   uint8_t steps_per_detent = 4);
+
+  int fd(void) const { return source->fd(); }
+  bool poll(InputEvent &ev);                   // 非阻塞取一个事件
+  bool wait(InputEvent &ev, int timeout_ms);  // 最多等待timeout_ms（-1为一直等）
+
+ private:
+  enum Role : uint8_t { ROLE_NONE, ROLE_BUTTON, ROLE_ENCODER };
+
+  struct Line {
+    Role role;
+    InputKey key;
+    uint8_t stable;          // 消抖后的电平
+    uint8_t raw;             // 最近一个边沿后的电平
+    uint64_t changed_ns;     // stable最近一次改变的内核时间戳
+    uint64_t raw_us;         // 最近一个边沿的接收时间
+    uint64_t raw_ns;
+  };
+
+  EdgeSource *source;
+  uint32_t debounce_us;
+  std::vector<Line> lines;
+  uint8_t enc_a, enc_b, enc_steps;
+  uint8_t enc_state;
+  int enc_acc;
+  std::deque<InputEvent> pending;
+
+  Line &line(uint8_t n);
+  void drain(void);
+  void edge(const GpioEdge &e, uint64_t now_us);
+  void settle(uint64_t now_us);
+  void emit(InputEventType type, InputKey key, int8_t delta, uint64_t ts_ns,
+            uint64_t now_us);
+};
+
+#endif  // INPUT_H
@@ -0,0 +1,1164 @@
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bridge.h"
+#include "bridge_client.h"
+#include "display_client.h"
+#include "image_cache.h"
+#include "lz4_codec.h"
+#include "probe.h"
+#include "stats.h"
+#include "stream_server.h"
+
+// J-Link USB转TCP桥：供远程的调试客户端通过WiFi访问探针。
+// 桥使用自己的分帧协议（见bridge.h）转发J-Link USB命令，不兼容SEGGER的
+// J-Link Remote Server，主机端需用jlink_remote或链接BridgeClient的适配层。
+// 用法：jlink_bridge [-p 端口] [-s 序列号] [-n 在途请求数] [-l 回环延迟us]
+//                    [-k 客户端数] [-c 缓存目录] [-m 缓存MiB]
+//                    [-o 名称=设备[@波特率]]...
+//                    [--bench 总KiB] [--stream-bench 秒] [--multi-bench 秒]
+//                    [--lz4-bench 镜像文件|KiB]
+// -l 使用进程内回环探针（数据原样回显），没有硬件时用于测试。
+// -k 允许多个客户端共用探针（默认1，独占）。
+// --bench 在本机回环上跑合成的烧录负载（分块写入再读回，以及上传一次后
+// 从镜像缓存烧录），报告MB/s和每次烧录经过网络的字节数。
+// -o 增加一个RTT/SWO上行流通道，依次监听端口+1、端口+2…；设备写作
+// synthetic@字节每秒时使用模拟目标。
+// --stream-bench 在流通道打满、主机读得慢的情况下测量命令通道的往返延迟。
+// --multi-bench 两个烧录客户端和一个交互客户端共用限速的回环探针，比较
+// 按到达顺序和按优先级调度时交互命令的延迟，以及烧录之间的公平性。
+// --lz4-bench 用给定的固件镜像（或指定大小的合成镜像）测量LZ4的压缩比和
+// CPU开销，并在限速到Wi-Fi吞吐的回环链路上比较压缩前后的有效上传和读出速率。
+// 设置OLED_SERVER时在屏幕上显示连接状态、缓存命中和烧录进度。
+
+#define BENCH_CHUNK 4096
+#define BENCH_UPLOAD_CHUNK 60000
+
+static JLinkBridge *bridge = nullptr;
+
+static void signalHandler(int signum) {
+  (void)signum;
+  if (bridge) bridge->stop();
+}
+
+static void printCounters(const JLinkBridge &server) {
+  const JLinkBridge::Counters &c = server.counters();
+  const BufferPool::Counters &p = server.poolCounters();
+  printf("bridge: %llu requests, %llu bytes out (+%llu from cache), "
+         "%llu bytes in, %llu errors, max %u in flight\n",
+         (unsigned long long)c.requests, (unsigned long long)c.tx_bytes,
+         (unsigned long long)c.ref_bytes, (unsigned long long)c.rx_bytes,
+         (unsigned long long)c.errors, c.max_inflight);
+  printf("bridge: %llu recvs, %llu sends (%.1f iov/send), %llu bytes carried\n",
+         (unsigned long long)c.recvs, (unsigned long long)c.sends,
+         c.sends ? (double)c.send_iovs / c.sends : 0.0,
+         (unsigned long long)c.carried);
+  printf("pool: %llu acquires, %llu misses, peak %u buffers, %llu stalls\n",
+         (unsigned long long)p.acquires, (unsigned long long)p.misses, p.peak,
+         (unsigned long long)c.pool_stalls);
+  if (server.clientSlots() > 1) {
+    printf("sched: max %u clients, %llu bulk deferrals, %llu lock timeouts\n",
+           c.max_clients, (unsigned long long)c.bulk_deferred,
+           (unsigned long long)c.lock_timeouts);
+  }
+}
+
+static void printStreamCounters(const StreamServer &streams) {
+  for (size_t i = 0; i < streams.channels(); i++) {
+    StreamServer::Counters c = streams.counters(i);
+    printf("stream %s: %llu bytes in, %llu sent in %llu writes, "
+           "%llu dropped, %llu stalls, ring peak %lluK\n",
+           streams.name(i), (unsigned long long)c.produced,
+           (unsigned long long)c.sent, (unsigned long long)c.writes,
+           (unsigned long long)c.dropped, (unsigned long long)c.stalls,
+           (unsigned long long)(c.max_fill / 1024));
+  }
+}
+
+// 解析“名称=设备[@波特率]”或“名称=synthetic@字节每秒”
+static StreamSource *parseStream(const char *spec, std::string &name) {
+  const char *eq = strchr(spec, '=');
+  if (!eq || eq == spec) return nullptr;
+  name.assign(spec, eq - spec);
+  std::string path(eq + 1);
+  uint32_t rate = 0;
+  size_t at = path.rfind('@');
+  if (at != std::string::npos) {
+    rate = strtoul(path.c_str() + at + 1, nullptr, 10);
+    path.erase(at);
+  }
+  if (path == "synthetic") return new SyntheticSource(rate ? rate : 100000);
+  return new DeviceSource(path.c_str(), rate);
+}
+
+// OLED状态页：连接、镜像缓存和烧录进度
+static void drawStatus(OLED &o, const JLinkBridge &server,
+                       const ImageCache *cache) {
+  char line[32];
+  o.clear_GRAM();
+  int n = server.clientCount();
+  if (n > 1) {
+    snprintf(line, sizeof(line), "J-Link: %d clients", n);
+  } else {
+    snprintf(line, sizeof(line), "J-Link: %s", n ? "connected" : "idle");
+  }
+  o.showString_GRAM(0, 0, line, 12);
+  if (cache) {
+    const ImageCache::Counters &c = cache->counters();
+    snprintf(line, sizeof(line), "Cache %u img %uK",
+             (unsigned)cache->entries(), (unsigned)(cache->usedBytes() / 1024));
+    o.showString_GRAM(0, 10, line, 12);
+    snprintf(line, sizeof(line), "Hit %llu Miss %llu",
+             (unsigned long long)c.hits, (unsigned long long)c.misses);
+    o.showString_GRAM(0, 20, line, 12);
+  }
+
+  const JLinkBridge::FlashProgress &f = server.progress();
+  if (f.active) {
+    char hex[2 * SHA256_LEN + 1];
+    sha256Hex(f.hash, hex);
+    snprintf(line, sizeof(line), "Flash %.8s #%u", hex, f.passes);
+    o.showString_GRAM(0, 32, line, 12);
+    uint64_t pct = f.size ? std::min<uint64_t>(100, f.streamed * 100 / f.size)
+                          : 100;
+    o.drawRect_GRAM(0, 42, 127, 49, WHITE);
+    if (pct) o.fillRect_GRAM(1, 43, (uint8_t)(1 + 125 * pct / 100), 48, WHITE);
+    snprintf(line, sizeof(line), "%3u%% %uK/%uK", (unsigned)pct,
+             (unsigned)(f.streamed / 1024), (unsigned)(f.size / 1024));
+    o.showString_GRAM(0, 54, line, 12);
+  }
+  o.present();
+}
+
+// 模拟探针固件的命令流：'W'+长度+数据写入，数据收完后应答4字节状态；
+// 'R'+长度读回（给了memory时依次循环读出其内容，否则为0,1,2…）。
+// 命令头和数据可以分在多个OUT传输里
+struct FlashEmulator {
+  uint8_t cmd[5];
+  size_t have;
+  uint32_t skip;
+  const std::vector<uint8_t> *memory;
+  size_t read_off;
+
+  explicit FlashEmulator(const std::vector<uint8_t> *memory = nullptr)
+      : have(0), skip(0), memory(memory), read_off(0) {}
+  void operator()(const uint8_t *data, size_t len,
+                  std::vector<uint8_t> &reply) {
+    while (len) {
+      if (skip) {
+        uint32_t n = std::min<size_t>(skip, len);
+        skip -= n;
+        data += n;
+        len -= n;
+        if (!skip) reply.insert(reply.end(), 4, 0);
+        continue;
+      }
+      cmd[have++] = *data++;
+      len--;
+      if (have < sizeof(cmd)) continue;
+      have = 0;
+      uint32_t n;
+      memcpy(&n, cmd + 1, sizeof(n));
+      if (cmd[0] == 'W') {
+        skip = n;
+        if (!n) reply.insert(reply.end(), 4, 0);
+      } else if (memory && !memory->empty()) {
+        for (uint32_t i = 0; i < n; i++) {
+          reply.push_back((*memory)[read_off]);
+          read_off = (read_off + 1) % memory->size();
+        }
+      } else {
+        for (uint32_t i = 0; i < n; i++) reply.push_back((uint8_t)i);
+      }
+    }
+  }
+};
+
+// 一个测量阶段：请求字节、经过网络的字节、耗时
+struct BenchResult {
+  double mbs;
+  uint64_t net_bytes;
+};
+
+// 流水线发送chunks个请求，最多depth个未应答。
+// op：'W'直接写入，'R'读回校验，'F'引用缓存镜像hash烧录
+static bool benchPhase(int fd, char op, uint32_t chunks, int depth,
+                       const uint8_t *hash, BenchResult &result) {
+  std::vector<uint8_t> req(sizeof(BridgeRequest) + sizeof(BridgeImageRef) +
+                           5 + BENCH_CHUNK);
+  std::vector<uint8_t> data(BENCH_CHUNK), expect(BENCH_CHUNK);
+  for (int i = 0; i < BENCH_CHUNK; i++) expect[i] = (uint8_t)i;
+
+  uint64_t start = monotonicUs();
+  uint32_t sent = 0, done = 0;
+  result.net_bytes = 0;
+  while (done < chunks) {
+    while (sent < chunks && sent - done < (uint32_t)depth) {
+      BridgeRequest hdr;
+      uint8_t *p = &req[sizeof(hdr)];
+      uint32_t n = BENCH_CHUNK;
+      if (op == 'F') {
+        BridgeImageRef ref;
+        memcpy(ref.hash, hash, SHA256_LEN);
+        ref.offset = sent * BENCH_CHUNK;
+        ref.length = BENCH_CHUNK;
+        memcpy(p, &ref, sizeof(ref));
+        p += sizeof(ref);
+      }
+      *p = op == 'R' ? 'R' : 'W';
+      memcpy(p + 1, &n, sizeof(n));
+      p += 5;
+      if (op == 'W') {
+        memset(p, 0x5A, BENCH_CHUNK);
+        p += BENCH_CHUNK;
+      }
+      uint32_t len = p - &req[sizeof(hdr)];
+      hdr.tx_len = op == 'F' ? BRIDGE_OP_XFER_REF << BRIDGE_OP_SHIFT | len
+                             : len;
+      hdr.rx_len = op == 'R' ? BENCH_CHUNK : 4;
+      memcpy(&req[0], &hdr, sizeof(hdr));
+      if (!bridgeSendAll(fd, req.data(), sizeof(hdr) + len)) return false;
+      result.net_bytes += sizeof(hdr) + len;
+      sent++;
+    }
+    BridgeReply reply;
+    uint32_t expect_len = op == 'R' ? BENCH_CHUNK : 4;
+    if (!bridgeRecvAll(fd, &reply, sizeof(reply)) || reply.status ||
+        reply.len != expect_len || !bridgeRecvAll(fd, data.data(), reply.len)) {
+      return false;
+    }
+    if (op == 'R' && memcmp(data.data(), expect.data(), reply.len) != 0) {
+      return false;
+    }
+    result.net_bytes += sizeof(reply) + reply.len;
+    done++;
+  }
+  double secs = (monotonicUs() - start) / 1e6;
+  result.mbs = (double)chunks * BENCH_CHUNK / secs / (1024 * 1024);
+  return true;
+}
+
+// 发送一个镜像操作（可以连续发送，应答稍后按序读取）
+static bool sendImageOp(int fd, int op, const void *payload, uint32_t len,
+                        uint64_t &net_bytes) {
+  BridgeRequest hdr;
+  hdr.tx_len = (uint32_t)op << BRIDGE_OP_SHIFT | len;
+  hdr.rx_len = 0;
+  net_bytes += sizeof(hdr) + len;
+  return bridgeSendAll(fd, &hdr, sizeof(hdr)) &&
+         bridgeSendAll(fd, payload, len);
+}
+
+// 查询镜像，未缓存时上传；返回查询结果是否命中
+static bool benchUpload(int fd, const std::vector<uint8_t> &image,
+                        const uint8_t *hash, bool &hit, BenchResult &result) {
+  uint64_t start = monotonicUs();
+  result.net_bytes = 0;
+  BridgeReply reply;
+  if (!sendImageOp(fd, BRIDGE_OP_IMAGE_QUERY, hash, SHA256_LEN,
+                   result.net_bytes) ||
+      !bridgeRecvAll(fd, &reply, sizeof(reply))) {
+    return false;
+  }
+  result.net_bytes += sizeof(reply);
+  hit = reply.status == PROBE_OK;
+  if (hit) {
+    result.mbs = 0;
+    return true;
+  }
+
+  BridgeImageBegin begin;
+  memcpy(begin.hash, hash, SHA256_LEN);
+  begin.size = image.size();
+  int ops = 2;
+  bool ok =
+      sendImageOp(fd, BRIDGE_OP_IMAGE_BEGIN, &begin, sizeof(begin),
+                  result.net_bytes);
+  for (size_t off = 0; ok && off < image.size(); off += BENCH_UPLOAD_CHUNK) {
+    uint32_t n = std::min<size_t>(BENCH_UPLOAD_CHUNK, image.size() - off);
+    ok = sendImageOp(fd, BRIDGE_OP_IMAGE_DATA, &image[off], n,
+                     result.net_bytes);
+    ops++;
+  }
+  ok = ok && sendImageOp(fd, BRIDGE_OP_IMAGE_END, nullptr, 0,
+                         result.net_bytes);
+  for (int i = 0; ok && i < ops; i++) {
+    ok = bridgeRecvAll(fd, &reply, sizeof(reply)) && reply.status == PROBE_OK;
+    result.net_bytes += sizeof(reply);
+  }
+  double secs = (monotonicUs() - start) / 1e6;
+  result.mbs = image.size() / secs / (1024 * 1024);
+  return ok;
+}
+
+// 基准用的临时缓存目录，离开作用域时连同其中的文件一起删除，
+// 提前返回的路径也不会留下目录
+struct TempDir {
+  char path[64];
+  bool ok;
+
+  explicit TempDir(const char *tmpl) {
+    snprintf(path, sizeof(path), "%s", tmpl);
+    ok = mkdtemp(path) != nullptr;
+    if (!ok) perror("mkdtemp");
+  }
+  ~TempDir() {
+    if (!ok) return;
+    DIR *d = opendir(path);
+    struct dirent *de;
+    while (d && (de = readdir(d)) != nullptr) {
+      if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0) {
+        continue;
+      }
+      unlink((std::string(path) + "/" + de->d_name).c_str());
+    }
+    if (d) closedir(d);
+    rmdir(path);
+  }
+};
+
+static int runBench(uint32_t total_kb, int inflight, int latency_us) {
+  uint32_t chunks = (total_kb * 1024 + BENCH_CHUNK - 1) / BENCH_CHUNK;
+  std::vector<uint8_t> image((size_t)chunks * BENCH_CHUNK);
+  uint32_t seed = 12345;
+  for (size_t i = 0; i < image.size(); i++) {
+    seed = seed * 1103515245 + 12345;
+    image[i] = (uint8_t)(seed >> 16);
+  }
+  uint8_t hash[SHA256_LEN];
+  Sha256::hash(image.data(), image.size(), hash);
+
+  TempDir dir("/tmp/jlink_bench.XXXXXX");
+  if (!dir.ok) return 1;
+  int status = 1;
+  {
+    ImageCache cache(dir.path, image.size() * 2);
+    LoopbackProbe probe(latency_us > 0 ? latency_us : 0);
+    probe.setResponder(FlashEmulator());
+    if (!cache.open() || !probe.open()) return 1;
+    JLinkBridge server(probe, 0, inflight);
+    server.setImageCache(&cache);
+    if (!server.start()) return 1;
+    std::thread loop([&server]() { server.run(); });
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sa.sin_port = htons(server.port());
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    BenchResult raw, read, upload, cached, again;
+    bool hit_first = false, hit_again = false;
+    bool ok = connect(fd, (struct sockaddr *)&sa, sizeof(sa)) == 0 &&
+              benchPhase(fd, 'W', chunks, inflight, nullptr, raw) &&
+              benchPhase(fd, 'R', chunks, inflight, nullptr, read) &&
+              benchUpload(fd, image, hash, hit_first, upload) &&
+              benchPhase(fd, 'F', chunks, inflight, hash, cached) &&
+              benchUpload(fd, image, hash, hit_again, again) &&
+              benchPhase(fd, 'F', chunks, inflight, hash, again);
+    server.stop();
+    close(fd);  // 唤醒事件循环
+    loop.join();
+
+    if (ok && !hit_first && hit_again) {
+      printf("bench: %u x %d B chunks, %d in flight, probe latency %d us\n",
+             chunks, BENCH_CHUNK, inflight, latency_us > 0 ? latency_us : 0);
+      printf("bench: write %.1f MB/s, read back %.1f MB/s\n", raw.mbs,
+             read.mbs);
+      printf("bench: upload %.1f MB/s, cached flash %.1f MB/s\n", upload.mbs,
+             cached.mbs);
+      printf("bench: network bytes per flash: direct %llu, upload once %llu, "
+             "cached %llu\n",
+             (unsigned long long)raw.net_bytes,
+             (unsigned long long)upload.net_bytes,
+             (unsigned long long)again.net_bytes);
+      printCounters(server);
+      status = 0;
+    } else {
+      fprintf(stderr, "bench failed\n");
+    }
+  }
+  return status;
+}
+
+static int connectLocal(uint16_t port) {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  sa.sin_port = htons(port);
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// 命令通道往返延迟：单个在途的64字节回显请求，持续ms毫秒
+static bool benchLatency(int fd, uint32_t ms, std::vector<uint64_t> &samples) {
+  uint8_t req[sizeof(BridgeRequest) + 64], rx[64];
+  BridgeRequest hdr;
+  hdr.tx_len = 64;
+  hdr.rx_len = 64;
+  memcpy(req, &hdr, sizeof(hdr));
+  memset(req + sizeof(hdr), 0xA5, 64);
+
+  samples.clear();
+  uint64_t end = monotonicUs() + (uint64_t)ms * 1000;
+  while (monotonicUs() < end) {
+    uint64_t start = monotonicUs();
+    BridgeReply reply;
+    if (!bridgeSendAll(fd, req, sizeof(req)) ||
+        !bridgeRecvAll(fd, &reply, sizeof(reply)) || reply.status ||
+        reply.len != 64 || !bridgeRecvAll(fd, rx, reply.len)) {
+      return false;
+    }
+    samples.push_back(monotonicUs() - start);
+  }
+  std::sort(samples.begin(), samples.end());
+  return !samples.empty();
+}
+
+static void printLatency(const char *label, const std::vector<uint64_t> &v) {
+  printf("stream-bench: %s: %zu requests, p50 %llu us, p99 %llu us, "
+         "max %llu us\n",
+         label, v.size(), (unsigned long long)v[v.size() / 2],
+         (unsigned long long)v[v.size() * 99 / 100],
+         (unsigned long long)v.back());
+}
+
+#define STREAM_BENCH_RATE (16 * 1024 * 1024)  // 模拟目标的输出速率
+#define STREAM_BENCH_READ (4 * 1024 * 1024)   // 慢速主机的读取速率
+
+static int runStreamBench(uint32_t secs, int inflight, int latency_us) {
+  LoopbackProbe probe(latency_us > 0 ? latency_us : 0);
+  if (!probe.open()) return 1;
+  JLinkBridge server(probe, 0, inflight);
+  if (!server.start()) return 1;
+  std::thread loop([&server]() { server.run(); });
+
+  StreamServer streams;
+  streams.addChannel("rtt", new SyntheticSource(STREAM_BENCH_RATE), 0);
+  int fd = connectLocal(server.port());
+  uint32_t ms = secs * 1000 / 2;
+  std::vector<uint64_t> idle, loaded;
+  bool ok = fd >= 0 && benchLatency(fd, ms, idle) && streams.start();
+
+  // 慢速主机：按固定速率读取流通道，读得比目标产生得慢
+  std::atomic<bool> reading(ok);
+  std::atomic<uint64_t> received(0);
+  std::thread reader([&]() {
+    int sfd = connectLocal(streams.port(0));
+    if (sfd < 0) return;
+    std::vector<uint8_t> buf(64 * 1024);
+    uint64_t start = monotonicUs();
+    while (reading) {
+      uint64_t due = start + received * 1000000 / STREAM_BENCH_READ;
+      uint64_t now = monotonicUs();
+      if (due > now) {
+        usleep(std::min<uint64_t>(due - now, 10000));
+        continue;
+      }
+      ssize_t n = recv(sfd, buf.data(), buf.size(), MSG_DONTWAIT);
+      if (n > 0) {
+        received += n;
+      } else if (n == 0) {
+        break;
+      } else {
+        usleep(1000);
+      }
+    }
+    close(sfd);
+  });
+  ok = ok && benchLatency(fd, ms, loaded);
+  reading = false;
+  reader.join();
+
+  streams.stop();
+  server.stop();
+  if (fd >= 0) close(fd);
+  loop.join();
+  if (!ok) {
+    fprintf(stderr, "stream bench failed\n");
+    return 1;
+  }
+
+  StreamServer::Counters c = streams.counters(0);
+  printf("stream-bench: target %u KB/s, host reads %u KB/s, %u s\n",
+         STREAM_BENCH_RATE / 1024, STREAM_BENCH_READ / 1024, secs);
+  printLatency("command latency, stream idle", idle);
+  printLatency("command latency, stream saturated", loaded);
+  printf("stream-bench: produced %llu, received %llu, dropped %llu (%.1f%%), "
+         "%.1f KB/write, %llu stalls\n",
+         (unsigned long long)c.produced, (unsigned long long)received.load(),
+         (unsigned long long)c.dropped,
+         c.produced + c.dropped
+             ? 100.0 * c.dropped / (c.produced + c.dropped)
+             : 0.0,
+         c.writes ? c.sent / 1024.0 / c.writes : 0.0,
+         (unsigned long long)c.stalls);
+  return 0;
+}
+
+#define MULTI_BENCH_RATE (8 * 1024 * 1024)  // 模拟探针的USB带宽
+#define MULTI_BENCH_CHUNK 32768             // 烧录客户端每个请求写入的字节
+#define MULTI_BENCH_DEPTH 4                 // 烧录客户端的流水线深度
+#define MULTI_BENCH_FLASHERS 2
+#define MULTI_BENCH_THINK_US 2000  // 交互客户端两次命令之间的间隔
+#define MULTI_BENCH_GROUP 4        // 每隔几次命令发一组加锁的连续读
+
+struct MultiClient {
+  std::vector<uint64_t> latency;  // 交互命令的往返时间
+  uint64_t bytes;
+  uint32_t groups;
+  bool ok;
+
+  MultiClient() : bytes(0), groups(0), ok(false) {}
+};
+
+// 烧录客户端：流水线写入，直到stop后收完在途应答
+static void flashClient(uint16_t port, const std::atomic<bool> &stop,
+                        MultiClient &out) {
+  int fd = connectLocal(port);
+  if (fd < 0) return;
+  std::vector<uint8_t> req(sizeof(BridgeRequest) + 5 + MULTI_BENCH_CHUNK, 0x5A);
+  BridgeRequest hdr;
+  hdr.tx_len = 5 + MULTI_BENCH_CHUNK;
+  hdr.rx_len = 4;
+  memcpy(&req[0], &hdr, sizeof(hdr));
+  uint32_t n = MULTI_BENCH_CHUNK;
+  req[sizeof(hdr)] = 'W';
+  memcpy(&req[sizeof(hdr) + 1], &n, sizeof(n));
+
+  int outstanding = 0;
+  bool ok = true;
+  while (ok && (!stop || outstanding)) {
+    while (ok && !stop && outstanding < MULTI_BENCH_DEPTH) {
+      ok = bridgeSendAll(fd, req.data(), req.size());
+      outstanding++;
+    }
+    BridgeReply reply;
+    uint8_t status[4];
+    ok = ok && bridgeRecvAll(fd, &reply, sizeof(reply)) && reply.status == 0 &&
+         reply.len == 4 && bridgeRecvAll(fd, status, 4);
+    outstanding--;
+    if (ok) out.bytes += MULTI_BENCH_CHUNK;
+  }
+  out.ok = ok;
+  close(fd);
+}
+
+static bool sendRead64(int fd) {
+  uint8_t req[sizeof(BridgeRequest) + 5];
+  BridgeRequest hdr;
+  hdr.tx_len = 5;
+  hdr.rx_len = 64;
+  uint32_t n = 64;
+  memcpy(req, &hdr, sizeof(hdr));
+  req[sizeof(hdr)] = 'R';
+  memcpy(req + sizeof(hdr) + 1, &n, sizeof(n));
+  return bridgeSendAll(fd, req, sizeof(req));
+}
+
+static bool recvRead64(int fd) {
+  BridgeReply reply;
+  uint8_t data[64];
+  if (!bridgeRecvAll(fd, &reply, sizeof(reply)) || reply.status ||
+      reply.len != 64 || !bridgeRecvAll(fd, data, 64)) {
+    return false;
+  }
+  for (int i = 0; i < 64; i++) {
+    if (data[i] != i) return false;
+  }
+  return true;
+}
+
+static bool sendOp(int fd, int op) {
+  BridgeRequest hdr;
+  hdr.tx_len = (uint32_t)op << BRIDGE_OP_SHIFT;
+  hdr.rx_len = 0;
+  return bridgeSendAll(fd, &hdr, sizeof(hdr));
+}
+
+static bool recvStatus(int fd) {
+  BridgeReply reply;
+  return bridgeRecvAll(fd, &reply, sizeof(reply)) && reply.status == 0 &&
+         reply.len == 0;
+}
+
+// 交互客户端：一次一个小读（像GDB读寄存器），定期发一组加锁的连续读
+static void interactiveClient(uint16_t port, const std::atomic<bool> &stop,
+                              MultiClient &out) {
+  int fd = connectLocal(port);
+  if (fd < 0) return;
+  bool ok = true;
+  for (uint32_t i = 0; ok && !stop; i++) {
+    uint64_t start = monotonicUs();
+    if (i % MULTI_BENCH_GROUP == MULTI_BENCH_GROUP - 1) {
+      ok = sendOp(fd, BRIDGE_OP_LOCK) && sendRead64(fd) && sendRead64(fd) &&
+           sendRead64(fd) && sendOp(fd, BRIDGE_OP_UNLOCK) && recvStatus(fd) &&
+           recvRead64(fd) && recvRead64(fd) && recvRead64(fd) &&
+           recvStatus(fd);
+      if (ok) out.groups++;
+    } else {
+      ok = sendRead64(fd) && recvRead64(fd);
+      if (ok) out.latency.push_back(monotonicUs() - start);
+    }
+    usleep(MULTI_BENCH_THINK_US);
+  }
+  std::sort(out.latency.begin(), out.latency.end());
+  out.ok = ok && !out.latency.empty();
+  close(fd);
+}
+
+// 一轮：flashers个烧录客户端加一个交互客户端，持续ms毫秒
+static bool multiPhase(const char *label, bool priority, int flashers,
+                       uint32_t ms, int inflight, int latency_us) {
+  LoopbackProbe probe(latency_us > 0 ? latency_us : 0);
+  probe.setResponder(FlashEmulator());
+  probe.setBandwidth(MULTI_BENCH_RATE);
+  if (!probe.open()) return false;
+  // 多留一个槽位给结束时唤醒事件循环的连接，不覆盖客户端的统计
+  JLinkBridge server(probe, 0, inflight, flashers + 2);
+  server.setScheduling(priority);
+  if (!server.start()) return false;
+  std::thread loop([&server]() { server.run(); });
+
+  std::atomic<bool> stop(false);
+  std::vector<MultiClient> results(flashers + 1);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < flashers; i++) {
+    threads.push_back(std::thread(flashClient, server.port(), std::ref(stop),
+                                  std::ref(results[i + 1])));
+  }
+  threads.push_back(std::thread(interactiveClient, server.port(),
+                                std::ref(stop), std::ref(results[0])));
+  usleep(ms * 1000);
+  stop = true;
+  for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+  server.stop();
+  int wake = connectLocal(server.port());  // 唤醒事件循环
+  loop.join();
+  if (wake >= 0) close(wake);
+
+  bool ok = true;
+  for (size_t i = 0; i < results.size(); i++) ok = ok && results[i].ok;
+  if (!ok) {
+    fprintf(stderr, "multi-bench: %s: client failed\n", label);
+    return false;
+  }
+  const std::vector<uint64_t> &v = results[0].latency;
+  printf("multi-bench: %-8s interactive %zu cmds + %u locked groups, "
+         "p50 %llu us, p99 %llu us, max %llu us\n",
+         label, v.size(), results[0].groups,
+         (unsigned long long)v[v.size() / 2],
+         (unsigned long long)v[v.size() * 99 / 100],
+         (unsigned long long)v.back());
+  if (flashers == 0) return true;
+
+  // Jain公平性指数：(Σx)²/(n·Σx²)，1为完全均分
+  double sum = 0, sq = 0;
+  printf("multi-bench: %-8s flash", label);
+  for (int i = 1; i <= flashers; i++) {
+    double mbs = results[i].bytes / (ms / 1000.0) / (1024 * 1024);
+    sum += mbs;
+    sq += mbs * mbs;
+    printf(" %.2f", mbs);
+  }
+  printf(" MB/s, fairness %.3f\n", sq > 0 ? sum * sum / (flashers * sq) : 0.0);
+  for (int i = 0; i < server.clientSlots(); i++) {
+    const JLinkBridge::ClientStats &cs = server.clientStats(i);
+    if (!cs.requests) continue;
+    printf("multi-bench: %-8s   %-21s %6llu requests (%llu bulk), bridge "
+           "p50 %llu us, p99 %llu us\n",
+           label, cs.peer, (unsigned long long)cs.requests,
+           (unsigned long long)cs.bulk,
+           (unsigned long long)cs.latency.percentile(0.5),
+           (unsigned long long)cs.latency.percentile(0.99));
+  }
+  return true;
+}
+
+static int runMultiBench(uint32_t secs, int inflight, int latency_us) {
+  uint32_t ms = secs * 1000 / 3;
+  printf("multi-bench: probe %u KB/s, %d flashers (%d B x %d deep), "
+         "1 interactive client, %d in flight\n",
+         MULTI_BENCH_RATE / 1024, MULTI_BENCH_FLASHERS, MULTI_BENCH_CHUNK,
+         MULTI_BENCH_DEPTH, inflight);
+  bool ok = multiPhase("alone", true, 0, ms, inflight, latency_us) &&
+            multiPhase("fifo", false, MULTI_BENCH_FLASHERS, ms, inflight,
+                       latency_us) &&
+            multiPhase("priority", true, MULTI_BENCH_FLASHERS, ms, inflight,
+                       latency_us);
+  return ok ? 0 : 1;
+}
+
+#define LZ4_BENCH_LINK (3 * 1024 * 1024)  // 模拟的Wi-Fi有效吞吐
+#define LZ4_BENCH_CHUNK 32768             // 每个上传/读出请求的原始字节
+#define LZ4_BENCH_DEPTH 4
+
+// 合成固件：向量表、指令流（常用指令夹杂随机立即数）、字符串表、0xFF填充，
+// 压缩比和常见的Cortex-M固件相近
+static void makeFirmware(std::vector<uint8_t> &image, size_t size) {
+  static const char *kStrings[] = {
+      "HAL_Init failed\n", "assert %s:%d\n", "usb: reset\n",
+      "flash: erase sector %u\n", "rtt: buffer overflow\n", "i2c timeout\n"};
+  static const uint16_t kOps[] = {0xB580, 0xAF00, 0x4618, 0x6813, 0x2300,
+                                  0x4770, 0xBD80, 0x3301, 0x601A, 0xE7FE,
+                                  0x4B02, 0x681B, 0x2B00, 0xD1FA, 0x46BD};
+  uint32_t seed = 0x1234567;
+  image.clear();
+  for (size_t i = 0; i < 256 && image.size() < size; i++) {
+    uint32_t vector = 0x08000101 + i * 0x40;
+    image.insert(image.end(), (uint8_t *)&vector, (uint8_t *)&vector + 4);
+  }
+  size_t code_end = size * 60 / 100, strings_end = size * 78 / 100;
+  while (image.size() < size) {
+    seed = seed * 1103515245 + 12345;
+    uint32_t r = seed >> 8;
+    if (image.size() < code_end) {
+      if (r % 8 == 0) {
+        image.insert(image.end(), (uint8_t *)&seed, (uint8_t *)&seed + 4);
+      } else {
+        uint16_t op = kOps[r % 15] ^ (r >> 4 & 0x7);  // 换寄存器
+        image.insert(image.end(), (uint8_t *)&op, (uint8_t *)&op + 2);
+      }
+    } else if (image.size() < strings_end) {
+      const char *str = kStrings[r % 6];
+      image.insert(image.end(), str, str + strlen(str) + 1);
+    } else {
+      image.push_back(0xFF);
+    }
+  }
+  image.resize(size);
+}
+
+// 参数为纯数字时生成这么多KiB的合成固件，否则读文件
+static bool loadImage(const char *arg, std::vector<uint8_t> &image) {
+  char *end;
+  unsigned long kb = strtoul(arg, &end, 10);
+  if (*arg && !*end) {
+    makeFirmware(image, kb * 1024);
+    return kb > 0;
+  }
+  FILE *fp = fopen(arg, "rb");
+  if (!fp) {
+    perror(arg);
+    return false;
+  }
+  uint8_t buf[4096];
+  size_t n;
+  image.clear();
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    image.insert(image.end(), buf, buf + n);
+  }
+  fclose(fp);
+  return !image.empty();
+}
+
+static uint64_t threadCpuUs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 按固定速率放行字节，模拟Wi-Fi瓶颈（收发共用一个信道）
+struct PacedLink {
+  uint64_t start_us;
+  uint64_t bytes;
+
+  PacedLink() : start_us(monotonicUs()), bytes(0) {}
+  void pace(size_t n) {
+    bytes += n;
+    uint64_t due = start_us + bytes * 1000000 / LZ4_BENCH_LINK;
+    uint64_t now = monotonicUs();
+    if (due > now) usleep(due - now);
+  }
+};
+
+// 客户端一侧的压缩端：压缩失败（不可压缩）时原样发送
+struct Lz4Client {
+  Lz4Codec codec;
+  std::vector<uint8_t> buf;
+  uint64_t cpu_us;
+
+  Lz4Client() : buf(sizeof(BridgeRequest) + 4 + BRIDGE_MAX_PAYLOAD), cpu_us(0) {}
+
+  // 组一个请求，返回总长度
+  size_t build(int op, const uint8_t *data, uint32_t len, uint32_t rx_len,
+               bool compress) {
+    BridgeRequest hdr;
+    uint8_t *payload = &buf[sizeof(hdr)];
+    size_t n = 0;
+    if (compress) {
+      uint64_t start = threadCpuUs();
+      n = codec.compress(data, len, payload + 4, len > 5 ? len - 5 : 0);
+      cpu_us += threadCpuUs() - start;
+    }
+    if (n) {
+      memcpy(payload, &len, 4);
+      n += 4;
+      op |= BRIDGE_OP_LZ4;
+    } else {
+      memcpy(payload, data, len);
+      n = len;
+    }
+    hdr.tx_len = (uint32_t)op << BRIDGE_OP_SHIFT | (uint32_t)n;
+    hdr.rx_len = rx_len;
+    memcpy(&buf[0], &hdr, sizeof(hdr));
+    return sizeof(hdr) + n;
+  }
+
+  // 读一个应答的数据，压缩的解到out；返回原始长度，出错时返回-1
+  int receive(int fd, const BridgeReply &reply, uint8_t *out, size_t cap) {
+    uint32_t len = reply.len & ~BRIDGE_REPLY_LZ4;
+    if (len > buf.size() || !bridgeRecvAll(fd, buf.data(), len)) return -1;
+    if (!(reply.len & BRIDGE_REPLY_LZ4)) {
+      if (len > cap) return -1;
+      memcpy(out, buf.data(), len);
+      return len;
+    }
+    uint32_t raw;
+    if (len < sizeof(raw)) return -1;
+    memcpy(&raw, buf.data(), sizeof(raw));
+    uint64_t start = threadCpuUs();
+    int n = Lz4Codec::decompress(buf.data() + 4, len - 4, out, cap);
+    cpu_us += threadCpuUs() - start;
+    return n == (int)raw ? n : -1;
+  }
+};
+
+// 上传整个镜像：BEGIN、DATA…、END连续发出，再按序收应答
+static bool lz4Upload(int fd, const std::vector<uint8_t> &image,
+                      const uint8_t *hash, bool compress, Lz4Client &client,
+                      PacedLink &link) {
+  BridgeImageBegin begin;
+  memcpy(begin.hash, hash, SHA256_LEN);
+  begin.size = image.size();
+  size_t n = client.build(BRIDGE_OP_IMAGE_BEGIN, (const uint8_t *)&begin,
+                          sizeof(begin), 0, false);
+  bool ok = bridgeSendAll(fd, client.buf.data(), n);
+  int ops = 2;
+  for (size_t off = 0; ok && off < image.size(); off += LZ4_BENCH_CHUNK) {
+    uint32_t len = std::min<size_t>(LZ4_BENCH_CHUNK, image.size() - off);
+    n = client.build(BRIDGE_OP_IMAGE_DATA, &image[off], len, 0, compress);
+    link.pace(n);
+    ok = bridgeSendAll(fd, client.buf.data(), n);
+    ops++;
+  }
+  n = client.build(BRIDGE_OP_IMAGE_END, nullptr, 0, 0, false);
+  ok = ok && bridgeSendAll(fd, client.buf.data(), n);
+  for (int i = 0; ok && i < ops; i++) {
+    BridgeReply reply;
+    ok = bridgeRecvAll(fd, &reply, sizeof(reply)) && reply.status == PROBE_OK;
+  }
+  return ok;
+}
+
+// 从模拟目标读出total字节（内存转储），校验内容；pos为目标读指针
+static bool lz4Dump(int fd, const std::vector<uint8_t> &memory, size_t &pos,
+                    Lz4Client &client, PacedLink &link) {
+  std::vector<uint8_t> data(LZ4_BENCH_CHUNK);
+  uint8_t cmd[5] = {'R'};
+  uint32_t chunk = LZ4_BENCH_CHUNK;
+  memcpy(cmd + 1, &chunk, sizeof(chunk));
+  uint32_t chunks = (memory.size() + LZ4_BENCH_CHUNK - 1) / LZ4_BENCH_CHUNK;
+  uint32_t sent = 0, done = 0;
+  while (done < chunks) {
+    while (sent < chunks && sent - done < LZ4_BENCH_DEPTH) {
+      size_t n = client.build(BRIDGE_OP_XFER, cmd, sizeof(cmd), chunk, false);
+      link.pace(n);
+      if (!bridgeSendAll(fd, client.buf.data(), n)) return false;
+      sent++;
+    }
+    BridgeReply reply;
+    if (!bridgeRecvAll(fd, &reply, sizeof(reply)) || reply.status) return false;
+    link.pace(sizeof(reply) + (reply.len & ~BRIDGE_REPLY_LZ4));
+    int n = client.receive(fd, reply, data.data(), data.size());
+    if (n != (int)chunk) return false;
+    for (int i = 0; i < n; i++) {
+      if (data[i] != memory[pos]) return false;
+      pos = (pos + 1) % memory.size();
+    }
+    done++;
+  }
+  return true;
+}
+
+static bool negotiate(int fd, uint32_t want, int32_t &got) {
+  Lz4Client client;
+  size_t n = client.build(BRIDGE_OP_FEATURES, (const uint8_t *)&want,
+                          sizeof(want), 0, false);
+  BridgeReply reply;
+  if (!bridgeSendAll(fd, client.buf.data(), n) ||
+      !bridgeRecvAll(fd, &reply, sizeof(reply))) {
+    return false;
+  }
+  got = reply.status;
+  return true;
+}
+
+static int runLz4Bench(const char *arg, int inflight) {
+  std::vector<uint8_t> image;
+  if (!loadImage(arg, image)) return 1;
+  uint8_t hash[SHA256_LEN];
+  Sha256::hash(image.data(), image.size(), hash);
+  double mb = image.size() / (1024.0 * 1024);
+
+  // 编解码本身：按请求大小分块，同一个上下文反复使用
+  Lz4Codec codec;
+  std::vector<uint8_t> z(LZ4_BLOCK_BOUND(LZ4_BENCH_CHUNK)), back(LZ4_BENCH_CHUNK);
+  size_t wire = 0;
+  uint64_t comp_us = 0, decomp_us = 0;
+  bool ok = codec.ok();
+  for (size_t off = 0; ok && off < image.size(); off += LZ4_BENCH_CHUNK) {
+    uint32_t len = std::min<size_t>(LZ4_BENCH_CHUNK, image.size() - off);
+    uint64_t t0 = threadCpuUs();
+    size_t n = codec.compress(&image[off], len, z.data(), z.size());
+    uint64_t t1 = threadCpuUs();
+    int m = Lz4Codec::decompress(z.data(), n, back.data(), back.size());
+    decomp_us += threadCpuUs() - t1;
+    comp_us += t1 - t0;
+    wire += n;
+    ok = m == (int)len && memcmp(back.data(), &image[off], len) == 0;
+  }
+  if (!ok) {
+    fprintf(stderr, "lz4-bench: round trip failed\n");
+    return 1;
+  }
+
+  TempDir dir("/tmp/jlink_lz4.XXXXXX");
+  if (!dir.ok) return 1;
+  double up_raw = 0, up_lz4 = 0, dump_raw = 0, dump_lz4 = 0;
+  uint64_t up_wire = 0, dump_wire = 0, client_us = 0;
+  JLinkBridge::Counters c;
+  {
+    ImageCache cache(dir.path, image.size() * 2);
+    LoopbackProbe probe(0);
+    probe.setResponder(FlashEmulator(&image));
+    if (!cache.open() || !probe.open()) return 1;
+    JLinkBridge server(probe, 0, inflight, 2);
+    server.setImageCache(&cache);
+    if (!server.start()) return 1;
+    std::thread loop([&server]() { server.run(); });
+
+    size_t pos = 0;
+    int32_t features = -1;
+    Lz4Client plain, packed;
+    int fd = connectLocal(server.port());
+    int zfd = connectLocal(server.port());
+    ok = fd >= 0 && zfd >= 0 && negotiate(zfd, BRIDGE_FEATURE_LZ4, features) &&
+         features == BRIDGE_FEATURE_LZ4;
+    for (int phase = 0; ok && phase < 4; phase++) {
+      bool lz4 = phase & 1;
+      PacedLink link;
+      uint64_t start = monotonicUs();
+      ok = phase < 2 ? lz4Upload(lz4 ? zfd : fd, image, hash, lz4,
+                                 lz4 ? packed : plain, link)
+                     : lz4Dump(lz4 ? zfd : fd, image, pos,
+                               lz4 ? packed : plain, link);
+      // 读出按整块进行，可能比镜像多读一点
+      size_t bytes = phase < 2 ? image.size()
+                               : (image.size() + LZ4_BENCH_CHUNK - 1) /
+                                     LZ4_BENCH_CHUNK * LZ4_BENCH_CHUNK;
+      double mbs = bytes / (1024.0 * 1024) / ((monotonicUs() - start) / 1e6);
+      (phase < 2 ? (lz4 ? up_lz4 : up_raw) : (lz4 ? dump_lz4 : dump_raw)) = mbs;
+      if (lz4) (phase < 2 ? up_wire : dump_wire) = link.bytes;
+    }
+    client_us = packed.cpu_us;
+    server.stop();
+    if (fd >= 0) close(fd);  // 唤醒事件循环
+    if (zfd >= 0) close(zfd);
+    loop.join();
+    c = server.counters();
+  }
+  if (!ok) {
+    fprintf(stderr, "lz4-bench failed\n");
+    return 1;
+  }
+
+  printf("lz4-bench: %s, %zu KiB, %d B blocks, link %u KB/s\n",
+         isdigit((unsigned char)arg[0]) ? "synthetic firmware" : arg,
+         image.size() / 1024, LZ4_BENCH_CHUNK, LZ4_BENCH_LINK / 1024);
+  printf("lz4-bench: codec ratio %.2f, compress %.1f MB/s, decompress %.1f "
+         "MB/s (thread CPU time)\n",
+         (double)image.size() / wire, comp_us ? mb / (comp_us / 1e6) : 0.0,
+         decomp_us ? mb / (decomp_us / 1e6) : 0.0);
+  printf("lz4-bench: upload %.2f -> %.2f MB/s effective, %llu wire bytes\n",
+         up_raw, up_lz4, (unsigned long long)up_wire);
+  printf("lz4-bench: dump   %.2f -> %.2f MB/s effective, %llu wire bytes\n",
+         dump_raw, dump_lz4, (unsigned long long)dump_wire);
+  printf("lz4-bench: bridge %llu us in LZ4 (%.0f us/MB), client %llu us\n",
+         (unsigned long long)c.lz4_us,
+         c.lz4_in_raw + c.lz4_out_raw
+             ? c.lz4_us * 1048576.0 / (c.lz4_in_raw + c.lz4_out_raw)
+             : 0.0,
+         (unsigned long long)client_us);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int port = JLINK_BRIDGE_PORT;
+  const char *serial = nullptr;
+  int inflight = 8;
+  int loopback_us = -1;
+  int bench_kb = 0;
+  const char *cache_dir = "/var/cache/jlink_bridge";
+  int cache_mb = 64;
+  int stream_secs = 0;
+  int multi_secs = 0;
+  const char *lz4_image = nullptr;
+  int max_clients = 1;
+  std::vector<const char *> stream_specs;
+  for (int i = 1; i < argc; i += 2) {
+    if (i + 1 < argc && strcmp(argv[i], "-p") == 0) {
+      port = atoi(argv[i + 1]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+      serial = argv[i + 1];
+    } else if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+      inflight = atoi(argv[i + 1]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-l") == 0) {
+      loopback_us = atoi(argv[i + 1]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-k") == 0) {
+      max_clients = atoi(argv[i + 1]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-c") == 0) {
+      cache_dir = argv[i + 1];
+    } else if (i + 1 < argc && strcmp(argv[i], "-m") == 0) {
+      cache_mb = atoi(argv[i + 1]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--bench") == 0) {
+      bench_kb = atoi(argv[i + 1]);
+    } else if (i + 1 < argc && strcmp(argv[i], "-o") == 0) {
+      stream_specs.push_back(argv[i + 1]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--stream-bench") == 0) {
+      stream_secs = atoi(argv[i + 1]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--multi-bench") == 0) {
+      multi_secs = atoi(argv[i + 1]);
+    } else if (i + 1 < argc && strcmp(argv[i], "--lz4-bench") == 0) {
+      lz4_image = argv[i + 1];
+    } else {
+      fprintf(stderr,
+              "usage: %s [-p port] [-s serial] [-n inflight] [-l loopback_us] "
+              "[-k max_clients] [-c cache_dir] [-m cache_mb] "
+              "[-o name=dev[@baud]]... [--bench total_kb] "
+              "[--stream-bench secs] [--multi-bench secs] "
+              "[--lz4-bench image|kb]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  if (bench_kb > 0) return runBench(bench_kb, inflight, loopback_us);
+  if (stream_secs > 0) return runStreamBench(stream_secs, inflight, loopback_us);
+  if (multi_secs > 0) return runMultiBench(multi_secs, inflight, loopback_us);
+  if (lz4_image) return runLz4Bench(lz4_image, inflight);
+
+  // 流通道和命令通道各用自己的线程和端口
+  StreamServer streams;
+  for (size_t i = 0; i < stream_specs.size(); i++) {
+    std::string name;
+    StreamSource *source = parseStream(stream_specs[i], name);
+    if (!source) {
+      fprintf(stderr, "bad stream spec: %s\n", stream_specs[i]);
+      return 1;
+    }
+    streams.addChannel(name.c_str(), source, port ? port + 1 + i : 0);
+  }
+
+  Probe *probe;
+  if (loopback_us >= 0) {
+    probe = new LoopbackProbe(loopback_us);
+  } else {
+#if HAVE_LIBUSB
+    probe = new UsbProbe(serial);
+#else
+    (void)serial;
+    fprintf(stderr, "built without libusb, only -l (loopback) is available\n");
+    return 1;
+#endif
+  }
+  if (!probe->open()) {
+    delete probe;
+    return 1;
+  }
+
+  const char *stats_path = getenv("JLINK_BRIDGE_STATS");
+  statsStartExporter(stats_path ? stats_path : "/tmp/jlink_bridge.stats");
+
+  // 缓存不可用时桥照常工作，只是镜像操作返回BRIDGE_NOT_CACHED
+  ImageCache cache(cache_dir, (uint64_t)cache_mb * 1024 * 1024);
+  bool have_cache = cache_mb > 0 && cache.open();
+  if (!have_cache) fprintf(stderr, "image cache disabled\n");
+
+  DisplayClient *display = nullptr;
+  const char *server_path = getenv("OLED_SERVER");
+  if (server_path) {
+    display = new DisplayClient();
+    if (!display->connect(0, 0, OLED_MAX_COLUMN, OLED_MAX_ROW, "jlink_bridge",
+                          server_path)) {
+      fprintf(stderr, "Failed to connect to display server!\n");
+      delete display;
+      display = nullptr;
+    }
+  }
+
+  int status = 0;
+  {
+    JLinkBridge server(*probe, port, inflight, max_clients);
+    if (have_cache) server.setImageCache(&cache);
+    if (display) {
+      server.setStatusHook([&]() {
+        drawStatus(display->canvas(), server, have_cache ? &cache : nullptr);
+      });
+      drawStatus(display->canvas(), server, have_cache ? &cache : nullptr);
+    }
+    if (server.start() && streams.start()) {
+      bridge = &server;
+
+      // 不设置SA_RESTART，让epoll_wait被信号打断后检查退出标志
+      struct sigaction sa;
+      memset(&sa, 0, sizeof(sa));
+      sa.sa_handler = signalHandler;
+      sigaction(SIGINT, &sa, nullptr);
+      sigaction(SIGTERM, &sa, nullptr);
+
+      printf("%s bridged on tcp port %u\n", probe->describe(), server.port());
+      for (size_t i = 0; i < streams.channels(); i++) {
+        printf("stream %s on tcp port %u\n", streams.name(i), streams.port(i));
+      }
+      server.run();
+      bridge = nullptr;
+      streams.stop();
+
+      printCounters(server);
+      printStreamCounters(streams);
+    } else {
+      status = 1;
+    }
+  }
+  delete display;
+  delete probe;
+  statsStopExporter();
+  return status;
+}
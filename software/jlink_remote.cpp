@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "bridge_client.h"
+#include "probe.h"
+#include "sha256.h"
+
+// jlink_bridge的主机端工具：通过桥向远程探针发送J-Link USB命令。
+// 桥不实现SEGGER J-Link Remote Server协议，J-Link Commander、GDB Server
+// 等工具不能直接连接；主机上的脚本用这个工具，或链接BridgeClient
+// 把原本写给USB端点的命令转发给桥。
+// 用法：jlink_remote -H 主机 [-p 端口] [-z] 命令
+//   version            读探针固件版本（EMU_CMD_VERSION）
+//   caps               读探针能力位（EMU_CMD_GET_CAPS）
+//   xfer 十六进制 [n]  发送原始命令字节，再读最多n字节，打印应答
+//   upload 镜像文件    把镜像存入桥的缓存（已缓存时只查询），打印哈希
+// -z 协商LZ4压缩（桥支持时），大块数据压缩后传输。
+
+#define EMU_CMD_VERSION 0x01
+#define EMU_CMD_GET_CAPS 0xE8
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s -H host [-p port] [-z] "
+          "version | caps | xfer hex [rx_len] | upload image\n",
+          prog);
+}
+
+static bool parseHex(const char *s, std::vector<uint8_t> &out) {
+  out.clear();
+  while (*s) {
+    if (*s == ' ' || *s == ':') {
+      s++;
+      continue;
+    }
+    if (!s[1]) return false;
+    char byte[3] = {s[0], s[1], 0};
+    char *end;
+    out.push_back((uint8_t)strtoul(byte, &end, 16));
+    if (*end) return false;
+    s += 2;
+  }
+  return true;
+}
+
+static void printHex(const uint8_t *data, uint32_t len) {
+  for (uint32_t i = 0; i < len; i++) {
+    printf("%02x%c", data[i], i % 16 == 15 || i + 1 == len ? '\n' : ' ');
+  }
+}
+
+static bool loadFile(const char *path, std::vector<uint8_t> &data) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    perror(path);
+    return false;
+  }
+  uint8_t chunk[65536];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+    data.insert(data.end(), chunk, chunk + n);
+  }
+  bool ok = !ferror(fp);
+  fclose(fp);
+  return ok;
+}
+
+// 版本字符串：先读2字节长度，再读字符串；两次传输之间锁住探针
+static int readVersion(BridgeClient &client) {
+  uint8_t cmd = EMU_CMD_VERSION;
+  uint8_t len_buf[2];
+  uint32_t got = 0;
+  if (client.lock() != PROBE_OK) return PROBE_ERROR;
+  int status = client.transfer(&cmd, 1, len_buf, sizeof(len_buf), &got);
+  std::vector<uint8_t> text;
+  if (status == PROBE_OK && got == sizeof(len_buf)) {
+    uint32_t len = len_buf[0] | len_buf[1] << 8;
+    text.resize(len + 1);
+    status = len ? client.transfer(nullptr, 0, text.data(), len, &got) : 0;
+    if (status == PROBE_OK) {
+      text[got] = 0;
+      printf("%s\n", (const char *)text.data());
+    }
+  } else if (status == PROBE_OK) {
+    status = PROBE_ERROR;
+  }
+  client.unlock();
+  return status;
+}
+
+static int readCaps(BridgeClient &client) {
+  uint8_t cmd = EMU_CMD_GET_CAPS;
+  uint8_t caps[4];
+  uint32_t got = 0;
+  int status = client.transfer(&cmd, 1, caps, sizeof(caps), &got);
+  if (status == PROBE_OK && got != sizeof(caps)) status = PROBE_ERROR;
+  if (status == PROBE_OK) {
+    printf("caps %08x\n",
+           caps[0] | caps[1] << 8 | caps[2] << 16 | (uint32_t)caps[3] << 24);
+  }
+  return status;
+}
+
+static int rawTransfer(BridgeClient &client, const char *hex,
+                       const char *rx_arg) {
+  std::vector<uint8_t> tx;
+  if (!parseHex(hex, tx)) {
+    fprintf(stderr, "bad hex: %s\n", hex);
+    return PROBE_ERROR;
+  }
+  uint32_t rx_len = rx_arg ? (uint32_t)atoi(rx_arg) : 0;
+  if (rx_len > BRIDGE_MAX_PAYLOAD) rx_len = BRIDGE_MAX_PAYLOAD;
+  std::vector<uint8_t> rx(rx_len);
+  uint32_t got = 0;
+  int status =
+      client.transfer(tx.data(), tx.size(), rx.data(), rx_len, &got);
+  if (status == PROBE_OK) printHex(rx.data(), got);
+  return status;
+}
+
+static int upload(BridgeClient &client, const char *path) {
+  std::vector<uint8_t> image;
+  if (!loadFile(path, image)) return PROBE_ERROR;
+  uint8_t hash[SHA256_LEN];
+  bool cached = false;
+  int status = client.uploadImage(image.data(), image.size(), hash, &cached);
+  if (status == PROBE_OK) {
+    char hex[2 * SHA256_LEN + 1];
+    sha256Hex(hash, hex);
+    printf("%s %s (%zu bytes)\n", hex, cached ? "cached" : "uploaded",
+           image.size());
+  }
+  return status;
+}
+
+int main(int argc, char **argv) {
+  const char *host = nullptr;
+  int port = JLINK_BRIDGE_PORT;
+  bool compress = false;
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (strcmp(argv[i], "-z") == 0) {
+      compress = true;
+    } else if (i + 1 < argc && strcmp(argv[i], "-H") == 0) {
+      host = argv[++i];
+    } else if (i + 1 < argc && strcmp(argv[i], "-p") == 0) {
+      port = atoi(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (!host || i >= argc) {
+    usage(argv[0]);
+    return 1;
+  }
+  const char *cmd = argv[i];
+  const char *arg = i + 1 < argc ? argv[i + 1] : nullptr;
+  const char *arg2 = i + 2 < argc ? argv[i + 2] : nullptr;
+
+  BridgeClient client;
+  if (!client.connect(host, port)) return 1;
+  if (compress && client.negotiate(BRIDGE_FEATURE_LZ4) < 0) return 1;
+
+  int status;
+  if (strcmp(cmd, "version") == 0) {
+    status = readVersion(client);
+  } else if (strcmp(cmd, "caps") == 0) {
+    status = readCaps(client);
+  } else if (strcmp(cmd, "xfer") == 0 && arg) {
+    status = rawTransfer(client, arg, arg2);
+  } else if (strcmp(cmd, "upload") == 0 && arg) {
+    status = upload(client, arg);
+  } else {
+    usage(argv[0]);
+    return 1;
+  }
+  if (status != PROBE_OK) {
+    fprintf(stderr, "%s failed: status %d\n", cmd, status);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,231 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "display_client.h"
+#include "i2c_transport.h"
+#include "link_quality.h"
+#include "stats.h"
+
+// 调试链路质量监视：AP信号/速率/重传/发送失败 + 到主机的UDP回显往返时间。
+// 用法：link_monitor [-i 网卡] [-w wireless文件] [-t 探测间隔ms] 主机[:端口]
+//       link_monitor --echo [端口]        在主机上运行回显服务
+//       link_monitor --self-test 秒       本机回环自测
+// 设置OLED_SERVER时在屏幕上显示仪表盘，否则每秒打印一行汇总。
+// 自测使用带延迟、抖动和丢包的本地回显替身和样例wireless文件，
+// 结束时把仪表盘画到模拟总线上并以字符画输出。
+
+static volatile sig_atomic_t running = 1;
+
+static void signalHandler(int signum) {
+  (void)signum;
+  running = 0;
+}
+
+static void printSummary(const LinkMonitor &monitor) {
+  LinkSummary s = monitor.summary();
+  if (s.associated) {
+    printf("%s%s%s %ddBm %u.%uMb/s ", s.station.ifname.c_str(),
+           s.station.ssid.empty() ? "" : " ", s.station.ssid.c_str(),
+           s.station.signal_dbm, s.station.bitrate_kbps / 1000,
+           s.station.bitrate_kbps % 1000 / 100);
+    if (s.station.has_retries) printf("%u retries/s ", s.retries_per_sec);
+    printf("%u tx failed/s | ", s.failed_per_sec);
+  }
+  printf("rtt p50 %u p90 %u p99 %u max %u us, jitter %u us, lost %u/%u\n",
+         s.rtt_p50, s.rtt_p90, s.rtt_p99, s.rtt_max, s.jitter_us, s.lost,
+         s.samples);
+  fflush(stdout);
+}
+
+// 把模拟总线上的面板输出为字符画
+static void printPanel(const MockTransport &bus) {
+  const uint8_t *panel = bus.panel();
+  for (int y = 0; y < OLED_MAX_ROW; y++) {
+    char row[OLED_MAX_COLUMN + 1];
+    for (int x = 0; x < OLED_MAX_COLUMN; x++) {
+      row[x] = panel[(y / 8) * OLED_MAX_COLUMN + x] >> (y % 8) & 1 ? '#' : '.';
+    }
+    row[OLED_MAX_COLUMN] = '\0';
+    puts(row);
+  }
+}
+
+static int runEcho(uint16_t port) {
+  UdpEchoServer echo;
+  if (!echo.start(port)) return 1;
+  printf("echo server on udp port %u\n", echo.port());
+  fflush(stdout);
+  while (running) pause();
+  echo.stop();
+  return 0;
+}
+
+static int runSelfTest(uint32_t secs, uint32_t interval_ms) {
+  // 样例wireless文件：信号-61dBm，retry列（发送失败）每秒增加40
+  char fixture[] = "/tmp/link_monitor.XXXXXX";
+  int fd = mkstemp(fixture);
+  if (fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+  // 写临时文件再rename，监视线程不会读到写了一半的文件
+  std::string tmp = std::string(fixture) + ".tmp";
+  auto writeFixture = [&fixture, &tmp](unsigned failed) {
+    FILE *fp = fopen(tmp.c_str(), "w");
+    if (!fp) return;
+    fprintf(fp,
+            "Inter-| sta-|   Quality        |   Discarded packets"
+            "               | Missed | WE\n"
+            " face | tus | link level noise |  nwid  crypt   frag  retry"
+            "   misc | beacon | 22\n"
+            " wlan0: 0000   49.  -61.  -256        0      0      0 %6u"
+            "      3        0\n",
+            failed);
+    fclose(fp);
+    rename(tmp.c_str(), fixture);
+  };
+  writeFixture(0);
+
+  UdpEchoServer echo;
+  ProcWirelessSource station("wlan0", fixture);
+  LinkMonitor monitor(&station, interval_ms, 500);
+  // 回显替身：2ms固定延迟、0~1ms抖动、5%丢包
+  if (!echo.start(0, 2000, 1000, 5) ||
+      !monitor.start("127.0.0.1", echo.port())) {
+    unlink(fixture);
+    return 1;
+  }
+  for (uint32_t i = 0; i < secs && running; i++) {
+    sleep(1);
+    writeFixture((i + 1) * 40);
+    printSummary(monitor);
+  }
+  monitor.stop();
+  echo.stop();
+  unlink(fixture);
+
+  MockTransport bus;
+  OLED panel(&bus);
+  drawLinkDashboard(panel, monitor);
+  printPanel(bus);
+
+  LinkSummary s = monitor.summary();
+  // wireless文件的retry列是发送失败，没有重传次数
+  bool ok = s.associated && s.samples > 0 && s.rtt_p50 >= 2000 &&
+            s.station.signal_dbm == -61 && !s.station.has_retries &&
+            (secs < 2 || s.station.tx_failed >= 40);
+  printf("self-test %s\n", ok ? "passed" : "FAILED");
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  const char *ifname = "wlan0";
+  const char *wireless = "/proc/net/wireless";
+  bool have_wireless = false;
+  uint32_t interval_ms = 100;
+  const char *target = nullptr;
+  int echo_port = -1;
+  int self_test = 0;
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 < argc && strcmp(argv[i], "-i") == 0) {
+      ifname = argv[++i];
+    } else if (i + 1 < argc && strcmp(argv[i], "-w") == 0) {
+      wireless = argv[++i];
+      have_wireless = true;
+    } else if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+      interval_ms = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--echo") == 0) {
+      echo_port = i + 1 < argc ? atoi(argv[++i]) : LINK_ECHO_PORT;
+    } else if (i + 1 < argc && strcmp(argv[i], "--self-test") == 0) {
+      self_test = atoi(argv[++i]);
+    } else if (argv[i][0] != '-' && !target) {
+      target = argv[i];
+    } else {
+      target = nullptr;
+      echo_port = -1;
+      self_test = 0;
+      break;
+    }
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = signalHandler;
+  sigaction(SIGINT, &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+
+  if (echo_port >= 0) return runEcho(echo_port);
+  if (self_test > 0) return runSelfTest(self_test, interval_ms);
+  if (!target) {
+    fprintf(stderr,
+            "usage: %s [-i ifname] [-w wireless_file] [-t interval_ms] "
+            "host[:port]\n"
+            "       %s --echo [port]\n"
+            "       %s --self-test secs\n",
+            argv[0], argv[0], argv[0]);
+    return 1;
+  }
+
+  std::string host(target);
+  uint16_t port = LINK_ECHO_PORT;
+  size_t colon = host.find(':');
+  if (colon != std::string::npos) {
+    port = atoi(host.c_str() + colon + 1);
+    host.erase(colon);
+  }
+
+  // 有NetworkManager时取活动AP的SSID和速率，没有时直接读nl80211；
+  // 指定-w时只读wireless文件
+  StationSource *station;
+  if (have_wireless) {
+    station = new ProcWirelessSource(ifname, wireless);
+  } else {
+#if HAVE_NETWORKMANAGER
+    station = new NmStationSource(ifname);
+#else
+    station = new Nl80211StationSource(ifname);
+#endif
+  }
+
+  const char *stats_path = getenv("LINK_MONITOR_STATS");
+  statsStartExporter(stats_path ? stats_path : "/tmp/link_monitor.stats");
+
+  DisplayClient *display = nullptr;
+  const char *server_path = getenv("OLED_SERVER");
+  if (server_path) {
+    display = new DisplayClient();
+    if (!display->connect(0, 0, OLED_MAX_COLUMN, OLED_MAX_ROW, "link_monitor",
+                          server_path)) {
+      fprintf(stderr, "Failed to connect to display server!\n");
+      delete display;
+      display = nullptr;
+    }
+  }
+
+  int status = 0;
+  {
+    LinkMonitor monitor(station, interval_ms);
+    if (monitor.start(host.c_str(), port)) {
+      printf("probing %s:%u every %u ms\n", host.c_str(), port, interval_ms);
+      // 仪表盘每500ms重绘，只有变化的块会上传
+      for (uint32_t tick = 0; running; tick++) {
+        usleep(500000);
+        if (display) drawLinkDashboard(display->canvas(), monitor);
+        if (!display && tick % 2) printSummary(monitor);
+      }
+      monitor.stop();
+    } else {
+      status = 1;
+    }
+  }
+  delete display;
+  delete station;
+  statsStopExporter();
+  return status;
+}
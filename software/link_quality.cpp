@@ -0,0 +1,498 @@
+#include "link_quality.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "stats.h"
+
+#if HAVE_NETWORKMANAGER
+#include <NetworkManager.h>
+#include <glib.h>
+#endif
+
+#define STATION_INTERVAL_US 1000000  // AP信息的刷新周期
+
+// ========== AP信息 ==========
+ProcWirelessSource::ProcWirelessSource(const char *ifname, const char *path)
+    : ifname(ifname), path(path) {}
+
+bool ProcWirelessSource::read(StationInfo &info) {
+  FILE *fp = fopen(path.c_str(), "r");
+  if (!fp) return false;
+  // 前两行为表头；每行：" wlan0: 0000   54.  -56.  -256  nwid crypt frag
+  // retry misc beacon"
+  char line[256];
+  bool found = false;
+  while (fgets(line, sizeof(line), fp)) {
+    char *colon = strchr(line, ':');
+    if (!colon) continue;
+    char *name = line;
+    while (*name == ' ') name++;
+    if ((size_t)(colon - name) != ifname.size() ||
+        strncmp(name, ifname.c_str(), ifname.size()) != 0) {
+      continue;
+    }
+    unsigned status;
+    float link, level, noise;
+    unsigned long long nwid, crypt, frag, retry, misc;
+    if (sscanf(colon + 1, "%x %f %f %f %llu %llu %llu %llu %llu", &status,
+               &link, &level, &noise, &nwid, &crypt, &frag, &retry,
+               &misc) == 9) {
+      info.ifname = ifname;
+      info.quality = link > 0 ? (uint32_t)link : 0;
+      info.signal_dbm = level < 0 ? (int)level : 0;  // 非负值不是dBm
+      info.tx_failed = retry;
+      found = true;
+    }
+    break;
+  }
+  fclose(fp);
+  return found;
+}
+
+Nl80211StationSource::Nl80211StationSource(const char *ifname)
+    : ifname(ifname), nl_failed(false), proc(ifname) {}
+
+bool Nl80211StationSource::read(StationInfo &info) {
+  bool have_proc = proc.read(info);  // 质量；nl80211不可用时也是信号来源
+  if (nl_failed) return have_proc;
+  if (!nl.isOpen() && !nl.open()) {
+    nl_failed = true;
+    return have_proc;
+  }
+  // 每次重新查接口序号，网卡重新插拔后仍然有效
+  unsigned ifindex = if_nametoindex(ifname.c_str());
+  Nl80211Station st;
+  if (!ifindex || !nl.getStation(ifindex, st)) return false;  // 未关联
+
+  info.ifname = ifname;
+  info.bssid = st.bssid;
+  if (st.signal_dbm) info.signal_dbm = st.signal_dbm;
+  if (st.bitrate_kbps) info.bitrate_kbps = st.bitrate_kbps;
+  if (st.has_retries) {
+    info.tx_retries = st.tx_retries;
+    info.tx_failed = st.tx_failed;
+    info.has_retries = true;
+  }
+  return true;
+}
+
+#if HAVE_NETWORKMANAGER
+NmStationSource::NmStationSource(const char *ifname)
+    : client(nullptr), want_ifname(ifname ? ifname : ""), counters(nullptr) {}
+
+NmStationSource::~NmStationSource() {
+  delete counters;
+  if (client) g_object_unref(client);
+}
+
+bool NmStationSource::read(StationInfo &info) {
+  if (!client) {
+    GError *error = nullptr;
+    client = nm_client_new(nullptr, &error);
+    if (!client) {
+      fprintf(stderr, "Failed to create NMClient: %s\n", error->message);
+      g_error_free(error);
+      return false;
+    }
+  }
+  // 处理积压的D-Bus信号，活动AP和速率才是最新的
+  while (g_main_context_iteration(nm_client_get_main_context(client), FALSE)) {
+  }
+
+  const GPtrArray *devices = nm_client_get_devices(client);
+  NMDeviceWifi *wifi = nullptr;
+  for (guint i = 0; devices && i < devices->len; i++) {
+    NMDevice *device = (NMDevice *)devices->pdata[i];
+    if (!NM_IS_DEVICE_WIFI(device)) continue;
+    if (!want_ifname.empty() && want_ifname != nm_device_get_iface(device)) {
+      continue;
+    }
+    wifi = NM_DEVICE_WIFI(device);
+    break;
+  }
+  if (!wifi) return false;
+  NMAccessPoint *ap = nm_device_wifi_get_active_access_point(wifi);
+  if (!ap) return false;
+
+  info.ifname = nm_device_get_iface(NM_DEVICE(wifi));
+  if (!counters) counters = new Nl80211StationSource(info.ifname.c_str());
+  counters->read(info);  // 信号（dBm）、重传和发送失败计数
+
+  GBytes *ssid_bytes = nm_access_point_get_ssid(ap);
+  if (ssid_bytes) {
+    gsize len;
+    const char *data = (const char *)g_bytes_get_data(ssid_bytes, &len);
+    info.ssid.assign(data, len);
+    for (char &c : info.ssid) {
+      if (c < 32 || c > 126) c = '?';
+    }
+  }
+  const char *bssid = nm_access_point_get_bssid(ap);
+  info.bssid = bssid ? bssid : "";
+  info.freq_mhz = nm_access_point_get_frequency(ap);
+  info.bitrate_kbps = nm_device_wifi_get_bitrate(wifi);
+  if (!info.quality) info.quality = nm_access_point_get_strength(ap);
+  return true;
+}
+#endif
+
+// ========== 回显替身 ==========
+UdpEchoServer::UdpEchoServer()
+    : sock(-1),
+      stop_fd(-1),
+      bound_port(0),
+      delay_us(0),
+      jitter_us(0),
+      loss_pct(0) {}
+
+UdpEchoServer::~UdpEchoServer() { stop(); }
+
+bool UdpEchoServer::start(uint16_t port, uint32_t delay_us, uint32_t jitter_us,
+                          uint32_t loss_pct) {
+  this->delay_us = delay_us;
+  this->jitter_us = jitter_us;
+  this->loss_pct = loss_pct;
+  sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  stop_fd = eventfd(0, EFD_CLOEXEC);
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_ANY);
+  sa.sin_port = htons(port);
+  socklen_t len = sizeof(sa);
+  if (sock < 0 || stop_fd < 0 ||
+      bind(sock, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+      getsockname(sock, (struct sockaddr *)&sa, &len) < 0) {
+    perror("echo server");
+    stop();
+    return false;
+  }
+  bound_port = ntohs(sa.sin_port);
+  thread = std::thread(&UdpEchoServer::run, this);
+  return true;
+}
+
+void UdpEchoServer::stop(void) {
+  if (thread.joinable()) {
+    uint64_t one = 1;
+    if (write(stop_fd, &one, sizeof(one)) < 0) perror("echo stop");
+    thread.join();
+  }
+  if (sock >= 0) close(sock);
+  if (stop_fd >= 0) close(stop_fd);
+  sock = stop_fd = -1;
+}
+
+void UdpEchoServer::run(void) {
+  unsigned seed = 1;
+  struct pollfd pfd[2];
+  pfd[0].fd = sock;
+  pfd[0].events = POLLIN;
+  pfd[1].fd = stop_fd;
+  pfd[1].events = POLLIN;
+  for (;;) {
+    if (poll(pfd, 2, -1) < 0 && errno != EINTR) return;
+    if (pfd[1].revents) return;
+    if (!pfd[0].revents) continue;
+
+    uint8_t buf[1500];
+    struct sockaddr_in from;
+    socklen_t len = sizeof(from);
+    ssize_t n = recvfrom(sock, buf, sizeof(buf), 0, (struct sockaddr *)&from,
+                         &len);
+    if (n < 0) continue;
+    if (loss_pct && (uint32_t)(rand_r(&seed) % 100) < loss_pct) continue;
+    uint32_t wait = delay_us + (jitter_us ? rand_r(&seed) % jitter_us : 0);
+    if (wait) usleep(wait);
+    sendto(sock, buf, n, 0, (struct sockaddr *)&from, len);
+  }
+}
+
+// ========== 监视 ==========
+LinkMonitor::LinkMonitor(StationSource *station, uint32_t interval_ms,
+                         uint32_t timeout_ms)
+    : station(station),
+      interval_ms(interval_ms ? interval_ms : 1),
+      timeout_ms(timeout_ms),
+      sock(-1),
+      stop_fd(-1),
+      next_seq(0),
+      jitter16(0),
+      last_rtt(0),
+      have_last(false),
+      info(),
+      associated(false),
+      retries_per_sec(0),
+      failed_per_sec(0) {
+  memset(ring, 0, sizeof(ring));
+}
+
+LinkMonitor::~LinkMonitor() { stop(); }
+
+bool LinkMonitor::start(const char *host, uint16_t port) {
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(port);
+  if (inet_pton(AF_INET, host, &sa.sin_addr) != 1) {
+    fprintf(stderr, "bad echo host: %s\n", host);
+    return false;
+  }
+  // connect后只收这个对端的回显，send/recv不需要带地址
+  sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  stop_fd = eventfd(0, EFD_CLOEXEC);
+  if (sock < 0 || stop_fd < 0 ||
+      connect(sock, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+    perror("link monitor");
+    stop();
+    return false;
+  }
+  thread = std::thread(&LinkMonitor::run, this);
+  return true;
+}
+
+void LinkMonitor::stop(void) {
+  if (thread.joinable()) {
+    uint64_t one = 1;
+    if (write(stop_fd, &one, sizeof(one)) < 0) perror("link monitor stop");
+    thread.join();
+  }
+  if (sock >= 0) close(sock);
+  if (stop_fd >= 0) close(stop_fd);
+  sock = stop_fd = -1;
+}
+
+void LinkMonitor::run(void) {
+  uint64_t station_us = 0;
+  uint64_t next_probe = monotonicUs();
+  pollStation(next_probe, station_us);
+
+  struct pollfd pfd[2];
+  pfd[0].fd = sock;
+  pfd[0].events = POLLIN;
+  pfd[1].fd = stop_fd;
+  pfd[1].events = POLLIN;
+  for (;;) {
+    uint64_t now = monotonicUs();
+    if (now >= next_probe) {
+      sendProbe(now);
+      next_probe += interval_ms * 1000ULL;
+      if (next_probe <= now) next_probe = now + interval_ms * 1000ULL;  // 落后时不补发
+    }
+    expire(now);
+    pollStation(now, station_us);
+
+    int wait_ms = (int)((next_probe - now + 999) / 1000);
+    if (poll(pfd, 2, wait_ms) < 0 && errno != EINTR) {
+      perror("link monitor poll");
+      return;
+    }
+    if (pfd[1].revents) return;
+    if (pfd[0].revents) receive(monotonicUs());
+  }
+}
+
+void LinkMonitor::sendProbe(uint64_t now) {
+  LinkProbePacket pkt;
+  pkt.magic = LINK_PROBE_MAGIC;
+  pkt.sent_us = now;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    pkt.seq = next_seq++;
+    LinkSample &s = ring[pkt.seq & (LINK_HISTORY - 1)];
+    s.sent_us = now;
+    s.seq = pkt.seq;
+    s.rtt_us = 0;
+    s.state = LINK_PENDING;
+    s.signal_dbm = associated ? (int8_t)info.signal_dbm : 0;
+  }
+  // 发送失败（网络不可达等）留在环里按超时计为丢失
+  send(sock, &pkt, sizeof(pkt), MSG_DONTWAIT);
+}
+
+void LinkMonitor::receive(uint64_t now) {
+  LinkProbePacket pkt;
+  ssize_t n;
+  while ((n = recv(sock, &pkt, sizeof(pkt), MSG_DONTWAIT)) >= 0) {
+    if (n != sizeof(pkt) || pkt.magic != LINK_PROBE_MAGIC) continue;
+    std::lock_guard<std::mutex> guard(lock);
+    LinkSample &s = ring[pkt.seq & (LINK_HISTORY - 1)];
+    // 已超时或已被新探测覆盖的迟到回显直接忽略
+    if (s.seq != pkt.seq || s.state != LINK_PENDING) continue;
+    uint32_t rtt = (uint32_t)(now - s.sent_us);
+    s.rtt_us = rtt;
+    s.state = LINK_OK;
+    // RFC 3550：J += (|D| - J) / 16，这里保存16J
+    if (have_last) {
+      uint32_t d = rtt > last_rtt ? rtt - last_rtt : last_rtt - rtt;
+      jitter16 += d - jitter16 / 16;
+    }
+    last_rtt = rtt;
+    have_last = true;
+    statsRecord(STAT_LINK_RTT, rtt, sizeof(pkt));
+  }
+}
+
+void LinkMonitor::expire(uint64_t now) {
+  uint64_t timeout_us = timeout_ms * 1000ULL;
+  std::lock_guard<std::mutex> guard(lock);
+  for (int i = 0; i < LINK_HISTORY; i++) {
+    LinkSample &s = ring[i];
+    if (s.state == LINK_PENDING && now - s.sent_us >= timeout_us) {
+      s.state = LINK_LOST;
+      statsRecord(STAT_LINK_RTT, timeout_us, 0, true);
+    }
+  }
+}
+
+void LinkMonitor::pollStation(uint64_t now, uint64_t &last_us) {
+  if (!station || (last_us && now - last_us < STATION_INTERVAL_US)) return;
+  // 读AP信息可能较慢（D-Bus），不持锁
+  StationInfo fresh = StationInfo();
+  bool ok = station->read(fresh);
+  std::lock_guard<std::mutex> guard(lock);
+  // 计数回绕或重新关联（计数清零）时这一轮记为0
+  retries_per_sec = failed_per_sec = 0;
+  if (ok && associated && last_us) {
+    if (fresh.has_retries && info.has_retries &&
+        fresh.tx_retries >= info.tx_retries) {
+      retries_per_sec = (uint32_t)((fresh.tx_retries - info.tx_retries) *
+                                   1000000 / (now - last_us));
+    }
+    if (fresh.tx_failed >= info.tx_failed) {
+      failed_per_sec = (uint32_t)((fresh.tx_failed - info.tx_failed) *
+                                  1000000 / (now - last_us));
+    }
+  }
+  associated = ok;
+  info = fresh;
+  last_us = now;
+}
+
+LinkSummary LinkMonitor::summary(void) const {
+  LinkSummary out;
+  std::vector<uint32_t> rtts;
+  rtts.reserve(LINK_HISTORY);
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    out.station = info;
+    out.associated = associated;
+    out.retries_per_sec = retries_per_sec;
+    out.failed_per_sec = failed_per_sec;
+    out.jitter_us = jitter16 / 16;
+    out.lost = 0;
+    for (int i = 0; i < LINK_HISTORY; i++) {
+      if (ring[i].state == LINK_OK) rtts.push_back(ring[i].rtt_us);
+      if (ring[i].state == LINK_LOST) out.lost++;
+    }
+  }
+  out.samples = rtts.size() + out.lost;
+  out.rtt_p50 = out.rtt_p90 = out.rtt_p99 = out.rtt_max = 0;
+  if (!rtts.empty()) {
+    std::sort(rtts.begin(), rtts.end());
+    size_t n = rtts.size();
+    out.rtt_p50 = rtts[(n - 1) * 50 / 100];
+    out.rtt_p90 = rtts[(n - 1) * 90 / 100];
+    out.rtt_p99 = rtts[(n - 1) * 99 / 100];
+    out.rtt_max = rtts[n - 1];
+  }
+  return out;
+}
+
+uint32_t LinkMonitor::history(LinkSample *out) const {
+  std::lock_guard<std::mutex> guard(lock);
+  uint32_t n = std::min<uint32_t>(next_seq, LINK_HISTORY);
+  for (uint32_t i = 0; i < n; i++) {
+    out[i] = ring[(next_seq - n + i) & (LINK_HISTORY - 1)];
+  }
+  return n;
+}
+
+// ========== 仪表盘 ==========
+// 6x8字体每行21个字符；上面四行文字，下面30像素画RTT趋势
+#define GRAPH_TOP 34
+#define GRAPH_BOTTOM 63
+
+// 微秒格式化为"1.2ms"/"850us"
+static void formatUs(char *buf, size_t size, uint32_t us) {
+  if (us >= 10000) {
+    snprintf(buf, size, "%ums", us / 1000);
+  } else if (us >= 1000) {
+    snprintf(buf, size, "%u.%ums", us / 1000, us % 1000 / 100);
+  } else {
+    snprintf(buf, size, "%uus", us);
+  }
+}
+
+void drawLinkDashboard(OLED &o, const LinkMonitor &monitor) {
+  LinkSummary s = monitor.summary();
+  LinkSample samples[LINK_HISTORY];
+  uint32_t n = monitor.history(samples);
+
+  char line[32], a[12], b[12];
+  o.clear_GRAM();
+  if (s.associated) {
+    const char *name = s.station.ssid.empty() ? s.station.ifname.c_str()
+                                              : s.station.ssid.c_str();
+    snprintf(line, sizeof(line), "%-14.14s%4ddBm", name, s.station.signal_dbm);
+    o.showString_GRAM(0, 0, line, 12);
+    // 有重传计数时显示重传（r），否则显示发送失败（f）
+    char tx[16];
+    if (s.station.has_retries) {
+      snprintf(tx, sizeof(tx), "r%u/s", s.retries_per_sec);
+    } else {
+      snprintf(tx, sizeof(tx), "f%u/s", s.failed_per_sec);
+    }
+    if (s.station.bitrate_kbps) {
+      snprintf(line, sizeof(line), "%u.%uM %uMHz %s",
+               s.station.bitrate_kbps / 1000,
+               s.station.bitrate_kbps % 1000 / 100, s.station.freq_mhz, tx);
+    } else {
+      snprintf(line, sizeof(line), "q%u %s", s.station.quality, tx);
+    }
+    o.showString_GRAM(0, 8, line, 12);
+  } else {
+    o.showString_GRAM(0, 0, "Not associated", 12);
+  }
+
+  if (s.samples) {
+    formatUs(a, sizeof(a), s.rtt_p50);
+    formatUs(b, sizeof(b), s.rtt_p99);
+    snprintf(line, sizeof(line), "RTT %s p99 %s", a, b);
+    o.showString_GRAM(0, 16, line, 12);
+    formatUs(a, sizeof(a), s.jitter_us);
+    snprintf(line, sizeof(line), "jit %s loss %u/%u", a, s.lost, s.samples);
+    o.showString_GRAM(0, 24, line, 12);
+  } else {
+    o.showString_GRAM(0, 16, "RTT: no replies", 12);
+  }
+
+  // 趋势图：每个样本一列，最新在右；按窗口内最大RTT缩放，丢失的样本
+  // 在顶行画一个点
+  uint32_t scale = std::max<uint32_t>(s.rtt_max, 1000);
+  uint8_t height = GRAPH_BOTTOM - GRAPH_TOP;
+  uint8_t x0 = OLED_MAX_COLUMN - n;
+  for (uint32_t i = 0; i < n; i++) {
+    uint8_t x = x0 + i;
+    if (samples[i].state == LINK_LOST) {
+      o.drawPixel_GRAM(x, GRAPH_TOP, WHITE);
+    } else if (samples[i].state == LINK_OK) {
+      uint32_t h = (uint64_t)samples[i].rtt_us * height / scale;
+      o.drawLine_GRAM(x, GRAPH_BOTTOM, x, GRAPH_BOTTOM - (h ? h : 1), WHITE);
+    }
+  }
+  o.present();
+}
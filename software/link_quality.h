@@ -0,0 +1,187 @@
+#ifndef LINK_QUALITY_H
+#define LINK_QUALITY_H
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "nl80211.h"
+#include "oled.h"
+
+// 调试链路质量监视：当前关联AP的信号、发送速率、重传和发送失败计数，
+// 以及到主机的UDP回显探测（往返时间、抖动、丢包）。
+// 样本存放在固定大小的环里，仪表盘和百分位都从环的快照计算。
+
+#define LINK_HISTORY 128          // 样本环长度（2的幂）
+#define LINK_ECHO_PORT 19030      // 主机端回显服务的默认端口
+#define LINK_PROBE_MAGIC 0x4C4E4B50  // "LNKP"
+
+// 当前关联的AP；取不到的字段为0/空
+struct StationInfo {
+  std::string ifname;
+  std::string ssid;
+  std::string bssid;
+  uint32_t freq_mhz;
+  int signal_dbm;         // 0为未知
+  uint32_t quality;       // 链路质量（驱动定义的刻度）
+  uint32_t bitrate_kbps;  // 发送速率
+  uint64_t tx_retries;    // 累计重传（nl80211 TX_RETRIES）
+  uint64_t tx_failed;     // 累计发送失败，即重传用尽后丢弃的帧
+                          // （nl80211 TX_FAILED或/proc/net/wireless的retry列）
+  bool has_retries;       // tx_retries有效，只有nl80211报告重传次数
+};
+
+class StationSource {
+ public:
+  virtual ~StationSource() {}
+  virtual bool read(StationInfo &info) = 0;  // 未关联或不可用时返回false
+};
+
+// /proc/net/wireless：信号、质量和发送失败计数；path可指向测试用的样例文件。
+// cfg80211驱动的retry列是重传用尽后的发送失败，不是重传次数；
+// misc列是接收端丢弃，不使用
+class ProcWirelessSource : public StationSource {
+ public:
+  ProcWirelessSource(const char *ifname,
+                     const char *path = "/proc/net/wireless");
+  bool read(StationInfo &info);
+
+ private:
+  std::string ifname;
+  std::string path;
+};
+
+// nl80211站点信息（NL80211_CMD_GET_STATION）：BSSID、信号、发送速率、
+// 重传和发送失败计数；质量仍取/proc/net/wireless。
+// nl80211不可用（非cfg80211驱动）时只读/proc/net/wireless
+class Nl80211StationSource : public StationSource {
+ public:
+  explicit Nl80211StationSource(const char *ifname);
+  bool read(StationInfo &info);
+
+ private:
+  std::string ifname;
+  Nl80211 nl;
+  bool nl_failed;  // 打开失败后不再重试
+  ProcWirelessSource proc;
+};
+
+#if HAVE_NETWORKMANAGER
+typedef struct _NMClient NMClient;
+
+// NetworkManager：活动AP的SSID/BSSID/频率和发送速率，
+// 信号和重传计数从nl80211读取
+class NmStationSource : public StationSource {
+ public:
+  explicit NmStationSource(const char *ifname = nullptr);
+  ~NmStationSource();
+  bool read(StationInfo &info);
+
+ private:
+  NMClient *client;
+  std::string want_ifname;
+  Nl80211StationSource *counters;
+};
+#endif
+
+// 回显探测报文；回显方原样返回，时间戳只由发送方解释，不需要对时
+struct LinkProbePacket {
+  uint32_t magic;
+  uint32_t seq;
+  uint64_t sent_us;
+};
+
+// 本地回显替身：收到什么回什么，可加固定延迟、随机抖动和丢包
+class UdpEchoServer {
+ public:
+  UdpEchoServer();
+  ~UdpEchoServer();
+
+  bool start(uint16_t port = 0, uint32_t delay_us = 0, uint32_t jitter_us = 0,
+             uint32_t loss_pct = 0);
+  void stop(void);
+  uint16_t port(void) const { return bound_port; }
+
+ private:
+  int sock;
+  int stop_fd;
+  uint16_t bound_port;
+  uint32_t delay_us, jitter_us, loss_pct;
+  std::thread thread;
+
+  void run(void);
+};
+
+// 环中的一个样本（一次探测）
+enum LinkSampleState {
+  LINK_EMPTY,    // 尚未使用的槽
+  LINK_PENDING,  // 已发送，等待回显
+  LINK_OK,
+  LINK_LOST,  // 超时未回
+};
+
+struct LinkSample {
+  uint64_t sent_us;
+  uint32_t seq;
+  uint32_t rtt_us;
+  uint8_t state;
+  int8_t signal_dbm;  // 发送时的信号，仪表盘画趋势用
+};
+
+// 环的汇总（只统计已有结果的样本）
+struct LinkSummary {
+  StationInfo station;
+  bool associated;
+  uint32_t retries_per_sec;  // 只在station.has_retries时有效
+  uint32_t failed_per_sec;
+  uint32_t samples;  // 有结果的样本数
+  uint32_t lost;
+  uint32_t rtt_p50, rtt_p90, rtt_p99, rtt_max;  // 微秒
+  uint32_t jitter_us;  // RFC 3550平滑抖动
+};
+
+class LinkMonitor {
+ public:
+  // station可为空（只做回显探测），不接管所有权
+  LinkMonitor(StationSource *station, uint32_t interval_ms = 100,
+              uint32_t timeout_ms = 1000);
+  ~LinkMonitor();
+
+  // host为回显服务的IPv4地址
+  bool start(const char *host, uint16_t port = LINK_ECHO_PORT);
+  void stop(void);
+
+  LinkSummary summary(void) const;
+  // 复制环，按时间从旧到新，返回样本数
+  uint32_t history(LinkSample *out) const;
+
+ private:
+  StationSource *station;
+  uint32_t interval_ms, timeout_ms;
+  int sock;
+  int stop_fd;
+  std::thread thread;
+
+  mutable std::mutex lock;  // 保护以下字段
+  LinkSample ring[LINK_HISTORY];
+  uint32_t next_seq;
+  uint32_t jitter16;  // 抖动的16倍（定点）
+  uint32_t last_rtt;
+  bool have_last;
+  StationInfo info;
+  bool associated;
+  uint32_t retries_per_sec, failed_per_sec;
+
+  void run(void);
+  void sendProbe(uint64_t now);
+  void receive(uint64_t now);
+  void expire(uint64_t now);
+  void pollStation(uint64_t now, uint64_t &last_us);
+};
+
+// 仪表盘：SSID/信号、速率/重传（或发送失败）、RTT百分位/抖动/丢包、RTT趋势图
+void drawLinkDashboard(OLED &o, const LinkMonitor &monitor);
+
+#endif  // LINK_QUALITY_H
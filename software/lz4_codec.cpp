@@ -0,0 +1,167 @@
+#include "lz4_codec.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#if HAVE_LZ4
+Lz4Codec::Lz4Codec() : state(malloc(LZ4_sizeofState())) {}
+
+Lz4Codec::~Lz4Codec() { free(state); }
+
+size_t Lz4Codec::compress(const uint8_t *src, size_t len, uint8_t *dst,
+                          size_t cap) {
+  // extState每次调用时自己做快速重置，不重新分配
+  int n = LZ4_compress_fast_extState(state, (const char *)src, (char *)dst,
+                                     (int)len, (int)cap, 1);
+  return n > 0 ? n : 0;
+}
+
+int Lz4Codec::decompress(const uint8_t *src, size_t len, uint8_t *dst,
+                         size_t cap) {
+  int n = LZ4_decompress_safe((const char *)src, (char *)dst, (int)len,
+                              (int)cap);
+  return n >= 0 ? n : -1;
+}
+#else
+#define HASH_LOG 12
+#define MIN_MATCH 4
+#define LAST_LITERALS 5  // 块末尾至少这么多字节是字面量
+#define MF_LIMIT 12      // 最后一个匹配至少在块末尾这么多字节之前开始
+#define MAX_DISTANCE 65535
+
+static inline uint32_t read32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint32_t hash4(uint32_t v) {
+  return (v * 2654435761U) >> (32 - HASH_LOG);
+}
+
+// 长度字段超过15的部分：若干个255再加余数
+static inline uint8_t *writeLength(uint8_t *op, size_t n) {
+  for (; n >= 255; n -= 255) *op++ = 255;
+  *op++ = (uint8_t)n;
+  return op;
+}
+
+Lz4Codec::Lz4Codec() : state(malloc(sizeof(uint32_t) << HASH_LOG)) {}
+
+Lz4Codec::~Lz4Codec() { free(state); }
+
+size_t Lz4Codec::compress(const uint8_t *src, size_t len, uint8_t *dst,
+                          size_t cap) {
+  uint32_t *table = (uint32_t *)state;
+  memset(table, 0, sizeof(uint32_t) << HASH_LOG);
+  const uint8_t *ip = src, *anchor = src, *end = src + len;
+  uint8_t *op = dst, *oend = dst + cap;
+
+  if (len > MF_LIMIT) {
+    const uint8_t *mflimit = end - MF_LIMIT;
+    const uint8_t *matchlimit = end - LAST_LITERALS;
+    ip++;
+    while (ip < mflimit) {
+      uint32_t seq = read32(ip);
+      uint32_t h = hash4(seq);
+      const uint8_t *ref = src + table[h];
+      table[h] = (uint32_t)(ip - src);
+      if (ref >= ip || ip - ref > MAX_DISTANCE || read32(ref) != seq) {
+        // 连续找不到匹配时加大步长，不可压缩的数据很快扫过去
+        ip += 1 + ((ip - anchor) >> 6);
+        continue;
+      }
+      while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+        ip--;
+        ref--;
+      }
+      const uint8_t *mp = ip + MIN_MATCH, *rp = ref + MIN_MATCH;
+      while (mp < matchlimit && *mp == *rp) {
+        mp++;
+        rp++;
+      }
+
+      size_t lit = ip - anchor, mlen = mp - ip - MIN_MATCH;
+      if ((size_t)(oend - op) < 1 + lit / 255 + 1 + lit + 2 + mlen / 255 + 1) {
+        return 0;
+      }
+      uint8_t *token = op++;
+      *token = (uint8_t)((lit < 15 ? lit : 15) << 4);
+      if (lit >= 15) op = writeLength(op, lit - 15);
+      memcpy(op, anchor, lit);
+      op += lit;
+      uint32_t offset = (uint32_t)(ip - ref);
+      *op++ = (uint8_t)offset;
+      *op++ = (uint8_t)(offset >> 8);
+      *token |= (uint8_t)(mlen < 15 ? mlen : 15);
+      if (mlen >= 15) op = writeLength(op, mlen - 15);
+
+      ip = anchor = mp;
+      // 匹配末尾前两字节也进表，下一个匹配常从这里开始
+      if (ip - 2 > src && ip < mflimit) {
+        table[hash4(read32(ip - 2))] = (uint32_t)(ip - 2 - src);
+      }
+    }
+  }
+
+  size_t lit = end - anchor;
+  if ((size_t)(oend - op) < 1 + lit / 255 + 1 + lit) return 0;
+  *op++ = (uint8_t)((lit < 15 ? lit : 15) << 4);
+  if (lit >= 15) op = writeLength(op, lit - 15);
+  memcpy(op, anchor, lit);
+  op += lit;
+  return op - dst;
+}
+
+int Lz4Codec::decompress(const uint8_t *src, size_t len, uint8_t *dst,
+                         size_t cap) {
+  const uint8_t *ip = src, *iend = src + len;
+  uint8_t *op = dst, *oend = dst + cap;
+  for (;;) {
+    if (ip >= iend) return -1;
+    uint8_t token = *ip++;
+    size_t lit = token >> 4;
+    if (lit == 15) {
+      uint8_t b;
+      do {
+        if (ip >= iend) return -1;
+        b = *ip++;
+        lit += b;
+      } while (b == 255);
+    }
+    if ((size_t)(iend - ip) < lit || (size_t)(oend - op) < lit) return -1;
+    memcpy(op, ip, lit);
+    op += lit;
+    ip += lit;
+    if (ip == iend) break;  // 最后一段只有字面量
+
+    if (iend - ip < 2) return -1;
+    size_t offset = ip[0] | ip[1] << 8;
+    ip += 2;
+    if (offset == 0 || offset > (size_t)(op - dst)) return -1;
+    size_t mlen = token & 15;
+    if (mlen == 15) {
+      uint8_t b;
+      do {
+        if (ip >= iend) return -1;
+        b = *ip++;
+        mlen += b;
+      } while (b == 255);
+    }
+    mlen += MIN_MATCH;
+    if ((size_t)(oend - op) < mlen) return -1;
+    const uint8_t *m = op - offset;
+    if (offset >= mlen) {
+      memcpy(op, m, mlen);
+    } else {
+      for (size_t i = 0; i < mlen; i++) op[i] = m[i];  // 重叠时逐字节复制
+    }
+    op += mlen;
+  }
+  return (int)(op - dst);
+}
+#endif
@@ -0,0 +1,33 @@
+#ifndef LZ4_CODEC_H
+#define LZ4_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// LZ4块格式压缩，和liblz4的LZ4_compress_default/LZ4_decompress_safe互通。
+// 有liblz4（HAVE_LZ4）时调用库，否则用这里的实现（单哈希表、贪心匹配）。
+// 压缩状态在构造时分配一次，之后每块只清零哈希表，数据路径上不分配内存。
+
+#define LZ4_BLOCK_BOUND(n) ((n) + (n) / 255 + 16)  // 最坏情况的压缩长度
+
+class Lz4Codec {
+ public:
+  Lz4Codec();
+  ~Lz4Codec();
+
+  bool ok(void) const { return state != nullptr; }
+
+  // 返回压缩后的长度；结果放不进cap时返回0（调用者可以原样发送）
+  size_t compress(const uint8_t *src, size_t len, uint8_t *dst, size_t cap);
+  // 返回解压出的字节数；输入损坏或超出cap时返回-1
+  static int decompress(const uint8_t *src, size_t len, uint8_t *dst,
+                        size_t cap);
+
+ private:
+  void *state;  // liblz4的LZ4_stream_t，或哈希表
+
+  Lz4Codec(const Lz4Codec &);
+  Lz4Codec &operator=(const Lz4Codec &);
+};
+
+#endif  // LZ4_CODEC_H
@@ -0,0 +1,465 @@
+#include "mirror.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "stats.h"
+
+// ========== 编码 ==========
+static inline int logicalWidth(uint8_t rotation) {
+  return rotation & 1 ? OLED_MAX_ROW : OLED_MAX_COLUMN;
+}
+
+size_t mirrorEncode(const uint8_t *frame, const uint8_t *shown,
+                    uint8_t rotation, uint32_t seq, uint8_t *out) {
+  int w = logicalWidth(rotation);
+  int pages = FRAME_BYTES / w;
+  uint8_t *p = out + sizeof(MirrorHeader);
+  uint8_t nspans = 0;
+  for (int page = 0; page < pages; page++) {
+    const uint8_t *a = frame + page * w, *b = shown + page * w;
+    int lo = 0, hi = w - 1;
+    while (lo < w && a[lo] == b[lo]) lo++;
+    if (lo == w) continue;
+    while (a[hi] == b[hi]) hi--;
+
+    uint8_t x[OLED_MAX_COLUMN];
+    int n = hi - lo + 1;
+    for (int c = 0; c < n; c++) x[c] = a[lo + c] ^ b[lo + c];
+    MirrorSpan span;
+    span.page = (uint8_t)page;
+    span.col = (uint8_t)lo;
+    span.ncols = (uint8_t)n;
+    span.reserved = 0;
+    span.rle_len = (uint16_t)frameRleEncode(x, n, p + sizeof(span));
+    memcpy(p, &span, sizeof(span));
+    p += sizeof(span) + span.rle_len;
+    nspans++;
+  }
+  MirrorHeader hdr;
+  hdr.magic = MIRROR_MAGIC;
+  hdr.seq = seq;
+  hdr.rotation = rotation;
+  hdr.nspans = nspans;
+  hdr.len = (uint16_t)(p - out - sizeof(hdr));
+  memcpy(out, &hdr, sizeof(hdr));
+  return p - out;
+}
+
+bool mirrorApply(uint8_t *frame, const MirrorHeader &hdr, const uint8_t *body) {
+  int w = logicalWidth(hdr.rotation);
+  size_t off = 0;
+  for (int i = 0; i < hdr.nspans; i++) {
+    MirrorSpan span;
+    if (hdr.len - off < sizeof(span)) return false;
+    memcpy(&span, body + off, sizeof(span));
+    off += sizeof(span);
+    if (span.page >= FRAME_BYTES / w || span.ncols == 0 ||
+        span.col + span.ncols > w || hdr.len - off < span.rle_len) {
+      return false;
+    }
+    uint8_t x[OLED_MAX_COLUMN];
+    if (frameRleDecode(body + off, span.rle_len, x, span.ncols) !=
+        span.ncols) {
+      return false;
+    }
+    uint8_t *dst = frame + span.page * w + span.col;
+    for (int c = 0; c < span.ncols; c++) dst[c] ^= x[c];
+    off += span.rle_len;
+  }
+  return off == hdr.len;
+}
+
+// ========== 服务端 ==========
+// 事件来源编码：查看器序号 << 2 | 类型
+enum {
+  EVENT_LISTEN,
+  EVENT_FRAME,
+  EVENT_CLIENT,
+};
+#define EVENT_STOP UINT64_MAX
+
+MirrorServer::MirrorServer(uint16_t port, int max_clients,
+                           uint16_t default_fps)
+    : listen_port(port),
+      default_fps(default_fps ? default_fps : MIRROR_DEFAULT_FPS),
+      listen_fd(-1),
+      epoll_fd(-1),
+      event_fd(-1),
+      stop_fd(-1),
+      clients(max_clients, nullptr),
+      nclients(0),
+      started(false),
+      latest_rotation(0),
+      latest_seq(0),
+      signaled(false),
+      current_rotation(0),
+      current_seq(0),
+      published(0),
+      messages(0),
+      coalesced(0),
+      bytes(0),
+      stalls(0) {
+  memset(latest, 0, sizeof(latest));
+  memset(current, 0, sizeof(current));
+}
+
+MirrorServer::~MirrorServer() {
+  stop();
+  for (size_t i = 0; i < clients.size(); i++) dropClient(i);
+  if (listen_fd >= 0) close(listen_fd);
+  if (event_fd >= 0) close(event_fd);
+  if (stop_fd >= 0) close(stop_fd);
+  if (epoll_fd >= 0) close(epoll_fd);
+}
+
+bool MirrorServer::start(void) {
+  listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (listen_fd < 0 || event_fd < 0 || stop_fd < 0 || epoll_fd < 0) {
+    perror("mirror");
+    return false;
+  }
+  int one = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_ANY);
+  sa.sin_port = htons(listen_port);
+  socklen_t len = sizeof(sa);
+  if (bind(listen_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+      listen(listen_fd, 4) < 0 ||
+      getsockname(listen_fd, (struct sockaddr *)&sa, &len) < 0) {
+    perror("mirror listen");
+    return false;
+  }
+  listen_port = ntohs(sa.sin_port);
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u64 = EVENT_STOP;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &ev);
+  ev.data.u64 = EVENT_LISTEN;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+  ev.data.u64 = EVENT_FRAME;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, event_fd, &ev);
+
+  loop = std::thread(&MirrorServer::run, this);
+  started = true;
+  return true;
+}
+
+void MirrorServer::stop(void) {
+  if (!started) return;
+  uint64_t one = 1;
+  if (write(stop_fd, &one, sizeof(one)) < 0) perror("mirror stop");
+  loop.join();
+  started = false;
+}
+
+MirrorServer::Counters MirrorServer::counters(void) const {
+  Counters out;
+  out.published = published.load(std::memory_order_relaxed);
+  out.messages = messages.load(std::memory_order_relaxed);
+  out.coalesced = coalesced.load(std::memory_order_relaxed);
+  out.bytes = bytes.load(std::memory_order_relaxed);
+  out.stalls = stalls.load(std::memory_order_relaxed);
+  return out;
+}
+
+void MirrorServer::publish(const uint8_t *frame, uint8_t rotation) {
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    memcpy(latest, frame, FRAME_BYTES);
+    latest_rotation = rotation;
+    latest_seq++;
+  }
+  published.fetch_add(1, std::memory_order_relaxed);
+  // 没有查看器时不唤醒；新查看器连接时服务线程自己取最新帧
+  if (nclients.load(std::memory_order_relaxed) == 0) return;
+  if (!signaled.exchange(true)) {
+    uint64_t one = 1;
+    if (write(event_fd, &one, sizeof(one)) < 0) perror("mirror");
+  }
+}
+
+void MirrorServer::accept(void) {
+  int fd = ::accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (fd < 0) return;
+  size_t i = 0;
+  while (i < clients.size() && clients[i]) i++;
+  if (i == clients.size()) {
+    close(fd);
+    return;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  Client *c = new Client;
+  c->fd = fd;
+  c->ready = false;
+  c->hello_len = 0;
+  c->interval_us = 1000000 / default_fps;
+  c->byte_rate = 0;
+  c->tokens = 0;
+  c->refill_us = c->last_send_us = 0;
+  c->blocked = false;
+  c->seq = 0;
+  c->out_len = c->out_off = 0;
+  memset(c->shown, 0, sizeof(c->shown));
+  clients[i] = c;
+  nclients++;
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u64 = i << 2 | EVENT_CLIENT;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+
+  // 之前没有查看器时publish()不唤醒，这里补取一次
+  std::lock_guard<std::mutex> guard(lock);
+  memcpy(current, latest, FRAME_BYTES);
+  current_rotation = latest_rotation;
+  current_seq = latest_seq;
+}
+
+void MirrorServer::dropClient(size_t i) {
+  Client *c = clients[i];
+  if (!c) return;
+  close(c->fd);
+  delete c;
+  clients[i] = nullptr;
+  nclients--;
+}
+
+void MirrorServer::readClient(size_t i) {
+  Client *c = clients[i];
+  uint8_t buf[64];
+  for (;;) {
+    ssize_t r = read(c->fd, buf, sizeof(buf));
+    if (r == 0 || (r < 0 && errno != EAGAIN && errno != EINTR)) {
+      dropClient(i);
+      return;
+    }
+    if (r < 0) {
+      if (errno == EAGAIN) return;
+      continue;
+    }
+    if (c->ready) continue;  // 握手之后查看器不再发送，多余的数据丢弃
+    size_t k = sizeof(c->hello) - c->hello_len;
+    if ((size_t)r < k) k = r;
+    memcpy(c->hello + c->hello_len, buf, k);
+    c->hello_len += k;
+    if (c->hello_len < sizeof(c->hello)) continue;
+
+    MirrorHello hello;
+    memcpy(&hello, c->hello, sizeof(hello));
+    if (hello.magic != MIRROR_MAGIC) {
+      dropClient(i);
+      return;
+    }
+    c->ready = true;
+    if (hello.max_fps) c->interval_us = 1000000 / hello.max_fps;
+    c->byte_rate = hello.max_bytes_per_sec;
+    c->tokens = c->byte_rate;
+    c->refill_us = monotonicUs();
+  }
+}
+
+bool MirrorServer::flush(size_t i) {
+  Client *c = clients[i];
+  while (c->out_off < c->out_len) {
+    ssize_t w = write(c->fd, c->out + c->out_off, c->out_len - c->out_off);
+    if (w > 0) {
+      c->out_off += w;
+      continue;
+    }
+    if (w < 0 && errno == EINTR) continue;
+    if (w < 0 && errno == EAGAIN) {
+      if (!c->blocked) {
+        stalls.fetch_add(1, std::memory_order_relaxed);
+        c->blocked = true;
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLOUT;
+        ev.data.u64 = i << 2 | EVENT_CLIENT;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+      }
+      return true;
+    }
+    dropClient(i);
+    return false;
+  }
+  c->out_len = c->out_off = 0;
+  if (c->blocked) {
+    c->blocked = false;
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u64 = i << 2 | EVENT_CLIENT;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+  }
+  return true;
+}
+
+int64_t MirrorServer::service(size_t i, uint64_t now) {
+  Client *c = clients[i];
+  // 上一条还没写完时等EPOLLOUT，期间的新帧在写完后合并成一条
+  if (!c->ready || c->out_len || c->seq == current_seq) return -1;
+
+  uint64_t due = c->last_send_us + c->interval_us;
+  if (c->last_send_us && now < due) return due - now;
+  if (c->byte_rate) {
+    int64_t cap = c->byte_rate > MIRROR_MSG_MAX ? c->byte_rate : MIRROR_MSG_MAX;
+    c->tokens += (int64_t)((now - c->refill_us) * c->byte_rate / 1000000);
+    if (c->tokens > cap) c->tokens = cap;
+    c->refill_us = now;
+    if (c->tokens < 0) return -c->tokens * 1000000 / c->byte_rate + 1;
+  }
+
+  if (c->seq && current_seq - c->seq > 1) {
+    coalesced.fetch_add(current_seq - c->seq - 1, std::memory_order_relaxed);
+  }
+  c->out_len = mirrorEncode(current, c->shown, current_rotation, current_seq,
+                            c->out);
+  c->out_off = 0;
+  memcpy(c->shown, current, FRAME_BYTES);
+  c->seq = current_seq;
+  c->last_send_us = now;
+  c->tokens -= c->out_len;
+  messages.fetch_add(1, std::memory_order_relaxed);
+  bytes.fetch_add(c->out_len, std::memory_order_relaxed);
+  statsRecord(STAT_MIRROR, c->out_len, c->out_len);
+  flush(i);
+  return -1;
+}
+
+void MirrorServer::run(void) {
+  struct epoll_event events[16];
+  int timeout_ms = -1;
+  for (;;) {
+    int n = epoll_wait(epoll_fd, events, 16, timeout_ms);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      perror("mirror epoll_wait");
+      return;
+    }
+    for (int k = 0; k < n; k++) {
+      uint64_t tag = events[k].data.u64;
+      if (tag == EVENT_STOP) return;
+      size_t i = tag >> 2;
+      switch (tag & 3) {
+        case EVENT_LISTEN:
+          accept();
+          break;
+        case EVENT_FRAME: {
+          // 先清标志再取帧：取帧之后的publish()会再次唤醒
+          signaled.store(false);
+          uint64_t count;
+          if (read(event_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+            perror("mirror");
+          }
+          std::lock_guard<std::mutex> guard(lock);
+          memcpy(current, latest, FRAME_BYTES);
+          current_rotation = latest_rotation;
+          current_seq = latest_seq;
+          break;
+        }
+        case EVENT_CLIENT:
+          if (!clients[i]) break;
+          if (events[k].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            readClient(i);
+          }
+          if (clients[i] && (events[k].events & EPOLLOUT)) flush(i);
+          break;
+      }
+    }
+
+    // 每轮检查所有查看器：有新帧且限速允许时发送，否则算出下次唤醒时间
+    uint64_t now = monotonicUs();
+    int64_t wait_us = -1;
+    for (size_t i = 0; i < clients.size(); i++) {
+      if (!clients[i]) continue;
+      int64_t w = service(i, now);
+      if (w >= 0 && (wait_us < 0 || w < wait_us)) wait_us = w;
+    }
+    timeout_ms = wait_us < 0 ? -1 : (int)((wait_us + 999) / 1000);
+  }
+}
+
+// ========== 查看器 ==========
+MirrorViewer::MirrorViewer()
+    : sock(-1), rot(0), last_seq(0), n_messages(0), n_skipped(0), n_bytes(0) {
+  memset(screen, 0, sizeof(screen));
+}
+
+MirrorViewer::~MirrorViewer() { close(); }
+
+bool MirrorViewer::connect(const char *host, uint16_t port, uint16_t max_fps,
+                           uint32_t max_bytes_per_sec) {
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_port = htons(port);
+  if (inet_pton(AF_INET, host, &sa.sin_addr) != 1) {
+    fprintf(stderr, "bad mirror host: %s\n", host);
+    return false;
+  }
+  sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sock < 0 || ::connect(sock, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+    perror("mirror connect");
+    close();
+    return false;
+  }
+  MirrorHello hello;
+  hello.magic = MIRROR_MAGIC;
+  hello.max_fps = max_fps;
+  hello.reserved = 0;
+  hello.max_bytes_per_sec = max_bytes_per_sec;
+  if (write(sock, &hello, sizeof(hello)) != (ssize_t)sizeof(hello)) {
+    perror("mirror hello");
+    close();
+    return false;
+  }
+  return true;
+}
+
+void MirrorViewer::close(void) {
+  if (sock >= 0) ::close(sock);
+  sock = -1;
+}
+
+static bool readFull(int fd, void *buf, size_t len) {
+  uint8_t *p = (uint8_t *)buf;
+  while (len) {
+    ssize_t r = read(fd, p, len);
+    if (r < 0 && errno == EINTR) continue;
+    if (r <= 0) return false;
+    p += r;
+    len -= r;
+  }
+  return true;
+}
+
+bool MirrorViewer::receive(void) {
+  MirrorHeader hdr;
+  if (!readFull(sock, &hdr, sizeof(hdr)) || hdr.magic != MIRROR_MAGIC ||
+      hdr.len > sizeof(body) || !readFull(sock, body, hdr.len) ||
+      !mirrorApply(screen, hdr, body)) {
+    return false;
+  }
+  if (last_seq && hdr.seq > last_seq + 1) n_skipped += hdr.seq - last_seq - 1;
+  last_seq = hdr.seq;
+  rot = hdr.rotation;
+  n_messages++;
+  n_bytes += sizeof(hdr) + hdr.len;
+  return true;
+}
@@ -0,0 +1,177 @@
+#ifndef MIRROR_H
+#define MIRROR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "frame_codec.h"
+
+// 帧镜像：把上传到屏幕的帧经TCP推给远程查看器（装在机柜里看不到屏幕时用）。
+// OLED上传完一帧后（refresh/present/逐页刷新的最后一页）调用publish()，
+// 只把逻辑帧拷进最新帧槽并唤醒服务线程，不编码、不碰套接字；
+// 没有查看器时只拷贝，不唤醒。
+// 服务线程为每个查看器保留它已有的帧，按页比较后只发变化的列区间，
+// 每段是新旧内容异或后的RLE（frame_codec）。查看器读得慢时不排队：
+// 上一条消息没写完不编码新帧，写完后直接发到最新帧的增量，中间的帧合并掉。
+//
+// 协议：查看器连接后先发MirrorHello，之后服务端只发消息：
+//   MirrorHeader + nspans个(MirrorSpan + rle_len字节RLE)
+// 第一条消息相对全0帧编码，即关键帧。页和列按消息里rotation对应的逻辑
+// 画布计（0°/180°为8页x128列，90°/270°为16页x64列）。
+
+#define MIRROR_PORT 19040
+#define MIRROR_MAGIC 0x524D4C4F  // "OLMR"
+#define MIRROR_DEFAULT_FPS 20
+#define MIRROR_MAX_PAGES (OLED_MAX_COLUMN / 8)
+
+struct MirrorHello {
+  uint32_t magic;
+  uint16_t max_fps;            // 0为服务端默认
+  uint16_t reserved;
+  uint32_t max_bytes_per_sec;  // 0为不限
+};
+
+struct MirrorHeader {
+  uint32_t magic;
+  uint32_t seq;  // publish()序号，跳号表示中间的帧被合并
+  uint8_t rotation;
+  uint8_t nspans;
+  uint16_t len;  // 之后的字节数
+};
+
+struct MirrorSpan {
+  uint8_t page;
+  uint8_t col;    // 起始列
+  uint8_t ncols;  // 列数（1~128）
+  uint8_t reserved;
+  uint16_t rle_len;
+};
+
+// 每页最多一段，每段最多一整行（未旋转时128列）的RLE
+#define MIRROR_MSG_MAX          \
+  (sizeof(MirrorHeader) +       \
+   MIRROR_MAX_PAGES * (sizeof(MirrorSpan) + FRAME_RLE_BOUND(OLED_MAX_COLUMN)))
+
+// 把frame相对shown的变化编码成一条消息，返回长度；没有变化时只有消息头
+size_t mirrorEncode(const uint8_t *frame, const uint8_t *shown,
+                    uint8_t rotation, uint32_t seq, uint8_t *out);
+// 消息体（消息头之后的部分）应用到frame，格式错误时返回false
+bool mirrorApply(uint8_t *frame, const MirrorHeader &hdr, const uint8_t *body);
+
+class MirrorServer {
+ public:
+  struct Counters {
+    uint64_t published;  // publish()次数
+    uint64_t messages;   // 发出的消息
+    uint64_t coalesced;  // 因查看器慢或限速被合并掉的帧
+    uint64_t bytes;      // 发出的字节
+    uint64_t stalls;     // 套接字写满的次数
+  };
+
+  // port为0时由内核分配，start()后用port()查询
+  explicit MirrorServer(uint16_t port = MIRROR_PORT, int max_clients = 4,
+                        uint16_t default_fps = MIRROR_DEFAULT_FPS);
+  ~MirrorServer();
+
+  bool start(void);
+  void stop(void);
+  uint16_t port(void) const { return listen_port; }
+
+  // 任意线程调用；frame为逻辑帧（FRAME_BYTES字节）
+  void publish(const uint8_t *frame, uint8_t rotation);
+
+  int clientCount(void) const { return nclients.load(); }
+  Counters counters(void) const;
+
+ private:
+  struct Client {
+    int fd;
+    bool ready;  // 已收到MirrorHello
+    uint8_t hello[sizeof(MirrorHello)];
+    size_t hello_len;
+    uint32_t interval_us;  // 最小发送间隔
+    uint32_t byte_rate;    // 0为不限
+    int64_t tokens;        // 字节令牌，可以为负（透支到下一次）
+    uint64_t refill_us;
+    uint64_t last_send_us;
+    bool blocked;  // 套接字写满，等待EPOLLOUT
+    uint32_t seq;  // 查看器已有的帧
+    alignas(8) uint8_t shown[FRAME_BYTES];
+    uint8_t out[MIRROR_MSG_MAX];
+    size_t out_len, out_off;
+  };
+
+  uint16_t listen_port;
+  uint16_t default_fps;
+  int listen_fd, epoll_fd, event_fd, stop_fd;
+  std::vector<Client *> clients;  // 空位为nullptr
+  std::atomic<int> nclients;
+  std::thread loop;
+  bool started;
+
+  // 最新帧槽，由lock保护；signaled为true时服务线程已被唤醒，不必再写event_fd
+  std::mutex lock;
+  alignas(8) uint8_t latest[FRAME_BYTES];
+  uint8_t latest_rotation;
+  uint32_t latest_seq;
+  std::atomic<bool> signaled;
+
+  // 服务线程的当前帧副本
+  alignas(8) uint8_t current[FRAME_BYTES];
+  uint8_t current_rotation;
+  uint32_t current_seq;
+
+  std::atomic<uint64_t> published, messages, coalesced, bytes, stalls;
+
+  void run(void);
+  void accept(void);
+  void dropClient(size_t i);
+  void readClient(size_t i);
+  bool flush(size_t i);
+  // 可以发送时编码并发送，否则返回还要等待的微秒数（-1为无需等待）
+  int64_t service(size_t i, uint64_t now);
+
+  MirrorServer(const MirrorServer &);
+  MirrorServer &operator=(const MirrorServer &);
+};
+
+// 查看器端：连接、发送MirrorHello，逐条接收并还原帧
+class MirrorViewer {
+ public:
+  MirrorViewer();
+  ~MirrorViewer();
+
+  bool connect(const char *host, uint16_t port, uint16_t max_fps = 0,
+               uint32_t max_bytes_per_sec = 0);
+  void close(void);
+  int fd(void) const { return sock; }
+
+  // 阻塞读一条消息并应用，连接断开或格式错误时返回false
+  bool receive(void);
+
+  const uint8_t *frame(void) const { return screen; }
+  uint8_t rotation(void) const { return rot; }
+  uint32_t seq(void) const { return last_seq; }
+  uint32_t messages(void) const { return n_messages; }
+  uint32_t skipped(void) const { return n_skipped; }  // 被合并的帧
+  uint64_t bytes(void) const { return n_bytes; }
+
+ private:
+  int sock;
+  alignas(8) uint8_t screen[FRAME_BYTES];
+  uint8_t body[MIRROR_MSG_MAX];
+  uint8_t rot;
+  uint32_t last_seq;
+  uint32_t n_messages, n_skipped;
+  uint64_t n_bytes;
+
+  MirrorViewer(const MirrorViewer &);
+  MirrorViewer &operator=(const MirrorViewer &);
+};
+
+#endif  // MIRROR_H
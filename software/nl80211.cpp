@@ -0,0 +1,464 @@
+#include "nl80211.h"
+
+#include <errno.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <linux/nl80211.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NL_RX_BUFFER 65536
+#define WLAN_CAPABILITY_PRIVACY 0x0010
+#define WLAN_EID_SSID 0
+#define WLAN_EID_RSN 48
+#define WLAN_EID_VENDOR 221
+#define NL_REQUEST_TIMEOUT_MS 1000  // 驱动卡住或应答丢失时不一直等
+
+// ========== 消息构造和解析 ==========
+void nlPut(std::vector<uint8_t> &msg, uint16_t type, const void *data,
+           size_t len) {
+  struct nlattr a;
+  a.nla_len = (uint16_t)(NLA_HDRLEN + len);
+  a.nla_type = type;
+  size_t at = msg.size();
+  msg.resize(at + NLA_ALIGN(a.nla_len), 0);
+  memcpy(&msg[at], &a, sizeof(a));
+  if (len) memcpy(&msg[at + NLA_HDRLEN], data, len);
+}
+
+void nlPutU32(std::vector<uint8_t> &msg, uint16_t type, uint32_t value) {
+  nlPut(msg, type, &value, sizeof(value));
+}
+
+size_t nlNestBegin(std::vector<uint8_t> &msg, uint16_t type) {
+  size_t at = msg.size();
+  nlPut(msg, type | NLA_F_NESTED, nullptr, 0);
+  return at;
+}
+
+void nlNestEnd(std::vector<uint8_t> &msg, size_t at) {
+  uint16_t len = (uint16_t)(msg.size() - at);
+  memcpy(&msg[at], &len, sizeof(len));
+}
+
+void nlParse(const uint8_t *attrs, size_t len, NlAttr *tb, int max) {
+  memset(tb, 0, sizeof(NlAttr) * (max + 1));
+  size_t off = 0;
+  while (off + NLA_HDRLEN <= len) {
+    struct nlattr a;
+    memcpy(&a, attrs + off, sizeof(a));
+    if (a.nla_len < NLA_HDRLEN || off + a.nla_len > len) break;
+    int type = a.nla_type & NLA_TYPE_MASK;
+    if (type <= max) {
+      tb[type].data = attrs + off + NLA_HDRLEN;
+      tb[type].len = a.nla_len - NLA_HDRLEN;
+    }
+    off += NLA_ALIGN(a.nla_len);
+  }
+}
+
+uint32_t nlU32(const NlAttr &a) {
+  uint32_t v = 0;
+  if (a.data && a.len >= 4) memcpy(&v, a.data, 4);
+  return v;
+}
+
+uint16_t nlU16(const NlAttr &a) {
+  uint16_t v = 0;
+  if (a.data && a.len >= 2) memcpy(&v, a.data, 2);
+  return v;
+}
+
+uint8_t nlU8(const NlAttr &a) { return a.data && a.len ? a.data[0] : 0; }
+
+std::string formatMac(const uint8_t *mac) {
+  char buf[18];
+  snprintf(buf, sizeof(buf), "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1],
+           mac[2], mac[3], mac[4], mac[5]);
+  return buf;
+}
+
+// ========== 套接字 ==========
+Nl80211::Nl80211() : sock(-1), events(-1), family(0), scan_group(0), seq(0) {}
+
+Nl80211::~Nl80211() { close(); }
+
+bool Nl80211::open(void) {
+  if (sock >= 0) return true;
+  sock = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+  if (sock < 0) {
+    perror("nl80211 socket");
+    return false;
+  }
+  // 错误确认里不带回整条请求
+  int one = 1;
+  setsockopt(sock, SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof(one));
+  rx.resize(NL_RX_BUFFER);
+  if (!resolve()) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void Nl80211::close(void) {
+  if (sock >= 0) ::close(sock);
+  if (events >= 0) ::close(events);
+  sock = events = -1;
+  family = 0;
+  scan_group = 0;
+}
+
+void Nl80211::begin(std::vector<uint8_t> &msg, uint16_t type, uint16_t flags,
+                    uint8_t cmd) {
+  msg.assign(NLMSG_HDRLEN + GENL_HDRLEN, 0);
+  struct nlmsghdr h;
+  memset(&h, 0, sizeof(h));
+  h.nlmsg_type = type;
+  h.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | flags;
+  h.nlmsg_seq = ++seq;
+  memcpy(&msg[0], &h, sizeof(h));
+  struct genlmsghdr g;
+  memset(&g, 0, sizeof(g));
+  g.cmd = cmd;
+  g.version = 1;
+  memcpy(&msg[NLMSG_HDRLEN], &g, sizeof(g));
+}
+
+static uint64_t nowMs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int Nl80211::request(const std::vector<uint8_t> &msg, Handler handler,
+                     void *ctx) {
+  std::vector<uint8_t> out(msg);
+  uint32_t len = out.size();
+  memcpy(&out[0], &len, sizeof(len));  // nlmsg_len
+  uint32_t want = seq;
+  if (send(sock, &out[0], out.size(), 0) < 0) return -errno;
+
+  uint64_t deadline = nowMs() + NL_REQUEST_TIMEOUT_MS;
+  for (;;) {
+    uint64_t now = nowMs();
+    if (now >= deadline) return -ETIMEDOUT;
+    struct pollfd p = {sock, POLLIN, 0};
+    int r = poll(&p, 1, (int)(deadline - now));
+    if (r < 0 && errno != EINTR) return -errno;
+    if (r <= 0) continue;
+    ssize_t n = recv(sock, &rx[0], rx.size(), MSG_DONTWAIT);
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN) continue;
+      return -errno;
+    }
+    size_t off = 0;
+    while (off + NLMSG_HDRLEN <= (size_t)n) {
+      struct nlmsghdr h;
+      memcpy(&h, &rx[off], sizeof(h));
+      if (h.nlmsg_len < NLMSG_HDRLEN || off + h.nlmsg_len > (size_t)n) break;
+      const uint8_t *payload = &rx[off + NLMSG_HDRLEN];
+      size_t plen = h.nlmsg_len - NLMSG_HDRLEN;
+      off += NLMSG_ALIGN(h.nlmsg_len);
+      if (h.nlmsg_seq != want) continue;  // 之前超时请求的迟到应答
+
+      // 转储以NLMSG_DONE结束（负载为转储的结果），其他请求以确认结束
+      if (h.nlmsg_type == NLMSG_DONE || h.nlmsg_type == NLMSG_ERROR) {
+        int err = 0;
+        if (plen >= sizeof(err)) memcpy(&err, payload, sizeof(err));
+        return err;
+      }
+      if (plen >= GENL_HDRLEN && handler) {
+        handler(payload + GENL_HDRLEN, plen - GENL_HDRLEN, ctx);
+      }
+    }
+  }
+}
+
+// 控制器应答：族号和"scan"多播组号
+struct FamilyQuery {
+  uint16_t family;
+  uint32_t scan_group;
+};
+
+static void onFamily(const uint8_t *attrs, size_t len, void *ctx) {
+  FamilyQuery *q = (FamilyQuery *)ctx;
+  NlAttr tb[CTRL_ATTR_MAX + 1];
+  nlParse(attrs, len, tb, CTRL_ATTR_MAX);
+  if (tb[CTRL_ATTR_FAMILY_ID].data) q->family = nlU16(tb[CTRL_ATTR_FAMILY_ID]);
+  nlEach(tb[CTRL_ATTR_MCAST_GROUPS], [q](const NlAttr &g) {
+    NlAttr grp[CTRL_ATTR_MCAST_GRP_MAX + 1];
+    nlParse(g.data, g.len, grp, CTRL_ATTR_MCAST_GRP_MAX);
+    const NlAttr &name = grp[CTRL_ATTR_MCAST_GRP_NAME];
+    if (name.data && name.len >= 5 && memcmp(name.data, "scan", 5) == 0) {
+      q->scan_group = nlU32(grp[CTRL_ATTR_MCAST_GRP_ID]);
+    }
+  });
+}
+
+bool Nl80211::resolve(void) {
+  std::vector<uint8_t> msg;
+  begin(msg, GENL_ID_CTRL, 0, CTRL_CMD_GETFAMILY);
+  nlPut(msg, CTRL_ATTR_FAMILY_NAME, NL80211_GENL_NAME,
+        sizeof(NL80211_GENL_NAME));
+  FamilyQuery q = {0, 0};
+  int err = request(msg, onFamily, &q);
+  if (err < 0 || !q.family) {
+    fprintf(stderr, "nl80211 not available: %s\n", strerror(-err));
+    return false;
+  }
+  family = q.family;
+  scan_group = q.scan_group;
+  return true;
+}
+
+// 扫描完成事件走单独的套接字，避免和请求的应答混在一起
+bool Nl80211::subscribeScan(void) {
+  if (events >= 0) return true;
+  if (!scan_group) {
+    fprintf(stderr, "nl80211: no scan multicast group\n");
+    return false;
+  }
+  events = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+  if (events < 0) {
+    perror("nl80211 event socket");
+    return false;
+  }
+  // 必须bind：未绑定的套接字portid为0，收不到nl80211以portid 0发出的多播
+  struct sockaddr_nl addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.nl_family = AF_NETLINK;
+  addr.nl_pid = 0;  // 由内核分配
+  if (bind(events, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    perror("nl80211 event bind");
+    ::close(events);
+    events = -1;
+    return false;
+  }
+  if (setsockopt(events, SOL_NETLINK, NETLINK_ADD_MEMBERSHIP, &scan_group,
+                 sizeof(scan_group)) < 0) {
+    perror("nl80211 scan group");
+    ::close(events);
+    events = -1;
+    return false;
+  }
+  return true;
+}
+
+// ========== 站点信息 ==========
+struct StationQuery {
+  Nl80211Station *out;
+  bool found;
+};
+
+static void onStation(const uint8_t *attrs, size_t len, void *ctx) {
+  StationQuery *q = (StationQuery *)ctx;
+  if (q->found) return;
+  NlAttr tb[NL80211_ATTR_MAX + 1];
+  nlParse(attrs, len, tb, NL80211_ATTR_MAX);
+  if (!tb[NL80211_ATTR_STA_INFO].data) return;
+  NlAttr sta[NL80211_STA_INFO_MAX + 1];
+  nlParse(tb[NL80211_ATTR_STA_INFO].data, tb[NL80211_ATTR_STA_INFO].len, sta,
+          NL80211_STA_INFO_MAX);
+
+  Nl80211Station &s = *q->out;
+  if (tb[NL80211_ATTR_MAC].len == 6) {
+    s.bssid = formatMac(tb[NL80211_ATTR_MAC].data);
+  }
+  if (sta[NL80211_STA_INFO_SIGNAL].data) {
+    s.signal_dbm = (int8_t)nlU8(sta[NL80211_STA_INFO_SIGNAL]);
+  }
+  if (sta[NL80211_STA_INFO_TX_BITRATE].data) {
+    NlAttr rate[NL80211_RATE_INFO_MAX + 1];
+    nlParse(sta[NL80211_STA_INFO_TX_BITRATE].data,
+            sta[NL80211_STA_INFO_TX_BITRATE].len, rate, NL80211_RATE_INFO_MAX);
+    // 单位100kbit/s；新内核用32位，旧内核只有16位
+    uint32_t r = rate[NL80211_RATE_INFO_BITRATE32].data
+                     ? nlU32(rate[NL80211_RATE_INFO_BITRATE32])
+                     : nlU16(rate[NL80211_RATE_INFO_BITRATE]);
+    s.bitrate_kbps = r * 100;
+  }
+  s.has_retries = sta[NL80211_STA_INFO_TX_RETRIES].data &&
+                  sta[NL80211_STA_INFO_TX_FAILED].data;
+  s.tx_retries = nlU32(sta[NL80211_STA_INFO_TX_RETRIES]);
+  s.tx_failed = nlU32(sta[NL80211_STA_INFO_TX_FAILED]);
+  q->found = true;
+}
+
+bool Nl80211::getStation(int ifindex, Nl80211Station &out) {
+  if (!open()) return false;
+  out = Nl80211Station();
+  std::vector<uint8_t> msg;
+  begin(msg, family, NLM_F_DUMP, NL80211_CMD_GET_STATION);
+  nlPutU32(msg, NL80211_ATTR_IFINDEX, ifindex);
+  StationQuery q = {&out, false};
+  return request(msg, onStation, &q) == 0 && q.found;
+}
+
+// ========== 接口和信道 ==========
+static void onInterface(const uint8_t *attrs, size_t len, void *ctx) {
+  NlAttr tb[NL80211_ATTR_MAX + 1];
+  nlParse(attrs, len, tb, NL80211_ATTR_MAX);
+  const NlAttr &name = tb[NL80211_ATTR_IFNAME];
+  if (!name.data || !tb[NL80211_ATTR_IFTYPE].data) return;
+  if (nlU32(tb[NL80211_ATTR_IFTYPE]) != NL80211_IFTYPE_STATION) return;
+  const char *s = (const char *)name.data;
+  ((std::vector<std::string> *)ctx)->push_back(
+      std::string(s, strnlen(s, name.len)));
+}
+
+bool Nl80211::interfaces(std::vector<std::string> &names) {
+  names.clear();
+  if (!open()) return false;
+  std::vector<uint8_t> msg;
+  begin(msg, family, NLM_F_DUMP, NL80211_CMD_GET_INTERFACE);
+  return request(msg, onInterface, &names) == 0;
+}
+
+static void onWiphy(const uint8_t *attrs, size_t len, void *ctx) {
+  std::vector<uint32_t> *freqs = (std::vector<uint32_t> *)ctx;
+  NlAttr tb[NL80211_ATTR_MAX + 1];
+  nlParse(attrs, len, tb, NL80211_ATTR_MAX);
+  // 分片转储时频段信息分散在多条消息里，每条都可能带一部分
+  nlEach(tb[NL80211_ATTR_WIPHY_BANDS], [freqs](const NlAttr &b) {
+    NlAttr band[NL80211_BAND_ATTR_MAX + 1];
+    nlParse(b.data, b.len, band, NL80211_BAND_ATTR_MAX);
+    nlEach(band[NL80211_BAND_ATTR_FREQS], [freqs](const NlAttr &f) {
+      NlAttr fa[NL80211_FREQUENCY_ATTR_MAX + 1];
+      nlParse(f.data, f.len, fa, NL80211_FREQUENCY_ATTR_MAX);
+      if (!fa[NL80211_FREQUENCY_ATTR_FREQ].data) return;
+      if (fa[NL80211_FREQUENCY_ATTR_DISABLED].data) return;
+      uint32_t mhz = nlU32(fa[NL80211_FREQUENCY_ATTR_FREQ]);
+      for (size_t i = 0; i < freqs->size(); i++) {
+        if ((*freqs)[i] == mhz) return;
+      }
+      freqs->push_back(mhz);
+    });
+  });
+}
+
+bool Nl80211::supportedFreqs(int ifindex, std::vector<uint32_t> &freqs) {
+  freqs.clear();
+  if (!open()) return false;
+  std::vector<uint8_t> msg;
+  begin(msg, family, NLM_F_DUMP, NL80211_CMD_GET_WIPHY);
+  nlPutU32(msg, NL80211_ATTR_IFINDEX, ifindex);
+  nlPut(msg, NL80211_ATTR_SPLIT_WIPHY_DUMP, nullptr, 0);
+  return request(msg, onWiphy, &freqs) == 0 && !freqs.empty();
+}
+
+// ========== 扫描 ==========
+int Nl80211::triggerScan(int ifindex, const std::vector<uint32_t> &freqs,
+                         const char *ssid) {
+  if (!open()) return -ENODEV;
+  if (!subscribeScan()) return -ENOTSUP;
+  // 丢掉之前积压的事件，waitScan只认这次触发之后的完成事件
+  while (recv(events, &rx[0], rx.size(), MSG_DONTWAIT) > 0) {
+  }
+
+  std::vector<uint8_t> msg;
+  begin(msg, family, 0, NL80211_CMD_TRIGGER_SCAN);
+  nlPutU32(msg, NL80211_ATTR_IFINDEX, ifindex);
+  // 主动探测：空SSID为通配探测请求
+  size_t at = nlNestBegin(msg, NL80211_ATTR_SCAN_SSIDS);
+  nlPut(msg, 1, ssid ? ssid : "", ssid ? strlen(ssid) : 0);
+  nlNestEnd(msg, at);
+  if (!freqs.empty()) {
+    at = nlNestBegin(msg, NL80211_ATTR_SCAN_FREQUENCIES);
+    for (size_t i = 0; i < freqs.size(); i++) {
+      nlPutU32(msg, (uint16_t)(i + 1), freqs[i]);
+    }
+    nlNestEnd(msg, at);
+  }
+  return request(msg, nullptr, nullptr);
+}
+
+bool Nl80211::waitScan(int ifindex, int timeout_ms) {
+  if (events < 0) return false;
+  uint64_t deadline = nowMs() + timeout_ms;
+  for (;;) {
+    uint64_t now = nowMs();
+    if (now >= deadline) return false;
+    struct pollfd p = {events, POLLIN, 0};
+    int r = poll(&p, 1, (int)(deadline - now));
+    if (r < 0 && errno != EINTR) return false;
+    if (r <= 0) continue;
+    ssize_t n = recv(events, &rx[0], rx.size(), 0);
+    if (n < 0) continue;
+
+    // 多播组里也有其他网卡、其他进程触发的扫描事件
+    size_t off = 0;
+    while (off + NLMSG_HDRLEN + GENL_HDRLEN <= (size_t)n) {
+      struct nlmsghdr h;
+      memcpy(&h, &rx[off], sizeof(h));
+      if (h.nlmsg_len < NLMSG_HDRLEN || off + h.nlmsg_len > (size_t)n) break;
+      size_t plen = h.nlmsg_len - NLMSG_HDRLEN;
+      const uint8_t *payload = &rx[off + NLMSG_HDRLEN];
+      off += NLMSG_ALIGN(h.nlmsg_len);
+      if (h.nlmsg_type != family || plen < GENL_HDRLEN) continue;
+      struct genlmsghdr g;
+      memcpy(&g, payload, sizeof(g));
+      if (g.cmd != NL80211_CMD_NEW_SCAN_RESULTS &&
+          g.cmd != NL80211_CMD_SCAN_ABORTED) {
+        continue;
+      }
+      NlAttr tb[NL80211_ATTR_MAX + 1];
+      nlParse(payload + GENL_HDRLEN, plen - GENL_HDRLEN, tb, NL80211_ATTR_MAX);
+      if ((int)nlU32(tb[NL80211_ATTR_IFINDEX]) != ifindex) continue;
+      return g.cmd == NL80211_CMD_NEW_SCAN_RESULTS;
+    }
+  }
+}
+
+// 从信息元素里取SSID，判断有没有RSN/WPA
+static void parseIes(const NlAttr &ies, Nl80211Bss &b) {
+  static const uint8_t wpa_oui[4] = {0x00, 0x50, 0xF2, 0x01};
+  size_t off = 0;
+  while (ies.data && off + 2 <= ies.len) {
+    uint8_t id = ies.data[off];
+    uint8_t len = ies.data[off + 1];
+    const uint8_t *v = ies.data + off + 2;
+    if (off + 2 + len > ies.len) break;
+    if (id == WLAN_EID_SSID) b.ssid.assign((const char *)v, len);
+    if (id == WLAN_EID_RSN) b.secured = true;
+    if (id == WLAN_EID_VENDOR && len >= 4 && memcmp(v, wpa_oui, 4) == 0) {
+      b.secured = true;
+    }
+    off += 2 + len;
+  }
+}
+
+static void onBss(const uint8_t *attrs, size_t len, void *ctx) {
+  NlAttr tb[NL80211_ATTR_MAX + 1];
+  nlParse(attrs, len, tb, NL80211_ATTR_MAX);
+  if (!tb[NL80211_ATTR_BSS].data) return;
+  NlAttr bss[NL80211_BSS_MAX + 1];
+  nlParse(tb[NL80211_ATTR_BSS].data, tb[NL80211_ATTR_BSS].len, bss,
+          NL80211_BSS_MAX);
+  if (bss[NL80211_BSS_BSSID].len != 6) return;
+
+  Nl80211Bss b = Nl80211Bss();
+  b.bssid = formatMac(bss[NL80211_BSS_BSSID].data);
+  b.freq_mhz = nlU32(bss[NL80211_BSS_FREQUENCY]);
+  b.has_mbm = bss[NL80211_BSS_SIGNAL_MBM].data != nullptr;
+  b.signal_mbm = (int32_t)nlU32(bss[NL80211_BSS_SIGNAL_MBM]);
+  b.signal_unspec = nlU8(bss[NL80211_BSS_SIGNAL_UNSPEC]);
+  b.secured =
+      (nlU16(bss[NL80211_BSS_CAPABILITY]) & WLAN_CAPABILITY_PRIVACY) != 0;
+  b.seen_ms_ago = nlU32(bss[NL80211_BSS_SEEN_MS_AGO]);
+  parseIes(bss[NL80211_BSS_INFORMATION_ELEMENTS], b);
+  ((std::vector<Nl80211Bss> *)ctx)->push_back(b);
+}
+
+bool Nl80211::getScan(int ifindex, std::vector<Nl80211Bss> &out) {
+  out.clear();
+  if (!open()) return false;
+  std::vector<uint8_t> msg;
+  begin(msg, family, NLM_F_DUMP, NL80211_CMD_GET_SCAN);
+  nlPutU32(msg, NL80211_ATTR_IFINDEX, ifindex);
+  return request(msg, onBss, &out) == 0;
+}
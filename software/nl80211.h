@@ -0,0 +1,122 @@
+#ifndef NL80211_CLIENT_H
+#define NL80211_CLIENT_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+// nl80211（cfg80211驱动的内核接口）的最小客户端：不依赖libnl，
+// 直接在通用netlink套接字上收发消息。每个实例有自己的套接字，
+// 不同线程各用各的实例即可并行。
+
+// 当前关联AP的站点信息（NL80211_CMD_GET_STATION）
+struct Nl80211Station {
+  std::string bssid;      // "AA:BB:CC:DD:EE:FF"
+  int signal_dbm;         // 0为未知
+  uint32_t bitrate_kbps;  // 发送速率，0为未知
+  uint32_t tx_retries;    // 累计重传次数
+  uint32_t tx_failed;     // 累计发送失败（重传次数用尽后丢弃）
+  bool has_retries;       // 驱动报告了tx_retries/tx_failed
+};
+
+// 扫描结果中的一个BSS（NL80211_CMD_GET_SCAN）
+struct Nl80211Bss {
+  std::string bssid;
+  std::string ssid;     // 原始字节，隐藏网络为空
+  uint32_t freq_mhz;
+  int signal_mbm;       // 1/100 dBm，has_mbm为false时无效
+  bool has_mbm;
+  uint8_t signal_unspec;  // 驱动不报告dBm时的0-100刻度
+  bool secured;         // 能力位Privacy或带RSN/WPA信息元素
+  uint32_t seen_ms_ago;
+};
+
+class Nl80211 {
+ public:
+  Nl80211();
+  ~Nl80211();
+
+  // 打开套接字并解析nl80211族号，失败时返回false
+  bool open(void);
+  void close(void);
+  bool isOpen(void) const { return sock >= 0; }
+
+  // ifindex上第一个站点（客户端模式下即关联的AP），未关联时返回false
+  bool getStation(int ifindex, Nl80211Station &out);
+
+  // 客户端模式（station）的无线接口名
+  bool interfaces(std::vector<std::string> &names);
+  // 网卡可用（未禁用）的信道频率
+  bool supportedFreqs(int ifindex, std::vector<uint32_t> &freqs);
+
+  // 扫描：先triggerScan（freqs为空时扫描全部信道，ssid非空时只探测该SSID），
+  // 再waitScan等这块网卡的扫描完成事件，最后getScan读取结果。
+  // triggerScan返回0或负的errno：-EBUSY为网卡正在扫描（如NM发起的），
+  // -EPERM为没有CAP_NET_ADMIN
+  int triggerScan(int ifindex, const std::vector<uint32_t> &freqs,
+                  const char *ssid);
+  // 扫描完成返回true，中止或超时返回false
+  bool waitScan(int ifindex, int timeout_ms);
+  bool getScan(int ifindex, std::vector<Nl80211Bss> &out);
+
+ protected:
+  int sock;
+  int events;  // 订阅scan多播组的套接字，第一次triggerScan时打开
+  uint16_t family;
+  uint32_t scan_group;
+  uint32_t seq;
+  std::vector<uint8_t> rx;  // 接收缓冲区（转储消息可达32KB）
+
+  // 发送一条请求，对每条应答调用handler（参数为genl头之后的属性区），
+  // 直到转储结束或收到确认。返回0或负的errno，超时返回-ETIMEDOUT
+  typedef void (*Handler)(const uint8_t *attrs, size_t len, void *ctx);
+  int request(const std::vector<uint8_t> &msg, Handler handler, void *ctx);
+  // 构造消息头；flags为NLM_F_DUMP等，自动加上NLM_F_REQUEST|NLM_F_ACK
+  void begin(std::vector<uint8_t> &msg, uint16_t type, uint16_t flags,
+             uint8_t cmd);
+  bool resolve(void);
+  bool subscribeScan(void);
+
+ private:
+  Nl80211(const Nl80211 &);
+  Nl80211 &operator=(const Nl80211 &);
+};
+
+// ========== 消息构造和解析 ==========
+// 追加属性（按4字节对齐填充）
+void nlPut(std::vector<uint8_t> &msg, uint16_t type, const void *data,
+           size_t len);
+void nlPutU32(std::vector<uint8_t> &msg, uint16_t type, uint32_t value);
+// 开始/结束嵌套属性，nlNestBegin返回属性头的位置
+size_t nlNestBegin(std::vector<uint8_t> &msg, uint16_t type);
+void nlNestEnd(std::vector<uint8_t> &msg, size_t at);
+
+// 属性区按类型索引到tb[0..max]，缺少的属性为nullptr
+struct NlAttr {
+  const uint8_t *data;
+  uint16_t len;
+};
+void nlParse(const uint8_t *attrs, size_t len, NlAttr *tb, int max);
+// 遍历属性区中的每个属性（嵌套数组），fn(NlAttr)
+template <typename F>
+void nlEach(const NlAttr &nest, F fn) {
+  size_t off = 0;
+  while (nest.data && off + 4 <= nest.len) {
+    uint16_t len;
+    memcpy(&len, nest.data + off, sizeof(len));
+    if (len < 4 || off + len > nest.len) break;
+    NlAttr a = {nest.data + off + 4, (uint16_t)(len - 4)};
+    fn(a);
+    off += (len + 3) & ~3u;
+  }
+}
+uint32_t nlU32(const NlAttr &a);
+uint16_t nlU16(const NlAttr &a);
+uint8_t nlU8(const NlAttr &a);
+
+// MAC地址格式化为"AA:BB:CC:DD:EE:FF"
+std::string formatMac(const uint8_t *mac);
+
+#endif  // NL80211_CLIENT_H
@@ -1,10 +1,21 @@
 #include "oled.h"
 
+#include "frame_recorder.h"
+#include "mirror.h"
+#include "stats.h"
+#include "text_layout.h"
+
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 // 幂函数保持不变
 uint32_t oled_pow(uint8_t m, uint8_t n) {
   uint32_t result = 1;
@@ -13,29 +24,61 @@ uint32_t oled_pow(uint8_t m, uint8_t n) {
 }
 
 OLED::OLED(uint8_t i2c_bus, uint8_t addr) {
+  this->bus = new LinuxI2CTransport(i2c_bus, addr);
+  this->owns_bus = true;
   this->addr = addr;
-  char device[20];
-  snprintf(device, sizeof(device), "/dev/i2c-%d", i2c_bus);
-  this->i2c_fd = wiringPiI2CSetupInterface(device, addr);
+  this->gram = this->frame;
+  this->scanout = this->frame;
+  this->rotation = OLED_ROTATE_0;
+  this->width = OLED_MAX_COLUMN;
+  this->height = OLED_MAX_ROW;
+  this->shadow_valid = false;
+  this->tx_bytes = 0;
+  this->recorder = nullptr;
+  this->mirror = nullptr;
 
   // 初始化GRAM为0
   clear_GRAM();
 
-  if (this->i2c_fd < 0) {
+  if (!this->bus->isOpen()) {
     printf("Error: Failed to initialize I2C on bus %d, address 0x%02X\n",
            i2c_bus, addr);
   } else {
     printf("I2C initialized successfully: fd=%d, address=0x%02X\n",
-           this->i2c_fd, addr);
+           ((LinuxI2CTransport *)this->bus)->getFd(), addr);
   }
 }
 
+OLED::OLED(I2CTransport *transport) {
+  this->bus = transport;
+  this->owns_bus = false;
+  this->addr = 0;
+  this->gram = this->frame;
+  this->scanout = this->frame;
+  this->rotation = OLED_ROTATE_0;
+  this->width = OLED_MAX_COLUMN;
+  this->height = OLED_MAX_ROW;
+  this->shadow_valid = false;
+  this->tx_bytes = 0;
+  this->recorder = nullptr;
+  this->mirror = nullptr;
+  clear_GRAM();
+}
+
+OLED::~OLED() {
+  if (owns_bus) delete bus;
+}
+
 bool OLED::init() {
-  if (this->i2c_fd < 0) {
+  if (!this->bus->isOpen()) {
     printf("I2C not initialized!\n");
     return false;
   }
 
+  // 180°与镜像直接由段重映射和COM扫描方向完成
+  bool flip_x = (rotation == OLED_ROTATE_180 || rotation == OLED_MIRROR_X);
+  bool flip_y = (rotation == OLED_ROTATE_180 || rotation == OLED_MIRROR_Y);
+
   // 初始化序列保持不变
   this->writeCommand(0xAE);  //--display off
   this->writeCommand(0x00);  //---set low column address
@@ -44,11 +87,11 @@ bool OLED::init() {
   this->writeCommand(0xB0);  //--set page address
   this->writeCommand(0x81);  // contract control
   this->writeCommand(0xFF);  //--128
-  this->writeCommand(0xA1);  // set segment remap
+  this->writeCommand(flip_x ? 0xA0 : 0xA1);  // set segment remap
   this->writeCommand(0xA6);  //--normal / reverse
   this->writeCommand(0xA8);  //--set multiplex ratio(1 to 64)
   this->writeCommand(0x3F);  //--1/32 duty
-  this->writeCommand(0xC8);  // Com scan direction
+  this->writeCommand(flip_y ? 0xC0 : 0xC8);  // Com scan direction
   this->writeCommand(0xD3);  //-set display offset
   this->writeCommand(0x00);  //
   this->writeCommand(0xD5);  // set osc division
@@ -69,14 +112,119 @@ bool OLED::init() {
   return true;
 }
 
+// 快速启动的初始化序列：控制字节0x00后跟连续命令，一次传输发出。
+// 参数与init()相同；显示保持关闭，并切换到水平寻址以便首帧一次写完。
+static constexpr uint8_t kInitSequence[] = {
+    0x00,              // 控制字节：后续全部为命令
+    0xAE,              // display off
+    0xD5, 0x80,        // osc division
+    0xA8, 0x3F,        // multiplex ratio 1/64
+    0xD3, 0x00,        // display offset
+    0x40,              // start line
+    0x8D, 0x14,        // charge pump enable
+    0xA1,              // segment remap
+    0xC8,              // com scan direction
+    0xDA, 0x12,        // com pin configuration
+    0x81, 0xFF,        // contrast
+    0xD9, 0xF1,        // pre-charge period
+    0xDB, 0x30,        // Vcomh
+    0xD8, 0x05,        // area color mode off
+    0xA6,              // normal display
+    0x20, 0x00,        // 水平寻址
+    0x21, 0x00, 0x7F,  // 列窗口
+    0x22, 0x00, 0x07,  // 页窗口
+};
+static constexpr int kInitRemapAt = 11;
+static constexpr int kInitComScanAt = 12;
+static_assert(kInitSequence[kInitRemapAt] == 0xA1 &&
+                  kInitSequence[kInitComScanAt] == 0xC8,
+              "remap/scan offsets out of date");
+
+// 首帧写入后：恢复页寻址（setPos依赖）并开显示
+static constexpr uint8_t kDisplayOnSequence[] = {0x00, 0x20, 0x02, 0xAF};
+
+bool OLED::fastInit(const uint8_t *first_frame) {
+  if (!this->bus->isOpen()) {
+    printf("I2C not initialized!\n");
+    return false;
+  }
+
+  uint8_t cmds[sizeof(kInitSequence)];
+  memcpy(cmds, kInitSequence, sizeof(cmds));
+  cmds[kInitRemapAt] =
+      (rotation == OLED_ROTATE_180 || rotation == OLED_MIRROR_X) ? 0xA0 : 0xA1;
+  cmds[kInitComScanAt] =
+      (rotation == OLED_ROTATE_180 || rotation == OLED_MIRROR_Y) ? 0xC0 : 0xC8;
+
+  // 首帧同时完成清屏，整帧1024字节一次传输
+  if (first_frame) {
+    memcpy(scanout, first_frame, sizeof(frame));
+  } else {
+    memset(scanout, 0, sizeof(frame));
+  }
+  prepareScanout();
+  uint8_t data[1 + sizeof(frame)];
+  data[0] = 0x40;
+  memcpy(data + 1, scanoutPage(0), sizeof(frame));  // 各页连续存放
+
+  bool ok = writeBurst(cmds, sizeof(cmds)) && writeBurst(data, sizeof(data)) &&
+            writeBurst(kDisplayOnSequence, sizeof(kDisplayOnSequence));
+  if (!ok) return false;
+
+  memcpy(shadow, scanout, sizeof(shadow));
+  shadow_valid = true;
+  statsRecord(STAT_BOOT, processAgeUs());
+  if (recorder) recorder->record(scanout[0], rotation);
+  if (mirror) mirror->publish(scanout[0], rotation);
+  return true;
+}
+
+bool OLED::writeBurst(const uint8_t *buf, uint16_t len) {
+  StatsTimer timer(buf[0] == 0x40 ? STAT_I2C_DATA : STAT_I2C_COMMAND, len);
+  this->tx_bytes += len;
+  if (!bus->write(buf, len)) {
+    timer.fail();
+    return false;
+  }
+  return true;
+}
+
 void OLED::writeCommand(unsigned char command) {
-  wiringPiI2CWriteReg8(this->i2c_fd, 0x00, command);
-  usleep(100);
+  {
+    StatsTimer timer(STAT_I2C_COMMAND, 2);  // 只统计总线传输，不含延时
+    uint8_t buf[2] = {0x00, command};
+    if (!bus->write(buf, 2)) timer.fail();
+  }
+  this->tx_bytes += 2;
+  if (bus->settleUs()) usleep(bus->settleUs());
 }
 
 void OLED::writeData(unsigned char data) {
-  wiringPiI2CWriteReg8(this->i2c_fd, 0x40, data);
-  usleep(100);
+  {
+    StatsTimer timer(STAT_I2C_DATA, 2);  // 只统计总线传输，不含延时
+    uint8_t buf[2] = {0x40, data};
+    if (!bus->write(buf, 2)) timer.fail();
+  }
+  this->tx_bytes += 2;
+  if (bus->settleUs()) usleep(bus->settleUs());
+}
+
+void OLED::writeDataBurst(const uint8_t *data, uint16_t len) {
+  // 控制字节0x40后跟连续数据，整段在一次I2C传输中发出
+  uint8_t buf[OLED_MAX_COLUMN + 1];
+  buf[0] = 0x40;
+  while (len > 0) {
+    uint16_t n = len > OLED_MAX_COLUMN ? OLED_MAX_COLUMN : len;
+    memcpy(buf + 1, data, n);
+    this->tx_bytes += n + 1;
+    StatsTimer timer(STAT_I2C_DATA, n + 1);
+    if (!bus->write(buf, n + 1)) {
+      timer.fail();
+      return;
+    }
+    data += n;
+    len -= n;
+  }
 }
 
 // ========== 常规OLED显示操作实现（直接操作OLED） ==========
@@ -189,18 +337,189 @@ void OLED::drawBMP(unsigned char x0, unsigned char y0, unsigned char x1,
 }
 
 // ========== GRAM缓冲区操作实现 ==========
-void OLED::clear_GRAM(void) { memset(gram, 0, sizeof(gram)); }
+void OLED::clear_GRAM(void) { memset(gram, 0, sizeof(frame)); }
+
+void OLED::setTarget_GRAM(uint8_t *buffer) {
+  gram = buffer ? (uint8_t(*)[128])buffer : frame;
+}
+
+void OLED::setScanout_GRAM(uint8_t *buffer) {
+  scanout = buffer ? (uint8_t(*)[128])buffer : frame;
+  shadow_valid = false;
+}
 
 void OLED::refresh(void) {
-  // 刷新整个GRAM到OLED
+  // 刷新整个GRAM到OLED，每页一次突发传输
+  uint32_t bytes_before = tx_bytes;
+  StatsTimer timer(STAT_I2C_REFRESH);
+  prepareScanout();
   for (int page = 0; page < OLED_PAGES; page++) {
     setPos(0, page);
+    writeDataBurst(scanoutPage(page), OLED_MAX_COLUMN);
+  }
+  memcpy(shadow, scanout, sizeof(shadow));
+  shadow_valid = true;
+  timer.addBytes(tx_bytes - bytes_before);
+  if (recorder) recorder->record(scanout[0], rotation);
+  if (mirror) mirror->publish(scanout[0], rotation);
+  if (present_hook) present_hook();
+}
+
+void OLED::refreshPage(uint8_t page) {
+  if (page >= OLED_PAGES) return;
+
+  {
+    StatsTimer timer(STAT_I2C_REFRESH, OLED_MAX_COLUMN + 1);
+    prepareScanout();
+    setPos(0, page);
+    writeDataBurst(scanoutPage(page), OLED_MAX_COLUMN);
+  }
+  // 逐页刷新（显示列表）到最后一页时整帧已上传
+  if (page != OLED_PAGES - 1) return;
+  if (recorder) recorder->record(scanout[0], rotation);
+  if (mirror) mirror->publish(scanout[0], rotation);
+  if (present_hook) present_hook();
+}
 
-    // 发送该页的所有数据
-    for (int col = 0; col < OLED_MAX_COLUMN; col++) {
-      writeData(gram[page][col]);
+void OLED::present(void) {
+  uint32_t bytes_before = tx_bytes;
+  StatsTimer timer(STAT_I2C_REFRESH);
+  uint8_t tiles = width / 8;  // 每逻辑页的8x8块数
+  uint8_t lo[OLED_PAGES], hi[OLED_PAGES];
+  memset(lo, 0xFF, sizeof(lo));
+  memset(hi, 0, sizeof(hi));
+
+  // 按8x8块比较逻辑帧，只转置和上传变化的块
+  for (uint8_t lp = 0; lp < height / 8; lp++) {
+    for (uint8_t t = 0; t < tiles; t++) {
+      uint16_t n = (lp * tiles + t) * 8;
+      uint64_t cur, old;
+      memcpy(&cur, scanout[0] + n, 8);
+      memcpy(&old, shadow[0] + n, 8);
+      if (shadow_valid && cur == old) continue;
+
+      uint8_t page, col;
+      if (rotation == OLED_ROTATE_90) {
+        page = t;
+        col = OLED_MAX_COLUMN - 8 - lp * 8;
+      } else if (rotation == OLED_ROTATE_270) {
+        page = OLED_PAGES - 1 - t;
+        col = lp * 8;
+      } else {
+        page = lp;
+        col = t * 8;
+      }
+      if (isTransposed()) transposeTile(lp, t);
+      if (col < lo[page]) lo[page] = col;
+      if (col + 7 > hi[page]) hi[page] = col + 7;
     }
   }
+
+  for (uint8_t page = 0; page < OLED_PAGES; page++) {
+    if (lo[page] > hi[page]) continue;
+    setPos(lo[page], page);
+    writeDataBurst(scanoutPage(page) + lo[page], hi[page] - lo[page] + 1);
+  }
+  memcpy(shadow, scanout, sizeof(shadow));
+  shadow_valid = true;
+  timer.addBytes(tx_bytes - bytes_before);
+  if (recorder) recorder->record(scanout[0], rotation);
+  if (mirror) mirror->publish(scanout[0], rotation);
+  if (present_hook) present_hook();
+}
+
+// ========== 旋转 ==========
+void OLED::setRotation(uint8_t mode) {
+  if (mode > OLED_MIRROR_Y) return;
+  rotation = mode;
+  width = isTransposed() ? OLED_MAX_ROW : OLED_MAX_COLUMN;
+  height = isTransposed() ? OLED_MAX_COLUMN : OLED_MAX_ROW;
+
+  bool flip_x = (mode == OLED_ROTATE_180 || mode == OLED_MIRROR_X);
+  bool flip_y = (mode == OLED_ROTATE_180 || mode == OLED_MIRROR_Y);
+  writeCommand(flip_x ? 0xA0 : 0xA1);
+  writeCommand(flip_y ? 0xC0 : 0xC8);
+
+  memset(scanout, 0, sizeof(frame));
+  shadow_valid = false;
+}
+
+bool OLED::isTransposed(void) const {
+  return rotation == OLED_ROTATE_90 || rotation == OLED_ROTATE_270;
+}
+
+// 逻辑页lpage第tile块（8列）转置到物理帧
+// 90°：逻辑(x, y) -> 物理(127 - y, x)；270°：逻辑(x, y) -> 物理(y, 63 - x)
+void OLED::transposeTile(uint8_t lpage, uint8_t tile) {
+  uint64_t x;
+  memcpy(&x, scanout[0] + lpage * width + tile * 8, 8);
+  if (rotation == OLED_ROTATE_90) {
+    x = __builtin_bswap64(oled_transpose8x8(x));
+    memcpy(&phys[tile][OLED_MAX_COLUMN - 8 - lpage * 8], &x, 8);
+  } else {
+    x = oled_transpose8x8(__builtin_bswap64(x));
+    memcpy(&phys[OLED_PAGES - 1 - tile][lpage * 8], &x, 8);
+  }
+}
+
+// 整帧转置，两块一组使用128位向量
+void OLED::prepareScanout(void) {
+  if (!isTransposed()) return;
+  uint8_t tiles = width / 8;
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__SSE2__)
+  for (uint8_t lp = 0; lp < height / 8; lp++) {
+    for (uint8_t t = 0; t < tiles; t += 2) {
+      uint64_t in[2], out[2];
+      memcpy(in, scanout[0] + lp * width + t * 8, 16);
+      if (rotation == OLED_ROTATE_270) {
+        in[0] = __builtin_bswap64(in[0]);
+        in[1] = __builtin_bswap64(in[1]);
+      }
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+      uint64x2_t v = vld1q_u64(in), s;
+      s = vandq_u64(veorq_u64(v, vshrq_n_u64(v, 7)),
+                    vdupq_n_u64(0x00AA00AA00AA00AAULL));
+      v = veorq_u64(veorq_u64(v, s), vshlq_n_u64(s, 7));
+      s = vandq_u64(veorq_u64(v, vshrq_n_u64(v, 14)),
+                    vdupq_n_u64(0x0000CCCC0000CCCCULL));
+      v = veorq_u64(veorq_u64(v, s), vshlq_n_u64(s, 14));
+      s = vandq_u64(veorq_u64(v, vshrq_n_u64(v, 28)),
+                    vdupq_n_u64(0x00000000F0F0F0F0ULL));
+      v = veorq_u64(veorq_u64(v, s), vshlq_n_u64(s, 28));
+      vst1q_u64(out, v);
+#else
+      __m128i v = _mm_loadu_si128((const __m128i *)in), s;
+      s = _mm_and_si128(_mm_xor_si128(v, _mm_srli_epi64(v, 7)),
+                        _mm_set1_epi64x(0x00AA00AA00AA00AALL));
+      v = _mm_xor_si128(_mm_xor_si128(v, s), _mm_slli_epi64(s, 7));
+      s = _mm_and_si128(_mm_xor_si128(v, _mm_srli_epi64(v, 14)),
+                        _mm_set1_epi64x(0x0000CCCC0000CCCCLL));
+      v = _mm_xor_si128(_mm_xor_si128(v, s), _mm_slli_epi64(s, 14));
+      s = _mm_and_si128(_mm_xor_si128(v, _mm_srli_epi64(v, 28)),
+                        _mm_set1_epi64x(0x00000000F0F0F0F0LL));
+      v = _mm_xor_si128(_mm_xor_si128(v, s), _mm_slli_epi64(s, 28));
+      _mm_storeu_si128((__m128i *)out, v);
+#endif
+      for (int k = 0; k < 2; k++) {
+        if (rotation == OLED_ROTATE_90) {
+          out[k] = __builtin_bswap64(out[k]);
+          memcpy(&phys[t + k][OLED_MAX_COLUMN - 8 - lp * 8], &out[k], 8);
+        } else {
+          memcpy(&phys[OLED_PAGES - 1 - t - k][lp * 8], &out[k], 8);
+        }
+      }
+    }
+  }
+#else
+  for (uint8_t lp = 0; lp < height / 8; lp++) {
+    for (uint8_t t = 0; t < tiles; t++) transposeTile(lp, t);
+  }
+#endif
+}
+
+const uint8_t *OLED::scanoutPage(uint8_t page) {
+  return isTransposed() ? phys[page] : scanout[page];
 }
 
 void OLED::refreshArea(uint8_t page, uint8_t start_col, uint8_t end_col) {
@@ -208,29 +527,31 @@ void OLED::refreshArea(uint8_t page, uint8_t start_col, uint8_t end_col) {
       end_col >= OLED_MAX_COLUMN)
     return;
 
+  prepareScanout();
   setPos(start_col, page);
 
+  const uint8_t *row = scanoutPage(page);
   for (int col = start_col; col <= end_col; col++) {
-    writeData(gram[page][col]);
+    writeData(row[col]);
   }
 }
 
 // GRAM像素级绘图函数
 void OLED::drawPixel_GRAM(uint8_t x, uint8_t y, uint8_t color) {
-  if (x >= OLED_MAX_COLUMN || y >= OLED_MAX_ROW) return;
+  if (x >= width || y >= height) return;
 
-  uint8_t page = y / 8;
+  uint8_t *cell = gram[0] + (y / 8) * width + x;  // 按逻辑宽度寻址
   uint8_t bit = y % 8;
 
   switch (color) {
     case WHITE:
-      gram[page][x] |= (1 << bit);
+      *cell |= (1 << bit);
       break;
     case BLACK:
-      gram[page][x] &= ~(1 << bit);
+      *cell &= ~(1 << bit);
       break;
     case INVERSE:
-      gram[page][x] ^= (1 << bit);
+      *cell ^= (1 << bit);
       break;
   }
 }
@@ -305,7 +626,7 @@ void OLED::drawCircle_GRAM(uint8_t x0, uint8_t y0, uint8_t r, uint8_t color) {
 void OLED::showChar_GRAM(uint8_t x, uint8_t y, uint8_t chr, uint8_t Char_Size) {
   unsigned char c = chr - ' ';
 
-  if (x > OLED_MAX_COLUMN - 1) {
+  if (x > width - 1) {
     x = 0;
     y = y + 2;
   }
@@ -337,25 +658,28 @@ void OLED::showChar_GRAM(uint8_t x, uint8_t y, uint8_t chr, uint8_t Char_Size) {
 
 void OLED::showNum_GRAM(uint8_t x, uint8_t y, uint32_t num, uint8_t len,
                         uint8_t size) {
-  uint8_t temp;
-  uint8_t enshow = 0;
-  for (int t = 0; t < len; t++) {
-    temp = (num / oled_pow(10, len - t - 1)) % 10;
-    if (enshow == 0 && t < (len - 1)) {
-      if (temp == 0) {
-        this->showChar_GRAM(x + (size / 2) * t, y, ' ', size);
-        continue;
-      } else
-        enshow = 1;
-    }
-    this->showChar_GRAM(x + (size / 2) * t, y, temp + '0', size);
+  // 从低位向高位取数字，高位的0显示为空格（个位总是显示）
+  char str[11];
+  if (len > 10) len = 10;
+  for (int t = len - 1; t >= 0; t--) {
+    str[t] = (t < len - 1 && num == 0) ? ' ' : (char)('0' + num % 10);
+    num /= 10;
   }
+  str[len] = '\0';
+  this->showString_GRAM(x, y, str, size);
+}
+
+void OLED::showFloat_GRAM(uint8_t x, uint8_t y, float num, uint8_t fontSize,
+                          int decimals) {
+  char str[TEXT_NUM_BUF];
+  formatFloat(str, num, decimals);
+  this->showString_GRAM(x, y, str, fontSize);
 }
 
 void OLED::showFloat_GRAM(uint8_t x, uint8_t y, float num, uint8_t fontSize,
                           const char *format) {
   char str[20];
-  sprintf(str, format, num);
+  snprintf(str, sizeof(str), format, num);
   this->showString_GRAM(x, y, str, fontSize);
 }
 
@@ -364,10 +688,11 @@ void OLED::showString_GRAM(uint8_t x, uint8_t y, const char *str,
   unsigned char j = 0;
   while (str[j] != '\0') {
     this->showChar_GRAM(x, y, str[j], fontSize);
-    x += (fontSize == 16) ? 8 : 6;
-    if (x > 120) {
+    uint8_t cw = (fontSize == 16) ? 8 : 6;
+    x += cw;
+    if (x + cw > width) {  // 下一个字符放不下时换行
       x = 0;
-      y += 2;
+      y += (fontSize == 16) ? 16 : 8;
     }
     j++;
   }
@@ -428,6 +753,8 @@ void OLED::sleep(void) {
 }
 
 void OLED::setPos(unsigned char x, unsigned char y) {
+  // 直接写屏会使屏幕内容与shadow不一致，下次present()整帧上传
+  this->shadow_valid = false;
   this->writeCommand(0xb0 + y);
   this->writeCommand(((x & 0xf0) >> 4) | 0x10);
   this->writeCommand((x & 0x0f));
@@ -2,21 +2,54 @@
 #define OLED_H
 
 #include <stdint.h>
-#include <wiringPi.h>
-#include <wiringPiI2C.h>
+
+#include <functional>
+
+#include "i2c_transport.h"
+
+class FrameRecorder;
+class MirrorServer;
 
 class OLED {
  private:
-  int i2c_fd;
+  I2CTransport *bus;
+  bool owns_bus;
   uint8_t addr;
-  uint8_t gram[8][128];  // GRAM缓冲区：8页 x 128列
+  alignas(8) uint8_t frame[8][128];  // 帧缓冲区：8页 x 128列，刷新时上传
+  uint8_t (*gram)[128];  // 当前绘图目标，默认指向frame
+  uint8_t (*scanout)[128];  // 上传（录制）的逻辑帧，默认指向frame
+
+  // 旋转：180°/镜像由控制器寄存器完成，90°/270°在上传前转置
+  uint8_t rotation;
+  uint8_t width, height;      // 逻辑画布尺寸
+  alignas(8) uint8_t phys[8][128];    // 90°/270°时转置后的物理帧
+  alignas(8) uint8_t shadow[8][128];  // 上次上传的逻辑帧，用于脏块检测
+  bool shadow_valid;
+  uint32_t tx_bytes;  // 累计发送到总线的字节数
+  std::function<void(void)> present_hook;
+  FrameRecorder *recorder;
+  MirrorServer *mirror;
+
+  OLED(const OLED &);  // 不可复制（持有总线）
+  OLED &operator=(const OLED &);
+
+  bool writeBurst(const uint8_t *buf, uint16_t len);  // 单次I2C传输
+  bool isTransposed(void) const;
+  void transposeTile(uint8_t lpage, uint8_t tile);
+  const uint8_t *scanoutPage(uint8_t page);
 
  public:
   OLED(uint8_t i2c_bus = 0, uint8_t addr = 0x3C);
+  explicit OLED(I2CTransport *transport);  // 使用外部总线，不接管所有权
+  ~OLED();
 
   bool init();
+  // 快速启动：初始化命令一次突发发出，first_frame（nullptr为空白）整帧写入
+  // 后再开显示。使用水平寻址，需要SSD1306兼容的控制器
+  bool fastInit(const uint8_t *first_frame = nullptr);
   void writeCommand(unsigned char command);
   void writeData(unsigned char data);
+  uint32_t getTxBytes(void) const { return tx_bytes; }
 
   // 基础功能
   void wakeUp(void);
@@ -45,6 +78,32 @@ class OLED {
   void refresh(void);     // 刷新GRAM到OLED
   void refreshArea(uint8_t page, uint8_t start_col,
                    uint8_t end_col);  // 局部刷新
+  void refreshPage(uint8_t page);     // 单页突发刷新（一次I2C传输）
+  void writeDataBurst(const uint8_t *data, uint16_t len);  // 连续写数据
+  uint8_t *getPage_GRAM(uint8_t page) {  // 页缓冲指针（逻辑页）
+    return gram[0] + page * width;
+  }
+  uint8_t *getFrame_GRAM(void) { return scanout[0]; }  // 上传用帧缓冲区
+  // 切换绘图目标（如图层缓冲区），传入nullptr恢复为帧缓冲区
+  void setTarget_GRAM(uint8_t *buffer);
+  // 切换上传的帧缓冲区（如显示服务的共享内存），传入nullptr恢复为frame
+  void setScanout_GRAM(uint8_t *buffer);
+  void present(void);  // 只上传与上次相比变化的8x8块所在的区域
+  // refresh()/present()或逐页刷新完最后一页后调用（如显示服务客户端借此提交帧）
+  void setPresentHook(std::function<void(void)> hook) { present_hook = hook; }
+  // 录制每次上传的帧（nullptr关闭），不接管所有权；逐页刷新时每帧在
+  // 最后一页上传后录制一次
+  void setRecorder(FrameRecorder *rec) { recorder = rec; }
+  // 把每次上传的帧推给远程查看器（nullptr关闭），不接管所有权；
+  // 与录制相同，推送的是实际上传的帧（scanout）
+  void setMirror(MirrorServer *m) { mirror = m; }
+
+  // 旋转与镜像（OLED_ROTATE_*），切换后逻辑画布被清空
+  void setRotation(uint8_t mode);
+  uint8_t getRotation(void) const { return rotation; }
+  uint8_t getWidth(void) const { return width; }    // 逻辑宽度
+  uint8_t getHeight(void) const { return height; }  // 逻辑高度
+  void prepareScanout(void);  // 90°/270°时整帧转置到物理帧（刷新时自动调用）
 
   // GRAM像素级操作
   void drawPixel_GRAM(uint8_t x, uint8_t y, uint8_t color);  // 画点
@@ -61,8 +120,12 @@ class OLED {
   void showChar_GRAM(uint8_t x, uint8_t y, uint8_t chr, uint8_t Char_Size);
   void showNum_GRAM(uint8_t x, uint8_t y, uint32_t num, uint8_t len,
                     uint8_t size);
+  // 保留decimals位小数，经formatFloat格式化，不调用sprintf
+  void showFloat_GRAM(uint8_t x, uint8_t y, float num, uint8_t fontSize,
+                      int decimals = 4);
+  // 兼容旧接口：按printf格式格式化
   void showFloat_GRAM(uint8_t x, uint8_t y, float num, uint8_t fontSize,
-                      const char *format = "%.4f");
+                      const char *format);
   void showString_GRAM(uint8_t x, uint8_t y, const char *str, uint8_t fontSize);
 	void showArrow_GRAM(uint8_t x, uint8_t y, uint8_t dir);
 
@@ -83,6 +146,26 @@ class OLED {
 #define WHITE 1
 #define INVERSE 2
 
+// 旋转模式
+#define OLED_ROTATE_0 0
+#define OLED_ROTATE_90 1   // 顺时针90°，逻辑画布64x128
+#define OLED_ROTATE_180 2
+#define OLED_ROTATE_270 3  // 顺时针270°，逻辑画布64x128
+#define OLED_MIRROR_X 4    // 左右镜像
+#define OLED_MIRROR_Y 5    // 上下镜像
+
+// 8x8位矩阵转置：输入第i字节第j位 -> 输出第j字节第i位
+static inline uint64_t oled_transpose8x8(uint64_t x) {
+  uint64_t t;
+  t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAULL;
+  x = x ^ t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCULL;
+  x = x ^ t ^ (t << 14);
+  t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ULL;
+  x = x ^ t ^ (t << 28);
+  return x;
+}
+
 const unsigned char left_arrow[5] = {0x20, 0x7F, 0xFF, 0x7F, 0x20};
 const unsigned char right_arrow[5] = {0x04, 0xFE, 0xFF, 0xFE, 0x04};
 const unsigned char up_arrow[5] = {0x10, 0x38, 0x7C, 0x38, 0x38};
@@ -0,0 +1,348 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <vector>
+
+#include "display_list.h"
+#include "image.h"
+#include "input.h"
+#include "oled.h"
+#include "panel_manager.h"
+#include "raster.h"
+#include "text_layout.h"
+
+// 光栅化性能基准：不依赖OLED硬件，只测量GRAM内的绘制耗时
+// 用法：oled_bench [次数]
+//       oled_bench --panels [帧数]   多屏按总线并行上传（模拟控制器）
+//       oled_bench --input            按键消抖和编码器解码自测（模拟事件源）
+
+static double nowUs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// 典型的扫描界面：8行SSID + 信号强度 + 选中框
+static const char *kLines[8] = {"HomeNet-5G", "Office",    "Guest",
+                                "TP-LINK_3F", "CMCC-abcd", "ChinaNet",
+                                "MERCURY",    "Hidden"};
+
+static void drawImmediate(OLED &oled) {
+  oled.clear_GRAM();
+  for (int i = 0; i < 8; i++) {
+    oled.showString_GRAM(0, i * 8, kLines[i], 12);
+    oled.showNum_GRAM(109, i * 8, 40 + i * 7, 3, 12);
+  }
+  oled.drawRect_GRAM(0, 8, 127, 15, INVERSE);
+  oled.drawLine_GRAM(0, 63, 127, 0, WHITE);
+  oled.fillRect_GRAM(100, 20, 120, 40, INVERSE);
+}
+
+// 与drawImmediate相同的文本，经排版缓存绘制
+static void drawText(OLED &oled, TextCache *cache, int dy) {
+  oled.clear_GRAM();
+  for (int i = 0; i < 8; i++) {
+    int y = i * 8 + dy;
+    if (cache) {
+      cache->draw(oled, 0, y, kLines[i], 12);
+      cache->drawInt(oled, 109, y, 40 + i * 7, 3, 12);
+    } else {
+      oled.showString_GRAM(0, y, kLines[i], 12);
+      oled.showNum_GRAM(109, y, 40 + i * 7, 3, 12);
+    }
+  }
+}
+
+// 缓存绘制必须与逐字符光栅化逐字节一致（页对齐和跨页两种情况）
+static bool checkTextCache(void) {
+  OLED ref(0, 0x3C), out(0, 0x3C);
+  TextCache cache;
+  for (int dy = 0; dy < 8; dy += 3) {
+    drawText(ref, nullptr, dy);
+    drawText(out, &cache, dy);
+    if (memcmp(ref.getFrame_GRAM(), out.getFrame_GRAM(),
+               OLED_PAGES * OLED_MAX_COLUMN) != 0) {
+      printf("text cache mismatch at dy=%d\n", dy);
+      return false;
+    }
+  }
+  const struct {
+    float value;
+    int decimals;
+    const char *fmt;
+  } kFloats[] = {{3.14159f, 2, "%.2f"}, {-0.05f, 1, "%.1f"},
+                 {1234.56f, 1, "%.1f"},  {-12.0627f, 3, "%.3f"}};
+  char a[TEXT_NUM_BUF], b[TEXT_NUM_BUF];
+  for (size_t i = 0; i < sizeof(kFloats) / sizeof(kFloats[0]); i++) {
+    formatFloat(a, kFloats[i].value, kFloats[i].decimals);
+    snprintf(b, sizeof(b), kFloats[i].fmt, kFloats[i].value);
+    if (strcmp(a, b) != 0) {
+      printf("formatFloat %s != %s\n", a, b);
+      return false;
+    }
+  }
+  const float kSpecial[] = {NAN, INFINITY, -INFINITY};
+  for (size_t i = 0; i < sizeof(kSpecial) / sizeof(kSpecial[0]); i++) {
+    formatFloat(a, kSpecial[i], 2, 5);
+    snprintf(b, sizeof(b), "%5.2f", kSpecial[i]);
+    if (strcmp(a, b) != 0) {
+      printf("formatFloat %s != %s\n", a, b);
+      return false;
+    }
+  }
+  formatInt(a, -2147483647 - 1, 12);
+  if (strcmp(a, " -2147483648") != 0) {
+    printf("formatInt %s\n", a);
+    return false;
+  }
+  return true;
+}
+
+static void recordList(DisplayList &list) {
+  char num[8];
+  list.clear();
+  for (int i = 0; i < 8; i++) {
+    list.showString(0, i * 8, kLines[i], 12);
+    snprintf(num, sizeof(num), "%3d", 40 + i * 7);
+    list.showString(109, i * 8, num, 12);
+  }
+  list.drawRect(0, 8, 127, 15, INVERSE);
+  list.drawLine(0, 63, 127, 0, WHITE);
+  list.fillRect(100, 20, 120, 40, INVERSE);
+}
+
+template <typename F>
+static double measure(const char *name, int iterations, F fn) {
+  double start = nowUs();
+  for (int i = 0; i < iterations; i++) fn();
+  double per = (nowUs() - start) / iterations;
+  printf("%-28s %10.2f us/frame\n", name, per);
+  return per;
+}
+
+// 多屏：4块模拟屏（总线1、2各一块，总线3两块），模拟控制器按400kHz
+// 实际等待。每帧每块屏更新一行状态和进度条，比较逐块上传和按总线并行
+#define PANEL_BENCH_PANELS 4
+
+static void drawStatus(OLED &oled, int panel, int frame) {
+  char line[24];
+  snprintf(line, sizeof(line), "Probe %d: %3d%%", panel, frame % 101);
+  oled.showString_GRAM(0, 0, line, 12);
+  oled.fillRect_GRAM(0, 16, 127, 23, BLACK);
+  oled.fillRect_GRAM(0, 16, frame % 101 * 127 / 100, 23, WHITE);
+}
+
+static int runPanelBench(int frames) {
+  static const int kBus[PANEL_BENCH_PANELS] = {1, 2, 3, 3};
+  MockTransport mocks[PANEL_BENCH_PANELS];
+  PanelManager panels;
+  for (int i = 0; i < PANEL_BENCH_PANELS; i++) {
+    mocks[i].setPacing(400);
+    panels.addPanel(&mocks[i], kBus[i]);
+    panels.setRenderer(i, [i, &frames](OLED &o) { drawStatus(o, i, frames); });
+  }
+  if (!panels.init()) return 1;
+
+  int total = frames;
+  double start = nowUs();
+  for (frames = 0; frames < total; frames++) {
+    for (int i = 0; i < PANEL_BENCH_PANELS; i++) {
+      drawStatus(panels.panel(i), i, frames);
+      panels.panel(i).present();
+    }
+  }
+  double serial = (nowUs() - start) / total;
+
+  uint64_t parallel = 0;
+  for (frames = 0; frames < total; frames++) parallel += panels.present();
+  printf("%d panels on 3 buses, %d frames, 400 kHz\n", PANEL_BENCH_PANELS,
+         total);
+  printf("%-28s %10.0f us/frame\n", "one panel after another", serial);
+  printf("%-28s %10.0f us/frame\n", "parallel per bus",
+         (double)parallel / total);
+  for (size_t i = 0; i < panels.busCount(); i++) {
+    PanelManager::BusStats s = panels.busStats(i);
+    printf("  bus %d: %d panel(s), p50 %llu us, max %llu us, %llu B/frame\n",
+           s.bus, s.panels, (unsigned long long)s.latency.percentile(0.5),
+           (unsigned long long)s.latency.max,
+           (unsigned long long)(s.frames ? s.bytes / s.frames : 0));
+  }
+
+  // 各模拟控制器的显存必须与对应屏的帧缓冲区一致
+  bool ok = true;
+  for (int i = 0; i < PANEL_BENCH_PANELS; i++) {
+    ok = ok && memcmp(mocks[i].panel(), panels.panel(i).getFrame_GRAM(),
+                      OLED_PAGES * OLED_MAX_COLUMN) == 0;
+  }
+  panels.stop();
+  printf("panel contents %s\n", ok ? "match" : "DIFFER");
+  return ok ? 0 : 1;
+}
+
+// ========== 输入自测 ==========
+// FakeEdgeSource注入带时间戳的边沿，检查消抖、静止确认、编码器解码和
+// wait()的超时
+#define INPUT_DEBOUNCE_US 5000
+#define INPUT_T0_NS 1000000000ULL  // 离开上电时刻，第一个边沿不在锁定时间内
+
+enum { LINE_KEY, LINE_ENC_A, LINE_ENC_B, INPUT_LINES };
+
+static bool expectEvent(InputManager &input, InputEventType type, int delta,
+                        const char *what) {
+  InputEvent ev;
+  bool ok = input.wait(ev, 100) && ev.type == type &&
+            (type != INPUT_ROTATE || ev.delta == delta);
+  printf("input: %-36s %s\n", what, ok ? "ok" : "FAILED");
+  return ok;
+}
+
+static bool expectQuiet(InputManager &input, int timeout_ms,
+                        const char *what) {
+  InputEvent ev;
+  double start = nowUs();
+  bool got = input.wait(ev, timeout_ms);
+  double ms = (nowUs() - start) / 1000;
+  // 超时不能提前返回，也不能拖太久
+  bool ok = !got && ms >= timeout_ms && ms < timeout_ms + 50;
+  printf("input: %-36s %s (%.1f ms)\n", what, ok ? "ok" : "FAILED", ms);
+  return ok;
+}
+
+// 一个完整的格雷码周期：顺时针B先变，逆时针A先变
+static void turn(FakeEdgeSource &src, uint64_t &t, bool cw) {
+  uint8_t first = cw ? LINE_ENC_B : LINE_ENC_A;
+  uint8_t second = cw ? LINE_ENC_A : LINE_ENC_B;
+  src.inject(first, 1, t += 1000000);
+  src.inject(second, 1, t += 1000000);
+  src.inject(first, 0, t += 1000000);
+  src.inject(second, 0, t += 1000000);
+}
+
+static int runInputTest(void) {
+  FakeEdgeSource src(INPUT_LINES);
+  InputManager input(&src, INPUT_DEBOUNCE_US);
+  input.bindButton(LINE_KEY, INPUT_KEY_SELECT);
+  input.bindEncoder(LINE_ENC_A, LINE_ENC_B);
+  bool ok = true;
+
+  // 按下时抖动：第一个边沿立即生效，锁定时间内的来回跳变被吞掉
+  uint64_t t = INPUT_T0_NS;
+  src.inject(LINE_KEY, 1, t);
+  src.inject(LINE_KEY, 0, t + 200000);
+  src.inject(LINE_KEY, 1, t + 400000);
+  ok = expectEvent(input, INPUT_PRESS, 0, "bounce on press -> one PRESS") && ok;
+  ok = expectQuiet(input, 20, "no extra events, wait() times out") && ok;
+
+  // 锁定时间内松开且不再变化：静止满消抖时间后确认RELEASE
+  t += 20000000;
+  src.inject(LINE_KEY, 0, t);
+  src.inject(LINE_KEY, 1, t + 300000);
+  src.inject(LINE_KEY, 0, t + 600000);
+  ok = expectEvent(input, INPUT_RELEASE, 0, "bounce on release -> RELEASE") &&
+       ok;
+  ok = expectQuiet(input, 10, "release reported once") && ok;
+
+  // 编码器：一个周期±1，中途的抖动来回抵消
+  t += 20000000;
+  turn(src, t, true);
+  ok = expectEvent(input, INPUT_ROTATE, 1, "one clockwise cycle -> +1") && ok;
+  turn(src, t, false);
+  ok = expectEvent(input, INPUT_ROTATE, -1, "one counter-clockwise -> -1") &&
+       ok;
+  src.inject(LINE_ENC_B, 1, t += 1000000);
+  src.inject(LINE_ENC_B, 0, t += 1000000);
+  src.inject(LINE_ENC_B, 1, t += 1000000);
+  src.inject(LINE_ENC_B, 0, t += 1000000);
+  ok = expectQuiet(input, 10, "encoder chatter cancels out") && ok;
+
+  printf("input self-test: %s\n", ok ? "passed" : "FAILED");
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "--panels") == 0) {
+    return runPanelBench(argc > 2 ? atoi(argv[2]) : 50);
+  }
+  if (argc > 1 && strcmp(argv[1], "--input") == 0) return runInputTest();
+  int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+  OLED oled(0, 0x3C);
+  DisplayList list;
+
+  printf("OLED raster benchmark, %d iterations\n", iterations);
+  measure("immediate *_GRAM", iterations, [&]() { drawImmediate(oled); });
+  measure("display list record", iterations, [&]() { recordList(list); });
+  recordList(list);
+  measure("display list execute", iterations,
+          [&]() { list.execute(oled, true, false); });
+  // 逐页上传到模拟控制器，光栅化与上传线程重叠
+  MockTransport mock;
+  OLED mock_oled(&mock);
+  mock_oled.fastInit();
+  measure("display list execute+upload", iterations,
+          [&]() { list.execute(mock_oled); });
+
+  // 文本：逐字符光栅化 vs 缓存的行精灵
+  TextCache cache;
+  if (!checkTextCache()) return 1;
+  measure("text showString_GRAM", iterations,
+          [&]() { drawText(oled, nullptr, 0); });
+  measure("text cached, page aligned", iterations,
+          [&]() { drawText(oled, &cache, 0); });
+  measure("text cached, 3px offset", iterations,
+          [&]() { drawText(oled, &cache, 3); });
+  printf("text cache: %u hits, %u misses\n", cache.hits(), cache.misses());
+  char num[TEXT_NUM_BUF];
+  float value = 0;
+  measure("number sprintf x8", iterations, [&]() {
+    for (int i = 0; i < 8; i++) snprintf(num, sizeof(num), "%.2f", value += 0.37f);
+  });
+  measure("number formatFloat x8", iterations, [&]() {
+    for (int i = 0; i < 8; i++) formatFloat(num, value += 0.37f, 2);
+  });
+
+  // 选中行高亮：重绘 vs 覆盖层一次XOR
+  LayerStack layers;
+  layers.bind(oled, LayerStack::LAYER_CONTENT);
+  drawImmediate(oled);
+  oled.setTarget_GRAM(nullptr);
+  int row = 0;
+  measure("highlight by redraw", iterations, [&]() {
+    drawImmediate(oled);
+    oled.fillRect_GRAM(0, row * 8, 127, row * 8 + 7, INVERSE);
+    row = (row + 1) & 7;
+  });
+  measure("highlight by overlay XOR", iterations, [&]() {
+    layers.clearLayer(LayerStack::LAYER_OVERLAY);
+    rasterInvertRect(layers.layer(LayerStack::LAYER_OVERLAY), 0, row * 8, 127,
+                     row * 8 + 7);
+    layers.composite(oled);
+    row = (row + 1) & 7;
+  });
+  measure("scroll list by 3px", iterations, [&]() {
+    rasterScrollVertical(oled.getFrame_GRAM(), -3, 0, OLED_PAGES - 1);
+  });
+
+  // 90°旋转：整帧8x8位矩阵转置
+  OLED rotated(0, 0x3C);
+  rotated.setRotation(OLED_ROTATE_90);
+  rotated.showString_GRAM(0, 0, "Rotated", 12);
+  measure("rotate 90 full transpose", iterations,
+          [&]() { rotated.prepareScanout(); });
+
+  // 640x480灰度帧缩放抖动到整屏
+  std::vector<uint8_t> still(640 * 480);
+  for (int y = 0; y < 480; y++) {
+    for (int x = 0; x < 640; x++) still[y * 640 + x] = (uint8_t)((x + y) / 5);
+  }
+  int frames = iterations / 50 + 1;
+  measure("dither 640x480 bayer", frames, [&]() {
+    drawGrayImage(oled, 0, 0, 128, 64, &still[0], 640, 480, DITHER_BAYER);
+  });
+  measure("dither 640x480 floyd", frames, [&]() {
+    drawGrayImage(oled, 0, 0, 128, 64, &still[0], 640, 480, DITHER_FLOYD);
+  });
+  return 0;
+}
@@ -0,0 +1,212 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "i2c_transport.h"
+#include "mirror.h"
+#include "oled.h"
+#include "stats.h"
+
+// 帧镜像查看器（主机工具）：连接设备上的镜像服务，在终端里实时显示屏幕。
+// 用法：oled_mirror 主机 [-p 端口] [-f 最大帧率] [-r 最大字节/秒]
+//       oled_mirror --self-test [帧数]   本机回环自测
+// 每个字符显示上下两个像素（半块字符），128x64的屏幕占128列x32行。
+// 设备端用OLED_SERVER_MIRROR=端口（或WIFI_SCANNER_MIRROR）打开镜像服务。
+
+static volatile sig_atomic_t running = 1;
+
+static void signalHandler(int signum) {
+  (void)signum;
+  running = 0;
+}
+
+static inline bool pixel(const uint8_t *frame, int w, int x, int y) {
+  return frame[(y / 8) * w + x] >> (y % 8) & 1;
+}
+
+static void drawFrame(const MirrorViewer &v) {
+  static const char *kBlocks[4] = {" ", "▀", "▄", "█"};
+  int w = v.rotation() & 1 ? OLED_MAX_ROW : OLED_MAX_COLUMN;
+  int h = FRAME_BYTES * 8 / w;
+  std::string out = "\033[H";
+  for (int y = 0; y < h; y += 2) {
+    for (int x = 0; x < w; x++) {
+      out += kBlocks[pixel(v.frame(), w, x, y) | pixel(v.frame(), w, x, y + 1)
+                                                     << 1];
+    }
+    out += "\033[K\n";
+  }
+  char status[128];
+  snprintf(status, sizeof(status),
+           "frame %u  msgs %u  skipped %u  avg %llu B/msg\033[K\n", v.seq(),
+           v.messages(), v.skipped(),
+           (unsigned long long)(v.messages() ? v.bytes() / v.messages() : 0));
+  out += status;
+  fwrite(out.data(), 1, out.size(), stdout);
+  fflush(stdout);
+}
+
+// ========== 自测 ==========
+// 两个查看器：快的不限速，慢的限10帧/秒、4KB/s且每条消息之后停50ms；
+// 中途切换到90°旋转。结束时两边的画面都必须和本地帧一致
+#define SELF_TEST_FRAME_US 2000
+
+static void drawTestFrame(OLED &oled, int i) {
+  int w = oled.getWidth(), h = oled.getHeight();
+  oled.clear_GRAM();
+  oled.drawRect_GRAM(0, 0, w - 1, h - 1, WHITE);
+  oled.fillRect_GRAM(i % (w - 8), h / 2, i % (w - 8) + 7, h / 2 + 7, WHITE);
+  oled.showNum_GRAM(2, 2, i, 5, 12);
+}
+
+static void viewerLoop(MirrorViewer *v, uint32_t last, int pause_us) {
+  while (v->seq() != last && v->receive()) {
+    if (pause_us) usleep(pause_us);
+  }
+}
+
+static int runSelfTest(int frames) {
+  MockTransport bus;
+  OLED oled(&bus);
+  oled.fastInit();
+  MirrorServer server(0, 4);
+  if (!server.start()) return 1;
+
+  // 基准：没有镜像时present()的耗时
+  uint64_t start = monotonicUs();
+  for (int i = 0; i < frames; i++) {
+    drawTestFrame(oled, i);
+    oled.present();
+  }
+  double bare_us = (double)(monotonicUs() - start) / frames;
+
+  MirrorViewer fast, slow;
+  if (!fast.connect("127.0.0.1", server.port(), 1000) ||
+      !slow.connect("127.0.0.1", server.port(), 10, 4096)) {
+    return 1;
+  }
+  int small = 2048;
+  setsockopt(slow.fd(), SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+  while (server.clientCount() < 2) usleep(1000);
+  oled.setMirror(&server);
+  uint32_t last = (uint32_t)server.counters().published + frames;
+  std::thread t1(viewerLoop, &fast, last, 0);
+  std::thread t2(viewerLoop, &slow, last, 50000);
+
+  uint64_t present_us = 0;
+  start = monotonicUs();
+  for (int i = 0; i < frames; i++) {
+    if (i == frames / 2) oled.setRotation(OLED_ROTATE_90);
+    drawTestFrame(oled, i);
+    uint64_t t = monotonicUs();
+    oled.present();
+    present_us += monotonicUs() - t;
+    uint64_t next = start + (uint64_t)(i + 1) * SELF_TEST_FRAME_US;
+    uint64_t now = monotonicUs();
+    if (now < next) usleep(next - now);
+  }
+  t1.join();
+  t2.join();
+  double seconds = (monotonicUs() - start) / 1e6;
+  oled.setMirror(nullptr);
+
+  MirrorServer::Counters c = server.counters();
+  const MirrorViewer *views[2] = {&fast, &slow};
+  const char *names[2] = {"fast", "slow"};
+  bool ok = true;
+  for (int i = 0; i < 2; i++) {
+    const MirrorViewer &v = *views[i];
+    bool same = v.seq() == last && v.rotation() == oled.getRotation() &&
+                memcmp(v.frame(), oled.getFrame_GRAM(), FRAME_BYTES) == 0;
+    printf("%s viewer: %u msgs, %u frames coalesced, %llu B/msg, %s\n",
+           names[i], v.messages(), v.skipped(),
+           (unsigned long long)(v.messages() ? v.bytes() / v.messages() : 0),
+           same ? "frame matches" : "FRAME DIFFERS");
+    ok = ok && same;
+  }
+  // 慢查看器：不超过限速（加上开头的关键帧和结尾的最后一帧）
+  ok = ok && slow.messages() <= seconds * 10 + 2 &&
+       fast.messages() > slow.messages();
+  printf("server: %llu published, %llu msgs, %llu coalesced, %llu bytes, "
+         "%llu stalls (raw frames: %d B)\n",
+         (unsigned long long)c.published, (unsigned long long)c.messages,
+         (unsigned long long)c.coalesced, (unsigned long long)c.bytes,
+         (unsigned long long)c.stalls, FRAME_BYTES);
+  printf("present(): %.1f us without mirror, %.1f us with 2 viewers\n",
+         bare_us, (double)present_us / frames);
+
+  // 整屏抖动（x,y,y重复）是RLE的最坏情况：新查看器的关键帧每段都不压缩
+  MirrorViewer dither;
+  if (!dither.connect("127.0.0.1", server.port(), 1000)) return 1;
+  while (server.clientCount() < 3) usleep(1000);
+  oled.setRotation(OLED_ROTATE_0);
+  uint8_t *gram = oled.getFrame_GRAM();
+  for (int n = 0; n < FRAME_BYTES; n++) gram[n] = n % 3 ? 0xAA : 0x55;
+  oled.setMirror(&server);
+  oled.present();
+  oled.setMirror(nullptr);
+  viewerLoop(&dither, (uint32_t)server.counters().published, 0);
+  bool dither_ok = dither.rotation() == OLED_ROTATE_0 &&
+                   memcmp(dither.frame(), gram, FRAME_BYTES) == 0;
+  printf("dither viewer: %llu B/msg (limit %zu), %s\n",
+         (unsigned long long)(dither.messages()
+                                  ? dither.bytes() / dither.messages()
+                                  : 0),
+         (size_t)MIRROR_MSG_MAX,
+         dither_ok ? "frame matches" : "FRAME DIFFERS");
+  ok = ok && dither_ok;
+  printf("self-test: %s\n", ok ? "passed" : "FAILED");
+  server.stop();
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  const char *host = nullptr;
+  int port = MIRROR_PORT;
+  int fps = 0;
+  uint32_t rate = 0;
+  for (int i = 1; i < argc; i++) {
+    bool has_arg = i + 1 < argc;
+    if (strcmp(argv[i], "--self-test") == 0) {
+      return runSelfTest(has_arg ? atoi(argv[i + 1]) : 300);
+    } else if (has_arg && strcmp(argv[i], "-p") == 0) {
+      port = atoi(argv[++i]);
+    } else if (has_arg && strcmp(argv[i], "-f") == 0) {
+      fps = atoi(argv[++i]);
+    } else if (has_arg && strcmp(argv[i], "-r") == 0) {
+      rate = strtoul(argv[++i], nullptr, 0);
+    } else if (argv[i][0] != '-' && !host) {
+      host = argv[i];
+    } else {
+      host = nullptr;
+      break;
+    }
+  }
+  if (!host) {
+    fprintf(stderr,
+            "usage: %s host [-p port] [-f max_fps] [-r max_bytes_per_sec]\n"
+            "       %s --self-test [frames]\n",
+            argv[0], argv[0]);
+    return 1;
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = signalHandler;
+  sigaction(SIGINT, &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+
+  MirrorViewer viewer;
+  if (!viewer.connect(host, port, fps, rate)) return 1;
+  printf("\033[2J");
+  while (running && viewer.receive()) drawFrame(viewer);
+  printf("\n%s\n", running ? "connection closed" : "");
+  return 0;
+}
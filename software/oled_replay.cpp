@@ -0,0 +1,363 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "frame_recorder.h"
+#include "i2c_transport.h"
+#include "oled.h"
+
+// 录制文件回放（主机工具）：把录制的帧按不同上传策略送入模拟控制器，
+// 统计每种策略的总线开销，并可把帧渲染成PNG条带。
+// 用法：oled_replay 录制文件 [-p PNG前缀] [-n 每条帧数] [-k 总线kHz]
+//       oled_replay --self-test   录制/读取往返自测
+
+// ========== PNG输出（8位灰度，无压缩deflate块） ==========
+static uint32_t crc_table[256];
+
+static void initCrc(void) {
+  for (uint32_t n = 0; n < 256; n++) {
+    uint32_t c = n;
+    for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+    crc_table[n] = c;
+  }
+}
+
+static uint32_t crc32(uint32_t crc, const uint8_t *p, size_t len) {
+  crc = ~crc;
+  while (len--) crc = crc_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+static void putBE32(std::vector<uint8_t> &out, uint32_t v) {
+  out.push_back(v >> 24);
+  out.push_back(v >> 16);
+  out.push_back(v >> 8);
+  out.push_back(v);
+}
+
+static void putChunk(FILE *fp, const char *type,
+                     const std::vector<uint8_t> &data) {
+  std::vector<uint8_t> chunk;
+  putBE32(chunk, data.size());
+  chunk.insert(chunk.end(), type, type + 4);
+  chunk.insert(chunk.end(), data.begin(), data.end());
+  putBE32(chunk, crc32(0, &chunk[4], chunk.size() - 4));
+  fwrite(&chunk[0], 1, chunk.size(), fp);
+}
+
+static bool writePng(const char *path, int w, int h,
+                     const std::vector<uint8_t> &gray) {
+  FILE *fp = fopen(path, "wb");
+  if (!fp) return false;
+  static const uint8_t sig[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  fwrite(sig, 1, 8, fp);
+
+  std::vector<uint8_t> ihdr;
+  putBE32(ihdr, w);
+  putBE32(ihdr, h);
+  ihdr.push_back(8);  // 位深
+  ihdr.push_back(0);  // 灰度
+  ihdr.push_back(0);
+  ihdr.push_back(0);
+  ihdr.push_back(0);
+  putChunk(fp, "IHDR", ihdr);
+
+  // 每行前加过滤类型0
+  std::vector<uint8_t> raw;
+  for (int y = 0; y < h; y++) {
+    raw.push_back(0);
+    raw.insert(raw.end(), gray.begin() + y * w, gray.begin() + (y + 1) * w);
+  }
+
+  std::vector<uint8_t> z;
+  z.push_back(0x78);
+  z.push_back(0x01);
+  uint32_t a = 1, b = 0;
+  for (size_t i = 0; i < raw.size(); i++) {
+    a = (a + raw[i]) % 65521;
+    b = (b + a) % 65521;
+  }
+  for (size_t pos = 0; pos < raw.size();) {
+    size_t n = std::min<size_t>(raw.size() - pos, 65535);
+    z.push_back(pos + n == raw.size() ? 1 : 0);
+    z.push_back(n & 0xFF);
+    z.push_back(n >> 8);
+    z.push_back(~n & 0xFF);
+    z.push_back((~n >> 8) & 0xFF);
+    z.insert(z.end(), raw.begin() + pos, raw.begin() + pos + n);
+    pos += n;
+  }
+  putBE32(z, (b << 16) | a);
+  putChunk(fp, "IDAT", z);
+  putChunk(fp, "IEND", std::vector<uint8_t>());
+  fclose(fp);
+  return true;
+}
+
+// 帧按逻辑画布渲染（90°/270°时为64x128），条带内纵向排列，帧间留灰线
+static void writeStrips(const std::vector<RecordedFrame> &frames,
+                        const char *prefix, int per_strip) {
+  for (size_t first = 0; first < frames.size(); first += per_strip) {
+    size_t last = std::min(frames.size(), first + per_strip);
+    int w = OLED_MAX_COLUMN;
+    int h = 0;
+    for (size_t i = first; i < last; i++) {
+      bool t = frames[i].rotation == OLED_ROTATE_90 ||
+               frames[i].rotation == OLED_ROTATE_270;
+      h += (t ? OLED_MAX_COLUMN : OLED_MAX_ROW) + 2;
+    }
+
+    std::vector<uint8_t> img(w * h, 0x80);
+    int y0 = 0;
+    for (size_t i = first; i < last; i++) {
+      bool t = frames[i].rotation == OLED_ROTATE_90 ||
+               frames[i].rotation == OLED_ROTATE_270;
+      int fw = t ? OLED_MAX_ROW : OLED_MAX_COLUMN;
+      int fh = t ? OLED_MAX_COLUMN : OLED_MAX_ROW;
+      for (int y = 0; y < fh; y++) {
+        for (int x = 0; x < w; x++) {
+          uint8_t v = 0x40;  // 画布外
+          if (x < fw) {
+            v = (frames[i].frame[(y / 8) * fw + x] >> (y & 7)) & 1 ? 0xFF
+                                                                    : 0x00;
+          }
+          img[(y0 + y) * w + x] = v;
+        }
+      }
+      y0 += fh + 2;
+    }
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s_%04zu.png", prefix, first / per_strip);
+    if (!writePng(path, w, h, img)) perror(path);
+  }
+}
+
+// ========== 上传策略 ==========
+struct Strategy {
+  const char *name;
+  MockTransport bus;
+  OLED oled;
+  uint64_t total_us;
+  uint64_t max_us;
+  uint64_t bytes;
+  uint64_t transactions;
+  uint32_t mismatches;  // 上传后显存与参考不一致的帧数
+
+  explicit Strategy(const char *name)
+      : name(name),
+        oled(&bus),
+        total_us(0),
+        max_us(0),
+        bytes(0),
+        transactions(0),
+        mismatches(0) {}
+
+  void account(uint32_t bus_khz) {
+    uint64_t us = bus.estimateUs(bus_khz);
+    total_us += us;
+    if (us > max_us) max_us = us;
+    bytes += bus.bytes();
+    transactions += bus.transactions();
+    bus.resetCounters();
+  }
+};
+
+// 只重传与参考显存不同的整页（页寻址）
+static void uploadPages(Strategy &s, const uint8_t *ref) {
+  const uint8_t *cur = s.bus.panel();
+  for (int page = 0; page < OLED_PAGES; page++) {
+    const uint8_t *want = ref + page * OLED_MAX_COLUMN;
+    if (memcmp(cur + page * OLED_MAX_COLUMN, want, OLED_MAX_COLUMN) == 0) {
+      continue;
+    }
+    s.oled.setPos(0, page);
+    s.oled.writeDataBurst(want, OLED_MAX_COLUMN);
+  }
+}
+
+// 水平寻址：用0x21/0x22设置覆盖所有变化的窗口，窗口内数据连续发送
+static void uploadWindow(Strategy &s, const uint8_t *ref) {
+  const uint8_t *cur = s.bus.panel();
+  int p0 = OLED_PAGES, p1 = -1, c0 = OLED_MAX_COLUMN, c1 = -1;
+  for (int i = 0; i < OLED_PAGES * OLED_MAX_COLUMN; i++) {
+    if (cur[i] == ref[i]) continue;
+    int page = i / OLED_MAX_COLUMN, col = i % OLED_MAX_COLUMN;
+    p0 = std::min(p0, page);
+    p1 = std::max(p1, page);
+    c0 = std::min(c0, col);
+    c1 = std::max(c1, col);
+  }
+  if (p1 < 0) return;
+
+  uint8_t buf[OLED_PAGES * OLED_MAX_COLUMN];
+  int n = 0;
+  for (int page = p0; page <= p1; page++) {
+    memcpy(buf + n, ref + page * OLED_MAX_COLUMN + c0, c1 - c0 + 1);
+    n += c1 - c0 + 1;
+  }
+  s.oled.writeCommand(0x21);
+  s.oled.writeCommand(c0);
+  s.oled.writeCommand(c1);
+  s.oled.writeCommand(0x22);
+  s.oled.writeCommand(p0);
+  s.oled.writeCommand(p1);
+  s.oled.writeDataBurst(buf, n);
+}
+
+static uint64_t percentile(std::vector<uint64_t> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  size_t i = (size_t)(p * (v.size() - 1));
+  return v[i];
+}
+
+// ========== 自测 ==========
+// 抖动图案（x,y,y重复）是RLE的最坏情况；关键帧和增量都用它，
+// 读回的帧必须和录制的逐字节一致
+#define SELF_TEST_FRAMES 40
+
+static void fillTestFrame(uint8_t *frame, int i) {
+  for (int n = 0; n < FRAME_BYTES; n++) {
+    if (i % 4 == 3) {
+      frame[n] = (uint8_t)(n * 7 + i);  // 普通内容
+    } else {
+      frame[n] = (n + i) % 3 ? 0xAA : 0x55;
+    }
+  }
+}
+
+static int runSelfTest(void) {
+  char path[] = "/tmp/oled_replay.XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0) {
+    perror("mkstemp");
+    return 1;
+  }
+  close(fd);
+
+  FrameRecorder rec;
+  if (!rec.open(path, 64 * 1024)) {
+    unlink(path);
+    return 1;
+  }
+  alignas(8) uint8_t frame[FRAME_BYTES];
+  for (int i = 0; i < SELF_TEST_FRAMES; i++) {
+    fillTestFrame(frame, i);
+    rec.record(frame, OLED_ROTATE_0);
+  }
+  rec.close();
+
+  std::vector<RecordedFrame> frames;
+  bool ok = loadRecording(path, frames) && !frames.empty();
+  unlink(path);
+  // 环形文件可能已覆盖最早的块，读回的是最后若干帧
+  int first = SELF_TEST_FRAMES - (int)frames.size();
+  for (size_t i = 0; ok && i < frames.size(); i++) {
+    fillTestFrame(frame, first + (int)i);
+    ok = memcmp(frames[i].frame, frame, FRAME_BYTES) == 0;
+  }
+  printf("self-test: %zu/%d frames read back, %s\n", frames.size(),
+         SELF_TEST_FRAMES, ok ? "passed" : "FAILED");
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  if (argc == 2 && strcmp(argv[1], "--self-test") == 0) return runSelfTest();
+  if (argc < 2) {
+    fprintf(stderr,
+            "usage: %s file [-p png_prefix] [-n per_strip] [-k khz]\n"
+            "       %s --self-test\n",
+            argv[0], argv[0]);
+    return 1;
+  }
+  const char *png_prefix = nullptr;
+  int per_strip = 16;
+  uint32_t bus_khz = 400;
+  for (int i = 2; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-p") == 0) {
+      png_prefix = argv[i + 1];
+    } else if (strcmp(argv[i], "-n") == 0) {
+      per_strip = std::max(1, atoi(argv[i + 1]));
+    } else if (strcmp(argv[i], "-k") == 0) {
+      bus_khz = std::max(1, atoi(argv[i + 1]));
+    }
+  }
+
+  std::vector<RecordedFrame> frames;
+  if (!loadRecording(argv[1], frames)) {
+    fprintf(stderr, "cannot read recording %s\n", argv[1]);
+    return 1;
+  }
+  if (frames.empty()) {
+    printf("recording is empty\n");
+    return 0;
+  }
+
+  // 帧间隔：现场"卡顿"通常表现为长间隔
+  std::vector<uint64_t> gaps;
+  for (size_t i = 1; i < frames.size(); i++) {
+    gaps.push_back(frames[i].ts_us - frames[i - 1].ts_us);
+  }
+  printf("%zu frames over %.2f s\n", frames.size(),
+         (frames.back().ts_us - frames.front().ts_us) / 1e6);
+  printf("frame interval us: p50=%llu p90=%llu p99=%llu max=%llu\n",
+         (unsigned long long)percentile(gaps, 0.5),
+         (unsigned long long)percentile(gaps, 0.9),
+         (unsigned long long)percentile(gaps, 0.99),
+         (unsigned long long)percentile(gaps, 1.0));
+
+  // full为参考：整帧刷新后的显存即期望的屏幕内容
+  Strategy full("full"), pages("pages"), tiles("tiles"), window("window");
+  Strategy *all[] = {&full, &pages, &tiles, &window};
+  window.oled.writeCommand(0x20);  // 水平寻址模式
+  window.oled.writeCommand(0x00);
+  window.bus.resetCounters();
+
+  for (size_t i = 0; i < frames.size(); i++) {
+    const RecordedFrame &f = frames[i];
+    Strategy *logical[] = {&full, &tiles};
+    for (int k = 0; k < 2; k++) {
+      OLED &o = logical[k]->oled;
+      if (o.getRotation() != f.rotation) o.setRotation(f.rotation);
+      memcpy(o.getFrame_GRAM(), f.frame, FRAME_BYTES);
+    }
+
+    full.oled.refresh();
+    tiles.oled.present();
+    uploadPages(pages, full.bus.panel());
+    uploadWindow(window, full.bus.panel());
+
+    for (int k = 0; k < 4; k++) {
+      if (memcmp(all[k]->bus.panel(), full.bus.panel(), FRAME_BYTES) != 0) {
+        all[k]->mismatches++;
+      }
+      all[k]->account(bus_khz);
+    }
+  }
+
+  printf("\nupload cost at %u kHz (%zu frames):\n", bus_khz, frames.size());
+  printf("%-8s %12s %10s %12s %10s %8s\n", "strategy", "bytes/frame",
+         "xfer/frame", "est us/frame", "max us", "errors");
+  for (int k = 0; k < 4; k++) {
+    Strategy &s = *all[k];
+    printf("%-8s %12.1f %10.1f %12.1f %10llu %8u\n", s.name,
+           (double)s.bytes / frames.size(),
+           (double)s.transactions / frames.size(),
+           (double)s.total_us / frames.size(), (unsigned long long)s.max_us,
+           s.mismatches);
+  }
+
+  if (png_prefix) {
+    initCrc();
+    writeStrips(frames, png_prefix, per_strip);
+    printf("\nwrote %zu PNG strip(s) to %s_*.png\n",
+           (frames.size() + per_strip - 1) / per_strip, png_prefix);
+  }
+  return 0;
+}
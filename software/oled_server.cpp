@@ -0,0 +1,86 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wiringPi.h>
+
+#include "display_server.h"
+#include "frame_recorder.h"
+#include "mirror.h"
+#include "oled.h"
+#include "stats.h"
+
+// 显示服务：独占OLED的I2C总线，合成各客户端的区域后上传。
+// 用法：oled_server [-b 总线号] [-a 地址] [-s 套接字路径]
+
+static DisplayServer *server = nullptr;
+
+static void signalHandler(int signum) {
+  (void)signum;
+  if (server) server->stop();
+}
+
+int main(int argc, char **argv) {
+  int bus = 0;
+  int addr = 0x3C;
+  const char *path = DISPLAY_SERVER_SOCKET;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "-b") == 0) {
+      bus = atoi(argv[i + 1]);
+    } else if (strcmp(argv[i], "-a") == 0) {
+      addr = (int)strtol(argv[i + 1], nullptr, 0);
+    } else if (strcmp(argv[i], "-s") == 0) {
+      path = argv[i + 1];
+    } else {
+      fprintf(stderr, "usage: %s [-b bus] [-a addr] [-s socket]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  if (wiringPiSetup() == -1) {
+    printf("wiringPi setup failed!\n");
+    return 1;
+  }
+
+  const char *stats_path = getenv("OLED_SERVER_STATS");
+  statsStartExporter(stats_path ? stats_path : "/tmp/oled_server.stats");
+
+  OLED oled(bus, addr);
+  if (!oled.fastInit()) return 1;
+
+  // 设置OLED_SERVER_RECORD时录制上传的帧，供oled_replay离线分析
+  FrameRecorder recorder;
+  const char *record_path = getenv("OLED_SERVER_RECORD");
+  if (record_path && recorder.open(record_path)) oled.setRecorder(&recorder);
+
+  // 设置OLED_SERVER_MIRROR=端口时把上传的帧推给远程查看器（oled_mirror）
+  const char *mirror_port = getenv("OLED_SERVER_MIRROR");
+  MirrorServer mirror(mirror_port ? atoi(mirror_port) : MIRROR_PORT);
+  if (mirror_port && mirror.start()) {
+    oled.setMirror(&mirror);
+    printf("OLED mirror listening on port %u\n", mirror.port());
+  }
+
+  DisplayServer display(oled, path);
+  if (!display.start()) return 1;
+  server = &display;
+
+  // 不设置SA_RESTART，让epoll_wait被信号打断后检查退出标志
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = signalHandler;
+  sigaction(SIGINT, &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+
+  printf("OLED display server listening on %s\n", path);
+  display.run();
+
+  server = nullptr;
+  oled.setRecorder(nullptr);
+  oled.setMirror(nullptr);
+  recorder.close();
+  oled.clear();
+  oled.sleep();
+  statsStopExporter();
+  return 0;
+}
@@ -0,0 +1,147 @@
+#include "panel_manager.h"
+
+#include <string.h>
+
+PanelManager::PanelManager()
+    : started(false), generation(0), job(JOB_PRESENT), pending(0),
+      quit(false) {}
+
+PanelManager::~PanelManager() {
+  stop();
+  for (size_t i = 0; i < panels.size(); i++) delete panels[i].oled;
+  for (size_t i = 0; i < buses.size(); i++) delete buses[i];
+}
+
+int PanelManager::addPanel(uint8_t bus, uint8_t addr) {
+  return add(new OLED(bus, addr), bus);
+}
+
+int PanelManager::addPanel(I2CTransport *transport, int bus) {
+  return add(new OLED(transport), bus);
+}
+
+int PanelManager::add(OLED *oled, int bus) {
+  if (started) {
+    delete oled;
+    return -1;
+  }
+  Panel p;
+  p.oled = oled;
+  p.bus = bus;
+  panels.push_back(p);
+  int idx = (int)panels.size() - 1;
+
+  // 同一条总线的屏归同一个工作线程
+  Bus *b = nullptr;
+  for (size_t i = 0; i < buses.size(); i++) {
+    if (buses[i]->bus == bus) b = buses[i];
+  }
+  if (!b) {
+    b = new Bus;
+    b->bus = bus;
+    b->ok = true;
+    b->frames = b->bytes = 0;
+    memset(&b->latency, 0, sizeof(b->latency));
+    buses.push_back(b);
+  }
+  b->panels.push_back(idx);
+  return idx;
+}
+
+void PanelManager::setRenderer(int panel, Renderer render) {
+  panels[panel].render = render;
+}
+
+PanelManager::BusStats PanelManager::busStats(size_t i) {
+  std::lock_guard<std::mutex> guard(lock);
+  const Bus *b = buses[i];
+  BusStats s;
+  s.bus = b->bus;
+  s.panels = (int)b->panels.size();
+  s.frames = b->frames;
+  s.bytes = b->bytes;
+  s.latency = b->latency;
+  return s;
+}
+
+bool PanelManager::start(void) {
+  if (started) return true;
+  quit = false;
+  for (size_t i = 0; i < buses.size(); i++) {
+    buses[i]->thread = std::thread(&PanelManager::worker, this, buses[i]);
+  }
+  started = true;
+  return true;
+}
+
+void PanelManager::stop(void) {
+  if (!started) return;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    quit = true;
+  }
+  kick.notify_all();
+  for (size_t i = 0; i < buses.size(); i++) buses[i]->thread.join();
+  started = false;
+}
+
+bool PanelManager::init(void) { return dispatch(JOB_INIT); }
+
+uint64_t PanelManager::present(void) {
+  uint64_t start = monotonicUs();
+  dispatch(JOB_PRESENT);
+  return monotonicUs() - start;
+}
+
+bool PanelManager::dispatch(Job j) {
+  if (!started) start();
+  std::unique_lock<std::mutex> guard(lock);
+  job = j;
+  pending = buses.size();
+  generation++;
+  kick.notify_all();
+  done.wait(guard, [this]() { return pending == 0; });
+  bool ok = true;
+  for (size_t i = 0; i < buses.size(); i++) ok = ok && buses[i]->ok;
+  return ok;
+}
+
+void PanelManager::worker(Bus *b) {
+  uint64_t seen = 0;
+  for (;;) {
+    Job j;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      kick.wait(guard, [&]() { return quit || generation != seen; });
+      if (quit) return;
+      seen = generation;
+      j = job;
+    }
+
+    // 总线上的屏依次处理；各总线的工作线程之间不共享任何状态
+    uint64_t start = monotonicUs();
+    uint32_t bytes = 0;
+    bool ok = true;
+    for (size_t i = 0; i < b->panels.size(); i++) {
+      Panel &p = panels[b->panels[i]];
+      uint32_t before = p.oled->getTxBytes();
+      if (j == JOB_INIT) {
+        ok = p.oled->fastInit() && ok;
+      } else {
+        if (p.render) p.render(*p.oled);
+        p.oled->present();
+      }
+      bytes += p.oled->getTxBytes() - before;
+    }
+    uint64_t us = monotonicUs() - start;
+
+    std::lock_guard<std::mutex> guard(lock);
+    b->ok = ok;
+    if (j == JOB_PRESENT) {
+      b->frames++;
+      b->bytes += bytes;
+      b->latency.add(us, bytes);
+    }
+    if (--pending == 0) done.notify_all();
+  }
+}
@@ -0,0 +1,97 @@
+#ifndef PANEL_MANAGER_H
+#define PANEL_MANAGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "oled.h"
+#include "stats.h"
+
+// 多屏管理：一台主机驱动多块屏，每块屏各有一个OLED。
+// 同一条I2C总线上的屏归同一个工作线程，按添加顺序串行上传；不同总线
+// 各有一个工作线程，同时渲染和上传。一帧的延迟是最慢那条总线的耗时，
+// 而不是所有屏相加。每块屏仍由OLED::present()只上传变化的块。
+class PanelManager {
+ public:
+  typedef std::function<void(OLED &)> Renderer;
+
+  struct BusStats {
+    int bus;
+    int panels;
+    uint64_t frames;
+    uint64_t bytes;        // 发到总线的字节
+    StatSnapshot latency;  // 每帧该总线上所有屏渲染+上传的耗时，微秒
+  };
+
+  PanelManager();
+  ~PanelManager();
+
+  // 在/dev/i2c-bus的addr处添加一块屏，返回序号
+  int addPanel(uint8_t bus, uint8_t addr = 0x3C);
+  // 使用外部总线（模拟控制器等），bus只用于分组，不接管transport
+  int addPanel(I2CTransport *transport, int bus);
+  // 在工作线程中、上传之前调用；不设置时由调用者事先画好GRAM
+  void setRenderer(int panel, Renderer render);
+
+  OLED &panel(int i) { return *panels[i].oled; }
+  size_t panelCount(void) const { return panels.size(); }
+  size_t busCount(void) const { return buses.size(); }
+  BusStats busStats(size_t i);
+
+  // 启动工作线程，之后不能再添加屏
+  bool start(void);
+  void stop(void);
+
+  // 所有屏fastInit，各总线并行；任一块失败时返回false
+  bool init(void);
+  // 所有屏渲染并上传，各总线并行，等全部完成后返回耗时（微秒）
+  uint64_t present(void);
+
+ private:
+  enum Job {
+    JOB_INIT,
+    JOB_PRESENT,
+  };
+
+  struct Panel {
+    OLED *oled;
+    int bus;
+    Renderer render;
+  };
+
+  struct Bus {
+    int bus;
+    std::vector<int> panels;
+    std::thread thread;
+    bool ok;  // 最近一次任务的结果
+    uint64_t frames, bytes;
+    StatSnapshot latency;
+  };
+
+  std::vector<Panel> panels;
+  std::vector<Bus *> buses;
+  bool started;
+
+  // 派发：generation变化时各工作线程执行job，pending减到0时唤醒调用者
+  std::mutex lock;
+  std::condition_variable kick, done;
+  uint64_t generation;
+  Job job;
+  size_t pending;
+  bool quit;
+
+  int add(OLED *oled, int bus);
+  bool dispatch(Job j);
+  void worker(Bus *b);
+
+  PanelManager(const PanelManager &);
+  PanelManager &operator=(const PanelManager &);
+};
+
+#endif  // PANEL_MANAGER_H
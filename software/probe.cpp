@@ -0,0 +1,407 @@
+#include "probe.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#if HAVE_LIBUSB
+#include <libusb.h>
+#endif
+
+#include "stats.h"
+
+// ========== 回环探针 ==========
+LoopbackProbe::LoopbackProbe(uint32_t latency_us)
+    : event_fd(-1),
+      timer_fd(-1),
+      latency_us(latency_us),
+      bytes_per_sec(0),
+      busy_until_us(0) {}
+
+LoopbackProbe::~LoopbackProbe() { close(); }
+
+bool LoopbackProbe::open(void) {
+  event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (event_fd < 0 || timer_fd < 0) {
+    perror("eventfd");
+    close();
+    return false;
+  }
+  return true;
+}
+
+void LoopbackProbe::close(void) {
+  // 未完成的传输按取消处理
+  while (!outs.empty()) {
+    Out o = outs.front();
+    outs.pop_front();
+    o.done(PROBE_ERROR, nullptr, 0);
+  }
+  while (!ins.empty()) {
+    Pending p = ins.front();
+    ins.pop_front();
+    p.done(PROBE_ERROR, nullptr, 0);
+  }
+  in_stream.clear();
+  if (event_fd >= 0) ::close(event_fd);
+  if (timer_fd >= 0) ::close(timer_fd);
+  event_fd = timer_fd = -1;
+}
+
+bool LoopbackProbe::submitOut(const uint8_t *data, size_t len, Callback done) {
+  if (event_fd < 0) return false;
+  Out o;
+  o.data = data;
+  o.len = len;
+  o.due_us = dueTime(len);
+  o.done = done;
+  outs.push_back(o);
+  kick();
+  return true;
+}
+
+bool LoopbackProbe::submitIn(uint8_t *buf, size_t max_len, Callback done) {
+  if (event_fd < 0) return false;
+  Pending p;
+  p.buf = buf;
+  p.max_len = max_len;
+  p.due_us = dueTime(max_len);
+  p.done = done;
+  ins.push_back(p);
+  kick();
+  return true;
+}
+
+void LoopbackProbe::pollFds(std::vector<struct pollfd> &fds) {
+  struct pollfd p = {event_fd, POLLIN, 0};
+  if (event_fd >= 0) fds.push_back(p);
+  p.fd = timer_fd;
+  if (timer_fd >= 0) fds.push_back(p);
+}
+
+// 不限带宽时每个传输各自延迟latency_us，否则按提交顺序排在总线上
+uint64_t LoopbackProbe::dueTime(size_t len) {
+  uint64_t now = monotonicUs();
+  if (!bytes_per_sec) return now + latency_us;
+  uint64_t start = busy_until_us > now ? busy_until_us : now;
+  busy_until_us = start + latency_us + len * 1000000ULL / bytes_per_sec;
+  return busy_until_us;
+}
+
+// 安排下一次handleEvents：无延迟时直接触发eventfd，否则定时到最早的到期时刻
+void LoopbackProbe::kick(void) {
+  uint64_t due = UINT64_MAX;
+  if (!outs.empty()) due = outs.front().due_us;
+  if (!ins.empty() && !in_stream.empty() && ins.front().due_us < due) {
+    due = ins.front().due_us;
+  }
+  if (due == UINT64_MAX) return;
+
+  uint64_t now = monotonicUs();
+  if (due <= now) {
+    uint64_t one = 1;
+    if (write(event_fd, &one, sizeof(one)) < 0) perror("eventfd write");
+    return;
+  }
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+  its.it_value.tv_sec = (due - now) / 1000000;
+  its.it_value.tv_nsec = (due - now) % 1000000 * 1000;
+  timerfd_settime(timer_fd, 0, &its, nullptr);
+}
+
+void LoopbackProbe::handleEvents(void) {
+  uint64_t count;
+  if (read(event_fd, &count, sizeof(count)) < 0) { /* 未触发 */ }
+  if (read(timer_fd, &count, sizeof(count)) < 0) { /* 未到期 */ }
+
+  uint64_t now = monotonicUs();
+  // OUT按顺序完成，应答数据进入IN流
+  while (!outs.empty() && outs.front().due_us <= now) {
+    Out o = outs.front();
+    outs.pop_front();
+    if (responder) {
+      responder(o.data, o.len, in_stream);
+    } else {
+      in_stream.insert(in_stream.end(), o.data, o.data + o.len);
+    }
+    o.done(PROBE_OK, o.data, o.len);
+  }
+
+  // IN取走当前可用的数据，和USB批量读一样可能短于请求长度
+  while (!ins.empty() && !in_stream.empty() && ins.front().due_us <= now) {
+    Pending p = ins.front();
+    ins.pop_front();
+    size_t n = p.max_len < in_stream.size() ? p.max_len : in_stream.size();
+    memcpy(p.buf, in_stream.data(), n);  // 相当于控制器DMA到缓冲
+    in_stream.erase(in_stream.begin(), in_stream.begin() + n);
+    p.done(PROBE_OK, p.buf, n);
+  }
+  kick();
+}
+
+#if HAVE_LIBUSB
+// ========== libusb探针 ==========
+#define SEGGER_VID 0x1366
+
+// 传输上下文，完成后回到空闲列表复用
+struct UsbXfer {
+  UsbProbe *probe;
+  libusb_transfer *transfer;
+  bool busy;
+  bool expired;  // 队首IN超时后被取消
+  Probe::Callback done;
+};
+
+UsbProbe::UsbProbe(const char *serial, uint32_t timeout_ms)
+    : ctx(nullptr),
+      handle(nullptr),
+      serial(serial ? serial : ""),
+      name("J-Link"),
+      interface(-1),
+      ep_in(0),
+      ep_out(0),
+      timeout_ms(timeout_ms),
+      active(0),
+      timer_fd(-1) {}
+
+UsbProbe::~UsbProbe() { close(); }
+
+// 找到厂商自定义类、同时有批量IN和OUT端点的接口
+static bool findBulkInterface(libusb_device *dev, int &iface, uint8_t &in,
+                              uint8_t &out) {
+  struct libusb_config_descriptor *cfg;
+  if (libusb_get_active_config_descriptor(dev, &cfg) != 0) return false;
+  bool found = false;
+  for (int i = 0; i < cfg->bNumInterfaces && !found; i++) {
+    const struct libusb_interface_descriptor *alt =
+        &cfg->interface[i].altsetting[0];
+    if (alt->bInterfaceClass != LIBUSB_CLASS_VENDOR_SPEC) continue;
+    in = out = 0;
+    for (int e = 0; e < alt->bNumEndpoints; e++) {
+      const struct libusb_endpoint_descriptor *ep = &alt->endpoint[e];
+      if ((ep->bmAttributes & 0x03) != LIBUSB_TRANSFER_TYPE_BULK) continue;
+      if (ep->bEndpointAddress & LIBUSB_ENDPOINT_IN) {
+        if (!in) in = ep->bEndpointAddress;
+      } else if (!out) {
+        out = ep->bEndpointAddress;
+      }
+    }
+    if (in && out) {
+      iface = alt->bInterfaceNumber;
+      found = true;
+    }
+  }
+  libusb_free_config_descriptor(cfg);
+  return found;
+}
+
+bool UsbProbe::open(void) {
+  if (libusb_init(&ctx) != 0) {
+    fprintf(stderr, "libusb_init failed\n");
+    return false;
+  }
+
+  libusb_device **list;
+  ssize_t n = libusb_get_device_list(ctx, &list);
+  for (ssize_t i = 0; i < n && !handle; i++) {
+    struct libusb_device_descriptor desc;
+    if (libusb_get_device_descriptor(list[i], &desc) != 0 ||
+        desc.idVendor != SEGGER_VID) {
+      continue;
+    }
+    libusb_device_handle *h;
+    if (libusb_open(list[i], &h) != 0) continue;
+
+    char sn[64] = "";
+    if (desc.iSerialNumber) {
+      libusb_get_string_descriptor_ascii(h, desc.iSerialNumber,
+                                         (unsigned char *)sn, sizeof(sn));
+    }
+    if ((!serial.empty() && serial != sn) ||
+        !findBulkInterface(list[i], interface, ep_in, ep_out)) {
+      libusb_close(h);
+      continue;
+    }
+    libusb_set_auto_detach_kernel_driver(h, 1);
+    if (libusb_claim_interface(h, interface) != 0) {
+      fprintf(stderr, "J-Link %s busy\n", sn);
+      libusb_close(h);
+      continue;
+    }
+    handle = h;
+    name = std::string("J-Link ") + sn;
+  }
+  libusb_free_device_list(list, 1);
+
+  if (!handle) {
+    fprintf(stderr, "no J-Link found\n");
+    libusb_exit(ctx);
+    ctx = nullptr;
+    return false;
+  }
+  timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd < 0) {
+    perror("timerfd_create");
+    close();
+    return false;
+  }
+  return true;
+}
+
+void UsbProbe::close(void) {
+  if (handle) {
+    // 取消仍在途的传输，等回调全部返回后再释放句柄
+    for (size_t i = 0; i < xfers.size(); i++) {
+      if (xfers[i]->busy) libusb_cancel_transfer(xfers[i]->transfer);
+    }
+    while (active > 0) libusb_handle_events(ctx);
+    libusb_release_interface(handle, interface);
+    libusb_close(handle);
+    handle = nullptr;
+  }
+  for (size_t i = 0; i < xfers.size(); i++) {
+    libusb_free_transfer(xfers[i]->transfer);
+    delete xfers[i];
+  }
+  xfers.clear();
+  idle.clear();
+  ins.clear();
+  if (timer_fd >= 0) ::close(timer_fd);
+  timer_fd = -1;
+  if (ctx) {
+    libusb_exit(ctx);
+    ctx = nullptr;
+  }
+}
+
+bool UsbProbe::submit(uint8_t ep, uint8_t *buf, size_t len, uint32_t timeout,
+                      Callback done) {
+  if (!handle) return false;
+  UsbXfer *x;
+  if (idle.empty()) {
+    x = new UsbXfer();
+    x->probe = this;
+    x->transfer = libusb_alloc_transfer(0);
+    if (!x->transfer) {
+      delete x;
+      return false;
+    }
+    xfers.push_back(x);
+  } else {
+    x = idle.back();
+    idle.pop_back();
+  }
+
+  x->done = done;
+  x->expired = false;
+  libusb_fill_bulk_transfer(x->transfer, handle, ep, buf, (int)len,
+                            transferDone, x, timeout);
+  if (libusb_submit_transfer(x->transfer) != 0) {
+    idle.push_back(x);
+    return false;
+  }
+  x->busy = true;
+  active++;
+  if (ep & LIBUSB_ENDPOINT_IN) {
+    ins.push_back(x);
+    if (ins.size() == 1) armInTimeout();
+  }
+  return true;
+}
+
+bool UsbProbe::submitOut(const uint8_t *data, size_t len, Callback done) {
+  // libusb不会写OUT缓冲，去掉const只是为了填写传输结构
+  return submit(ep_out, (uint8_t *)data, len, timeout_ms, done);
+}
+
+bool UsbProbe::submitIn(uint8_t *buf, size_t max_len, Callback done) {
+  // IN不用libusb的超时（提交时就开始计时），由timer_fd只对队首计时
+  return submit(ep_in, buf, max_len, 0, done);
+}
+
+// 队首IN传输从现在起计时；没有在途IN时停止
+void UsbProbe::armInTimeout(void) {
+  struct itimerspec its;
+  memset(&its, 0, sizeof(its));
+  if (!ins.empty()) {
+    its.it_value.tv_sec = timeout_ms / 1000;
+    its.it_value.tv_nsec = timeout_ms % 1000 * 1000000;
+  }
+  timerfd_settime(timer_fd, 0, &its, nullptr);
+}
+
+void UsbProbe::transferDone(libusb_transfer *t) {
+  UsbXfer *x = (UsbXfer *)t->user_data;
+
+  int status;
+  switch (t->status) {
+    case LIBUSB_TRANSFER_COMPLETED:
+      status = PROBE_OK;
+      break;
+    case LIBUSB_TRANSFER_TIMED_OUT:
+      status = PROBE_TIMEOUT;
+      break;
+    case LIBUSB_TRANSFER_NO_DEVICE:
+      status = PROBE_NO_DEVICE;
+      break;
+    case LIBUSB_TRANSFER_CANCELLED:
+      status = x->expired ? PROBE_TIMEOUT : PROBE_ERROR;
+      break;
+    default:
+      status = PROBE_ERROR;
+      break;
+  }
+  // OUT没有全部写出也算失败
+  if (status == PROBE_OK && !(t->endpoint & LIBUSB_ENDPOINT_IN) &&
+      t->actual_length != t->length) {
+    status = PROBE_ERROR;
+  }
+  // 先放回空闲列表，回调里可以立即提交下一个传输
+  UsbProbe *p = x->probe;
+  Callback done;
+  done.swap(x->done);
+  x->busy = false;
+  p->active--;
+  p->idle.push_back(x);
+  if (t->endpoint & LIBUSB_ENDPOINT_IN) {
+    std::deque<UsbXfer *>::iterator it =
+        std::find(p->ins.begin(), p->ins.end(), x);
+    bool head = it == p->ins.begin();
+    if (it != p->ins.end()) p->ins.erase(it);
+    if (head) p->armInTimeout();  // 下一个IN成为队首，重新计时
+  }
+  done(status, t->buffer, t->actual_length);
+}
+
+void UsbProbe::pollFds(std::vector<struct pollfd> &fds) {
+  // Linux上libusb的描述符集合固定（usbfs + timerfd），打开后取一次即可；
+  // usbfs以可写表示有传输完成
+  struct pollfd timer = {timer_fd, POLLIN, 0};
+  fds.push_back(timer);
+  const struct libusb_pollfd **pfds = libusb_get_pollfds(ctx);
+  if (!pfds) return;
+  for (int i = 0; pfds[i]; i++) {
+    struct pollfd p = {pfds[i]->fd, pfds[i]->events, 0};
+    fds.push_back(p);
+  }
+  libusb_free_pollfds(pfds);
+}
+
+void UsbProbe::handleEvents(void) {
+  // 队首IN超时：取消它，回调报告PROBE_TIMEOUT
+  uint64_t count;
+  if (read(timer_fd, &count, sizeof(count)) == sizeof(count) && !ins.empty() &&
+      !ins.front()->expired) {
+    ins.front()->expired = true;
+    libusb_cancel_transfer(ins.front()->transfer);
+  }
+  struct timeval zero = {0, 0};
+  libusb_handle_events_timeout_completed(ctx, &zero, nullptr);
+}
+#endif
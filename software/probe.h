@@ -0,0 +1,140 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <poll.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+// 调试探针的批量端点抽象：异步提交传输，完成回调在handleEvents()中调用。
+// 同一方向的传输按提交顺序完成，可以同时排队多个，避免USB空闲间隙。
+// 传输直接使用调用者的缓冲（不复制），缓冲必须保持有效直到回调返回。
+
+#define PROBE_OK 0
+#define PROBE_ERROR -1
+#define PROBE_TIMEOUT -2
+#define PROBE_NO_DEVICE -3
+
+class Probe {
+ public:
+  // status为PROBE_*；IN传输时data为提交的缓冲，len为实际读到的字节数
+  typedef std::function<void(int status, const uint8_t *data, size_t len)>
+      Callback;
+
+  virtual ~Probe() {}
+  virtual bool open(void) = 0;
+  virtual void close(void) = 0;
+  virtual const char *describe(void) const = 0;
+
+  virtual bool submitOut(const uint8_t *data, size_t len, Callback done) = 0;
+  virtual bool submitIn(uint8_t *buf, size_t max_len, Callback done) = 0;
+
+  // 需要加入事件循环的描述符及关注的事件，就绪时调用handleEvents()
+  virtual void pollFds(std::vector<struct pollfd> &fds) = 0;
+  virtual void handleEvents(void) = 0;
+};
+
+// 回环探针：在进程内模拟探针，OUT数据经responder生成IN数据
+// （默认原样回显），用于没有硬件时测试桥接和客户端
+class LoopbackProbe : public Probe {
+ public:
+  typedef std::function<void(const uint8_t *data, size_t len,
+                             std::vector<uint8_t> &reply)>
+      Responder;
+
+  // latency_us：每个传输的模拟完成延迟
+  explicit LoopbackProbe(uint32_t latency_us = 0);
+  ~LoopbackProbe();
+
+  void setResponder(Responder r) { responder = r; }
+  // 模拟有限的USB带宽：传输依次占用总线，每个另加latency_us；0为不限
+  void setBandwidth(uint32_t bytes_per_sec) {
+    this->bytes_per_sec = bytes_per_sec;
+  }
+
+  bool open(void);
+  void close(void);
+  const char *describe(void) const { return "loopback"; }
+  bool submitOut(const uint8_t *data, size_t len, Callback done);
+  bool submitIn(uint8_t *buf, size_t max_len, Callback done);
+  void pollFds(std::vector<struct pollfd> &fds);
+  void handleEvents(void);
+
+ private:
+  struct Out {
+    const uint8_t *data;
+    size_t len;
+    uint64_t due_us;
+    Callback done;
+  };
+  struct Pending {
+    uint8_t *buf;
+    size_t max_len;
+    uint64_t due_us;
+    Callback done;
+  };
+
+  int event_fd;
+  int timer_fd;
+  uint32_t latency_us;
+  uint32_t bytes_per_sec;
+  uint64_t busy_until_us;  // 总线上最后一个传输的完成时刻
+  Responder responder;
+  std::vector<uint8_t> in_stream;  // 等待IN传输取走的数据
+  std::deque<Pending> ins;
+  std::deque<Out> outs;  // 已提交、待完成的OUT
+
+  uint64_t dueTime(size_t len);
+  void kick(void);
+};
+
+#if HAVE_LIBUSB
+struct libusb_context;
+struct libusb_device_handle;
+struct libusb_transfer;
+struct UsbXfer;
+
+// J-Link（SEGGER VID 0x1366）的libusb异步实现
+class UsbProbe : public Probe {
+ public:
+  // serial为空时使用找到的第一个探针。timeout_ms用于OUT传输和排在最前的
+  // IN传输：流水线里后面的IN在成为队首时才开始计时，排在长时间命令
+  // （如擦除Flash）之后不会误判超时
+  explicit UsbProbe(const char *serial = nullptr, uint32_t timeout_ms = 1000);
+  ~UsbProbe();
+
+  bool open(void);
+  void close(void);
+  const char *describe(void) const { return name.c_str(); }
+  bool submitOut(const uint8_t *data, size_t len, Callback done);
+  bool submitIn(uint8_t *buf, size_t max_len, Callback done);
+  void pollFds(std::vector<struct pollfd> &fds);
+  void handleEvents(void);
+
+ private:
+  libusb_context *ctx;
+  libusb_device_handle *handle;
+  std::string serial;
+  std::string name;
+  int interface;
+  uint8_t ep_in, ep_out;
+  uint32_t timeout_ms;
+  // 传输对象分配后反复使用，稳定运行时提交不再分配内存
+  std::vector<UsbXfer *> xfers;
+  std::vector<UsbXfer *> idle;
+  int active;
+  std::deque<UsbXfer *> ins;  // 在途的IN传输，按提交顺序
+  int timer_fd;               // 队首IN传输的超时
+
+  bool submit(uint8_t ep, uint8_t *buf, size_t len, uint32_t timeout,
+              Callback done);
+  void armInTimeout(void);
+  static void transferDone(libusb_transfer *t);
+};
+#endif
+
+#endif  // PROBE_H
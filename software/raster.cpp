@@ -0,0 +1,274 @@
+#include "raster.h"
+
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define RASTER_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define RASTER_SSE2 1
+#endif
+
+// 单个字（或字节）的光栅操作，m为区域掩码，掩码外的位保持不变
+template <RasterOp OP, typename W>
+static inline W ropWord(W d, W s, W m) {
+  W t = s & m;
+  switch (OP) {
+    case ROP_COPY:
+      return (d & ~m) | t;
+    case ROP_AND:
+      return d & (t | ~m);
+    case ROP_OR:
+      return d | t;
+    case ROP_XOR:
+      return d ^ t;
+    case ROP_ANDNOT:
+    default:
+      return d & ~t;
+  }
+}
+
+#if RASTER_NEON
+template <RasterOp OP>
+static inline uint8x16_t ropVec(uint8x16_t d, uint8x16_t s, uint8x16_t m) {
+  uint8x16_t t = vandq_u8(s, m);
+  switch (OP) {
+    case ROP_COPY:
+      return vbslq_u8(m, s, d);
+    case ROP_AND:
+      return vandq_u8(d, vornq_u8(t, m));
+    case ROP_OR:
+      return vorrq_u8(d, t);
+    case ROP_XOR:
+      return veorq_u8(d, t);
+    case ROP_ANDNOT:
+    default:
+      return vbicq_u8(d, t);
+  }
+}
+#elif RASTER_SSE2
+template <RasterOp OP>
+static inline __m128i ropVec(__m128i d, __m128i s, __m128i m) {
+  __m128i t = _mm_and_si128(s, m);
+  switch (OP) {
+    case ROP_COPY:
+      return _mm_or_si128(_mm_andnot_si128(m, d), t);
+    case ROP_AND:
+      return _mm_andnot_si128(_mm_andnot_si128(t, m), d);
+    case ROP_OR:
+      return _mm_or_si128(d, t);
+    case ROP_XOR:
+      return _mm_xor_si128(d, t);
+    case ROP_ANDNOT:
+    default:
+      return _mm_andnot_si128(t, d);
+  }
+}
+#endif
+
+// 对连续n字节执行光栅操作；src为nullptr时源视为全1（用于反色/填充）
+template <RasterOp OP>
+static void spanKernel(uint8_t *dst, const uint8_t *src, size_t n,
+                       uint8_t mask) {
+  size_t i = 0;
+
+#if RASTER_NEON
+  uint8x16_t vm = vdupq_n_u8(mask);
+  uint8x16_t ones = vdupq_n_u8(0xFF);
+  for (; i + 16 <= n; i += 16) {
+    uint8x16_t s = src ? vld1q_u8(src + i) : ones;
+    vst1q_u8(dst + i, ropVec<OP>(vld1q_u8(dst + i), s, vm));
+  }
+#elif RASTER_SSE2
+  __m128i vm = _mm_set1_epi8((char)mask);
+  __m128i ones = _mm_set1_epi8((char)0xFF);
+  for (; i + 16 <= n; i += 16) {
+    __m128i s = src ? _mm_loadu_si128((const __m128i *)(src + i)) : ones;
+    __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+    _mm_storeu_si128((__m128i *)(dst + i), ropVec<OP>(d, s, vm));
+  }
+#endif
+
+  uint64_t m64 = mask * 0x0101010101010101ULL;
+  for (; i + 8 <= n; i += 8) {
+    uint64_t d, s = ~0ULL;
+    memcpy(&d, dst + i, 8);
+    if (src) memcpy(&s, src + i, 8);
+    d = ropWord<OP, uint64_t>(d, s, m64);
+    memcpy(dst + i, &d, 8);
+  }
+  for (; i < n; i++) {
+    uint8_t s = src ? src[i] : 0xFF;
+    dst[i] = ropWord<OP, uint8_t>(dst[i], s, mask);
+  }
+}
+
+static void spanOp(uint8_t *dst, const uint8_t *src, size_t n, uint8_t mask,
+                   RasterOp op) {
+  switch (op) {
+    case ROP_COPY:
+      spanKernel<ROP_COPY>(dst, src, n, mask);
+      break;
+    case ROP_AND:
+      spanKernel<ROP_AND>(dst, src, n, mask);
+      break;
+    case ROP_OR:
+      spanKernel<ROP_OR>(dst, src, n, mask);
+      break;
+    case ROP_XOR:
+      spanKernel<ROP_XOR>(dst, src, n, mask);
+      break;
+    case ROP_ANDNOT:
+      spanKernel<ROP_ANDNOT>(dst, src, n, mask);
+      break;
+  }
+}
+
+// [ya, yb] 行在第page页内对应的位掩码
+static inline uint8_t pageMask(int ya, int yb, int page) {
+  int top = page * 8;
+  if (yb < top || ya > top + 7) return 0;
+  int a = ya < top ? 0 : ya - top;
+  int b = yb > top + 7 ? 7 : yb - top;
+  return (uint8_t)((0xFF << a) & (0xFF >> (7 - b)));
+}
+
+void rasterBlit(uint8_t *dst, const uint8_t *src, size_t len, RasterOp op) {
+  spanOp(dst, src, len, 0xFF, op);
+}
+
+static void rectOp(uint8_t *dst, const uint8_t *src, int x1, int y1, int x2,
+                   int y2, RasterOp op, int width, int height) {
+  if (x1 < 0) x1 = 0;
+  if (y1 < 0) y1 = 0;
+  if (x2 > width - 1) x2 = width - 1;
+  if (y2 > height - 1) y2 = height - 1;
+  if (x1 > x2 || y1 > y2) return;
+
+  for (int page = y1 / 8; page <= y2 / 8; page++) {
+    size_t offset = page * width + x1;
+    spanOp(dst + offset, src ? src + offset : nullptr, x2 - x1 + 1,
+           pageMask(y1, y2, page), op);
+  }
+}
+
+void rasterBlitRect(uint8_t *dst, const uint8_t *src, int x1, int y1, int x2,
+                    int y2, RasterOp op, int width, int height) {
+  rectOp(dst, src, x1, y1, x2, y2, op, width, height);
+}
+
+void rasterInvertRect(uint8_t *buf, int x1, int y1, int x2, int y2, int width,
+                      int height) {
+  rectOp(buf, nullptr, x1, y1, x2, y2, ROP_XOR, width, height);
+}
+
+// 按字节移位合并两页：a为主页，b为相邻页，up为真表示向上移位
+static void shiftRows(uint8_t *out, const uint8_t *a, const uint8_t *b,
+                      int r, bool up, int width) {
+  int i = 0;
+  if (up) {
+    uint64_t ma = (uint8_t)(0xFF >> r) * 0x0101010101010101ULL;
+    uint64_t mb = (uint8_t)(0xFF << (8 - r)) * 0x0101010101010101ULL;
+    for (; i + 8 <= width; i += 8) {
+      uint64_t wa = 0, wb = 0;
+      if (a) memcpy(&wa, a + i, 8);
+      if (b) memcpy(&wb, b + i, 8);
+      uint64_t w = ((wa >> r) & ma) | (r ? (wb << (8 - r)) & mb : 0);
+      memcpy(out + i, &w, 8);
+    }
+    for (; i < width; i++) {
+      uint8_t va = a ? a[i] : 0, vb = b ? b[i] : 0;
+      out[i] = (uint8_t)((va >> r) | (r ? vb << (8 - r) : 0));
+    }
+  } else {
+    uint64_t ma = (uint8_t)(0xFF << r) * 0x0101010101010101ULL;
+    uint64_t mb = (uint8_t)(0xFF >> (8 - r)) * 0x0101010101010101ULL;
+    for (; i + 8 <= width; i += 8) {
+      uint64_t wa = 0, wb = 0;
+      if (a) memcpy(&wa, a + i, 8);
+      if (b) memcpy(&wb, b + i, 8);
+      uint64_t w = ((wa << r) & ma) | (r ? (wb >> (8 - r)) & mb : 0);
+      memcpy(out + i, &w, 8);
+    }
+    for (; i < width; i++) {
+      uint8_t va = a ? a[i] : 0, vb = b ? b[i] : 0;
+      out[i] = (uint8_t)((va << r) | (r ? vb >> (8 - r) : 0));
+    }
+  }
+}
+
+void rasterScrollVertical(uint8_t *buf, int dy, int first_page, int last_page,
+                          int width) {
+  if (dy == 0 || first_page > last_page) return;
+  int n = dy > 0 ? dy : -dy;
+  int q = n >> 3;
+  int r = n & 7;
+
+  if (n >= (last_page - first_page + 1) * 8) {
+    memset(buf + first_page * width, 0,
+           (last_page - first_page + 1) * width);
+    return;
+  }
+
+  if (dy < 0) {
+    // 向上：从上往下处理，源页总在目标页之下，可原地进行
+    for (int p = first_page; p <= last_page; p++) {
+      int pa = p + q, pb = p + q + 1;
+      shiftRows(buf + p * width, pa <= last_page ? buf + pa * width : nullptr,
+                pb <= last_page ? buf + pb * width : nullptr, r, true, width);
+    }
+  } else {
+    // 向下：从下往上处理
+    for (int p = last_page; p >= first_page; p--) {
+      int pa = p - q, pb = p - q - 1;
+      shiftRows(buf + p * width, pa >= first_page ? buf + pa * width : nullptr,
+                pb >= first_page ? buf + pb * width : nullptr, r, false,
+                width);
+    }
+  }
+}
+
+void rasterScrollHorizontal(uint8_t *buf, int dx, int first_page,
+                            int last_page, int width) {
+  if (dx == 0) return;
+  int n = dx > 0 ? dx : -dx;
+  if (n > width) n = width;
+
+  for (int p = first_page; p <= last_page; p++) {
+    uint8_t *row = buf + p * width;
+    if (dx > 0) {
+      memmove(row + n, row, width - n);
+      memset(row, 0, n);
+    } else {
+      memmove(row, row + n, width - n);
+      memset(row + width - n, 0, n);
+    }
+  }
+}
+
+// ========== 图层合成 ==========
+LayerStack::LayerStack() {
+  memset(layers, 0, sizeof(layers));
+  ops[LAYER_BACKGROUND] = ROP_COPY;
+  ops[LAYER_CONTENT] = ROP_OR;
+  ops[LAYER_OVERLAY] = ROP_XOR;
+  for (int i = 0; i < LAYER_COUNT; i++) visible_mask[i] = true;
+}
+
+void LayerStack::clearLayer(int id) {
+  memset(layers[id], 0, sizeof(layers[id]));
+}
+
+void LayerStack::composite(OLED &oled) {
+  uint8_t *out = oled.getFrame_GRAM();
+  memset(out, 0, sizeof(layers[0]));
+  for (int i = 0; i < LAYER_COUNT; i++) {
+    if (visible_mask[i]) rasterBlit(out, layers[i], sizeof(layers[i]), ops[i]);
+  }
+}
+
+void LayerStack::present(OLED &oled) {
+  composite(oled);
+  oled.present();
+}
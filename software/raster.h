@@ -0,0 +1,71 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "oled.h"
+
+// 页打包缓冲区（与GRAM相同布局）上的字宽光栅操作。
+// 内核按64位字处理，支持NEON/SSE2时按128位处理。
+
+enum RasterOp {
+  ROP_COPY,    // dst = src
+  ROP_AND,     // dst = dst & src
+  ROP_OR,      // dst = dst | src
+  ROP_XOR,     // dst = dst ^ src
+  ROP_ANDNOT,  // dst = dst & ~src
+};
+
+// 整段位块传送：dst[i] = dst[i] op src[i]
+void rasterBlit(uint8_t *dst, const uint8_t *src, size_t len, RasterOp op);
+
+// 矩形区域位块传送，src与dst布局相同（每页width字节）
+void rasterBlitRect(uint8_t *dst, const uint8_t *src, int x1, int y1, int x2,
+                    int y2, RasterOp op, int width = OLED_MAX_COLUMN,
+                    int height = OLED_MAX_ROW);
+
+// 矩形区域反色（选中行高亮、光标闪烁）
+void rasterInvertRect(uint8_t *buf, int x1, int y1, int x2, int y2,
+                      int width = OLED_MAX_COLUMN, int height = OLED_MAX_ROW);
+
+// 在[first_page, last_page]页范围内垂直滚动dy像素（正数向下），移入部分清零
+void rasterScrollVertical(uint8_t *buf, int dy, int first_page, int last_page,
+                          int width = OLED_MAX_COLUMN);
+
+// 在[first_page, last_page]页范围内水平滚动dx像素（正数向右），移入部分清零
+void rasterScrollHorizontal(uint8_t *buf, int dx, int first_page,
+                            int last_page, int width = OLED_MAX_COLUMN);
+
+// 图层合成：背景、内容、覆盖层在刷新时按各自的操作合成到帧缓冲区
+class LayerStack {
+ public:
+  enum Layer {
+    LAYER_BACKGROUND,
+    LAYER_CONTENT,
+    LAYER_OVERLAY,
+    LAYER_COUNT,
+  };
+
+  LayerStack();
+
+  uint8_t *layer(int id) { return layers[id]; }
+  void clearLayer(int id);
+  void setOp(int id, RasterOp op) { ops[id] = op; }
+  void setVisible(int id, bool visible) { visible_mask[id] = visible; }
+
+  // 将OLED的绘图目标切换到指定图层，之后的 *_GRAM 调用绘制到该图层
+  void bind(OLED &oled, int id) { oled.setTarget_GRAM(layers[id]); }
+
+  // 合成到OLED帧缓冲区
+  void composite(OLED &oled);
+  // 合成并只上传变化的区域
+  void present(OLED &oled);
+
+ private:
+  alignas(16) uint8_t layers[LAYER_COUNT][OLED_PAGES * OLED_MAX_COLUMN];
+  RasterOp ops[LAYER_COUNT];
+  bool visible_mask[LAYER_COUNT];
+};
+
+#endif  // RASTER_H
@@ -0,0 +1,313 @@
+#include "roam.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <set>
+
+#include "stats.h"
+
+#if HAVE_NETWORKMANAGER
+#include <NetworkManager.h>
+#include <glib.h>
+#endif
+
+#define ROAM_LOG_MAX 256
+#define ROAM_TIMEOUT_US 15000000  // 等待重新激活完成的上限
+
+// ========== NetworkManager执行器 ==========
+#if HAVE_NETWORKMANAGER
+NmRoamActuator::NmRoamActuator(const char *ifname)
+    : client(nullptr), ifname(ifname ? ifname : "") {}
+
+NmRoamActuator::~NmRoamActuator() {
+  if (client) g_object_unref(client);
+}
+
+NMDeviceWifi *NmRoamActuator::device(void) {
+  if (!client) {
+    GError *error = nullptr;
+    client = nm_client_new(nullptr, &error);
+    if (!client) {
+      fprintf(stderr, "Failed to create NMClient: %s\n", error->message);
+      g_error_free(error);
+      return nullptr;
+    }
+  }
+  while (g_main_context_iteration(nm_client_get_main_context(client), FALSE)) {
+  }
+  const GPtrArray *devices = nm_client_get_devices(client);
+  for (guint i = 0; devices && i < devices->len; i++) {
+    NMDevice *device = (NMDevice *)devices->pdata[i];
+    if (!NM_IS_DEVICE_WIFI(device)) continue;
+    if (!ifname.empty() && ifname != nm_device_get_iface(device)) continue;
+    return NM_DEVICE_WIFI(device);
+  }
+  return nullptr;
+}
+
+bool NmRoamActuator::current(std::string &bssid) {
+  NMDeviceWifi *wifi = device();
+  NMAccessPoint *ap = wifi ? nm_device_wifi_get_active_access_point(wifi)
+                           : nullptr;
+  const char *b = ap ? nm_access_point_get_bssid(ap) : nullptr;
+  bssid = b ? b : "";
+  return b != nullptr;
+}
+
+// 0为进行中，1为激活请求已接受，-1为失败
+static void activateDone(GObject *source, GAsyncResult *result, gpointer data) {
+  GError *error = nullptr;
+  NMActiveConnection *ac =
+      nm_client_activate_connection_finish(NM_CLIENT(source), result, &error);
+  if (ac) {
+    g_object_unref(ac);
+    *(int *)data = 1;
+  } else {
+    fprintf(stderr, "roam: activation failed: %s\n", error->message);
+    g_error_free(error);
+    *(int *)data = -1;
+  }
+}
+
+bool NmRoamActuator::roam(const std::string &ssid, const std::string &bssid,
+                          uint64_t &outage_us) {
+  (void)ssid;  // 沿用当前活动连接的配置
+  outage_us = 0;
+  NMDeviceWifi *wifi = device();
+  if (!wifi) return false;
+
+  NMAccessPoint *target = nullptr;
+  const GPtrArray *aps = nm_device_wifi_get_access_points(wifi);
+  for (guint i = 0; aps && i < aps->len; i++) {
+    NMAccessPoint *ap = (NMAccessPoint *)aps->pdata[i];
+    const char *b = nm_access_point_get_bssid(ap);
+    if (b && strcasecmp(b, bssid.c_str()) == 0) target = ap;
+  }
+  NMActiveConnection *active = nm_device_get_active_connection(NM_DEVICE(wifi));
+  NMRemoteConnection *conn =
+      active ? nm_active_connection_get_connection(active) : nullptr;
+  if (!target || !conn) return false;
+
+  int status = 0;
+  uint64_t start = monotonicUs();
+  nm_client_activate_connection_async(
+      client, NM_CONNECTION(conn), NM_DEVICE(wifi),
+      nm_object_get_path(NM_OBJECT(target)), nullptr, activateDone, &status);
+
+  // 断链时间：从发出请求到设备重新进入ACTIVATED且关联到目标
+  GMainContext *context = nm_client_get_main_context(client);
+  while (monotonicUs() - start < ROAM_TIMEOUT_US && status >= 0) {
+    if (g_main_context_iteration(context, FALSE)) continue;
+    NMAccessPoint *ap = nm_device_wifi_get_active_access_point(wifi);
+    const char *b = ap ? nm_access_point_get_bssid(ap) : nullptr;
+    if (status == 1 &&
+        nm_device_get_state(NM_DEVICE(wifi)) == NM_DEVICE_STATE_ACTIVATED &&
+        b && strcasecmp(b, bssid.c_str()) == 0) {
+      outage_us = monotonicUs() - start;
+      return true;
+    }
+    usleep(5000);
+  }
+  outage_us = monotonicUs() - start;
+  return false;
+}
+#endif
+
+// ========== 链路活动 ==========
+uint64_t StatsActivity::idleUs(uint64_t now) {
+  FILE *fp = fopen(path.c_str(), "r");
+  if (!fp) return UINT64_MAX;  // 没有桥在运行，视为一直空闲
+  char line[512];
+  uint64_t value = count;
+  while (fgets(line, sizeof(line), fp)) {
+    unsigned long long c;
+    if (strncmp(line, stat.c_str(), stat.size()) == 0 &&
+        sscanf(line + stat.size(), " count=%llu", &c) == 1) {
+      value = c;
+      break;
+    }
+  }
+  fclose(fp);
+  // 第一次读到时不知道之前是否有流量，保守地视为刚有过活动
+  if (value != count || last_change_us == 0) {
+    count = value;
+    last_change_us = now;
+  }
+  return now - last_change_us;
+}
+
+// ========== 策略 ==========
+RoamEngine::RoamEngine(const RoamConfig &config, ScanBackend *backend,
+                       RoamActuator *actuator, IdleFn idle)
+    : config(config),
+      backend(backend),
+      actuator(actuator),
+      idle(idle),
+      associated_us(0),
+      state(IDLE),
+      decided_us(0) {}
+
+void RoamEngine::update(const std::vector<WiFiNetwork> &networks,
+                        bool targeted) {
+  std::set<std::string> present;
+  for (size_t i = 0; i < networks.size(); i++) {
+    const WiFiNetwork &n = networks[i];
+    if (n.ssid != config.ssid || n.bssid.empty()) continue;
+    present.insert(n.bssid);
+    std::map<std::string, BssHistory>::iterator it = bss.find(n.bssid);
+    if (it == bss.end()) {
+      BssHistory h;
+      h.signal16 = n.signal_strength * 16;
+      h.freq_mhz = n.freq_mhz;
+      h.seen = 1;
+      h.missed = 0;
+      bss[n.bssid] = h;
+    } else {
+      BssHistory &h = it->second;
+      h.signal16 += (n.signal_strength * 16 - h.signal16) / 4;
+      h.freq_mhz = n.freq_mhz;
+      h.seen++;
+      h.missed = 0;
+    }
+  }
+  // 定向扫描可能只覆盖部分信道，不据此老化
+  if (targeted) return;
+  for (std::map<std::string, BssHistory>::iterator it = bss.begin();
+       it != bss.end();) {
+    if (!present.count(it->first) && ++it->second.missed > config.max_missed) {
+      bss.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+}
+
+int RoamEngine::signalOf(const std::string &bssid) const {
+  std::map<std::string, BssHistory>::const_iterator it = bss.find(bssid);
+  return it == bss.end() ? 0 : it->second.signal16 / 16;
+}
+
+bool RoamEngine::bestCandidate(std::string &out, int &signal) const {
+  bool found = false;
+  for (std::map<std::string, BssHistory>::const_iterator it = bss.begin();
+       it != bss.end(); ++it) {
+    const BssHistory &h = it->second;
+    if (it->first == current || h.seen < config.min_seen || h.missed) continue;
+    if (!found || h.signal16 / 16 > signal) {
+      out = it->first;
+      signal = h.signal16 / 16;
+      found = true;
+    }
+  }
+  return found;
+}
+
+void RoamEngine::record(uint64_t now, RoamEventKind kind,
+                        const std::string &to, uint64_t outage_us,
+                        const char *reason) {
+  static const char *kKindNames[] = {"roamed", "roam failed", "cancelled",
+                                     "external roam"};
+  RoamEvent ev;
+  ev.time_us = now;
+  ev.kind = kind;
+  ev.from = current;
+  ev.to = to;
+  ev.from_signal = signalOf(current);
+  ev.to_signal = signalOf(to);
+  ev.outage_us = outage_us;
+  ev.reason = reason;
+  if (log.size() >= ROAM_LOG_MAX) log.erase(log.begin());
+  log.push_back(ev);
+
+  printf("roam %llu.%03llu: %s %s (%d) -> %s (%d), %s",
+         (unsigned long long)(now / 1000000),
+         (unsigned long long)(now / 1000 % 1000), kKindNames[kind],
+         ev.from.empty() ? "-" : ev.from.c_str(), ev.from_signal, to.c_str(),
+         ev.to_signal, reason);
+  if (kind == ROAM_DONE || kind == ROAM_FAILED) {
+    printf(", outage %llu ms", (unsigned long long)(outage_us / 1000));
+    statsRecord(STAT_ROAM, outage_us, 0, kind == ROAM_FAILED);
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+void RoamEngine::step(uint64_t now) {
+  std::vector<WiFiNetwork> networks;
+  if (!backend->scan(networks)) return;
+  update(networks, false);
+
+  std::string bssid;
+  actuator->current(bssid);
+  if (bssid != current) {
+    if (!current.empty() && !bssid.empty()) {
+      record(now, ROAM_EXTERNAL, bssid, 0, "association changed outside policy");
+    }
+    current = bssid;
+    associated_us = now;
+    state = IDLE;
+  }
+  if (current.empty()) return;  // 未关联时由NM自动连接
+
+  if (state == WAIT_IDLE) {
+    // 等待期间每次扫描都重新确认目标仍然更好
+    if (signalOf(target) < signalOf(current) + config.hysteresis) {
+      record(now, ROAM_CANCELLED, target, 0, "target no longer better");
+      state = IDLE;
+      return;
+    }
+    tick(now);
+    return;
+  }
+
+  int cur = signalOf(current);
+  if (cur >= config.trigger_below ||
+      now - associated_us < config.min_dwell_ms * 1000ULL) {
+    return;
+  }
+  std::string candidate;
+  int signal = 0;
+  if (!bestCandidate(candidate, signal) ||
+      signal < cur + config.hysteresis) {
+    return;
+  }
+
+  // 预热：定向扫描刷新目标的BSS信息，确认不是一次偶然的强信号
+  std::vector<WiFiNetwork> fresh;
+  if (backend->scan(fresh, config.ssid.c_str())) {
+    update(fresh, true);
+  }
+  if (signalOf(candidate) < signalOf(current) + config.hysteresis) {
+    record(now, ROAM_CANCELLED, candidate, 0, "target faded on targeted scan");
+    return;
+  }
+  target = candidate;
+  decided_us = now;
+  state = WAIT_IDLE;
+  tick(now);
+}
+
+void RoamEngine::tick(uint64_t now) {
+  if (state != WAIT_IDLE) return;
+  uint64_t idle_us = idle ? idle(now) : UINT64_MAX;
+  const char *reason;
+  if (idle_us >= config.idle_ms * 1000ULL) {
+    reason = "debug link idle";
+  } else if (signalOf(current) < config.critical_below) {
+    reason = "signal critical";
+  } else if (now >= decided_us + config.max_defer_ms * 1000ULL) {
+    reason = "gave up waiting for idle link";
+  } else {
+    return;
+  }
+
+  uint64_t outage_us = 0;
+  bool ok = actuator->roam(config.ssid, target, outage_us);
+  record(now, ok ? ROAM_DONE : ROAM_FAILED, target, outage_us, reason);
+  if (ok) current = target;
+  associated_us = now;  // 失败时也按驻留时间退避
+  state = IDLE;
+}
@@ -0,0 +1,171 @@
+#ifndef ROAM_H
+#define ROAM_H
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "wifi_scan.h"
+
+// 漫游策略：在配置的SSID的各个BSSID之间选择最好的一个。
+// 每个BSSID保存信号的滑动平均；候选比当前强出滞回量、当前已驻留足够
+// 时间、且当前信号低于触发门限时才切换。决定之后先对目标做一次定向扫描
+// 预热（刷新驱动的BSS表，关联时不必再全信道扫描），再等调试链路空闲时
+// 通过执行器切换，记录决定原因和断链时间。
+
+struct RoamConfig {
+  std::string ssid;
+  int hysteresis;         // 候选至少强出多少（信号0-100）
+  int trigger_below;      // 当前信号不低于此值时不考虑漫游
+  int critical_below;     // 当前信号低于此值时不等链路空闲
+  uint32_t min_dwell_ms;  // 两次漫游之间的最短驻留
+  uint32_t min_seen;      // 候选至少出现在几次扫描中
+  uint32_t max_missed;    // 连续几次扫描缺席后丢弃历史
+  uint32_t idle_ms;       // 调试链路空闲多久才切换
+  uint32_t max_defer_ms;  // 等待空闲的上限，超过后强制切换
+
+  RoamConfig()
+      : hysteresis(10),
+        trigger_below(70),
+        critical_below(25),
+        min_dwell_ms(20000),
+        min_seen(2),
+        max_missed(3),
+        idle_ms(500),
+        max_defer_ms(15000) {}
+};
+
+// 切换执行器：实际关联由NetworkManager完成，测试时用MockRoamActuator
+class RoamActuator {
+ public:
+  virtual ~RoamActuator() {}
+  virtual bool current(std::string &bssid) = 0;  // 当前关联的BSSID
+  // 关联到指定BSSID，返回时已恢复连接（或失败）；outage_us为断链时间
+  virtual bool roam(const std::string &ssid, const std::string &bssid,
+                    uint64_t &outage_us) = 0;
+};
+
+#if HAVE_NETWORKMANAGER
+typedef struct _NMClient NMClient;
+typedef struct _NMDeviceWifi NMDeviceWifi;
+
+// 用当前活动连接重新激活，specific_object指定目标AP
+class NmRoamActuator : public RoamActuator {
+ public:
+  explicit NmRoamActuator(const char *ifname = nullptr);
+  ~NmRoamActuator();
+
+  bool current(std::string &bssid);
+  bool roam(const std::string &ssid, const std::string &bssid,
+            uint64_t &outage_us);
+
+ private:
+  NMClient *client;
+  std::string ifname;
+
+  NMDeviceWifi *device(void);
+};
+#endif
+
+class MockRoamActuator : public RoamActuator {
+ public:
+  explicit MockRoamActuator(const char *bssid = "", uint32_t outage_ms = 80)
+      : bssid(bssid), outage_ms(outage_ms), roams(0) {}
+
+  bool current(std::string &out) {
+    out = bssid;
+    return !bssid.empty();
+  }
+  bool roam(const std::string &ssid, const std::string &target,
+            uint64_t &outage_us) {
+    (void)ssid;
+    bssid = target;
+    outage_us = outage_ms * 1000ULL;
+    roams++;
+    return true;
+  }
+
+  std::string bssid;
+  uint32_t outage_ms;
+  uint32_t roams;
+};
+
+// 调试链路活动：读取统计文件中某一项的计数，计数变化即视为有流量。
+// 统计文件由导出线程定期重写，精度为导出周期
+class StatsActivity {
+ public:
+  StatsActivity(const char *path, const char *stat = "bridge.request")
+      : path(path), stat(stat), count(0), last_change_us(0) {}
+  uint64_t idleUs(uint64_t now);
+
+ private:
+  std::string path;
+  std::string stat;
+  uint64_t count;
+  uint64_t last_change_us;
+};
+
+enum RoamEventKind {
+  ROAM_DONE,       // 已切换
+  ROAM_FAILED,     // 执行器切换失败
+  ROAM_CANCELLED,  // 决定后目标变弱，放弃
+  ROAM_EXTERNAL,   // 驱动/NM自行漫游
+};
+
+struct RoamEvent {
+  uint64_t time_us;
+  RoamEventKind kind;
+  std::string from, to;
+  int from_signal, to_signal;
+  uint64_t outage_us;
+  const char *reason;
+};
+
+class RoamEngine {
+ public:
+  // 返回调试链路已空闲的微秒数；为空时视为一直空闲
+  typedef std::function<uint64_t(uint64_t now)> IdleFn;
+
+  RoamEngine(const RoamConfig &config, ScanBackend *backend,
+             RoamActuator *actuator, IdleFn idle = IdleFn());
+
+  // 一次完整扫描并更新决定；now为扫描时间
+  void step(uint64_t now);
+  // 扫描之间频繁调用：处于等待空闲状态时检查能否切换
+  void tick(uint64_t now);
+
+  const std::vector<RoamEvent> &events(void) const { return log; }
+  bool pending(void) const { return state != IDLE; }
+
+ private:
+  struct BssHistory {
+    int signal16;  // 信号的16倍滑动平均（新样本权重1/4）
+    uint32_t freq_mhz;
+    uint32_t seen;
+    uint32_t missed;
+  };
+  enum State { IDLE, WAIT_IDLE };
+
+  RoamConfig config;
+  ScanBackend *backend;
+  RoamActuator *actuator;
+  IdleFn idle;
+  std::map<std::string, BssHistory> bss;
+  std::string current;
+  uint64_t associated_us;  // 关联到当前BSSID的时间
+  State state;
+  std::string target;
+  uint64_t decided_us;
+  std::vector<RoamEvent> log;
+
+  void update(const std::vector<WiFiNetwork> &networks, bool targeted);
+  int signalOf(const std::string &bssid) const;
+  bool bestCandidate(std::string &out, int &signal) const;
+  void record(uint64_t now, RoamEventKind kind, const std::string &to,
+              uint64_t outage_us, const char *reason);
+};
+
+#endif  // ROAM_H
@@ -0,0 +1,32 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// SHA-256（FIPS 180-4），用于固件镜像的内容寻址
+
+#define SHA256_LEN 32
+
+class Sha256 {
+ public:
+  Sha256() { reset(); }
+  void reset(void);
+  void update(const void *data, size_t len);
+  void finish(uint8_t out[SHA256_LEN]);
+
+  static void hash(const void *data, size_t len, uint8_t out[SHA256_LEN]);
+
+ private:
+  uint32_t state[8];
+  uint64_t total;
+  uint8_t block[64];
+  size_t fill;
+
+  void compress(const uint8_t *p);
+};
+
+// 十六进制表示，out至少2*SHA256_LEN+1字节
+void sha256Hex(const uint8_t hash[SHA256_LEN], char *out);
+
+#endif  // SHA256_H
@@ -0,0 +1,81 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#include <atomic>
+
+// 单生产者单消费者字节环，无锁。读写位置单调递增，容量为2的幂。
+// 生产者可以用prepare()拿到空闲区直接readv进来，消费者用peek()拿到
+// 数据区直接writev出去，数据只在环里存一份。
+class SpscRing {
+ public:
+  explicit SpscRing(size_t capacity) : head(0), tail(0) {
+    size_t cap = 64;
+    while (cap < capacity) cap <<= 1;
+    buf = new uint8_t[cap];
+    mask = cap - 1;
+  }
+  ~SpscRing() { delete[] buf; }
+
+  size_t capacity(void) const { return mask + 1; }
+
+  // ===== 生产者 =====
+  size_t writable(void) const {
+    return capacity() - (head.load(std::memory_order_relaxed) -
+                         tail.load(std::memory_order_acquire));
+  }
+  // 空闲区（回绕时分两段），返回段数
+  int prepare(struct iovec iov[2]) const {
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t free = capacity() - (h - tail.load(std::memory_order_acquire));
+    return segments(h, free, iov);
+  }
+  void commit(size_t n) {
+    head.store(head.load(std::memory_order_relaxed) + n,
+               std::memory_order_release);
+  }
+
+  // ===== 消费者 =====
+  size_t readable(void) const {
+    return head.load(std::memory_order_acquire) -
+           tail.load(std::memory_order_relaxed);
+  }
+  int peek(struct iovec iov[2]) const {
+    size_t t = tail.load(std::memory_order_relaxed);
+    return segments(t, head.load(std::memory_order_acquire) - t, iov);
+  }
+  void consume(size_t n) {
+    tail.store(tail.load(std::memory_order_relaxed) + n,
+               std::memory_order_release);
+  }
+
+ private:
+  uint8_t *buf;
+  size_t mask;
+  // 读写位置分在不同缓存行，避免生产者和消费者互相失效
+  char pad0[64];
+  std::atomic<size_t> head;
+  char pad1[64];
+  std::atomic<size_t> tail;
+  char pad2[64];
+
+  int segments(size_t pos, size_t len, struct iovec iov[2]) const {
+    if (len == 0) return 0;
+    size_t off = pos & mask;
+    size_t first = capacity() - off < len ? capacity() - off : len;
+    iov[0].iov_base = buf + off;
+    iov[0].iov_len = first;
+    if (first == len) return 1;
+    iov[1].iov_base = buf;
+    iov[1].iov_len = len - first;
+    return 2;
+  }
+
+  SpscRing(const SpscRing &);
+  SpscRing &operator=(const SpscRing &);
+};
+
+#endif  // SPSC_RING_H
@@ -0,0 +1,97 @@
+#ifndef STATIC_FRAME_H
+#define STATIC_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "oled.h"
+
+// 编译期帧：把固定文本（启动画面等）在编译时渲染成页打包的整帧，
+// 运行时无需绘制，可直接随初始化一次上传。仅使用C++11 constexpr。
+// 文本按showString_GRAM的规则放置（size为12或16），不做换行。
+
+struct StaticText {
+  uint8_t x, y;  // 像素坐标
+  uint8_t size;
+  const char *str;
+};
+
+struct StaticFrame {
+  uint8_t data[OLED_PAGES * OLED_MAX_COLUMN];
+};
+
+namespace static_frame {
+
+template <size_t... I>
+struct IndexSeq {};
+
+template <class A, class B>
+struct Concat;
+template <size_t... A, size_t... B>
+struct Concat<IndexSeq<A...>, IndexSeq<B...> > {
+  typedef IndexSeq<A..., (sizeof...(A) + B)...> type;
+};
+
+// 对半拆分，模板递归深度为log2(N)
+template <size_t N>
+struct MakeIndexSeq {
+  typedef typename Concat<typename MakeIndexSeq<N / 2>::type,
+                          typename MakeIndexSeq<N - N / 2>::type>::type type;
+};
+template <>
+struct MakeIndexSeq<0> {
+  typedef IndexSeq<> type;
+};
+template <>
+struct MakeIndexSeq<1> {
+  typedef IndexSeq<0> type;
+};
+
+constexpr int length(const char *s) { return *s ? 1 + length(s + 1) : 0; }
+
+constexpr int advance(const StaticText &t) { return t.size == 16 ? 8 : 6; }
+
+// 字形第row段（8像素高）的第col列
+constexpr uint8_t glyph(const StaticText &t, int row, int dx) {
+  return t.size == 16
+             ? F8X16[(t.str[dx / 8] - ' ') * 16 + row * 8 + dx % 8]
+             : (row ? 0 : F6x8[t.str[dx / 6] - ' '][dx % 6]);
+}
+
+// 字形段起始于像素行top，取其落在page页内的部分
+constexpr uint8_t place(uint8_t bits, int top, int page) {
+  return top - page * 8 <= -8 || top - page * 8 >= 8
+             ? 0
+             : top >= page * 8 ? (uint8_t)(bits << (top - page * 8))
+                               : (uint8_t)(bits >> (page * 8 - top));
+}
+
+constexpr uint8_t textByte(const StaticText &t, int page, int col) {
+  return col < t.x || col >= t.x + length(t.str) * advance(t)
+             ? 0
+             : (uint8_t)(place(glyph(t, 0, col - t.x), t.y, page) |
+                         place(glyph(t, 1, col - t.x), t.y + 8, page));
+}
+
+constexpr uint8_t frameByte(const StaticText *texts, size_t n, size_t i) {
+  return n == 0 ? 0
+                : (uint8_t)(textByte(texts[0], i / OLED_MAX_COLUMN,
+                                     i % OLED_MAX_COLUMN) |
+                            frameByte(texts + 1, n - 1, i));
+}
+
+template <size_t... I>
+constexpr StaticFrame render(const StaticText *texts, size_t n,
+                             IndexSeq<I...>) {
+  return StaticFrame{{frameByte(texts, n, I)...}};
+}
+
+}  // namespace static_frame
+
+constexpr StaticFrame renderStaticFrame(const StaticText *texts, size_t n) {
+  return static_frame::render(
+      texts, n,
+      static_frame::MakeIndexSeq<OLED_PAGES * OLED_MAX_COLUMN>::type());
+}
+
+#endif  // STATIC_FRAME_H
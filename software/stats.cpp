@@ -0,0 +1,251 @@
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+uint64_t monotonicUs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+uint64_t processAgeUs(void) {
+  // /proc/self/stat第22个字段为进程启动时刻（开机后的时钟节拍数）
+  FILE *fp = fopen("/proc/self/stat", "r");
+  if (!fp) return 0;
+  char buf[512];
+  size_t n = fread(buf, 1, sizeof(buf) - 1, fp);
+  fclose(fp);
+  buf[n] = '\0';
+
+  char *p = strrchr(buf, ')');  // 进程名可能含空格，从最后一个')'之后开始
+  if (!p) return 0;
+  unsigned long long start = 0;
+  int field = 2;
+  for (char *tok = strtok(p + 1, " "); tok; tok = strtok(nullptr, " ")) {
+    if (++field == 22) {
+      start = strtoull(tok, nullptr, 10);
+      break;
+    }
+  }
+
+  struct timespec ts;
+  clock_gettime(CLOCK_BOOTTIME, &ts);
+  uint64_t now = (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+  uint64_t start_us = start * 1000000ULL / sysconf(_SC_CLK_TCK);
+  return now > start_us ? now - start_us : 0;
+}
+
+static const char *kStatNames[STAT_COUNT] = {
+    "i2c.writeCommand", "i2c.writeData", "i2c.refresh",
+    "raster",           "scan.duration", "scan.ap_count",
+    "record",           "boot.first_frame", "input.latency",
+    "bridge.request",   "stream.write",     "stream.drop",
+    "link.rtt",         "roam.outage",      "mirror.send",
+};
+
+// 单个统计项；只有所属线程写入，使用relaxed的load+store而非原子加
+struct StatCell {
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> bytes;
+  std::atomic<uint64_t> errors;
+  std::atomic<uint64_t> sum;
+  std::atomic<uint64_t> max;
+  std::atomic<uint64_t> hist[STATS_BUCKETS];
+};
+
+struct StatBlock {
+  StatCell cells[STAT_COUNT];
+  StatBlock() { reset(); }
+  void reset(void) {
+    for (int i = 0; i < STAT_COUNT; i++) {
+      StatCell &c = cells[i];
+      c.count = 0;
+      c.bytes = 0;
+      c.errors = 0;
+      c.sum = 0;
+      c.max = 0;
+      for (int b = 0; b < STATS_BUCKETS; b++) c.hist[b] = 0;
+    }
+  }
+};
+
+// 所有活动线程的统计块；退出线程的数据并入retired
+static std::mutex g_blocks_lock;
+static std::vector<StatBlock *> g_blocks;
+static StatBlock g_retired;
+
+static inline void bump(std::atomic<uint64_t> &v, uint64_t n) {
+  v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+struct ThreadStats {
+  StatBlock *block;
+  ThreadStats() : block(new StatBlock) {
+    std::lock_guard<std::mutex> guard(g_blocks_lock);
+    g_blocks.push_back(block);
+  }
+  ~ThreadStats() {
+    std::lock_guard<std::mutex> guard(g_blocks_lock);
+    for (int i = 0; i < STAT_COUNT; i++) {
+      StatCell &src = block->cells[i];
+      StatCell &dst = g_retired.cells[i];
+      bump(dst.count, src.count);
+      bump(dst.bytes, src.bytes);
+      bump(dst.errors, src.errors);
+      bump(dst.sum, src.sum);
+      if (src.max > dst.max) dst.max = src.max.load();
+      for (int b = 0; b < STATS_BUCKETS; b++) bump(dst.hist[b], src.hist[b]);
+    }
+    for (size_t i = 0; i < g_blocks.size(); i++) {
+      if (g_blocks[i] == block) {
+        g_blocks.erase(g_blocks.begin() + i);
+        break;
+      }
+    }
+    delete block;
+  }
+};
+
+static inline int bucketOf(uint64_t v) {
+  if (v == 0) return 0;
+  int b = 64 - __builtin_clzll(v);
+  return b > STATS_BUCKETS - 1 ? STATS_BUCKETS - 1 : b;
+}
+
+void statsRecord(StatId id, uint64_t value, uint32_t bytes, bool error) {
+  static thread_local ThreadStats tls;
+  StatCell &c = tls.block->cells[id];
+  bump(c.count, 1);
+  bump(c.bytes, bytes);
+  if (error) bump(c.errors, 1);
+  bump(c.sum, value);
+  if (value > c.max.load(std::memory_order_relaxed)) {
+    c.max.store(value, std::memory_order_relaxed);
+  }
+  bump(c.hist[bucketOf(value)], 1);
+}
+
+void StatSnapshot::add(uint64_t value, uint32_t n, bool error) {
+  count++;
+  bytes += n;
+  if (error) errors++;
+  sum += value;
+  if (value > max) max = value;
+  hist[bucketOf(value)]++;
+}
+
+const char *statsName(StatId id) { return kStatNames[id]; }
+
+static void accumulate(StatSnapshot &out, const StatCell &c) {
+  out.count += c.count.load(std::memory_order_relaxed);
+  out.bytes += c.bytes.load(std::memory_order_relaxed);
+  out.errors += c.errors.load(std::memory_order_relaxed);
+  out.sum += c.sum.load(std::memory_order_relaxed);
+  uint64_t m = c.max.load(std::memory_order_relaxed);
+  if (m > out.max) out.max = m;
+  for (int b = 0; b < STATS_BUCKETS; b++) {
+    out.hist[b] += c.hist[b].load(std::memory_order_relaxed);
+  }
+}
+
+void statsSnapshot(StatId id, StatSnapshot &out) {
+  memset(&out, 0, sizeof(out));
+  std::lock_guard<std::mutex> guard(g_blocks_lock);
+  accumulate(out, g_retired.cells[id]);
+  for (size_t i = 0; i < g_blocks.size(); i++) {
+    accumulate(out, g_blocks[i]->cells[id]);
+  }
+}
+
+uint64_t StatSnapshot::percentile(double p) const {
+  if (count == 0) return 0;
+  uint64_t target = (uint64_t)(p * count);
+  if (target == 0) target = 1;
+  uint64_t seen = 0;
+  for (int b = 0; b < STATS_BUCKETS; b++) {
+    seen += hist[b];
+    if (seen >= target) return b == 0 ? 0 : (1ULL << b) - 1;
+  }
+  return max;
+}
+
+void statsDump(FILE *fp) {
+  for (int i = 0; i < STAT_COUNT; i++) {
+    StatSnapshot s;
+    statsSnapshot((StatId)i, s);
+    fprintf(fp,
+            "%s count=%llu bytes=%llu errors=%llu avg=%llu p50=%llu "
+            "p90=%llu p99=%llu max=%llu hist=",
+            kStatNames[i], (unsigned long long)s.count,
+            (unsigned long long)s.bytes, (unsigned long long)s.errors,
+            (unsigned long long)(s.count ? s.sum / s.count : 0),
+            (unsigned long long)s.percentile(0.5),
+            (unsigned long long)s.percentile(0.9),
+            (unsigned long long)s.percentile(0.99),
+            (unsigned long long)s.max);
+    // 直方图只输出到最后一个非空桶
+    int last = STATS_BUCKETS - 1;
+    while (last > 0 && s.hist[last] == 0) last--;
+    for (int b = 0; b <= last; b++) {
+      fprintf(fp, b ? ",%llu" : "%llu", (unsigned long long)s.hist[b]);
+    }
+    fprintf(fp, "\n");
+  }
+}
+
+// ========== 统计文件导出 ==========
+static std::thread g_exporter;
+static std::mutex g_exporter_lock;
+static std::condition_variable g_exporter_cv;
+static bool g_exporter_stop = false;
+
+// exit()或main返回时导出线程仍在运行则先停止，不销毁可join的线程
+static struct ExporterGuard {
+  ~ExporterGuard() { statsStopExporter(); }
+} g_exporter_guard;
+
+static void writeStatsFile(const std::string &path) {
+  std::string tmp = path + ".tmp";
+  FILE *fp = fopen(tmp.c_str(), "w");
+  if (!fp) return;
+  fprintf(fp, "uptime_us %llu\n", (unsigned long long)monotonicUs());
+  statsDump(fp);
+  fclose(fp);
+  rename(tmp.c_str(), path.c_str());
+}
+
+bool statsStartExporter(const char *path, uint32_t interval_ms) {
+  if (g_exporter.joinable()) return false;
+  g_exporter_stop = false;
+  std::string file(path);
+  g_exporter = std::thread([file, interval_ms]() {
+    std::unique_lock<std::mutex> guard(g_exporter_lock);
+    while (!g_exporter_stop) {
+      writeStatsFile(file);
+      g_exporter_cv.wait_for(guard, std::chrono::milliseconds(interval_ms));
+    }
+    writeStatsFile(file);
+  });
+  return true;
+}
+
+void statsStopExporter(void) {
+  if (!g_exporter.joinable()) return;
+  {
+    std::lock_guard<std::mutex> guard(g_exporter_lock);
+    g_exporter_stop = true;
+  }
+  g_exporter_cv.notify_all();
+  g_exporter.join();
+}
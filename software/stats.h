@@ -0,0 +1,76 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// 运行统计：计数器 + 对数分桶延迟直方图。
+// 每个线程写自己的统计块（无锁、无原子读改写），读取时再汇总；
+// 导出线程定期重写统计文件，供本地脚本抓取。
+
+uint64_t monotonicUs(void);  // CLOCK_MONOTONIC，微秒
+uint64_t processAgeUs(void);  // 进程启动至今（含exec和动态链接），精度为时钟节拍
+
+enum StatId {
+  STAT_I2C_COMMAND,  // OLED::writeCommand
+  STAT_I2C_DATA,     // OLED::writeData / 突发数据
+  STAT_I2C_REFRESH,  // 整帧/增量刷新
+  STAT_RASTER,       // 光栅化（显示列表、动画帧）
+  STAT_SCAN,         // WiFi扫描耗时
+  STAT_SCAN_APS,     // 每次扫描的AP数量（值直方图）
+  STAT_RECORD,       // 帧录制（编码+写文件）
+  STAT_BOOT,         // 进程启动到首帧上屏
+  STAT_INPUT,        // 读到按键边沿到界面上屏
+  STAT_BRIDGE,       // J-Link桥：请求收到到探针应答
+  STAT_STREAM,       // RTT/SWO流：每次写套接字的字节数
+  STAT_STREAM_DROP,  // RTT/SWO流：环满时丢弃的字节数
+  STAT_LINK_RTT,     // 链路监视：UDP回显往返时间（丢失记为错误）
+  STAT_ROAM,         // 漫游：切换造成的断链时间（失败记为错误）
+  STAT_MIRROR,       // 帧镜像：每条发给查看器的消息字节数
+  STAT_COUNT,
+};
+
+#define STATS_BUCKETS 33  // 桶0为0，桶k(k>=1)为[2^(k-1), 2^k)
+
+struct StatSnapshot {
+  uint64_t count;
+  uint64_t bytes;
+  uint64_t errors;
+  uint64_t sum;  // 数值总和（延迟为微秒）
+  uint64_t max;
+  uint64_t hist[STATS_BUCKETS];
+
+  uint64_t percentile(double p) const;  // 返回所在桶的上界
+  // 单线程直接累加到快照（如桥为每个连接单独记的延迟）
+  void add(uint64_t value, uint32_t bytes = 0, bool error = false);
+};
+
+// 记录一次事件：value为延迟（微秒）或数值
+void statsRecord(StatId id, uint64_t value, uint32_t bytes = 0,
+                 bool error = false);
+const char *statsName(StatId id);
+void statsSnapshot(StatId id, StatSnapshot &out);  // 汇总所有线程
+void statsDump(FILE *fp);
+
+// 在析构时记录从构造开始经过的时间
+class StatsTimer {
+ public:
+  explicit StatsTimer(StatId id, uint32_t bytes = 0)
+      : id(id), bytes(bytes), error(false), start(monotonicUs()) {}
+  ~StatsTimer() { statsRecord(id, monotonicUs() - start, bytes, error); }
+
+  void addBytes(uint32_t n) { bytes += n; }
+  void fail(void) { error = true; }
+
+ private:
+  StatId id;
+  uint32_t bytes;
+  bool error;
+  uint64_t start;
+};
+
+// 统计文件导出：每interval_ms毫秒写临时文件后rename，读者总能看到完整内容
+bool statsStartExporter(const char *path, uint32_t interval_ms = 1000);
+void statsStopExporter(void);
+
+#endif  // STATS_H
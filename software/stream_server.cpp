@@ -0,0 +1,452 @@
+#include "stream_server.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "stats.h"
+
+// ========== 数据源 ==========
+static speed_t baudConstant(uint32_t baud) {
+  switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 921600: return B921600;
+    case 1000000: return B1000000;
+    case 1500000: return B1500000;
+    case 2000000: return B2000000;
+    case 3000000: return B3000000;
+    case 4000000: return B4000000;
+  }
+  return 0;
+}
+
+DeviceSource::DeviceSource(const char *path, uint32_t baud)
+    : path(path), baud(baud), dev_fd(-1) {}
+
+bool DeviceSource::open(void) {
+  dev_fd = ::open(path.c_str(), O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (dev_fd < 0) {
+    perror(path.c_str());
+    return false;
+  }
+  if (baud) {
+    speed_t speed = baudConstant(baud);
+    struct termios tio;
+    if (!speed || tcgetattr(dev_fd, &tio) < 0) {
+      fprintf(stderr, "%s: cannot set %u baud\n", path.c_str(), baud);
+      close();
+      return false;
+    }
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tcsetattr(dev_fd, TCSANOW, &tio);
+    tcflush(dev_fd, TCIFLUSH);
+  }
+  return true;
+}
+
+void DeviceSource::close(void) {
+  if (dev_fd >= 0) ::close(dev_fd);
+  dev_fd = -1;
+}
+
+ssize_t DeviceSource::read(const struct iovec *iov, int n) {
+  return readv(dev_fd, iov, n);
+}
+
+SyntheticSource::SyntheticSource(uint32_t bytes_per_sec, uint32_t burst)
+    : burst(burst ? burst : 1),
+      interval_us(0),
+      timer_fd(-1),
+      owed(0),
+      line(0) {
+  // 低速率时减小每批字节数，保证每秒至少100批
+  if (bytes_per_sec && this->burst > bytes_per_sec / 100) {
+    this->burst = bytes_per_sec / 100 ? bytes_per_sec / 100 : 1;
+  }
+  uint64_t us = bytes_per_sec ? (uint64_t)this->burst * 1000000 / bytes_per_sec
+                              : 1000000;
+  interval_us = us ? (uint32_t)us : 1;
+}
+
+bool SyntheticSource::open(void) {
+  timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd < 0) {
+    perror("timerfd_create");
+    return false;
+  }
+  struct itimerspec its;
+  its.it_interval.tv_sec = interval_us / 1000000;
+  its.it_interval.tv_nsec = interval_us % 1000000 * 1000;
+  its.it_value = its.it_interval;
+  timerfd_settime(timer_fd, 0, &its, nullptr);
+  return true;
+}
+
+void SyntheticSource::close(void) {
+  if (timer_fd >= 0) ::close(timer_fd);
+  timer_fd = -1;
+}
+
+ssize_t SyntheticSource::read(const struct iovec *iov, int n) {
+  uint64_t ticks;
+  if (::read(timer_fd, &ticks, sizeof(ticks)) == sizeof(ticks)) {
+    owed += ticks * burst;
+  }
+  if (!owed) {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  // 按行产生带序号的日志文本，主机端可以据此检查丢失
+  size_t total = 0;
+  for (int i = 0; i < n && owed; i++) {
+    uint8_t *p = (uint8_t *)iov[i].iov_base;
+    size_t space = iov[i].iov_len;
+    while (space && owed) {
+      if (pending.empty()) {
+        char text[64];
+        snprintf(text, sizeof(text), "[%08u] rtt: synthetic target log line\n",
+                 line++);
+        pending = text;
+      }
+      size_t k = pending.size();
+      if (k > space) k = space;
+      if (k > owed) k = owed;
+      memcpy(p, pending.data(), k);
+      pending.erase(0, k);
+      p += k;
+      space -= k;
+      owed -= k;
+      total += k;
+    }
+  }
+  return total;
+}
+
+// ========== 流服务 ==========
+// 事件来源编码：通道序号 << 2 | 类型
+enum {
+  EVENT_LISTEN,
+  EVENT_CLIENT,
+  EVENT_RING,
+};
+#define EVENT_STOP UINT64_MAX
+
+static int listenTcp(uint16_t &port) {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) return -1;
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_ANY);
+  sa.sin_port = htons(port);
+  socklen_t len = sizeof(sa);
+  if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || listen(fd, 2) < 0 ||
+      getsockname(fd, (struct sockaddr *)&sa, &len) < 0) {
+    close(fd);
+    return -1;
+  }
+  port = ntohs(sa.sin_port);
+  return fd;
+}
+
+StreamServer::StreamServer(uint32_t ring_bytes)
+    : ring_bytes(ring_bytes), epoll_fd(-1), stop_fd(-1), started(false) {}
+
+StreamServer::~StreamServer() {
+  stop();
+  for (size_t i = 0; i < chans.size(); i++) {
+    Channel *c = chans[i];
+    dropClient(c);
+    if (c->listen_fd >= 0) close(c->listen_fd);
+    if (c->event_fd >= 0) close(c->event_fd);
+    delete c->source;
+    delete c;
+  }
+  if (epoll_fd >= 0) close(epoll_fd);
+  if (stop_fd >= 0) close(stop_fd);
+}
+
+void StreamServer::addChannel(const char *name, StreamSource *source,
+                              uint16_t port) {
+  Channel *c = new Channel(ring_bytes);
+  c->name = name;
+  c->source = source;
+  c->port = port;
+  c->listen_fd = -1;
+  c->client_fd = -1;
+  c->event_fd = -1;
+  c->blocked = false;
+  c->idle = false;
+  c->produced = c->dropped = c->max_fill = 0;
+  c->sent = c->writes = c->stalls = 0;
+  chans.push_back(c);
+}
+
+bool StreamServer::start(void) {
+  stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (stop_fd < 0 || epoll_fd < 0) {
+    perror("stream server");
+    return false;
+  }
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u64 = EVENT_STOP;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &ev);
+
+  for (size_t i = 0; i < chans.size(); i++) {
+    Channel *c = chans[i];
+    if (!c->source->open()) return false;
+    c->listen_fd = listenTcp(c->port);
+    c->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (c->listen_fd < 0 || c->event_fd < 0) {
+      perror(c->name.c_str());
+      return false;
+    }
+    ev.data.u64 = i << 2 | EVENT_LISTEN;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->listen_fd, &ev);
+    ev.data.u64 = i << 2 | EVENT_RING;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->event_fd, &ev);
+  }
+
+  for (size_t i = 0; i < chans.size(); i++) {
+    chans[i]->producer = std::thread(&StreamServer::produce, this, chans[i]);
+  }
+  loop = std::thread(&StreamServer::run, this);
+  started = true;
+  return true;
+}
+
+void StreamServer::stop(void) {
+  if (!started) return;
+  // stop_fd保持可读，所有线程都能看到
+  uint64_t one = 1;
+  if (write(stop_fd, &one, sizeof(one)) < 0) perror("stream stop");
+  for (size_t i = 0; i < chans.size(); i++) chans[i]->producer.join();
+  loop.join();
+  for (size_t i = 0; i < chans.size(); i++) chans[i]->source->close();
+  started = false;
+}
+
+StreamServer::Counters StreamServer::counters(size_t i) const {
+  const Channel *c = chans[i];
+  Counters out;
+  out.produced = c->produced.load(std::memory_order_relaxed);
+  out.dropped = c->dropped.load(std::memory_order_relaxed);
+  out.sent = c->sent.load(std::memory_order_relaxed);
+  out.writes = c->writes.load(std::memory_order_relaxed);
+  out.stalls = c->stalls.load(std::memory_order_relaxed);
+  out.max_fill = c->max_fill.load(std::memory_order_relaxed);
+  return out;
+}
+
+// 生产者线程：把数据源读空到环里，环满时读出来丢弃，避免数据源侧溢出
+void StreamServer::produce(Channel *c) {
+  uint8_t scratch[4096];
+  struct pollfd pfd[2];
+  pfd[0].fd = c->source->fd();
+  pfd[0].events = POLLIN;
+  pfd[1].fd = stop_fd;
+  pfd[1].events = POLLIN;
+
+  for (;;) {
+    if (poll(pfd, 2, -1) < 0) {
+      if (errno == EINTR) continue;
+      perror("stream poll");
+      return;
+    }
+    if (pfd[1].revents) return;
+
+    for (;;) {
+      struct iovec iov[2];
+      int n = c->ring.prepare(iov);
+      ssize_t r;
+      if (n == 0) {
+        struct iovec drop = {scratch, sizeof(scratch)};
+        r = c->source->read(&drop, 1);
+        if (r > 0) {
+          c->dropped.fetch_add(r, std::memory_order_relaxed);
+          statsRecord(STAT_STREAM_DROP, r, r, true);
+        }
+      } else {
+        r = c->source->read(iov, n);
+        if (r > 0) {
+          c->ring.commit(r);
+          c->produced.fetch_add(r, std::memory_order_relaxed);
+          uint64_t fill = c->ring.capacity() - c->ring.writable();
+          if (fill > c->max_fill.load(std::memory_order_relaxed)) {
+            c->max_fill.store(fill, std::memory_order_relaxed);
+          }
+          // 服务线程已取空环并在等待时才通知，持续写入时不产生系统调用
+          std::atomic_thread_fence(std::memory_order_seq_cst);
+          if (c->idle.exchange(false)) {
+            uint64_t one = 1;
+            if (write(c->event_fd, &one, sizeof(one)) < 0) perror("stream");
+          }
+        }
+      }
+      if (r > 0) continue;
+      if (r == 0) {
+        fprintf(stderr, "stream %s: source closed\n", c->name.c_str());
+        return;
+      }
+      if (errno != EINTR) break;  // EAGAIN：已读空
+    }
+  }
+}
+
+void StreamServer::accept(Channel *c) {
+  int fd = ::accept4(c->listen_fd, nullptr, nullptr,
+                     SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (fd < 0) return;
+  if (c->client_fd >= 0) {
+    close(fd);  // 每个通道只有一个读者
+    return;
+  }
+  // 批量由drain()控制，小的日志行不需要再等Nagle
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  c->client_fd = fd;
+  c->blocked = false;
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u64 = (uint64_t)(std::find(chans.begin(), chans.end(), c) -
+                           chans.begin()) << 2 |
+                EVENT_CLIENT;
+  epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+  printf("stream %s: client connected\n", c->name.c_str());
+  drain(c);  // 先发出连接前积压的数据
+}
+
+void StreamServer::dropClient(Channel *c) {
+  if (c->client_fd < 0) return;
+  close(c->client_fd);
+  c->client_fd = -1;
+  c->blocked = false;
+  c->idle = false;  // 没有读者时不需要通知，数据留在环里
+  printf("stream %s: client disconnected\n", c->name.c_str());
+}
+
+// 把环里所有数据写到套接字，每次writev带上环的两段
+void StreamServer::drain(Channel *c) {
+  if (c->client_fd < 0 || c->blocked) return;
+  for (;;) {
+    struct iovec iov[2];
+    int n = c->ring.peek(iov);
+    if (n == 0) {
+      // 先声明空闲再复查，避免和生产者的通知错过
+      c->idle.store(true);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (c->ring.readable() == 0) return;
+      c->idle.store(false);
+      continue;
+    }
+
+    size_t want = iov[0].iov_len + (n > 1 ? iov[1].iov_len : 0);
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = n;
+    ssize_t w = sendmsg(c->client_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (w < 0 && errno == EINTR) continue;
+    if (w < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      dropClient(c);
+      return;
+    }
+    if (w > 0) {
+      c->ring.consume(w);
+      c->sent.fetch_add(w, std::memory_order_relaxed);
+      c->writes.fetch_add(1, std::memory_order_relaxed);
+      statsRecord(STAT_STREAM, w, w);
+    }
+    if (w < (ssize_t)want) {
+      // 主机读得慢：停止取数据，等套接字可写；期间环满由生产者丢弃
+      c->blocked = true;
+      c->stalls.fetch_add(1, std::memory_order_relaxed);
+      struct epoll_event ev;
+      ev.events = EPOLLIN | EPOLLOUT;
+      ev.data.u64 = (uint64_t)(std::find(chans.begin(), chans.end(), c) -
+                               chans.begin()) << 2 |
+                    EVENT_CLIENT;
+      epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->client_fd, &ev);
+      return;
+    }
+  }
+}
+
+void StreamServer::run(void) {
+  struct epoll_event events[16];
+  for (;;) {
+    int n = epoll_wait(epoll_fd, events, 16, -1);
+    if (n < 0 && errno != EINTR) {
+      perror("epoll_wait");
+      return;
+    }
+    for (int i = 0; i < n; i++) {
+      uint64_t tag = events[i].data.u64;
+      if (tag == EVENT_STOP) return;
+      Channel *c = chans[tag >> 2];
+      switch (tag & 3) {
+        case EVENT_LISTEN:
+          accept(c);
+          break;
+        case EVENT_RING: {
+          uint64_t count;
+          if (read(c->event_fd, &count, sizeof(count)) < 0) break;
+          drain(c);
+          break;
+        }
+        case EVENT_CLIENT: {
+          if (c->client_fd < 0) break;
+          if (events[i].events & EPOLLIN) {
+            // 上行通道不接收数据，读到的内容丢弃，只用来发现断开
+            char buf[256];
+            ssize_t r = recv(c->client_fd, buf, sizeof(buf), MSG_DONTWAIT);
+            if (r == 0 || (r < 0 && errno != EAGAIN && errno != EINTR)) {
+              dropClient(c);
+              break;
+            }
+          }
+          if (events[i].events & (EPOLLHUP | EPOLLERR)) {
+            dropClient(c);
+            break;
+          }
+          if ((events[i].events & EPOLLOUT) && c->blocked) {
+            c->blocked = false;
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.u64 = tag;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->client_fd, &ev);
+            drain(c);
+          }
+          break;
+        }
+      }
+    }
+  }
+}
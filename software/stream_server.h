@@ -0,0 +1,128 @@
+#ifndef STREAM_SERVER_H
+#define STREAM_SERVER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spsc_ring.h"
+
+// RTT/SWO上行流：每个通道一个TCP端口，和调试命令通道完全分开。
+// 生产者线程从数据源读进SPSC环，服务线程把环里的数据成批写到套接字。
+// 主机读得慢时套接字写满，服务线程停止取数据，环满后生产者丢弃新数据并计数；
+// 目标端（SWO引脚、RTT缓冲）无法暂停，丢弃只发生在桥上，不会拖慢命令通道。
+
+// 数据源：fd()可读时调用read()，非阻塞
+class StreamSource {
+ public:
+  virtual ~StreamSource() {}
+  virtual bool open(void) = 0;
+  virtual void close(void) = 0;
+  virtual int fd(void) const = 0;
+  // 读进iov，返回字节数；暂无数据返回-1且errno为EAGAIN，结束返回0
+  virtual ssize_t read(const struct iovec *iov, int n) = 0;
+};
+
+// 串口/FIFO/字符设备。SWO用NRZ（UART）编码时可以直接接到串口上采集；
+// baud为0时不设置串口参数（FIFO、由其他进程转发的RTT等）
+class DeviceSource : public StreamSource {
+ public:
+  DeviceSource(const char *path, uint32_t baud = 0);
+  ~DeviceSource() { close(); }
+
+  bool open(void);
+  void close(void);
+  int fd(void) const { return dev_fd; }
+  ssize_t read(const struct iovec *iov, int n);
+
+ private:
+  std::string path;
+  uint32_t baud;
+  int dev_fd;
+};
+
+// 模拟目标：按固定速率成批产生日志行，用于负载测试
+class SyntheticSource : public StreamSource {
+ public:
+  SyntheticSource(uint32_t bytes_per_sec, uint32_t burst = 4096);
+  ~SyntheticSource() { close(); }
+
+  bool open(void);
+  void close(void);
+  int fd(void) const { return timer_fd; }
+  ssize_t read(const struct iovec *iov, int n);
+
+ private:
+  uint32_t burst;
+  uint32_t interval_us;
+  int timer_fd;
+  uint64_t owed;  // 已到期、尚未产生的字节
+  uint32_t line;
+  std::string pending;  // 当前日志行未输出的部分
+};
+
+class StreamServer {
+ public:
+  struct Counters {
+    uint64_t produced;  // 从数据源读进环的字节
+    uint64_t dropped;   // 环满时丢弃的字节
+    uint64_t sent;      // 写到套接字的字节
+    uint64_t writes;    // 写套接字的系统调用次数
+    uint64_t stalls;    // 套接字写满（EAGAIN）的次数
+    uint64_t max_fill;  // 环的最高水位
+  };
+
+  explicit StreamServer(uint32_t ring_bytes = 256 * 1024);
+  ~StreamServer();
+
+  // 接管source；port为0时由内核分配，start()后用port()查询
+  void addChannel(const char *name, StreamSource *source, uint16_t port);
+  bool start(void);
+  void stop(void);
+
+  size_t channels(void) const { return chans.size(); }
+  const char *name(size_t i) const { return chans[i]->name.c_str(); }
+  uint16_t port(size_t i) const { return chans[i]->port; }
+  Counters counters(size_t i) const;
+
+ private:
+  struct Channel {
+    std::string name;
+    StreamSource *source;
+    uint16_t port;
+    SpscRing ring;
+    int listen_fd;
+    int client_fd;
+    int event_fd;  // 生产者通知服务线程
+    bool blocked;  // 套接字写满，等待EPOLLOUT
+    std::atomic<bool> idle;  // 服务线程已取空环，下一次写入需要通知
+    std::thread producer;
+
+    // 各由一个线程写入，counters()可在任意线程读取
+    std::atomic<uint64_t> produced, dropped, max_fill;  // 生产者
+    std::atomic<uint64_t> sent, writes, stalls;         // 服务线程
+
+    Channel(uint32_t ring_bytes) : ring(ring_bytes) {}
+  };
+
+  uint32_t ring_bytes;
+  std::vector<Channel *> chans;
+  int epoll_fd;
+  int stop_fd;
+  std::thread loop;
+  bool started;
+
+  void produce(Channel *c);
+  void run(void);
+  void accept(Channel *c);
+  void dropClient(Channel *c);
+  void drain(Channel *c);
+
+  StreamServer(const StreamServer &);
+  StreamServer &operator=(const StreamServer &);
+};
+
+#endif  // STREAM_SERVER_H
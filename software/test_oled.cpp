@@ -5,6 +5,7 @@
 
 #include <iostream>
 
+#include "animation.h"
 #include "oled.h"
 
 OLED *oled = nullptr;
@@ -70,16 +71,21 @@ int main() {
   oled->refresh();
   delay(3000);
 
-  // 测试3: 动画效果（使用局部刷新）
+  // 测试3: 动画效果（按帧预算调度，只上传变化区域）
   std::cout << "Test 3: Animation with partial refresh..." << std::endl;
-  for (int i = 0; i < 5; i++) {
-    oled->clear();
-
+  {
+    Animator animator(*oled, 33333);
+    animator.setBackground([](OLED &o) {
+      o.showString_GRAM(5, 40, "Animation Test", 12);
+    });
     // 移动的方块
-    oled->fillRect(10 + i * 20, 10, 30 + i * 20, 30, OLED_COLOR_WHITE);
-    oled->showString(5, 40, "Animation Test", 12);
-    oled->refresh();
-    delay(500);
+    animator.add(new SlideAnimation(
+        10, 10, 90, 10, 2000000, [](OLED &o, int x, int y) {
+          o.fillRect_GRAM(x, y, x + 20, y + 20, WHITE);
+        }));
+    animator.add(new BlinkAnimation(0, 38, 127, 49, 500000, 4));
+    animator.run();
+    animator.printStats();
   }
 
   // 测试4: 像素级操作
@@ -0,0 +1,274 @@
+#include "text_layout.h"
+
+#include <math.h>
+#include <string.h>
+
+// 省略号占一个字符宽，用专门的三点字形，不占三个'.'的位置
+static const uint8_t kEllipsis6x8[6] = {0x40, 0x00, 0x40, 0x00, 0x40, 0x00};
+static const uint8_t kEllipsis8x16[8] = {0x00, 0x30, 0x00, 0x30,
+                                         0x00, 0x30, 0x00, 0x00};
+
+static const uint32_t kPow10[10] = {1,      10,      100,      1000,
+                                    10000,  100000,  1000000,  10000000,
+                                    100000000, 1000000000};
+
+// ========== 排版 ==========
+int textLayout(const char *str, uint8_t size, int max_width,
+               TextOverflow mode, TextLine *lines, int max_lines) {
+  int cap = max_width / textCharWidth(size);  // 每行字符数
+  if (cap > TEXT_LINE_CHARS - 1) cap = TEXT_LINE_CHARS - 1;
+  if (cap <= 0 || max_lines <= 0) return 0;
+
+  int n = 0;
+  size_t pos = 0;
+  while (n < max_lines) {
+    // 换行后的行首空格不占位置
+    if (mode == TEXT_WRAP && n > 0) {
+      while (str[pos] == ' ') pos++;
+    }
+    if (str[pos] == '\0' && n > 0) break;
+
+    TextLine &line = lines[n++];
+    line.start = (uint16_t)pos;
+    line.ellipsis = false;
+    int len = 0, last_space = -1;
+    bool newline = false;
+    while (len < cap && str[pos + len] != '\0') {
+      char c = str[pos + len];
+      if (c == '\n') {
+        newline = true;
+        break;
+      }
+      if (c == ' ') last_space = len;
+      len++;
+    }
+    char next = str[pos + len];
+    bool overflow = !newline && next != '\0';
+    bool last = n == max_lines || mode != TEXT_WRAP;
+
+    if (overflow && last) {
+      if (mode != TEXT_CLIP) {
+        len--;
+        line.ellipsis = true;
+      }
+    } else if (overflow && next != ' ' && last_space > 0) {
+      len = last_space;  // 在单词边界换行，空格留给下一行跳过
+    }
+    line.len = (uint8_t)len;
+    line.width = (uint8_t)((len + line.ellipsis) * textCharWidth(size));
+    pos += len;
+    if (newline) {
+      if (mode != TEXT_WRAP) break;
+      pos++;
+    }
+    if (last || str[pos] == '\0') break;
+  }
+  return n;
+}
+
+// ========== 数字格式化 ==========
+// 从end向前写value的十进制数字，至少min_digits位（不足补0），返回起始位置
+static char *writeDigits(char *end, uint32_t value, int min_digits) {
+  char *p = end;
+  do {
+    *--p = (char)('0' + value % 10);
+    value /= 10;
+    min_digits--;
+  } while (value || min_digits > 0);
+  return p;
+}
+
+// 把[p, end)右对齐到width复制进buf
+static int finish(char *buf, const char *p, const char *end, int width) {
+  int len = (int)(end - p);
+  if (width > TEXT_NUM_BUF - 1) width = TEXT_NUM_BUF - 1;
+  int pad = width > len ? width - len : 0;
+  memset(buf, ' ', pad);
+  memcpy(buf + pad, p, len);
+  buf[pad + len] = '\0';
+  return pad + len;
+}
+
+int formatInt(char *buf, int32_t value, int width) {
+  char tmp[16];
+  char *end = tmp + sizeof(tmp);
+  uint32_t mag = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+  char *p = writeDigits(end, mag, 1);
+  if (value < 0) *--p = '-';
+  return finish(buf, p, end, width);
+}
+
+int formatFixed(char *buf, int32_t value, int decimals, int width) {
+  if (decimals <= 0) return formatInt(buf, value, width);
+  if (decimals > 9) decimals = 9;
+  char tmp[16];
+  char *end = tmp + sizeof(tmp);
+  uint32_t mag = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+  char *p = writeDigits(end, mag % kPow10[decimals], decimals);
+  *--p = '.';
+  p = writeDigits(p, mag / kPow10[decimals], 1);
+  if (value < 0) *--p = '-';
+  return finish(buf, p, end, width);
+}
+
+int formatFloat(char *buf, float value, int decimals, int width) {
+  // NaN与任何值比较都为假，夹不住，转换成整数是未定义行为
+  if (isnan(value) || isinf(value)) {
+    const char *token = isnan(value) ? "nan" : value < 0 ? "-inf" : "inf";
+    return finish(buf, token, token + strlen(token), width);
+  }
+  if (decimals < 0) decimals = 0;
+  if (decimals > 9) decimals = 9;
+  double scaled = (double)value * kPow10[decimals];
+  scaled += scaled < 0 ? -0.5 : 0.5;
+  if (scaled > 2147483647.0) scaled = 2147483647.0;
+  if (scaled < -2147483647.0) scaled = -2147483647.0;
+  return formatFixed(buf, (int32_t)scaled, decimals, width);
+}
+
+// ========== 行精灵缓存 ==========
+static uint32_t hashLine(const char *text, size_t len, uint8_t size,
+                         uint8_t max_width, bool ellipsis) {
+  uint32_t h = 2166136261u;  // FNV-1a
+  for (size_t i = 0; i < len; i++) h = (h ^ (uint8_t)text[i]) * 16777619u;
+  h = (h ^ size) * 16777619u;
+  h = (h ^ max_width) * 16777619u;
+  return (h ^ ellipsis) * 16777619u;
+}
+
+TextCache::TextCache() { clear(); }
+
+void TextCache::clear(void) {
+  memset(entries, 0, sizeof(entries));
+  memset(buckets, 0xFF, sizeof(buckets));  // 全部-1
+  clock = 0;
+  hit_count = miss_count = 0;
+}
+
+const TextCache::Entry *TextCache::lookup(const char *text,
+                                          const TextLine &line, uint8_t size,
+                                          uint8_t max_width) {
+  const char *s = text + line.start;
+  uint32_t h = hashLine(s, line.len, size, max_width, line.ellipsis);
+  int16_t *bucket = &buckets[h % (TEXT_CACHE_ENTRIES * 2)];
+  for (int i = *bucket; i >= 0; i = entries[i].next) {
+    Entry &e = entries[i];
+    if (e.hash == h && e.size == size && e.max_width == max_width &&
+        e.len == line.len && e.ellipsis == line.ellipsis &&
+        memcmp(e.text, s, line.len) == 0) {
+      e.last_used = ++clock;
+      hit_count++;
+      return &e;
+    }
+  }
+
+  // 未命中：取空项或最久未用的项
+  miss_count++;
+  int victim = 0;
+  for (int i = 0; i < TEXT_CACHE_ENTRIES; i++) {
+    if (!entries[i].valid) {
+      victim = i;
+      break;
+    }
+    if (entries[i].last_used < entries[victim].last_used) victim = i;
+  }
+  Entry &e = entries[victim];
+  if (e.valid) {
+    int16_t *link = &buckets[e.hash % (TEXT_CACHE_ENTRIES * 2)];
+    while (*link != victim) link = &entries[*link].next;
+    *link = e.next;
+  }
+  e.hash = h;
+  e.size = size;
+  e.max_width = max_width;
+  e.len = line.len;
+  e.width = line.width;
+  e.ellipsis = line.ellipsis;
+  e.valid = true;
+  e.last_used = ++clock;
+  memcpy(e.text, s, line.len);
+  render(e, s);
+  e.next = *bucket;
+  *bucket = (int16_t)victim;
+  return &e;
+}
+
+void TextCache::render(Entry &e, const char *text) {
+  memset(e.sprite, 0, sizeof(e.sprite));
+  int cw = textCharWidth(e.size);
+  for (int i = 0; i <= e.len; i++) {
+    uint8_t *top = e.sprite[0] + i * cw, *bottom = e.sprite[1] + i * cw;
+    if (i == e.len) {
+      if (!e.ellipsis) break;
+      if (cw == 8) {
+        memcpy(bottom, kEllipsis8x16, 8);
+      } else {
+        memcpy(top, kEllipsis6x8, 6);
+      }
+      break;
+    }
+    unsigned char c = (unsigned char)text[i];
+    if (c < ' ' || c > '~') c = '?';
+    c -= ' ';
+    if (cw == 8) {
+      memcpy(top, &F8X16[c * 16], 8);
+      memcpy(bottom, &F8X16[c * 16 + 8], 8);
+    } else {
+      memcpy(top, F6x8[c], 6);
+    }
+  }
+}
+
+void TextCache::blit(OLED &oled, uint8_t x, uint8_t y, const Entry &e) {
+  int w = oled.getWidth(), h = oled.getHeight();
+  if (x >= w || y >= h) return;
+  int cols = e.width < w - x ? e.width : w - x;
+  int pages = e.size == 16 ? 2 : 1;
+  int page = y / 8, shift = y % 8;
+
+  for (int p = 0; p < pages && (page + p) * 8 < h; p++) {
+    const uint8_t *src = e.sprite[p];
+    uint8_t *dst = oled.getPage_GRAM(page + p) + x;
+    if (shift == 0) {
+      memcpy(dst, src, cols);
+      continue;
+    }
+    // 跨页：低页保留上方shift行，高页保留下方8-shift行
+    uint8_t keep = (uint8_t)((1 << shift) - 1);
+    for (int c = 0; c < cols; c++) {
+      dst[c] = (uint8_t)((dst[c] & keep) | (src[c] << shift));
+    }
+    if ((page + p + 1) * 8 >= h) continue;
+    uint8_t *next = oled.getPage_GRAM(page + p + 1) + x;
+    for (int c = 0; c < cols; c++) {
+      next[c] = (uint8_t)((next[c] & ~keep) | (src[c] >> (8 - shift)));
+    }
+  }
+}
+
+int TextCache::draw(OLED &oled, uint8_t x, uint8_t y, const char *str,
+                    uint8_t size, int max_width, TextOverflow mode,
+                    int max_lines) {
+  int avail = oled.getWidth() - x;
+  if (avail <= 0) return 0;
+  if (max_width <= 0 || max_width > avail) max_width = avail;
+  if (max_lines > TEXT_MAX_LINES) max_lines = TEXT_MAX_LINES;
+
+  TextLine lines[TEXT_MAX_LINES];
+  int n = textLayout(str, size, max_width, mode, lines, max_lines);
+  int lh = textLineHeight(size);
+  int i;
+  for (i = 0; i < n && y + i * lh < oled.getHeight(); i++) {
+    if (lines[i].width == 0) continue;  // 空行只占位置
+    blit(oled, x, (uint8_t)(y + i * lh),
+         *lookup(str, lines[i], size, (uint8_t)max_width));
+  }
+  return i;
+}
+
+void TextCache::drawInt(OLED &oled, uint8_t x, uint8_t y, int32_t value,
+                        int digits, uint8_t size) {
+  char buf[TEXT_NUM_BUF];
+  formatInt(buf, value, digits);
+  draw(oled, x, y, buf, size, digits * textCharWidth(size), TEXT_CLIP);
+}
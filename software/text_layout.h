@@ -0,0 +1,101 @@
+#ifndef TEXT_LAYOUT_H
+#define TEXT_LAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "oled.h"
+
+// 文本排版：一次遍历完成测量、换行和省略号截断。
+// 排好的行渲染成页打包精灵（与GRAM同布局，每页width字节），按
+// (字符串哈希, 字号, 排版宽度) 缓存在固定大小的LRU区里；标签不变时
+// 绘制只是每页一次memcpy，不再逐像素光栅化。
+
+#define TEXT_CACHE_ENTRIES 32
+#define TEXT_LINE_CHARS 22  // 6x8字体下一行最多21个字符
+#define TEXT_MAX_LINES 8
+
+enum TextOverflow {
+  TEXT_CLIP,      // 超出部分直接截掉
+  TEXT_ELLIPSIS,  // 最后一行放不下时末尾换成省略号
+  TEXT_WRAP,      // 按单词换行，最后一行仍放不下时加省略号
+};
+
+struct TextLine {
+  uint16_t start;    // 在原字符串中的偏移
+  uint8_t len;       // 本行字符数（不含省略号）
+  uint8_t width;     // 像素宽度（含省略号）
+  bool ellipsis;     // 末尾是否有省略号
+};
+
+// 字号12/8为6x8字体，16为8x16字体
+static inline uint8_t textCharWidth(uint8_t size) { return size == 16 ? 8 : 6; }
+static inline uint8_t textLineHeight(uint8_t size) {
+  return size == 16 ? 16 : 8;
+}
+
+// 把str排进max_width像素宽、最多max_lines行，返回行数
+int textLayout(const char *str, uint8_t size, int max_width,
+               TextOverflow mode, TextLine *lines, int max_lines);
+
+// 数字格式化的缓冲大小：width最大为TEXT_NUM_BUF-1，"-2147483.647"这类
+// 定点数不补空格也要13字节
+#define TEXT_NUM_BUF 16
+
+// 不分配内存的数字格式化，返回写入的长度（buf至少TEXT_NUM_BUF字节，
+// 结果以'\0'结尾）。width大于长度时左侧补空格右对齐
+int formatInt(char *buf, int32_t value, int width = 0);
+// 定点数：value按10^decimals缩放，formatFixed(buf, -3142, 3) -> "-3.142"
+int formatFixed(char *buf, int32_t value, int decimals, int width = 0);
+// 浮点数四舍五入成定点后格式化，不经过sprintf；NaN和无穷输出"nan"、"inf"、
+// "-inf"，超出int32范围的有限值按范围夹住
+int formatFloat(char *buf, float value, int decimals, int width = 0);
+
+class TextCache {
+ public:
+  TextCache();
+
+  // 在(x, y)按max_width（<=0时到画布右边）排版并绘制，返回绘制的行数。
+  // 背景不透明（与showString_GRAM相同）；y按页对齐时每页一次memcpy
+  int draw(OLED &oled, uint8_t x, uint8_t y, const char *str, uint8_t size,
+           int max_width = 0, TextOverflow mode = TEXT_ELLIPSIS,
+           int max_lines = 1);
+  // 右对齐绘制整数，宽度为digits个字符
+  void drawInt(OLED &oled, uint8_t x, uint8_t y, int32_t value, int digits,
+               uint8_t size);
+
+  void clear(void);
+
+  uint32_t hits(void) const { return hit_count; }
+  uint32_t misses(void) const { return miss_count; }
+
+ private:
+  struct Entry {
+    uint32_t hash;
+    uint32_t last_used;
+    int16_t next;       // 同一哈希桶的下一项，-1结束
+    uint8_t size;
+    uint8_t max_width;
+    uint8_t len;
+    uint8_t width;
+    bool ellipsis;
+    bool valid;
+    char text[TEXT_LINE_CHARS];
+    uint8_t sprite[2][OLED_MAX_COLUMN];  // 最多2页高
+  };
+
+  const Entry *lookup(const char *text, const TextLine &line, uint8_t size,
+                      uint8_t max_width);
+  static void render(Entry &e, const char *text);
+  static void blit(OLED &oled, uint8_t x, uint8_t y, const Entry &e);
+
+  Entry entries[TEXT_CACHE_ENTRIES];
+  int16_t buckets[TEXT_CACHE_ENTRIES * 2];
+  uint32_t clock;
+  uint32_t hit_count, miss_count;
+
+  TextCache(const TextCache &);
+  TextCache &operator=(const TextCache &);
+};
+
+#endif  // TEXT_LAYOUT_H
@@ -0,0 +1,355 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "roam.h"
+#include "stats.h"
+#include "wifi_scan.h"
+
+// 漫游守护：按扫描历史在同一SSID的AP之间切换，切换时机避开调试流量。
+// 用法：wifi_roam -s SSID [-i 网卡[,网卡...]] [-t 扫描间隔s]
+//                 [--activity 统计文件] [--record 文件]
+//       wifi_roam -s SSID --replay 文件 --current BSSID   回放扫描，模拟切换
+//       wifi_roam --self-test                             生成走动场景并回放
+//       wifi_roam --scan-bench                            单网卡/双网卡扫描对比
+// --activity默认读取jlink_bridge的统计文件，bridge.request计数不变即链路空闲。
+// -i给出多块网卡时信道分给各网卡并行扫描，切换只在第一块网卡上进行。
+// --record把每次扫描追加到文件，格式与--replay相同。
+
+static volatile sig_atomic_t running = 1;
+
+static void signalHandler(int signum) {
+  (void)signum;
+  running = 0;
+}
+
+#define REPLAY_TICK_US 100000  // 回放时两次扫描之间检查空闲的步长
+
+// 按回放文件的时间驱动引擎，扫描之间按步长检查空闲
+static void replay(RoamEngine &engine, ReplayScanBackend &backend) {
+  uint64_t now = backend.nextTimeUs();
+  while (!backend.done() && running) {
+    uint64_t next = backend.nextTimeUs();
+    for (; now < next; now += REPLAY_TICK_US) engine.tick(now);
+    now = next;
+    engine.step(now);
+  }
+}
+
+static void writeWalkScan(FILE *fp, uint64_t ms, int a, int b, int guest) {
+  std::vector<WiFiNetwork> networks(3);
+  networks[0].bssid = "02:00:00:00:00:0a";
+  networks[0].freq_mhz = 2437;
+  networks[0].signal_strength = a;
+  networks[0].ssid = "lab";
+  networks[1].bssid = "02:00:00:00:00:0b";
+  networks[1].freq_mhz = 5180;
+  networks[1].signal_strength = b;
+  networks[1].ssid = "lab";
+  networks[2].bssid = "02:00:00:00:00:99";
+  networks[2].freq_mhz = 2412;
+  networks[2].signal_strength = guest;
+  networks[2].ssid = "guest";
+  for (size_t i = 0; i < networks.size(); i++) networks[i].secured = true;
+  writeScan(fp, ms * 1000, networks);
+}
+
+// 录制的扫描回放后必须与原扫描相同：没有BSSID的条目（写作"-"）、
+// 隐藏SSID和带空格的SSID
+static bool checkRoundTrip(void) {
+  char path[] = "/tmp/wifi_roam.XXXXXX";
+  int fd = mkstemp(path);
+  FILE *fp = fd >= 0 ? fdopen(fd, "w") : nullptr;
+  if (!fp) {
+    perror("fixture");
+    return false;
+  }
+  std::vector<WiFiNetwork> networks(3);
+  networks[0].bssid = "02:00:00:00:00:0a";
+  networks[0].freq_mhz = 2437;
+  networks[0].signal_strength = 80;
+  networks[0].secured = true;
+  networks[0].ssid = "lab 2";
+  networks[1].freq_mhz = 2412;
+  networks[1].signal_strength = 60;
+  networks[1].ssid = "no bssid";
+  networks[2].bssid = "02:00:00:00:00:0c";
+  networks[2].freq_mhz = 5180;
+  networks[2].signal_strength = 40;
+  writeScan(fp, 1000000, networks);
+  fclose(fp);
+
+  ReplayScanBackend backend;
+  std::vector<WiFiNetwork> out;
+  bool ok = backend.load(path) && backend.scan(out) &&
+            out.size() == networks.size();
+  unlink(path);
+  for (size_t i = 0; ok && i < out.size(); i++) {
+    const WiFiNetwork &a = networks[i], &b = out[i];
+    ok = a.bssid == b.bssid && a.ssid == b.ssid && a.freq_mhz == b.freq_mhz &&
+         a.signal_strength == b.signal_strength && a.secured == b.secured;
+  }
+  printf("self-test: record/replay round trip %s\n", ok ? "passed" : "FAILED");
+  return ok;
+}
+
+// 自测：从A走到B，5秒扫描一次。开头B有一次偶然的强信号（不应触发），
+// 调试链路每10秒里前6秒繁忙；期望恰好一次A->B，且发生在空闲时
+static int runSelfTest(void) {
+  if (!checkRoundTrip()) return 1;
+  char path[] = "/tmp/wifi_roam.XXXXXX";
+  int fd = mkstemp(path);
+  FILE *fp = fd >= 0 ? fdopen(fd, "w") : nullptr;
+  if (!fp) {
+    perror("fixture");
+    return 1;
+  }
+  fprintf(fp, "# walk from lab/A to lab/B\n");
+  for (int i = 0; i <= 36; i++) {
+    int a = 85 - i * 2, b = 15 + i * 2;
+    int noise = (i * 7) % 5 - 2;
+    if (i == 2) b = 95;  // 偶然的强信号
+    writeWalkScan(fp, i * 5000, a + noise, b - noise, 40 + noise);
+  }
+  fclose(fp);
+
+  ReplayScanBackend backend;
+  bool loaded = backend.load(path);
+  unlink(path);
+  if (!loaded) return 1;
+
+  RoamConfig config;
+  config.ssid = "lab";
+  MockRoamActuator actuator("02:00:00:00:00:0a", 120);
+  RoamEngine engine(config, &backend, &actuator, [](uint64_t now) {
+    uint64_t phase = now % 10000000;
+    return phase < 6000000 ? 0 : phase - 6000000;
+  });
+  replay(engine, backend);
+
+  const std::vector<RoamEvent> &events = engine.events();
+  int done = 0;
+  bool idle_ok = true;
+  for (size_t i = 0; i < events.size(); i++) {
+    if (events[i].kind != ROAM_DONE) continue;
+    done++;
+    idle_ok = idle_ok && events[i].time_us % 10000000 >= 6000000 +
+                                                  config.idle_ms * 1000ULL;
+  }
+  bool ok = done == 1 && actuator.bssid == "02:00:00:00:00:0b" && idle_ok;
+  printf("self-test: %d roam(s), final %s, %s\n", done, actuator.bssid.c_str(),
+         ok ? "passed" : "FAILED");
+  StatSnapshot s;
+  statsSnapshot(STAT_ROAM, s);
+  printf("self-test: outage avg %llu ms\n",
+         (unsigned long long)(s.count ? s.sum / s.count / 1000 : 0));
+  return ok ? 0 : 1;
+}
+
+#define BENCH_DWELL_MS 10  // 模拟的每信道驻留时间
+#define BENCH_SCANS 5
+
+// 多网卡扫描对比：同一回放文件分别用一块和两块模拟网卡扫描，
+// 两种方式的合并结果必须一致，双网卡耗时应约为一半
+static int runScanBench(void) {
+  char path[] = "/tmp/wifi_scan.XXXXXX";
+  int fd = mkstemp(path);
+  FILE *fp = fd >= 0 ? fdopen(fd, "w") : nullptr;
+  if (!fp) {
+    perror("fixture");
+    return 1;
+  }
+  const std::vector<uint32_t> &all = defaultChannels();
+  for (int scan = 0; scan < BENCH_SCANS; scan++) {
+    std::vector<WiFiNetwork> networks;
+    for (int i = 0; i < 48; i++) {
+      WiFiNetwork n;
+      char bssid[24];
+      snprintf(bssid, sizeof(bssid), "02:00:00:00:%02x:%02x", i / 8, i % 8);
+      n.bssid = bssid;
+      n.ssid = i % 6 ? "lab" : "guest";
+      n.freq_mhz = all[(i * 7) % all.size()];
+      n.signal_strength = 20 + (i * 37 + scan * 11) % 75;
+      n.secured = i % 6 != 0;
+      networks.push_back(n);
+    }
+    writeScan(fp, scan * 5000000ULL, networks);
+  }
+  fclose(fp);
+
+  double elapsed[2];
+  std::vector<std::vector<WiFiNetwork> > tables[2];
+  bool ok = true;
+  for (int radios = 1; radios <= 2; radios++) {
+    std::vector<ScanBackend *> backends;
+    for (int i = 0; i < radios; i++) {
+      ReplayScanBackend *replay = new ReplayScanBackend();
+      ok = replay->load(path) && ok;
+      replay->setDwell(BENCH_DWELL_MS);
+      backends.push_back(replay);
+    }
+    MultiRadioScanBackend multi(backends);
+    for (int i = 0; i < radios; i++) {
+      const std::vector<uint32_t> &ch = multi.radioChannels(i);
+      printf("radio %d/%d: %zu channels, %u-%u MHz\n", i + 1, radios,
+             ch.size(), ch.front(), ch.back());
+    }
+    uint64_t start = monotonicUs();
+    std::vector<WiFiNetwork> out;
+    while (multi.scan(out)) tables[radios - 1].push_back(out);
+    elapsed[radios - 1] = (monotonicUs() - start) / 1e3 / BENCH_SCANS;
+  }
+  unlink(path);
+
+  bool same =
+      tables[0].size() == BENCH_SCANS && tables[1].size() == BENCH_SCANS;
+  for (size_t s = 0; same && s < tables[0].size(); s++) {
+    same = tables[0][s].size() == tables[1][s].size() &&
+           tables[0][s].size() == 48;
+    for (size_t i = 0; same && i < tables[0][s].size(); i++) {
+      same = tables[0][s][i].bssid == tables[1][s][i].bssid &&
+             tables[0][s][i].signal_strength ==
+                 tables[1][s][i].signal_strength;
+    }
+  }
+  printf("scan cycle: 1 radio %.0f ms, 2 radios %.0f ms (%.2fx)\n",
+         elapsed[0], elapsed[1], elapsed[0] / elapsed[1]);
+  ok = ok && same;
+  printf("scan-bench: merged tables %s\n", ok ? "match" : "DIFFER");
+  return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  RoamConfig config;
+  const char *ifname = nullptr;
+  const char *activity = "/tmp/jlink_bridge.stats";
+  const char *record = nullptr;
+  const char *replay_path = nullptr;
+  const char *current = "";
+  int interval_s = 5;
+  bool self_test = false;
+  bool scan_bench = false;
+  bool usage = false;
+  for (int i = 1; i < argc; i++) {
+    bool has_arg = i + 1 < argc;
+    if (has_arg && strcmp(argv[i], "-s") == 0) {
+      config.ssid = argv[++i];
+    } else if (has_arg && strcmp(argv[i], "-i") == 0) {
+      ifname = argv[++i];
+    } else if (has_arg && strcmp(argv[i], "-t") == 0) {
+      interval_s = atoi(argv[++i]);
+    } else if (has_arg && strcmp(argv[i], "--activity") == 0) {
+      activity = argv[++i];
+    } else if (has_arg && strcmp(argv[i], "--record") == 0) {
+      record = argv[++i];
+    } else if (has_arg && strcmp(argv[i], "--replay") == 0) {
+      replay_path = argv[++i];
+    } else if (has_arg && strcmp(argv[i], "--current") == 0) {
+      current = argv[++i];
+    } else if (strcmp(argv[i], "--self-test") == 0) {
+      self_test = true;
+    } else if (strcmp(argv[i], "--scan-bench") == 0) {
+      scan_bench = true;
+    } else {
+      usage = true;
+    }
+  }
+  if (self_test) return runSelfTest();
+  if (scan_bench) return runScanBench();
+  if (usage || config.ssid.empty()) {
+    fprintf(stderr,
+            "usage: %s -s ssid [-i ifname[,ifname...]] [-t scan_interval_s] "
+            "[--activity stats_file] [--record file]\n"
+            "       %s -s ssid --replay file --current bssid\n"
+            "       %s --self-test | --scan-bench\n",
+            argv[0], argv[0], argv[0]);
+    return 1;
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = signalHandler;
+  sigaction(SIGINT, &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
+
+  if (replay_path) {
+    ReplayScanBackend backend;
+    if (!backend.load(replay_path)) return 1;
+    MockRoamActuator actuator(current);
+    RoamEngine engine(config, &backend, &actuator);
+    replay(engine, backend);
+    printf("replay: %u roam(s), final %s\n", actuator.roams,
+           actuator.bssid.c_str());
+    return 0;
+  }
+
+#if HAVE_NETWORKMANAGER
+  const char *stats_path = getenv("WIFI_ROAM_STATS");
+  statsStartExporter(stats_path ? stats_path : "/tmp/wifi_roam.stats");
+
+  FILE *rec = record ? fopen(record, "a") : nullptr;
+  // 多块网卡：第一块负责切换，信道分给所有网卡，各自用nl80211只扫描
+  // 分到的信道；只有一块网卡时仍由NM扫描
+  std::vector<std::string> names;
+  for (const char *p = ifname; p && *p;) {
+    size_t n = strcspn(p, ",");
+    names.push_back(std::string(p, n));
+    p += n + (p[n] == ',');
+  }
+  std::string primary = names.empty() ? "" : names[0];
+  std::vector<ScanBackend *> radios;
+  for (size_t i = 0; names.size() > 1 && i < names.size(); i++) {
+    radios.push_back(new Nl80211ScanBackend(names[i].c_str()));
+  }
+  if (radios.empty()) {
+    radios.push_back(new NmScanBackend(primary.empty() ? nullptr
+                                                       : primary.c_str()));
+  }
+  MultiRadioScanBackend nm(radios);
+  NmRoamActuator actuator(primary.empty() ? nullptr : primary.c_str());
+  StatsActivity link(activity);
+
+  // 录制时包一层，把每次扫描写入文件
+  struct RecordingBackend : public ScanBackend {
+    ScanBackend *inner;
+    FILE *fp;
+    bool scan(std::vector<WiFiNetwork> &out, const char *ssid) {
+      bool ok = inner->scan(out, ssid);
+      if (ok && fp && !ssid) writeScan(fp, inner->timeUs(), out);
+      return ok;
+    }
+    uint64_t timeUs(void) const { return inner->timeUs(); }
+  } backend;
+  backend.inner = &nm;
+  backend.fp = rec;
+
+  RoamEngine engine(config, &backend, &actuator,
+                    [&link](uint64_t now) { return link.idleUs(now); });
+  printf("roaming within \"%s\", scanning every %d s\n", config.ssid.c_str(),
+         interval_s);
+  while (running) {
+    uint64_t now = monotonicUs();
+    engine.step(now);
+    // 扫描间隔内每100ms检查一次调试链路是否空闲
+    uint64_t next = now + interval_s * 1000000ULL;
+    while (running && (now = monotonicUs()) < next) {
+      engine.tick(now);
+      usleep(engine.pending() ? 100000 : 500000);
+    }
+  }
+  if (rec) fclose(rec);
+  statsStopExporter();
+  return 0;
+#else
+  (void)ifname;
+  (void)activity;
+  (void)record;
+  (void)interval_s;
+  fprintf(stderr, "built without NetworkManager, only --replay is available\n");
+  return 1;
+#endif
+}
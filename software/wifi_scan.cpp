@@ -0,0 +1,453 @@
+#include "wifi_scan.h"
+
+#include <errno.h>
+#include <net/if.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <thread>
+
+#include "nl80211.h"
+#include "stats.h"
+
+#if HAVE_NETWORKMANAGER
+#include <NetworkManager.h>
+#include <glib.h>
+#endif
+
+#define SCAN_TIMEOUT_US 8000000  // 等待扫描完成的上限
+
+static void sortBySignal(std::vector<WiFiNetwork> &networks) {
+  std::stable_sort(networks.begin(), networks.end(),
+                   [](const WiFiNetwork &a, const WiFiNetwork &b) {
+                     return a.signal_strength > b.signal_strength;
+                   });
+}
+
+// ========== 信道 ==========
+bool ScanBackend::onChannel(uint32_t freq_mhz) const {
+  return channels.empty() ||
+         std::find(channels.begin(), channels.end(), freq_mhz) !=
+             channels.end();
+}
+
+const std::vector<uint32_t> &defaultChannels(void) {
+  static std::vector<uint32_t> freqs;
+  if (freqs.empty()) {
+    for (uint32_t ch = 1; ch <= 13; ch++) freqs.push_back(2407 + ch * 5);
+    for (uint32_t ch = 36; ch <= 64; ch += 4) freqs.push_back(5000 + ch * 5);
+    for (uint32_t ch = 100; ch <= 144; ch += 4) freqs.push_back(5000 + ch * 5);
+    for (uint32_t ch = 149; ch <= 165; ch += 4) freqs.push_back(5000 + ch * 5);
+  }
+  return freqs;
+}
+
+std::vector<std::vector<uint32_t> > partitionChannels(
+    const std::vector<uint32_t> &freqs, int n) {
+  std::vector<uint32_t> sorted(freqs);
+  std::sort(sorted.begin(), sorted.end());
+  std::vector<std::vector<uint32_t> > parts(n > 0 ? n : 1);
+  size_t begin = 0;
+  for (size_t i = 0; i < parts.size(); i++) {
+    size_t end = sorted.size() * (i + 1) / parts.size();
+    parts[i].assign(sorted.begin() + begin, sorted.begin() + end);
+    begin = end;
+  }
+  return parts;
+}
+
+#if HAVE_NETWORKMANAGER
+NmScanBackend::NmScanBackend(const char *ifname)
+    : context(nullptr), client(nullptr), ifname(ifname ? ifname : ""),
+      last_us(0) {}
+
+NmScanBackend::~NmScanBackend() {
+  if (client) g_object_unref(client);
+  if (context) g_main_context_unref(context);
+}
+
+std::vector<std::string> NmScanBackend::interfaces(void) {
+  std::vector<std::string> names;
+  GError *error = nullptr;
+  NMClient *c = nm_client_new(nullptr, &error);
+  if (!c) {
+    fprintf(stderr, "Failed to create NMClient: %s\n", error->message);
+    g_error_free(error);
+    return names;
+  }
+  const GPtrArray *devices = nm_client_get_devices(c);
+  for (guint i = 0; devices && i < devices->len; i++) {
+    NMDevice *device = (NMDevice *)devices->pdata[i];
+    if (NM_IS_DEVICE_WIFI(device)) names.push_back(nm_device_get_iface(device));
+  }
+  g_object_unref(c);
+  return names;
+}
+
+bool NmScanBackend::scan(std::vector<WiFiNetwork> &out, const char *ssid) {
+  out.clear();
+  StatsTimer timer(STAT_SCAN);
+
+  GError *error = nullptr;
+  if (!client) {
+    // 客户端绑定创建时线程的默认上下文，这里换成自己的
+    if (!context) context = g_main_context_new();
+    g_main_context_push_thread_default(context);
+    client = nm_client_new(nullptr, &error);
+    g_main_context_pop_thread_default(context);
+    if (!client) {
+      fprintf(stderr, "Failed to create NMClient: %s\n", error->message);
+      g_error_free(error);
+      timer.fail();
+      return false;
+    }
+  }
+  while (g_main_context_iteration(context, FALSE)) {
+  }
+
+  // 查找WiFi设备
+  const GPtrArray *devices = nm_client_get_devices(client);
+  NMDeviceWifi *wifi = nullptr;
+  for (guint i = 0; devices && i < devices->len; i++) {
+    NMDevice *device = (NMDevice *)devices->pdata[i];
+    if (!NM_IS_DEVICE_WIFI(device)) continue;
+    if (!ifname.empty() && ifname != nm_device_get_iface(device)) continue;
+    wifi = NM_DEVICE_WIFI(device);
+    break;
+  }
+  if (!wifi) {
+    fprintf(stderr, "No WiFi device found\n");
+    timer.fail();
+    return false;
+  }
+
+  // 请求扫描；定向扫描只带一个SSID，驱动可以只发对应的探测请求
+  gint64 before = nm_device_wifi_get_last_scan(wifi);
+  GVariantBuilder builder;
+  g_variant_builder_init(&builder, G_VARIANT_TYPE_VARDICT);
+  if (ssid) {
+    GVariantBuilder ssids;
+    g_variant_builder_init(&ssids, G_VARIANT_TYPE("aay"));
+    g_variant_builder_add_value(
+        &ssids, g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, ssid,
+                                          strlen(ssid), 1));
+    g_variant_builder_add(&builder, "{sv}", "ssids",
+                          g_variant_builder_end(&ssids));
+  }
+  if (!nm_device_wifi_request_scan_options(wifi, g_variant_builder_end(&builder),
+                                           nullptr, &error)) {
+    // 扫描过于频繁时NM会拒绝，仍使用现有结果
+    g_error_free(error);
+    error = nullptr;
+  }
+
+  // 等待LastScan更新，而不是固定延时
+  uint64_t start = monotonicUs();
+  while (nm_device_wifi_get_last_scan(wifi) == before &&
+         monotonicUs() - start < SCAN_TIMEOUT_US) {
+    if (!g_main_context_iteration(context, FALSE)) usleep(20000);
+  }
+
+  const GPtrArray *aps = nm_device_wifi_get_access_points(wifi);
+  for (guint i = 0; aps && i < aps->len; i++) {
+    NMAccessPoint *ap = (NMAccessPoint *)aps->pdata[i];
+    WiFiNetwork network;
+
+    // 获取SSID
+    GBytes *ssid_bytes = nm_access_point_get_ssid(ap);
+    if (ssid_bytes) {
+      gsize len;
+      const char *ssid_data = (const char *)g_bytes_get_data(ssid_bytes, &len);
+      network.ssid = std::string(ssid_data, len);
+      // 过滤不可打印字符
+      for (char &c : network.ssid) {
+        if (c < 32 || c > 126) c = '?';
+      }
+    } else {
+      network.ssid = "Hidden Network";
+    }
+    if (ssid && network.ssid != ssid) continue;
+
+    const char *bssid = nm_access_point_get_bssid(ap);
+    network.bssid = bssid ? bssid : "";
+    network.freq_mhz = nm_access_point_get_frequency(ap);
+    network.signal_strength = nm_access_point_get_strength(ap);
+
+    // 检查是否加密
+    NM80211ApFlags flags = nm_access_point_get_flags(ap);
+    NM80211ApSecurityFlags wpa_flags = nm_access_point_get_wpa_flags(ap);
+    NM80211ApSecurityFlags rsn_flags = nm_access_point_get_rsn_flags(ap);
+    network.secured = (flags & NM_802_11_AP_FLAGS_PRIVACY) ||
+                      (wpa_flags != NM_802_11_AP_SEC_NONE) ||
+                      (rsn_flags != NM_802_11_AP_SEC_NONE);
+    out.push_back(network);
+  }
+
+  sortBySignal(out);
+  last_us = monotonicUs();
+  statsRecord(STAT_SCAN_APS, out.size());
+  return true;
+}
+#endif
+
+// ========== nl80211 ==========
+Nl80211ScanBackend::Nl80211ScanBackend(const char *ifname)
+    : nl(new Nl80211()), ifname(ifname ? ifname : ""), ifindex(0),
+      last_us(0) {}
+
+Nl80211ScanBackend::~Nl80211ScanBackend() { delete nl; }
+
+bool Nl80211ScanBackend::resolve(void) {
+  if (ifindex) return true;
+  if (ifname.empty()) {
+    std::vector<std::string> names;
+    if (!nl->interfaces(names) || names.empty()) {
+      fprintf(stderr, "No WiFi device found\n");
+      return false;
+    }
+    ifname = names[0];
+  }
+  ifindex = if_nametoindex(ifname.c_str());
+  if (!ifindex) {
+    perror(ifname.c_str());
+    return false;
+  }
+  // 取不到时不过滤，由内核拒绝不支持的信道
+  nl->supportedFreqs(ifindex, supported);
+  return true;
+}
+
+// 与NM相同的换算：-100dBm以下为0，-40dBm以上为100
+static int signalQuality(const Nl80211Bss &b) {
+  if (!b.has_mbm) return std::min((int)b.signal_unspec, 100);
+  int dbm = std::max(-100, std::min(-40, b.signal_mbm / 100));
+  return 100 - 100 * (-40 - dbm) / 60;
+}
+
+bool Nl80211ScanBackend::scan(std::vector<WiFiNetwork> &out, const char *ssid) {
+  out.clear();
+  StatsTimer timer(STAT_SCAN);
+  if (!resolve()) {
+    timer.fail();
+    return false;
+  }
+
+  // 分到的信道和网卡支持的信道取交集；一个都不支持时不用扫描
+  std::vector<uint32_t> freqs;
+  for (size_t i = 0; i < channels.size(); i++) {
+    if (supported.empty() ||
+        std::find(supported.begin(), supported.end(), channels[i]) !=
+            supported.end()) {
+      freqs.push_back(channels[i]);
+    }
+  }
+  if (!channels.empty() && freqs.empty()) {
+    last_us = monotonicUs();
+    return true;
+  }
+
+  uint64_t start = monotonicUs();
+  int err = nl->triggerScan(ifindex, freqs, ssid);
+  bool fresh = err == 0 && nl->waitScan(ifindex, SCAN_TIMEOUT_US / 1000);
+  if (err < 0 && err != -EBUSY && err != -EPERM) {
+    fprintf(stderr, "%s: scan failed: %s\n", ifname.c_str(), strerror(-err));
+  }
+
+  std::vector<Nl80211Bss> bss;
+  if (!nl->getScan(ifindex, bss)) {
+    timer.fail();
+    return false;
+  }
+  uint64_t elapsed_ms = (monotonicUs() - start) / 1000;
+  for (size_t i = 0; i < bss.size(); i++) {
+    const Nl80211Bss &b = bss[i];
+    if (!onChannel(b.freq_mhz)) continue;
+    // 扫描成功时丢掉这次扫描之前就没再见过的条目
+    if (fresh && b.seen_ms_ago > elapsed_ms) continue;
+
+    WiFiNetwork network;
+    network.ssid = b.ssid;
+    if (network.ssid.empty() || network.ssid[0] == '\0') {
+      network.ssid = "Hidden Network";
+    }
+    // 过滤不可打印字符
+    for (char &c : network.ssid) {
+      if (c < 32 || c > 126) c = '?';
+    }
+    if (ssid && network.ssid != ssid) continue;
+    network.bssid = b.bssid;
+    network.freq_mhz = b.freq_mhz;
+    network.signal_strength = signalQuality(b);
+    network.secured = b.secured;
+    out.push_back(network);
+  }
+
+  sortBySignal(out);
+  last_us = monotonicUs();
+  statsRecord(STAT_SCAN_APS, out.size());
+  return true;
+}
+
+// ========== 回放 ==========
+ReplayScanBackend::ReplayScanBackend() : next(0), last_us(0), dwell_ms(0) {}
+
+bool ReplayScanBackend::load(const char *path) {
+  FILE *fp = fopen(path, "r");
+  if (!fp) {
+    perror(path);
+    return false;
+  }
+  scans.clear();
+  next = 0;
+  char line[512];
+  int lineno = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), fp)) {
+    lineno++;
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] == '\0' || line[0] == '#') continue;
+
+    unsigned long long ms;
+    if (sscanf(line, "scan %llu", &ms) == 1) {
+      Scan s;
+      s.time_us = ms * 1000;
+      scans.push_back(s);
+      continue;
+    }
+    char bssid[32];
+    unsigned freq;
+    int signal, secured, pos = 0;
+    if (scans.empty() ||
+        sscanf(line, "%31s %u %d %d %n", bssid, &freq, &signal, &secured,
+               &pos) != 4 ||
+        pos == 0) {
+      fprintf(stderr, "%s:%d: bad scan line\n", path, lineno);
+      ok = false;
+      break;
+    }
+    WiFiNetwork network;
+    if (strcmp(bssid, "-") != 0) network.bssid = bssid;  // writeScan的空BSSID
+    network.freq_mhz = freq;
+    network.signal_strength = signal;
+    network.secured = secured != 0;
+    network.ssid = line + pos;
+    scans.back().networks.push_back(network);
+  }
+  fclose(fp);
+  for (size_t i = 0; i < scans.size(); i++) sortBySignal(scans[i].networks);
+  return ok;
+}
+
+bool ReplayScanBackend::scan(std::vector<WiFiNetwork> &out, const char *ssid) {
+  out.clear();
+  // 定向扫描重复最近一次扫描（不推进时间），完整扫描取下一段
+  if (ssid ? next == 0 : next >= scans.size()) return false;
+  const Scan &s = ssid ? scans[next - 1] : scans[next++];
+  if (dwell_ms) {
+    size_t n = channels.empty() ? defaultChannels().size() : channels.size();
+    usleep(dwell_ms * 1000 * n);
+  }
+  for (size_t i = 0; i < s.networks.size(); i++) {
+    const WiFiNetwork &n = s.networks[i];
+    if ((!ssid || n.ssid == ssid) && onChannel(n.freq_mhz)) out.push_back(n);
+  }
+  last_us = s.time_us;
+  statsRecord(STAT_SCAN_APS, out.size());
+  return true;
+}
+
+uint64_t ReplayScanBackend::nextTimeUs(void) const {
+  if (next < scans.size()) return scans[next].time_us;
+  return last_us;
+}
+
+// ========== 多网卡 ==========
+MultiRadioScanBackend::MultiRadioScanBackend(
+    const std::vector<ScanBackend *> &backends)
+    : last_us(0) {
+  radios.resize(backends.size());
+  for (size_t i = 0; i < backends.size(); i++) {
+    radios[i].backend = backends[i];
+    radios[i].ok = false;
+    radios[i].elapsed_us = 0;
+  }
+  setChannels(defaultChannels());
+}
+
+MultiRadioScanBackend::~MultiRadioScanBackend() {
+  for (size_t i = 0; i < radios.size(); i++) delete radios[i].backend;
+}
+
+void MultiRadioScanBackend::setChannels(const std::vector<uint32_t> &freqs) {
+  channels = freqs;
+  std::vector<std::vector<uint32_t> > parts =
+      partitionChannels(freqs.empty() ? defaultChannels() : freqs,
+                        (int)radios.size());
+  for (size_t i = 0; i < radios.size(); i++) {
+    radios[i].channels = parts[i];
+    radios[i].backend->setChannels(parts[i]);
+  }
+}
+
+void MultiRadioScanBackend::scanRadio(Radio &r, const char *ssid) {
+  uint64_t start = monotonicUs();
+  r.ok = r.backend->scan(r.result, ssid);
+  r.elapsed_us = monotonicUs() - start;
+}
+
+bool MultiRadioScanBackend::scan(std::vector<WiFiNetwork> &out,
+                                 const char *ssid) {
+  out.clear();
+  if (radios.empty()) return false;
+
+  // 第一块网卡在调用线程里扫描，其余各一个线程
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < radios.size(); i++) {
+    workers.push_back(std::thread(scanRadio, std::ref(radios[i]), ssid));
+  }
+  scanRadio(radios[0], ssid);
+  for (size_t i = 0; i < workers.size(); i++) workers[i].join();
+
+  // 合并：相邻信道的AP可能被两块网卡都收到，不能限定信道的后端（NM）
+  // 每块网卡都报告全部AP，同一BSSID保留最强的一条
+  std::map<std::string, size_t> index;
+  bool ok = false;
+  last_us = 0;
+  for (size_t i = 0; i < radios.size(); i++) {
+    Radio &r = radios[i];
+    if (!r.ok) continue;
+    ok = true;
+    if (r.backend->timeUs() > last_us) last_us = r.backend->timeUs();
+    for (size_t j = 0; j < r.result.size(); j++) {
+      const WiFiNetwork &n = r.result[j];
+      if (n.bssid.empty()) {
+        out.push_back(n);
+        continue;
+      }
+      std::map<std::string, size_t>::iterator it = index.find(n.bssid);
+      if (it == index.end()) {
+        index[n.bssid] = out.size();
+        out.push_back(n);
+      } else if (n.signal_strength > out[it->second].signal_strength) {
+        out[it->second] = n;
+      }
+    }
+  }
+  sortBySignal(out);
+  return ok;
+}
+
+void writeScan(FILE *fp, uint64_t time_us,
+               const std::vector<WiFiNetwork> &networks) {
+  fprintf(fp, "scan %llu\n", (unsigned long long)(time_us / 1000));
+  for (size_t i = 0; i < networks.size(); i++) {
+    const WiFiNetwork &n = networks[i];
+    fprintf(fp, "%s %u %d %d %s\n", n.bssid.empty() ? "-" : n.bssid.c_str(),
+            n.freq_mhz, n.signal_strength, n.secured ? 1 : 0, n.ssid.c_str());
+  }
+  fflush(fp);
+}
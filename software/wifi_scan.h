@@ -0,0 +1,174 @@
+#ifndef WIFI_SCAN_H
+#define WIFI_SCAN_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+// WiFi扫描后端：NetworkManager或nl80211实时扫描，或回放录制的扫描文件。
+// 回放文件为文本，每次扫描一段：
+//   scan <时间ms>
+//   <bssid> <频率MHz> <信号0-100> <0/1加密> <ssid到行尾>
+// 录制（writeScan）和回放使用同一格式，可以把现场扫描带回来离线调试。
+// 有多块网卡时用MultiRadioScanBackend把信道分给各网卡并行扫描，
+// 每块网卡用Nl80211ScanBackend只扫描分到的信道。
+
+// WiFi网络信息（一个BSSID）
+struct WiFiNetwork {
+  std::string ssid;
+  std::string bssid;
+  uint32_t freq_mhz;
+  int signal_strength;  // 信号强度 (0-100)
+  bool secured;         // 是否加密
+};
+
+class ScanBackend {
+ public:
+  virtual ~ScanBackend() {}
+  // 完成一次扫描，结果按信号从强到弱排序。ssid非空时为定向扫描
+  // （只探测这个SSID，用于漫游前预热目标AP）
+  virtual bool scan(std::vector<WiFiNetwork> &out,
+                    const char *ssid = nullptr) = 0;
+  // 最近一次扫描的时间（回放时为文件中的时间，实时为单调时钟），微秒
+  virtual uint64_t timeUs(void) const = 0;
+  // 只扫描这些信道，频率MHz；空为全部信道。
+  // 不能指定信道的后端忽略此设置，仍报告全部信道
+  virtual void setChannels(const std::vector<uint32_t> &freqs) {
+    channels = freqs;
+  }
+
+ protected:
+  bool onChannel(uint32_t freq_mhz) const;
+
+  std::vector<uint32_t> channels;
+};
+
+// 常用信道：2.4GHz 1-13，5GHz UNII-1/2/2e/3
+const std::vector<uint32_t> &defaultChannels(void);
+// 按频率排序后切成n段连续区间，各段信道数相差不超过1
+// （两块网卡时一块扫2.4GHz和5GHz低段，另一块扫5GHz其余信道）
+std::vector<std::vector<uint32_t> > partitionChannels(
+    const std::vector<uint32_t> &freqs, int n);
+
+#if HAVE_NETWORKMANAGER
+typedef struct _NMClient NMClient;
+typedef struct _GMainContext GMainContext;
+
+class NmScanBackend : public ScanBackend {
+ public:
+  // ifname为空时使用第一个WiFi设备
+  explicit NmScanBackend(const char *ifname = nullptr);
+  ~NmScanBackend();
+
+  bool scan(std::vector<WiFiNetwork> &out, const char *ssid = nullptr);
+  uint64_t timeUs(void) const { return last_us; }
+
+  // 所有WiFi网卡的接口名
+  static std::vector<std::string> interfaces(void);
+
+ private:
+  // 每个后端用自己的GMainContext，多块网卡可以在不同线程里同时扫描。
+  // NM的扫描请求不能指定信道，setChannels无效；分信道扫描用Nl80211ScanBackend
+  GMainContext *context;
+  NMClient *client;
+  std::string ifname;
+  uint64_t last_us;
+};
+#endif
+
+class Nl80211;
+
+// 直接通过nl80211触发扫描（NL80211_CMD_TRIGGER_SCAN），可以只扫描
+// setChannels指定的信道。网卡不支持的信道跳过；网卡正忙（NM在扫描）或
+// 没有CAP_NET_ADMIN时不触发扫描，返回内核缓存中这些信道的结果。
+class Nl80211ScanBackend : public ScanBackend {
+ public:
+  // ifname为空时使用第一个客户端模式的网卡
+  explicit Nl80211ScanBackend(const char *ifname = nullptr);
+  ~Nl80211ScanBackend();
+
+  bool scan(std::vector<WiFiNetwork> &out, const char *ssid = nullptr);
+  uint64_t timeUs(void) const { return last_us; }
+
+ private:
+  bool resolve(void);
+
+  Nl80211 *nl;
+  std::string ifname;
+  int ifindex;
+  std::vector<uint32_t> supported;  // 网卡可用的信道
+  uint64_t last_us;
+
+  Nl80211ScanBackend(const Nl80211ScanBackend &);
+  Nl80211ScanBackend &operator=(const Nl80211ScanBackend &);
+};
+
+class ReplayScanBackend : public ScanBackend {
+ public:
+  ReplayScanBackend();
+  bool load(const char *path);
+
+  // 依次返回文件中的扫描，读完后返回false；定向扫描返回最近一次扫描中
+  // 该SSID的部分
+  bool scan(std::vector<WiFiNetwork> &out, const char *ssid = nullptr);
+  uint64_t timeUs(void) const { return last_us; }
+  bool done(void) const { return next >= scans.size(); }
+  // 下一次扫描的时间，已读完时为最后一次的时间
+  uint64_t nextTimeUs(void) const;
+  // 模拟每个信道的驻留时间：每次扫描睡眠 驻留×信道数，用于比较多网卡的扫描耗时
+  void setDwell(uint32_t ms) { dwell_ms = ms; }
+
+ private:
+  struct Scan {
+    uint64_t time_us;
+    std::vector<WiFiNetwork> networks;
+  };
+  std::vector<Scan> scans;
+  size_t next;
+  uint64_t last_us;
+  uint32_t dwell_ms;
+};
+
+// 多网卡并行扫描：信道按partitionChannels分给各网卡，各网卡同时扫描，
+// 结果合并成按BSSID去重的一张表（保留信号最强的一条）。每块网卡的结果
+// 写进自己的槽位，线程汇合后由调用线程合并，扫描期间不共享任何状态。
+class MultiRadioScanBackend : public ScanBackend {
+ public:
+  // 接管radios；全部信道为defaultChannels()，可用setChannels改变
+  explicit MultiRadioScanBackend(const std::vector<ScanBackend *> &radios);
+  ~MultiRadioScanBackend();
+
+  bool scan(std::vector<WiFiNetwork> &out, const char *ssid = nullptr);
+  uint64_t timeUs(void) const { return last_us; }
+  void setChannels(const std::vector<uint32_t> &freqs);
+
+  size_t radioCount(void) const { return radios.size(); }
+  const std::vector<uint32_t> &radioChannels(size_t i) const {
+    return radios[i].channels;
+  }
+  // 最近一次扫描中该网卡的耗时
+  uint64_t radioElapsedUs(size_t i) const { return radios[i].elapsed_us; }
+
+ private:
+  struct Radio {
+    ScanBackend *backend;
+    std::vector<uint32_t> channels;
+    std::vector<WiFiNetwork> result;
+    bool ok;
+    uint64_t elapsed_us;
+  };
+  static void scanRadio(Radio &r, const char *ssid);
+
+  std::vector<Radio> radios;
+  uint64_t last_us;
+
+  MultiRadioScanBackend(const MultiRadioScanBackend &);
+  MultiRadioScanBackend &operator=(const MultiRadioScanBackend &);
+};
+
+// 追加一段扫描记录（回放文件格式）
+void writeScan(FILE *fp, uint64_t time_us, const std::vector<WiFiNetwork> &networks);
+
+#endif  // WIFI_SCAN_H
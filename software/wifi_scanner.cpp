@@ -1,4 +1,7 @@
 #include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <wiringPi.h>
 
@@ -9,171 +12,222 @@
 #include <string>
 #include <vector>
 
+#include "animation.h"
+#include "display_client.h"
+#include "frame_recorder.h"
+#include "input.h"
+#include "mirror.h"
 #include "oled.h"
-
-// NetworkManager头文件
-#include <NetworkManager.h>
-#include <glib.h>
-#include <nm-dbus-interface.h>
+#include "raster.h"
+#include "static_frame.h"
+#include "stats.h"
+#include "text_layout.h"
+#include "wifi_scan.h"
 
 OLED *oled = nullptr;
+DisplayClient *display = nullptr;  // 通过显示服务绘制时非空
+FrameRecorder recorder;
+GpioChipSource gpio;
+InputManager *input = nullptr;  // 未配置按键时为空
+ScanBackend *scanner = nullptr;
+TextCache labels;  // SSID和信号强度每轮扫描基本不变，缓存渲染好的行
+
+#define LIST_ROWS 8  // 每屏显示的网络数（每行8像素）
+
+// 列表浏览状态
+struct ListView {
+  int top;       // 第一行显示的网络
+  int selected;  // 选中的网络，-1为未选中
+  bool detail;   // 显示选中网络的详情
+};
+ListView view = {0, -1, false};
 
-// WiFi网络信息结构体
-struct WiFiNetwork {
-  std::string ssid;
-  int signal_strength;  // 信号强度 (0-100)
-  bool secured;         // 是否加密
+// 启动画面在编译期渲染，随初始化一次上传
+constexpr StaticText kSplashTexts[] = {
+    {10, 10, 16, "WiFi Scanner"},
+    {5, 30, 12, "NanoPi Duo2"},
+    {15, 45, 12, "Scanning..."},
 };
+constexpr StaticFrame kSplash = renderStaticFrame(kSplashTexts, 3);
+
+// 信号处理函数：只置退出标志，主循环退出后统一清理。
+// 不设置SA_RESTART，让按键等待被信号打断后检查标志
+static volatile sig_atomic_t running = 1;
 
-// 信号处理函数
 void signalHandler(int signum) {
-  std::cout << "Interrupt signal (" << signum << ") received.\n";
-  if (oled != nullptr) {
-    oled->clear();
-    oled->sleep();
-    delete oled;
-  }
-  // 不需要调用nm_client_stop()，直接退出
-  exit(signum);
+  (void)signum;
+  running = 0;
 }
 
-// 获取WiFi网络列表
-std::vector<WiFiNetwork> scanWiFiNetworks() {
-  std::vector<WiFiNetwork> networks;
+// 获取WiFi网络列表（按信号强度排序）
+// 扫描失败时返回false（回放后端表示文件已读完）
+bool scanWiFiNetworks(std::vector<WiFiNetwork> &networks) {
+  std::cout << "Scanning for WiFi networks..." << std::endl;
+  if (!scanner->scan(networks)) return false;
+  std::cout << "Found " << networks.size() << " access points" << std::endl;
+  return true;
+}
 
-  GError *error = nullptr;
-  NMClient *client = nm_client_new(nullptr, &error);
+// 绘制网络列表，y_offset用于滑入动画，从第top个网络开始，选中行反色
+void drawNetworkList(OLED &o, const std::vector<WiFiNetwork> &networks,
+                     int y_offset, int top = 0, int selected = -1) {
+  int max_display = std::min(LIST_ROWS, (int)networks.size() - top);
 
-  if (!client) {
-    std::cerr << "Failed to create NMClient: " << error->message << std::endl;
-    g_error_free(error);
-    return networks;
+  for (int i = 0; i < max_display; i++) {
+    const WiFiNetwork &network = networks[top + i];
+    int y_pos = i * 8 + y_offset;  // 每行8像素
+    if (y_pos >= OLED_MAX_ROW) break;
+
+    // SSID放不下时在信号强度一栏之前截断加省略号
+    labels.drawInt(o, 109, y_pos, network.signal_strength, 3, 12);
+    labels.draw(o, 0, y_pos, network.ssid.c_str(), 12, 108, TEXT_ELLIPSIS);
+    if (top + i == selected) {
+      rasterInvertRect(o.getPage_GRAM(0), 0, y_pos, OLED_MAX_COLUMN - 1,
+                       y_pos + 7);
+    }
   }
+}
 
-  // 获取所有设备
-  const GPtrArray *devices = nm_client_get_devices(client);
-  if (!devices) {
-    std::cerr << "No devices found" << std::endl;
-    g_object_unref(client);
-    return networks;
-  }
+// 选中网络的详情：完整SSID、信号强度、加密方式
+void drawNetworkDetail(OLED &o, const WiFiNetwork &network) {
+  labels.draw(o, 0, 0, network.ssid.c_str(), 12, 0, TEXT_WRAP, 4);
+  char line[24];
+  snprintf(line, sizeof(line), "Signal: %d%%", network.signal_strength);
+  o.showString_GRAM(0, 40, line, 12);
+  o.showString_GRAM(0, 52, network.secured ? "Secured" : "Open", 12);
+}
 
-  // 查找WiFi设备
-  NMDeviceWifi *wifi_device = nullptr;
-  for (guint i = 0; i < devices->len; i++) {
-    NMDevice *device = (NMDevice *)devices->pdata[i];
-    if (NM_IS_DEVICE_WIFI(device)) {
-      wifi_device = NM_DEVICE_WIFI(device);
-      break;
+// 处理一个输入事件，界面有变化时只重绘GRAM并增量上传
+void handleInput(const InputEvent &ev,
+                 const std::vector<WiFiNetwork> &networks) {
+  if (networks.empty() || ev.type == INPUT_RELEASE) return;
+
+  int move = 0;
+  if (ev.type == INPUT_ROTATE) {
+    move = ev.delta;
+  } else if (ev.key == INPUT_KEY_UP) {
+    move = -1;
+  } else if (ev.key == INPUT_KEY_DOWN) {
+    move = 1;
+  } else if (ev.key == INPUT_KEY_SELECT) {
+    if (view.selected < 0) view.selected = 0;
+    view.detail = !view.detail;
+  } else if (ev.key == INPUT_KEY_BACK) {
+    if (view.detail) {
+      view.detail = false;
+    } else {
+      view.selected = -1;
     }
   }
 
-  if (!wifi_device) {
-    std::cerr << "No WiFi device found" << std::endl;
-    g_object_unref(client);
-    return networks;
+  if (move && !view.detail) {
+    int n = (int)networks.size();
+    view.selected = view.selected < 0 ? 0 : view.selected + move;
+    view.selected = std::max(0, std::min(n - 1, view.selected));
+    if (view.selected < view.top) view.top = view.selected;
+    if (view.selected >= view.top + LIST_ROWS) {
+      view.top = view.selected - LIST_ROWS + 1;
+    }
   }
 
-  // 请求扫描 - 使用正确的参数数量
-  nm_device_wifi_request_scan(wifi_device, nullptr, &error);
-  std::cout << "Scanning for WiFi networks..." << std::endl;
-
-  // 等待扫描完成（简单延时）
-  sleep(5);
-
-  // 获取扫描结果
-  const GPtrArray *aps = nm_device_wifi_get_access_points(wifi_device);
-  if (!aps) {
-    std::cerr << "No access points found" << std::endl;
-    g_object_unref(client);
-    return networks;
+  oled->clear_GRAM();
+  if (view.detail) {
+    drawNetworkDetail(*oled, networks[view.selected]);
+  } else {
+    drawNetworkList(*oled, networks, 0, view.top, view.selected);
   }
+  oled->present();
+  statsRecord(STAT_INPUT, monotonicUs() - ev.received_us);
+}
 
-  std::cout << "Found " << aps->len << " access points" << std::endl;
-
-  // 提取网络信息
-  for (guint i = 0; i < aps->len; i++) {
-    NMAccessPoint *ap = (NMAccessPoint *)aps->pdata[i];
-
-    WiFiNetwork network;
-
-    // 获取SSID
-    GBytes *ssid_bytes = nm_access_point_get_ssid(ap);
-    if (ssid_bytes) {
-      gsize len;
-      const char *ssid_data = (const char *)g_bytes_get_data(ssid_bytes, &len);
-      network.ssid = std::string(ssid_data, len);
-      // 过滤不可打印字符
-      for (char &c : network.ssid) {
-        if (c < 32 || c > 126) c = '?';
-      }
-    } else {
-      network.ssid = "Hidden Network";
+// 等待到下一次扫描，期间处理按键；没有配置按键时直接延时
+// 收到退出信号后最多再等WAIT_SLICE_MS
+#define WAIT_SLICE_MS 100
+
+void waitForInput(const std::vector<WiFiNetwork> &networks, int ms) {
+  uint64_t deadline = monotonicUs() + ms * 1000ULL;
+  for (uint64_t now = monotonicUs(); now < deadline && running;
+       now = monotonicUs()) {
+    int slice = std::min((int)((deadline - now + 999) / 1000), WAIT_SLICE_MS);
+    InputEvent ev;
+    if (!input) {
+      delay(slice);
+    } else if (input->wait(ev, slice)) {
+      handleInput(ev, networks);
     }
+  }
+}
 
-    // 获取信号强度
-    network.signal_strength = nm_access_point_get_strength(ap);
-
-    // 检查是否加密
-    NM80211ApFlags flags = nm_access_point_get_flags(ap);
-    NM80211ApSecurityFlags wpa_flags = nm_access_point_get_wpa_flags(ap);
-    NM80211ApSecurityFlags rsn_flags = nm_access_point_get_rsn_flags(ap);
-
-    network.secured = (flags & NM_802_11_AP_FLAGS_PRIVACY) ||
-                      (wpa_flags != NM_802_11_AP_SEC_NONE) ||
-                      (rsn_flags != NM_802_11_AP_SEC_NONE);
-
-    networks.push_back(network);
+// 解析逗号分隔的GPIO线偏移，"-"表示不使用
+static std::vector<int> parseLines(const char *spec) {
+  std::vector<int> lines;
+  std::stringstream ss(spec ? spec : "");
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    lines.push_back(item.empty() || item == "-" ? -1 : atoi(item.c_str()));
   }
+  return lines;
+}
 
-  // 按信号强度排序
-  std::sort(networks.begin(), networks.end(),
-            [](const WiFiNetwork &a, const WiFiNetwork &b) {
-              return a.signal_strength > b.signal_strength;
-            });
+// WIFI_SCANNER_KEYS="上,下,确认,返回"与WIFI_SCANNER_ENCODER="A,B"为
+// WIFI_SCANNER_GPIOCHIP（默认/dev/gpiochip0）上的线偏移
+static void setupInput(void) {
+  std::vector<int> keys = parseLines(getenv("WIFI_SCANNER_KEYS"));
+  std::vector<int> encoder = parseLines(getenv("WIFI_SCANNER_ENCODER"));
+  static const InputKey kKeyOrder[] = {INPUT_KEY_UP, INPUT_KEY_DOWN,
+                                       INPUT_KEY_SELECT, INPUT_KEY_BACK};
+
+  std::vector<uint32_t> offsets;
+  std::vector<InputKey> roles;
+  for (size_t i = 0; i < keys.size() && i < 4; i++) {
+    if (keys[i] < 0) continue;
+    offsets.push_back(keys[i]);
+    roles.push_back(kKeyOrder[i]);
+  }
+  bool has_encoder = encoder.size() == 2 && encoder[0] >= 0 && encoder[1] >= 0;
+  if (has_encoder) {
+    offsets.push_back(encoder[0]);
+    offsets.push_back(encoder[1]);
+  }
+  if (offsets.empty()) return;
 
-  g_object_unref(client);
-  return networks;
+  const char *chip = getenv("WIFI_SCANNER_GPIOCHIP");
+  if (!gpio.open(chip ? chip : "/dev/gpiochip0", offsets)) {
+    std::cout << "GPIO input unavailable, continuing without buttons"
+              << std::endl;
+    return;
+  }
+  input = new InputManager(&gpio);
+  for (size_t i = 0; i < roles.size(); i++) input->bindButton(i, roles[i]);
+  if (has_encoder) input->bindEncoder(roles.size(), roles.size() + 1);
 }
 
-// 在OLED上显示WiFi网络列表（使用常规OLED操作）
+// 在OLED上显示WiFi网络列表，只上传与上一帧相比变化的区域
 void displayWiFiNetworks(const std::vector<WiFiNetwork> &networks) {
   if (!oled) return;
 
-  oled->clear();  // 使用常规清屏
+  oled->clear_GRAM();
 
   if (networks.empty()) {
     oled->showString_GRAM(0, 8, "No networks found", 12);
+    oled->present();
     return;
   }
 
-  // 显示网络列表（最多显示6个）
-  int max_display = std::min(8, (int)networks.size());
-
-  for (int i = 0; i < max_display; i++) {
-    const WiFiNetwork &network = networks[i];
-    int y_pos = i * 8;  // 每行8像素
-
-    std::string display_ssid = network.ssid;
-    if (display_ssid.length() > 10) {
-      display_ssid = display_ssid.substr(0, 10) + "...";
-    }
-
-    int signal_bars = (int)(network.signal_strength * 0.08f);
-    oled->showNum_GRAM(109, y_pos, network.signal_strength, 3, 12);
-    // for (uint8_t i = 0; i < signal_bars; i++) {
-    //   for(uint8_t j = 0; j < 8; j++) {
-    //     oled->drawPixel_GRAM(119 + i, y_pos + 8 - j, WHITE);
-    //   }
-    // }
-
-    oled->showString_GRAM(0, y_pos, display_ssid.c_str(), 12);
-  }
-  oled->refresh();
+  // 列表从底部滑入
+  Animator animator(*oled);
+  animator.add(new SlideAnimation(
+      0, OLED_MAX_ROW, 0, 0, 300000,
+      [&networks](OLED &o, int x, int y) { drawNetworkList(o, networks, y); }));
+  animator.run();
 }
 
 int main() {
-  signal(SIGINT, signalHandler);
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = signalHandler;
+  sigaction(SIGINT, &sa, nullptr);
+  sigaction(SIGTERM, &sa, nullptr);
 
   std::cout << "Initializing WiFi Scanner for NanoPi Duo2..." << std::endl;
 
@@ -183,55 +237,145 @@ int main() {
     return 1;
   }
 
-  // 创建OLED对象
-  oled = new OLED(0, 0x3C);
-
-  // 初始化OLED
-  std::cout << "Initializing OLED..." << std::endl;
-  if (!oled->init()) {
-    std::cout << "OLED initialization failed!" << std::endl;
-    delete oled;
-    return 1;
+  // 设置了OLED_SERVER时作为显示服务的客户端，占用整个屏幕
+  const char *server_path = getenv("OLED_SERVER");
+  if (server_path) {
+    display = new DisplayClient();
+    if (!display->connect(0, 0, OLED_MAX_COLUMN, OLED_MAX_ROW, "wifi_scanner",
+                          server_path)) {
+      std::cout << "Failed to connect to display server!" << std::endl;
+      delete display;
+      return 1;
+    }
+    oled = &display->canvas();
+    memcpy(oled->getPage_GRAM(0), kSplash.data, sizeof(kSplash.data));
+    oled->refresh();
+  } else {
+    // 创建OLED对象
+    oled = new OLED(0, 0x3C);
+
+    // 快速启动：初始化命令、启动画面和开显示共三次I2C传输
+    std::cout << "Initializing OLED..." << std::endl;
+    if (!oled->fastInit(kSplash.data)) {
+      std::cout << "OLED initialization failed!" << std::endl;
+      delete oled;
+      return 1;
+    }
   }
 
-  std::cout << "OLED initialized successfully!" << std::endl;
+  std::cout << "OLED initialized successfully, splash shown "
+            << processAgeUs() / 1000 << " ms after process start"
+            << std::endl;
+
+  // 统计文件，供本地脚本抓取（可用WIFI_SCANNER_STATS指定路径）
+  const char *stats_path = getenv("WIFI_SCANNER_STATS");
+  statsStartExporter(stats_path ? stats_path : "/tmp/wifi_scanner.stats");
+
+  setupInput();
+
+  // 设置WIFI_SCANNER_REPLAY时回放录制的扫描，不访问NetworkManager；
+  // WIFI_SCANNER_RADIOS=n时模拟n块网卡分信道扫描
+  const char *replay_path = getenv("WIFI_SCANNER_REPLAY");
+  if (replay_path) {
+    const char *radios_env = getenv("WIFI_SCANNER_RADIOS");
+    int radios = radios_env ? atoi(radios_env) : 1;
+    std::vector<ScanBackend *> replays;
+    bool loaded = true;
+    for (int i = 0; loaded && i < std::max(radios, 1); i++) {
+      ReplayScanBackend *replay = new ReplayScanBackend();
+      loaded = replay->load(replay_path);
+      replays.push_back(replay);
+    }
+    if (loaded) {
+      scanner = radios > 1 ? new MultiRadioScanBackend(replays) : replays[0];
+    } else {
+      for (size_t i = 0; i < replays.size(); i++) delete replays[i];
+    }
+  } else {
+#if HAVE_NETWORKMANAGER
+    // 所有WiFi网卡分信道同时扫描（nl80211才能指定信道），结果按BSSID合并
+    std::vector<std::string> ifaces = NmScanBackend::interfaces();
+    if (ifaces.size() > 1) {
+      std::vector<ScanBackend *> radios;
+      for (size_t i = 0; i < ifaces.size(); i++) {
+        radios.push_back(new Nl80211ScanBackend(ifaces[i].c_str()));
+      }
+      std::cout << "Scanning with " << ifaces.size() << " radios" << std::endl;
+      scanner = new MultiRadioScanBackend(radios);
+    } else {
+      scanner = new NmScanBackend();
+    }
+#else
+    std::cout << "Built without NetworkManager, set WIFI_SCANNER_REPLAY"
+              << std::endl;
+#endif
+  }
+  // 没有扫描后端时不进入主循环，但仍走下面的清理（统计线程、输入、屏幕）
+  int status = scanner ? 0 : 1;
+
+  // 设置WIFI_SCANNER_RECORD时录制上传的帧，供oled_replay离线分析
+  const char *record_path = getenv("WIFI_SCANNER_RECORD");
+  if (record_path && recorder.open(record_path)) oled->setRecorder(&recorder);
+
+  // 设置WIFI_SCANNER_MIRROR=端口时把上传的帧推给远程查看器（oled_mirror）
+  const char *mirror_port = getenv("WIFI_SCANNER_MIRROR");
+  MirrorServer *mirror = nullptr;
+  if (mirror_port) {
+    mirror = new MirrorServer(atoi(mirror_port));
+    if (mirror->start()) oled->setMirror(mirror);
+  }
 
-  // 显示启动信息
-  oled->clear();
-  oled->showString_GRAM(10, 10, "WiFi Scanner", 16);
-  oled->showString_GRAM(5, 30, "NanoPi Duo2", 12);
-  oled->showString_GRAM(15, 45, "Scanning...", 12);
-  oled->refresh();
-  while (true) {
+  while (running && scanner) {
     // 扫描WiFi网络
     std::vector<WiFiNetwork> networks;
 
-    std::cout << "Scanning for WiFi networks..." << std::endl;
-
-    // 尝试使用NetworkManager扫描
-    networks = scanWiFiNetworks();
+    // 尝试使用NetworkManager扫描；回放读完后退出，不再重复扫描
+    if (!scanWiFiNetworks(networks) && replay_path) {
+      std::cout << "Replay finished, exiting" << std::endl;
+      break;
+    }
 
     std::cout << "Found " << networks.size() << " WiFi networks" << std::endl;
 
     if (networks.empty()) {
       // 没有找到网络
-      oled->clear();
-      oled->showString(10, 20, "No WiFi Networks", 12);
-      oled->showString(15, 35, "Found!", 12);
-      oled->refresh();
-    } else {
-      oled->clear();
       oled->clear_GRAM();
-
-      // 显示网络列表
+      oled->showString_GRAM(10, 20, "No WiFi Networks", 12);
+      oled->showString_GRAM(15, 35, "Found!", 12);
+      oled->present();
+      // 扫描立即返回时（没有网卡等）同样等待，避免空转重绘
+      waitForInput(networks, 5000);
+    } else {
+      // 显示网络列表，每次扫描后回到列表顶部
+      view.top = 0;
+      view.selected = -1;
+      view.detail = false;
       displayWiFiNetworks(networks);
       // oled->showArrow(120,1,0);
       // oled->showArrow(120,2,1);
       // oled->showArrow(120,3,2);
       // oled->showArrow(120,4,3);
-      delay(5000);
-      oled->clear();
+      waitForInput(networks, 5000);
     }
   }
-  return 0;
+
+  if (scanner && !running) {
+    std::cout << "Interrupt signal received, exiting" << std::endl;
+  }
+  oled->setRecorder(nullptr);
+  oled->setMirror(nullptr);
+  recorder.close();
+  delete mirror;
+  if (display != nullptr) {
+    delete display;
+  } else {
+    oled->clear();
+    oled->sleep();
+    delete oled;
+  }
+  delete input;
+  // 不需要调用nm_client_stop()
+  delete scanner;
+  statsStopExporter();
+  return status;
 }